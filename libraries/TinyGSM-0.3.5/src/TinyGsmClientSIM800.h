@@ -16,9 +16,33 @@
   #define TINY_GSM_RX_BUFFER 64
 #endif
 
-#define TINY_GSM_MUX_COUNT 5
+#if !defined(TINY_GSM_MUX_COUNT)
+  #define TINY_GSM_MUX_COUNT 5
+#endif
+
+// Chunk size for copying the +CIPRXGET data from the stream into the rx fifo
+#if !defined(TINY_GSM_RX_CHUNK)
+  #define TINY_GSM_RX_CHUNK 32
+#endif
+
+// Called before every AT command and before maintain() reads the stream,
+// i.e. to finish an asynchronous command first
+#if !defined(TINY_GSM_SEND_HOOK)
+  #define TINY_GSM_SEND_HOOK()
+#endif
+
+// Called with every complete unsolicited line (const char*), returns true if the line is consumed
+#if !defined(TINY_GSM_URC_HOOK)
+  #define TINY_GSM_URC_HOOK(line) false
+#endif
+
+// Maximum length of a received line which is passed to the TINY_GSM_URC_HOOK
+#if !defined(TINY_GSM_LINE_SIZE)
+  #define TINY_GSM_LINE_SIZE 128
+#endif
 
 #include <TinyGsmCommon.h>
+#include <TinyGsmMatcher.h>
 
 #define GSM_NL "\r\n"
 static const char GSM_OK[] TINY_GSM_PROGMEM = "OK" GSM_NL;
@@ -126,8 +150,8 @@ public:
       // TODO: Currently we ping the module periodically,
       // but maybe there's a better indicator that we need to poll
       if (millis() - prev_check > 500) {
-        got_data = true;
         prev_check = millis();
+        sock_available = at->modemGetAvailable(mux);
       }
       at->maintain();
     }
@@ -136,7 +160,6 @@ public:
 
   virtual int read(uint8_t *buf, size_t size) {
     TINY_GSM_YIELD();
-    at->maintain();
     size_t cnt = 0;
     while (cnt < size && sock_connected) {
       size_t chunk = TinyGsmMin(size-cnt, rx.size());
@@ -147,9 +170,15 @@ public:
         continue;
       }
       // TODO: Read directly into user buffer?
-      at->maintain();
+      if (sock_available == 0) {
+        at->maintain();
+      }
+      if (rx.size() > 0) {
+        continue;
+      }
       if (sock_available > 0) {
-        at->modemRead(rx.free(), mux);
+        // Request only what fits into the fifo and what the modem has
+        at->modemRead(TinyGsmMin((size_t)rx.free(), (size_t)sock_available), mux);
       } else {
         break;
       }
@@ -258,11 +287,17 @@ public:
   }
 
   void maintain() {
+    // The answer of an asynchronous command in flight is not for us
+    TINY_GSM_SEND_HOOK();
     for (int mux = 0; mux < TINY_GSM_MUX_COUNT; mux++) {
       GsmClient* sock = sockets[mux];
       if (sock && sock->got_data) {
         sock->got_data = false;
-        sock->sock_available = modemGetAvailable(mux);
+        // The +CIPRXGET: 1 notification says that data is waiting, so read
+        // it directly. The answer contains the remaining size as well.
+        if (!sock->rx.free() || !modemRead(sock->rx.free(), mux)) {
+          sock->sock_available = modemGetAvailable(mux);
+        }
       }
     }
     while (stream.available()) {
@@ -270,6 +305,14 @@ public:
     }
   }
 
+  // Marks the data of a +CIPRXGET: 1 notification which was read outside
+  // of waitResponse(), the next maintain() reads it directly.
+  void notifyData(int mux) {
+    if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
+      sockets[mux]->got_data = true;
+    }
+  }
+
   bool factoryDefault() {
     sendAT(GF("&FZE0&W"));  // Factory + Reset + Echo Off + Write
     waitResponse();
@@ -844,26 +887,27 @@ protected:
     size_t len = stream.readStringUntil(',').toInt();
     sockets[mux]->sock_available = stream.readStringUntil('\n').toInt();
 
-    for (size_t i=0; i<len; i++) {
 #ifdef TINY_GSM_USE_HEX
+    for (size_t i=0; i<len; i++) {
       while (stream.available() < 2) { TINY_GSM_YIELD(); }
       char buf[4] = { 0, };
       buf[0] = stream.read();
       buf[1] = stream.read();
       char c = strtol(buf, NULL, 16);
+      sockets[mux]->rx.put(c);
+    }
 #else
-      while (!stream.available()) { TINY_GSM_YIELD(); }
-      // Original!!!
-      // char c = stream.read();
-      // New: Check the return value!
-      char c = stream.read();
-      if (c == -1) {
+    // Copy the data in chunks instead of byte by byte into the fifo
+    uint8_t chunk[TINY_GSM_RX_CHUNK];
+    for (size_t i=0; i<len; ) {
+      size_t n = stream.readBytes((char*)chunk, TinyGsmMin(len-i, (size_t)TINY_GSM_RX_CHUNK));
+      if (n == 0) { // Timeout
          return i;
       }
-      // Ende
+      sockets[mux]->rx.put(chunk, n);
+      i += n;
+    }
 #endif
-       sockets[mux]->rx.put(c);
-  }
     waitResponse();
     return len;
   }
@@ -919,6 +963,7 @@ public:
 
   template<typename... Args>
   void sendAT(Args... cmd) {
+    TINY_GSM_SEND_HOOK();
     streamWrite("AT", cmd..., GSM_NL);
     stream.flush();
     TINY_GSM_YIELD();
@@ -930,84 +975,131 @@ public:
                        GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
                        GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
   {
-    /*String r1s(r1); r1s.trim();
-    String r2s(r2); r2s.trim();
-    String r3s(r3); r3s.trim();
-    String r4s(r4); r4s.trim();
-    String r5s(r5); r5s.trim();
-    DBG("### ..:", r1s, ",", r2s, ",", r3s, ",", r4s, ",", r5s);*/
     data.reserve(64);
+    return waitResponse(timeout, &data, r1, r2, r3, r4, r5);
+  }
+
+  uint8_t waitResponse(uint32_t timeout,
+                       GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
+                       GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
+  {
+    return waitResponse(timeout, (String*)NULL, r1, r2, r3, r4, r5);
+  }
+
+  uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
+                       GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
+  {
+    return waitResponse(1000, r1, r2, r3, r4, r5);
+  }
+
+protected:
+  /*
+   * Waits for one of the patterns r1..r5 at the end of the received bytes.
+   * The bytes are only collected if data is given, the patterns are matched
+   * byte by byte with a fixed size automaton and the current line is kept in
+   * a fixed buffer for the urc handling.
+   */
+  uint8_t waitResponse(uint32_t timeout, String* data,
+                       GsmConstStr r1, GsmConstStr r2,
+                       GsmConstStr r3, GsmConstStr r4, GsmConstStr r5)
+  {
+    TinyGsmMatcher matcher;
+    char line[TINY_GSM_LINE_SIZE];
+    size_t lineLen = 0;
+    size_t lineStart = 0;
     int index = 0;
+
+    matcher.set(0, r1);
+    matcher.set(1, r2);
+    matcher.set(2, r3);
+    matcher.set(3, r4);
+    matcher.set(4, r5);
+    matcher.set(5, GF(GSM_NL "+CIPRXGET:"));
+    matcher.set(6, GF("CLOSED" GSM_NL));
+    matcher.set(7, GF(GSM_NL));
     unsigned long startMillis = millis();
     do {
       TINY_GSM_YIELD();
       while (stream.available() > 0) {
         int a = stream.read();
         if (a <= 0) continue; // Skip 0x00 bytes, just in case
-        data += (char)a;
-        if (r1 && data.endsWith(r1)) {
-          index = 1;
-          goto finish;
-        } else if (r2 && data.endsWith(r2)) {
-          index = 2;
-          goto finish;
-        } else if (r3 && data.endsWith(r3)) {
-          index = 3;
-          goto finish;
-        } else if (r4 && data.endsWith(r4)) {
-          index = 4;
-          goto finish;
-        } else if (r5 && data.endsWith(r5)) {
-          index = 5;
+        if (data) {
+          *data += (char)a;
+        }
+        if (lineLen < sizeof(line)) {
+          line[lineLen] = (char)a;
+        }
+        lineLen++;
+        uint8_t match = matcher.feed((char)a);
+        if (match >= 1 && match <= 5) {
+          index = match;
           goto finish;
-        } else if (data.endsWith(GF(GSM_NL "+CIPRXGET:"))) {
+        } else if (match == 6) {
           String mode = stream.readStringUntil(',');
           if (mode.toInt() == 1) {
             int mux = stream.readStringUntil('\n').toInt();
             if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
               sockets[mux]->got_data = true;
             }
-            data = "";
+            if (data) {
+              *data = "";
+            }
+            matcher.reset();
+            lineLen = 0;
+            lineStart = 0;
           } else {
-            data += mode;
+            for (unsigned i = 0; i < mode.length(); i++) {
+              if (data) {
+                *data += mode[i];
+              }
+              if (lineLen < sizeof(line)) {
+                line[lineLen] = mode[i];
+              }
+              lineLen++;
+              matcher.feed(mode[i]);
+            }
           }
-        } else if (data.endsWith(GF("CLOSED" GSM_NL))) {
-          int nl = data.lastIndexOf(GSM_NL, data.length()-8);
-          int coma = data.indexOf(',', nl+2);
-          int mux = data.substring(nl+2, coma).toInt();
+        } else if (match == 7) {
+          int mux = lineLen <= sizeof(line) ? atoi(line) : -1;
           if (mux >= 0 && mux < TINY_GSM_MUX_COUNT && sockets[mux]) {
             sockets[mux]->sock_connected = false;
           }
-          data = "";
+          if (data) {
+            *data = "";
+          }
+          matcher.reset();
+          lineLen = 0;
+          lineStart = 0;
           DBG("### Closed: ", mux);
+        } else if (match == 8) {
+          // Longer lines are data and no urcs
+          if (lineLen > 2 && lineLen <= sizeof(line)) {
+            line[lineLen-2] = 0;
+            if (TINY_GSM_URC_HOOK(line) && data) {
+              data->remove(lineStart);
+            }
+          }
+          lineLen = 0;
+          lineStart = data ? data->length() : 0;
         }
       }
     } while (millis() - startMillis < timeout);
 finish:
     if (!index) {
-      data.trim();
-      if (data.length()) {
-        DBG("### Unhandled:", data);
+      if (data) {
+        data->trim();
+        if (data->length()) {
+          DBG("### Unhandled:", *data);
+        }
+        *data = "";
+      } else if (lineLen > 0 && lineLen < sizeof(line)) {
+        line[lineLen] = 0;
+        DBG("### Unhandled:", line);
       }
-      data = "";
     }
     return index;
   }
 
-  uint8_t waitResponse(uint32_t timeout,
-                       GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
-                       GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
-  {
-    String data;
-    return waitResponse(timeout, data, r1, r2, r3, r4, r5);
-  }
-
-  uint8_t waitResponse(GsmConstStr r1=GFP(GSM_OK), GsmConstStr r2=GFP(GSM_ERROR),
-                       GsmConstStr r3=NULL, GsmConstStr r4=NULL, GsmConstStr r5=NULL)
-  {
-    return waitResponse(1000, r1, r2, r3, r4, r5);
-  }
-
 public:
   Stream&       stream;
 
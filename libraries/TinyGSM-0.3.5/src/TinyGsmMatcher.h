@@ -0,0 +1,121 @@
+/**
+ * @file       TinyGsmMatcher.h
+ * @license    LGPL-3.0
+ * @date       Jan 2019
+ */
+
+#ifndef TinyGsmMatcher_h
+#define TinyGsmMatcher_h
+
+#ifndef TINY_GSM_MATCH_PATTERNS
+  #define TINY_GSM_MATCH_PATTERNS 8
+#endif
+
+#ifndef TINY_GSM_MATCH_LEN
+  #define TINY_GSM_MATCH_LEN 32
+#endif
+
+/**
+ * Finds the patterns at the end of a byte stream without buffering the stream.
+ * The failure table of every pattern is built once (Knuth-Morris-Pratt), then
+ * every byte advances the state of each pattern in amortized constant time.
+ * A pattern is found on the same byte as with data.endsWith(pattern).
+ */
+class TinyGsmMatcher
+{
+public:
+  TinyGsmMatcher()
+  {
+    for (uint8_t i = 0; i < TINY_GSM_MATCH_PATTERNS; i++) {
+      _pattern[i] = NULL;
+      _len[i] = 0;
+      _state[i] = 0;
+    }
+  }
+
+  // Sets the pattern of the slot, NULL, empty or too long patterns never match
+  void set(uint8_t slot, GsmConstStr pattern)
+  {
+    const char* p = reinterpret_cast<const char*>(pattern);
+    uint8_t len = 0;
+
+    if (slot >= TINY_GSM_MATCH_PATTERNS) {
+      return;
+    }
+    while (p && at(p, len) && len <= TINY_GSM_MATCH_LEN) {
+      len++;
+    }
+    if (len > TINY_GSM_MATCH_LEN) {
+      len = 0;
+    }
+    _pattern[slot] = len ? p : NULL;
+    _len[slot] = len;
+    _state[slot] = 0;
+
+    // _fail[i] is the length of the longest proper prefix which is also a suffix of p[0..i]
+    uint8_t k = 0;
+    _fail[slot][0] = 0;
+    for (uint8_t i = 1; i < len; i++) {
+      while (k > 0 && at(p, i) != at(p, k)) {
+        k = _fail[slot][k-1];
+      }
+      if (at(p, i) == at(p, k)) {
+        k++;
+      }
+      _fail[slot][i] = k;
+    }
+  }
+
+  // Forgets the received bytes, i.e. after the collected data was cleared
+  void reset()
+  {
+    for (uint8_t i = 0; i < TINY_GSM_MATCH_PATTERNS; i++) {
+      _state[i] = 0;
+    }
+  }
+
+  // Advances all patterns with the byte, returns the first slot + 1 which ends here or 0
+  uint8_t feed(char c)
+  {
+    uint8_t ret = 0;
+
+    for (uint8_t i = 0; i < TINY_GSM_MATCH_PATTERNS; i++) {
+      if (!_len[i]) {
+        continue;
+      }
+      uint8_t s = _state[i];
+      while (s > 0 && at(_pattern[i], s) != c) {
+        s = _fail[i][s-1];
+      }
+      if (at(_pattern[i], s) == c) {
+        s++;
+      }
+      if (s == _len[i]) {
+        if (!ret) {
+          ret = i + 1;
+        }
+        s = _fail[i][s-1];
+      }
+      _state[i] = s;
+    }
+    return ret;
+  }
+
+private:
+  static char at(const char* p, uint8_t i)
+  {
+#if defined(__AVR__)
+    return pgm_read_byte(p + i);
+#else
+    return p[i];
+#endif
+  }
+
+private:
+  const char* _pattern[TINY_GSM_MATCH_PATTERNS];
+  uint8_t     _len[TINY_GSM_MATCH_PATTERNS];
+  uint8_t     _state[TINY_GSM_MATCH_PATTERNS];
+  uint8_t     _fail[TINY_GSM_MATCH_PATTERNS][TINY_GSM_MATCH_LEN];
+};
+
+#endif
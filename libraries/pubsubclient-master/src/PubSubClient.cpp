@@ -9,6 +9,7 @@
 
 PubSubClient::PubSubClient() {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     this->_client = NULL;
     this->stream = NULL;
     setCallback(NULL);
@@ -16,24 +17,28 @@ PubSubClient::PubSubClient() {
 
 PubSubClient::PubSubClient(Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setClient(client);
     this->stream = NULL;
 }
 
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(addr, port);
     setClient(client);
     this->stream = NULL;
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(addr,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(addr, port);
     setCallback(callback);
     setClient(client);
@@ -41,6 +46,7 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
 }
 PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(addr,port);
     setCallback(callback);
     setClient(client);
@@ -49,18 +55,21 @@ PubSubClient::PubSubClient(IPAddress addr, uint16_t port, MQTT_CALLBACK_SIGNATUR
 
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(ip, port);
     setClient(client);
     this->stream = NULL;
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(ip,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(ip, port);
     setCallback(callback);
     setClient(client);
@@ -68,6 +77,7 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
 }
 PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(ip,port);
     setCallback(callback);
     setClient(client);
@@ -76,18 +86,21 @@ PubSubClient::PubSubClient(uint8_t *ip, uint16_t port, MQTT_CALLBACK_SIGNATURE,
 
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(domain,port);
     setClient(client);
     this->stream = NULL;
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(domain,port);
     setClient(client);
     setStream(stream);
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
@@ -95,6 +108,7 @@ PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGN
 }
 PubSubClient::PubSubClient(const char* domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client& client, Stream& stream) {
     this->_state = MQTT_DISCONNECTED;
+    initInflight();
     setServer(domain,port);
     setCallback(callback);
     setClient(client);
@@ -123,7 +137,9 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
             result = _client->connect(this->ip, this->port);
         }
         if (result == 1) {
-            nextMsgId = 1;
+            if (inflightCount() == 0) {
+                nextMsgId = 1;
+            }
             // Leave room in the buffer for header and variable length field
             uint16_t length = 5;
             unsigned int j;
@@ -193,7 +209,10 @@ boolean PubSubClient::connect(const char *id, const char *user, const char *pass
                     lastInActivity = millis();
                     pingOutstanding = false;
                     _state = MQTT_CONNECTED;
-                    return true;
+                    if (resendInflight()) {
+                        return true;
+                    }
+                    _state = MQTT_CONNECTION_LOST;
                 } else {
                     _state = buffer[3];
                 }
@@ -343,6 +362,11 @@ boolean PubSubClient::loop() {
                     _client->write(buffer,2);
                 } else if (type == MQTTPINGRESP) {
                     pingOutstanding = false;
+                } else if (type == MQTTPUBACK) {
+                    int i = inflightIndex((buffer[2]<<8)+buffer[3]);
+                    if (i >= 0) {
+                        inflightMsgId[i] = 0;
+                    }
                 }
             } else if (!connected()) {
                 // readPacket has closed the connection
@@ -388,6 +412,59 @@ boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigne
     return false;
 }
 
+boolean PubSubClient::publish(const char* topic, const char* payload, boolean retained, uint8_t qos) {
+    return publish(topic,(const uint8_t*)payload,strlen(payload),retained,qos);
+}
+
+// QoS 1: the packet is kept until the PUBACK arrives and is sent again after a
+// reconnect. Up to inflightWindow packets can be unacknowledged at the same time.
+// If the window is full the PUBACKs are read with loop() until a slot is free.
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained, uint8_t qos) {
+    if (qos == 0) {
+        return publish(topic, payload, plength, retained);
+    }
+    if (!connected()) {
+        return false;
+    }
+    if (qos != 1 || MQTT_MAX_PACKET_SIZE < 5 + 2+strlen(topic) + 2 + plength ||
+        MQTT_MAX_INFLIGHT_PACKET_SIZE < 2+strlen(topic) + 2 + plength) {
+        // Too long
+        return false;
+    }
+    if (!waitInflight(inflightWindow-1)) {
+        return false;
+    }
+    int slot = inflightIndex(0);
+    if (slot < 0) {
+        return false;
+    }
+    do {
+        nextMsgId++;
+        if (nextMsgId == 0) {
+            nextMsgId = 1;
+        }
+    } while (inflightIndex(nextMsgId) >= 0);
+
+    // Leave room in the buffer for header and variable length field
+    uint16_t length = 5;
+    length = writeString(topic,buffer,length);
+    buffer[length++] = (nextMsgId >> 8);
+    buffer[length++] = (nextMsgId & 0xFF);
+    uint16_t i;
+    for (i=0;i<plength;i++) {
+        buffer[length++] = payload[i];
+    }
+    uint8_t header = MQTTPUBLISH|MQTTQOS1;
+    if (retained) {
+        header |= 1;
+    }
+    inflightMsgId[slot] = nextMsgId;
+    inflightHeader[slot] = header;
+    inflightLength[slot] = length-5;
+    memcpy(inflightPacket[slot],buffer+5,length-5);
+    return write(header,buffer,length-5);
+}
+
 boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
     uint8_t llen = 0;
     uint8_t digit;
@@ -433,6 +510,64 @@ boolean PubSubClient::publish_P(const char* topic, const uint8_t* payload, unsig
     return rc == tlen + 4 + plength;
 }
 
+void PubSubClient::initInflight() {
+    inflightWindow = MQTT_MAX_INFLIGHT;
+    for (int i=0;i<MQTT_MAX_INFLIGHT;i++) {
+        inflightMsgId[i] = 0;
+    }
+}
+
+// Returns the slot of msgId or -1. msgId 0 finds a free slot.
+int PubSubClient::inflightIndex(uint16_t msgId) {
+    for (int i=0;i<MQTT_MAX_INFLIGHT;i++) {
+        if (inflightMsgId[i] == msgId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t PubSubClient::inflightCount() {
+    uint8_t count = 0;
+    for (int i=0;i<MQTT_MAX_INFLIGHT;i++) {
+        if (inflightMsgId[i] != 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Reads the incoming packets until not more than maxInflight QoS 1 packets are
+// unacknowledged. Returns false on a timeout or a lost connection.
+boolean PubSubClient::waitInflight(uint8_t maxInflight) {
+    unsigned long start = millis();
+    while (inflightCount() > maxInflight) {
+        if (!loop()) {
+            return false;
+        }
+        if (millis()-start >= ((int32_t) MQTT_SOCKET_TIMEOUT*1000UL)) {
+            return false;
+        }
+        if (!_client->available()) {
+            delay(1);
+        }
+    }
+    return true;
+}
+
+// Sends the unacknowledged packets of the last connection again with the DUP flag.
+boolean PubSubClient::resendInflight() {
+    for (int i=0;i<MQTT_MAX_INFLIGHT;i++) {
+        if (inflightMsgId[i] != 0) {
+            memcpy(buffer+5,inflightPacket[i],inflightLength[i]);
+            if (!write(inflightHeader[i]|MQTTDUP,buffer,inflightLength[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 boolean PubSubClient::write(uint8_t header, uint8_t* buf, uint16_t length) {
     uint8_t lenBuf[4];
     uint8_t llen = 0;
@@ -595,6 +730,17 @@ PubSubClient& PubSubClient::setStream(Stream& stream){
     return *this;
 }
 
+PubSubClient& PubSubClient::setInflightWindow(uint8_t window){
+    if (window < 1) {
+        window = 1;
+    }
+    if (window > MQTT_MAX_INFLIGHT) {
+        window = MQTT_MAX_INFLIGHT;
+    }
+    this->inflightWindow = window;
+    return *this;
+}
+
 int PubSubClient::state() {
     return this->_state;
 }
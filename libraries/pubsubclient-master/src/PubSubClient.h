@@ -38,6 +38,18 @@
 #define MQTT_SOCKET_TIMEOUT 15
 #endif
 
+// MQTT_MAX_INFLIGHT : Maximum number of unacknowledged QoS 1 publish packets
+#ifndef MQTT_MAX_INFLIGHT
+#define MQTT_MAX_INFLIGHT 4
+#endif
+
+// MQTT_MAX_INFLIGHT_PACKET_SIZE : Maximum size of a QoS 1 packet (topic, id
+//  and payload) which is kept for the retransmission after a reconnect
+#ifndef MQTT_MAX_INFLIGHT_PACKET_SIZE
+//#define MQTT_MAX_INFLIGHT_PACKET_SIZE 128
+#define MQTT_MAX_INFLIGHT_PACKET_SIZE 200 // SnorkTracker gps track
+#endif
+
 // MQTT_MAX_TRANSFER_SIZE : limit how much data is passed to the network client
 //  in each write call. Needed for the Arduino Wifi Shield. Leave undefined to
 //  pass the entire MQTT packet in each write call.
@@ -74,6 +86,7 @@
 #define MQTTQOS0        (0 << 1)
 #define MQTTQOS1        (1 << 1)
 #define MQTTQOS2        (2 << 1)
+#define MQTTDUP         (1 << 3)
 
 #ifdef ESP8266
 #include <functional>
@@ -101,6 +114,14 @@ private:
    uint16_t port;
    Stream* stream;
    int _state;
+   uint8_t inflightWindow;
+   uint16_t inflightMsgId[MQTT_MAX_INFLIGHT];
+   uint8_t inflightHeader[MQTT_MAX_INFLIGHT];
+   uint16_t inflightLength[MQTT_MAX_INFLIGHT];
+   uint8_t inflightPacket[MQTT_MAX_INFLIGHT][MQTT_MAX_INFLIGHT_PACKET_SIZE];
+   void initInflight();
+   int inflightIndex(uint16_t msgId);
+   boolean resendInflight();
 public:
    PubSubClient();
    PubSubClient(Client& client);
@@ -123,6 +144,7 @@ public:
    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
    PubSubClient& setClient(Client& client);
    PubSubClient& setStream(Stream& stream);
+   PubSubClient& setInflightWindow(uint8_t window);
 
    boolean connect(const char* id);
    boolean connect(const char* id, const char* user, const char* pass);
@@ -133,7 +155,11 @@ public:
    boolean publish(const char* topic, const char* payload, boolean retained);
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength);
    boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   boolean publish(const char* topic, const char* payload, boolean retained, uint8_t qos);
+   boolean publish(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained, uint8_t qos);
    boolean publish_P(const char* topic, const uint8_t * payload, unsigned int plength, boolean retained);
+   uint8_t inflightCount();
+   boolean waitInflight(uint8_t maxInflight);
    boolean subscribe(const char* topic);
    boolean subscribe(const char* topic, uint8_t qos);
    boolean unsubscribe(const char* topic);
@@ -15,6 +15,7 @@ extern "C"{
     extern void setup( void ) ;
     extern void loop( void ) ;
     uint32_t millis( void );
+    void delay( unsigned long ms );
 }
 
 #define PROGMEM
@@ -4,9 +4,15 @@
 #include <Arduino.h>
 #include <ctime>
 
+static uint32_t delayed = 0;
+
 extern "C" {
     uint32_t millis(void) {
-       return time(0)*1000;
+       return time(0)*1000 + delayed;
+    }
+    // Virtual delay: lets the socket timeouts elapse without waiting
+    void delay(unsigned long ms) {
+       delayed += ms;
     }
 }
 
@@ -174,6 +174,154 @@ int test_publish_P() {
 
 
 
+int test_publish_qos1() {
+    IT("publishes qos1 and keeps it until the puback");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish,18);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_EQUAL(client.inflightCount(), 1);
+
+    byte puback[] = { 0x40, 0x02, 0x00, 0x02 };
+    shimClient.respond(puback,4);
+
+    rc = client.loop();
+    IS_TRUE(rc);
+    IS_EQUAL(client.inflightCount(), 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_window() {
+    IT("publishes qos1 without waiting for each puback");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setInflightWindow(2);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    byte publish1[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte publish2[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x3,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    byte publish3[] = {0x32,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x4,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(publish1,18);
+    shimClient.expect(publish2,18);
+    shimClient.expect(publish3,18);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_EQUAL(client.inflightCount(), 2);
+
+    // The window is full: the third publish has to read the first puback
+    byte puback[] = { 0x40, 0x02, 0x00, 0x02 };
+    shimClient.respond(puback,4);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+    IS_EQUAL(client.inflightCount(), 2);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_window_full() {
+    IT("publish qos1 fails when the window stays full");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    client.setInflightWindow(1);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"payload",false,1);
+    IS_FALSE(rc);
+    IS_EQUAL(client.inflightCount(), 1);
+
+    END_IT
+}
+
+int test_publish_qos1_resend() {
+    IT("publishes unacknowledged qos1 again after a reconnect");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"payload",true,1);
+    IS_TRUE(rc);
+
+    shimClient.setConnected(false);
+    IS_FALSE(client.connected());
+
+    byte connect[] = {0x10,0x18,0x0,0x4,0x4d,0x51,0x54,0x54,0x4,0x2,0x0,0xf,0x0,0xc,0x63,0x6c,0x69,0x65,0x6e,0x74,0x5f,0x74,0x65,0x73,0x74,0x31};
+    byte publish[] = {0x3b,0x10,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x0,0x2,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
+    shimClient.expect(connect,26);
+    shimClient.expect(publish,18);
+    shimClient.respond(connack,4);
+
+    rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+    IS_EQUAL(client.inflightCount(), 1);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+int test_publish_qos1_too_long() {
+    IT("publish qos1 fails when the packet can not be kept");
+    ShimClient shimClient;
+    shimClient.setAllowConnect(true);
+
+    byte connack[] = { 0x20, 0x02, 0x00, 0x00 };
+    shimClient.respond(connack,4);
+
+    PubSubClient client(server, 1883, callback, shimClient);
+    int rc = client.connect((char*)"client_test1");
+    IS_TRUE(rc);
+
+    rc = client.publish((char*)"topic",(char*)"123456789012345678901234567890123456789012345678901234567890",false,1);
+    IS_FALSE(rc);
+    IS_EQUAL(client.inflightCount(), 0);
+
+    IS_FALSE(shimClient.error());
+
+    END_IT
+}
+
+
 
 int main()
 {
@@ -185,6 +333,11 @@ int main()
     test_publish_not_connected();
     test_publish_too_long();
     test_publish_P();
+    test_publish_qos1();
+    test_publish_qos1_window();
+    test_publish_qos1_window_full();
+    test_publish_qos1_resend();
+    test_publish_qos1_too_long();
 
     FINISH
 }
@@ -109,7 +109,7 @@ int test_receive_max_sized_message() {
     byte publish[] = {0x30,length-2,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
     byte bigPublish[length];
     memset(bigPublish,'A',length);
-    bigPublish[length] = 'B';
+    bigPublish[length-1] = 'B';
     memcpy(bigPublish,publish,16);
     shimClient.respond(bigPublish,length);
 
@@ -145,7 +145,7 @@ int test_receive_oversized_message() {
     byte publish[] = {0x30,length-2,0x0,0x5,0x74,0x6f,0x70,0x69,0x63,0x70,0x61,0x79,0x6c,0x6f,0x61,0x64};
     byte bigPublish[length];
     memset(bigPublish,'A',length);
-    bigPublish[length] = 'B';
+    bigPublish[length-1] = 'B';
     memcpy(bigPublish,publish,16);
     shimClient.respond(bigPublish,length);
 
@@ -210,7 +210,7 @@ int test_receive_oversized_stream_message() {
 
     byte bigPublish[length];
     memset(bigPublish,'A',length);
-    bigPublish[length] = 'B';
+    bigPublish[length-1] = 'B';
     memcpy(bigPublish,publish,16);
 
     shimClient.respond(bigPublish,length);
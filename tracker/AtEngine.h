@@ -0,0 +1,386 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file AtEngine.h
+  *
+  * Non blocking AT command queue with a dispatcher for the unsolicited result codes.
+  */
+
+#define AT_QUEUE_SIZE     8    //!< Maximum number of waiting commands.
+#define AT_URC_SIZE       8    //!< Maximum number of urc handlers.
+#define AT_LINE_SIZE      255  //!< Maximum length of one received line.
+
+#define AT_RESULT_OK      0    //!< Command finished with OK.
+#define AT_RESULT_ERROR   1    //!< Command finished with ERROR, +CME ERROR or +CMS ERROR.
+#define AT_RESULT_TIMEOUT 2    //!< Command got no final result in time.
+
+/** Called when a queued command is finished. The response has all the info lines of the command. 
+  * A compound command like '+CSQ;+CBC' has the info lines of all its parts, the modul stops 
+  * on the first failing part, so the lines of the parts before are still valid on an error.
+  */
+typedef void (*AtCallback)(void *context, int result, const String &response);
+
+/** Called with every unsolicited line which matches the pattern of the handler. */
+typedef void (*UrcCallback)(void *context, const String &line);
+
+/**
+  * Sends queued AT commands one after the other without blocking.
+  * loop() reads the received bytes line by line, collects the info lines of 
+  * the command in flight and calls its callback on the final result or the timeout. 
+  * Unsolicited result codes are routed to the registered handlers, also if they 
+  * arrive in the middle of a command.
+  * Synchronous TinyGSM calls wait for the command in flight with the 
+  * TINY_GSM_SEND_HOOK and pass their unsolicited lines with the TINY_GSM_URC_HOOK.
+  */
+class MyAtEngine
+{
+protected:
+   /** One queued command. */
+   class Command
+   {
+   public:
+      String     command;    //!< Command without the 'AT', compound commands are separated with ';'.
+      String     info;       //!< Prefixes of the expected info lines separated with ';' i.e. '+CSQ:;+CBC:'.
+      long       timeoutMs;  //!< Timeout for the final result.
+      AtCallback callback;   //!< Result callback, can be NULL.
+      void      *context;    //!< Parameter of the callback.
+   };
+
+   /** One urc handler. */
+   class Urc
+   {
+   public:
+      String      pattern;   //!< Matches the start or the end of the line i.e. '+CMTI:' or ', CLOSED'.
+      UrcCallback callback;  //!< Handler function.
+      void       *context;   //!< Parameter of the handler.
+   };
+
+   static MyAtEngine *g_myAtEngine; //!< Instance for the TinyGSM hooks.
+
+   Stream  &stream;                  //!< Serial interface to the modul.
+   Command  queue[AT_QUEUE_SIZE];    //!< Ring buffer of the waiting commands.
+   int      queueHead;               //!< Index of the next or running command.
+   int      queueCount;              //!< Number of commands in the queue.
+   bool     inFlight;                //!< Is the head command sent and waiting for its result?
+   long     sentMs;                  //!< Time the command in flight was sent.
+   String   response;                //!< Collected info lines of the command in flight.
+   String   line;                    //!< Currently received line.
+   Urc      urcs[AT_URC_SIZE];       //!< Registered urc handlers.
+   int      urcCount;                //!< Number of urc handlers.
+   bool     inLoop;                  //!< Protection against recursive calls from the callbacks.
+
+protected:
+   void pump(bool sendNext);
+   void processLine();
+   void finish(int result);
+   bool dispatch(const char *urc, int len);
+
+   static bool isPart(const String &list, const String &part);
+   static bool isInfoLine(const String &info, const String &line);
+
+public:
+   MyAtEngine(Stream &serial);
+   ~MyAtEngine();
+
+   bool send(const String &command, const String &info, long timeoutMs, AtCallback callback, void *context);
+   bool onUrc(const String &pattern, UrcCallback callback, void *context);
+   bool isQueued(const String &command);
+   bool isIdle();
+   void clear();
+
+   void loop();
+   bool waitForIdle();
+
+   static String infoLine(const String &response, const String &info);
+
+   static void beforeSyncCommand();
+   static bool dispatchUrc(const char *urc);
+};
+
+/* ******************************************** */
+
+MyAtEngine *MyAtEngine::g_myAtEngine = NULL;
+
+/** Constructor/Destructor */
+MyAtEngine::MyAtEngine(Stream &serial)
+   : stream(serial)
+   , queueHead(0)
+   , queueCount(0)
+   , inFlight(false)
+   , sentMs(0)
+   , urcCount(0)
+   , inLoop(false)
+{
+   g_myAtEngine = this;
+}
+MyAtEngine::~MyAtEngine()
+{
+   g_myAtEngine = NULL;
+}
+
+/** Appends a command to the queue. The callback is called from loop() with the result. */
+bool MyAtEngine::send(const String &command, const String &info, long timeoutMs, AtCallback callback, void *context)
+{
+   if (queueCount >= AT_QUEUE_SIZE) {
+      MyDbg((String) F("AT queue full: ") + command);
+      return false;
+   }
+
+   Command &cmd = queue[(queueHead + queueCount) % AT_QUEUE_SIZE];
+
+   cmd.command   = command;
+   cmd.info      = info;
+   cmd.timeoutMs = timeoutMs;
+   cmd.callback  = callback;
+   cmd.context   = context;
+   queueCount++;
+   return true;
+}
+
+/** Registers a handler for unsolicited lines which start or end with the pattern. */
+bool MyAtEngine::onUrc(const String &pattern, UrcCallback callback, void *context)
+{
+   if (urcCount >= AT_URC_SIZE) {
+      return false;
+   }
+   urcs[urcCount].pattern  = pattern;
+   urcs[urcCount].callback = callback;
+   urcs[urcCount].context  = context;
+   urcCount++;
+   return true;
+}
+
+/** Is the command already waiting or running, alone or as part of a compound command? */
+bool MyAtEngine::isQueued(const String &command)
+{
+   for (int i = 0; i < queueCount; i++) {
+      if (isPart(queue[(queueHead + i) % AT_QUEUE_SIZE].command, command)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/** Is the part one of the ';' separated entries of the list? */
+bool MyAtEngine::isPart(const String &list, const String &part)
+{
+   int start = 0;
+
+   while (start <= (int) list.length()) {
+      int end = list.indexOf(';', start);
+
+      if (end == -1) {
+         end = list.length();
+      }
+      if (end - start == (int) part.length() && list.startsWith(part, start)) {
+         return true;
+      }
+      start = end + 1;
+   }
+   return false;
+}
+
+/** Does the line start with one of the ';' separated info prefixes? */
+bool MyAtEngine::isInfoLine(const String &info, const String &line)
+{
+   int start = 0;
+
+   while (start < (int) info.length()) {
+      int end = info.indexOf(';', start);
+
+      if (end == -1) {
+         end = info.length();
+      }
+      if (end > start && line.startsWith(info.substring(start, end))) {
+         return true;
+      }
+      start = end + 1;
+   }
+   return false;
+}
+
+/** Returns the first info line of a response which starts with the info prefix or an empty string. */
+String MyAtEngine::infoLine(const String &response, const String &info)
+{
+   int start = response.startsWith(info) ? 0 : response.indexOf((String) '\n' + info);
+
+   if (start == -1) {
+      return String();
+   }
+   if (response[start] == '\n') {
+      start++;
+   }
+
+   int end = response.indexOf('\n', start);
+
+   return response.substring(start, end == -1 ? response.length() : end);
+}
+
+/** No command waiting or running. */
+bool MyAtEngine::isIdle()
+{
+   return queueCount == 0;
+}
+
+/** Removes all waiting commands without calling the callbacks, i.e. on stopping the modul. */
+void MyAtEngine::clear()
+{
+   queueHead  = 0;
+   queueCount = 0;
+   inFlight   = false;
+   response   = "";
+   line       = "";
+}
+
+/** Processes the received bytes and sends the next command. Never waits. */
+void MyAtEngine::loop()
+{
+   pump(true);
+}
+
+/** Waits until the command in flight is finished, the queued commands are not sent. */
+bool MyAtEngine::waitForIdle()
+{
+   if (inLoop) {
+      return false;
+   }
+   while (inFlight) {
+      pump(false);
+      if (inFlight) {
+         MyDelay(1);
+      }
+   }
+   return true;
+}
+
+/** Reads the received lines, checks the timeout and optionally sends the next command. */
+void MyAtEngine::pump(bool sendNext)
+{
+   if (inLoop) {
+      return;
+   }
+   inLoop = true;
+   while (stream.available() > 0) {
+      int c = stream.read();
+
+      if (c == '\n') {
+         processLine();
+         line = "";
+      } else if (c > 0 && c != '\r' && line.length() < AT_LINE_SIZE) {
+         line += (char) c;
+      }
+   }
+   if (inFlight && millis() - sentMs > queue[queueHead].timeoutMs) {
+      finish(AT_RESULT_TIMEOUT);
+   }
+   if (sendNext && !inFlight && queueCount > 0) {
+      response = "";
+      stream.print(F("AT"));
+      stream.print(queue[queueHead].command);
+      stream.print(F("\r\n"));
+      sentMs   = millis();
+      inFlight = true;
+   }
+   inLoop = false;
+}
+
+/** Sorts one complete line to the command in flight or to the urc handlers. */
+void MyAtEngine::processLine()
+{
+   line.trim();
+   if (line.length() == 0) {
+      return;
+   }
+   if (inFlight && isInfoLine(queue[queueHead].info, line)) {
+      response += line + '\n';
+   } else if (dispatch(line.c_str(), line.length())) {
+      // urc handled
+   } else if (!inFlight) {
+      MyDbg((String) F("AT unhandled: ") + line);
+   } else if (line == F("OK")) {
+      finish(AT_RESULT_OK);
+   } else if (line == F("ERROR") || line.startsWith(F("+CME ERROR")) || line.startsWith(F("+CMS ERROR"))) {
+      finish(AT_RESULT_ERROR);
+   } else if (!line.startsWith(F("AT"))) { // no echo
+      response += line + '\n';
+   }
+}
+
+/** Removes the command in flight from the queue and calls its callback. */
+void MyAtEngine::finish(int result)
+{
+   Command cmd = queue[queueHead];
+
+   queueHead = (queueHead + 1) % AT_QUEUE_SIZE;
+   queueCount--;
+   inFlight  = false;
+   if (result == AT_RESULT_TIMEOUT) {
+      MyDbg((String) F("AT timeout: ") + cmd.command);
+   }
+   if (cmd.callback) {
+      cmd.callback(cmd.context, result, response);
+   }
+}
+
+/** Calls the first handler whose pattern matches the start or the end of the line. 
+  * The line is only copied into a String for the matching handler.
+  */
+bool MyAtEngine::dispatch(const char *urc, int len)
+{
+   for (int i = 0; i < urcCount; i++) {
+      const char *pattern    = urcs[i].pattern.c_str();
+      int         patternLen = urcs[i].pattern.length();
+
+      if (patternLen <= len && 
+          (strncmp(urc, pattern, patternLen) == 0 || strncmp(urc + len - patternLen, pattern, patternLen) == 0)) {
+         String line = urc;
+
+         line.remove(len);
+         urcs[i].callback(urcs[i].context, line);
+         return true;
+      }
+   }
+   return false;
+}
+
+/** TinyGSM hook: A synchronous command has to wait for the asynchronous command in flight. */
+void MyAtEngine::beforeSyncCommand()
+{
+   if (g_myAtEngine) {
+      g_myAtEngine->waitForIdle();
+   }
+}
+
+/** TinyGSM hook: Routes the unsolicited lines received during a synchronous command. 
+  * The line is trimmed without a copy.
+  */
+bool MyAtEngine::dispatchUrc(const char *urc)
+{
+   int len;
+
+   if (!g_myAtEngine) {
+      return false;
+   }
+   while (isspace(*urc)) {
+      urc++;
+   }
+   len = strlen(urc);
+   while (len > 0 && isspace(urc[len - 1])) {
+      len--;
+   }
+   return len > 0 && g_myAtEngine->dispatch(urc, len);
+}
@@ -0,0 +1,156 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Battery.h
+  *
+  * State of charge and remaining runtime estimation of the battery.
+  */
+
+#define BATTERY_UPDATE_SEC    60    //!< Minimum time between two updates of the estimate.
+#define BATTERY_VOLTAGE_SEC   21600 //!< Time constant of the correction with the voltage curve.
+#define BATTERY_RATE_SEC      86400 //!< Time constant of the smoothed consumption per day.
+
+/**
+  * Estimates the state of charge from the consumption of the energy ledger and corrects
+  * it slowly with the configured voltage curve of the battery. The ledger follows the
+  * consumption exactly but knows nothing about charging and drifts with wrong currents,
+  * the voltage knows the charge but is noisy and depends on the load. The remaining
+  * runtime is the remaining charge divided by the smoothed consumption per day.
+  * The estimator is a part of the RTC data like the energy ledger, so it has no
+  * pointers and is updated once on every wake.
+  */
+class MyBattery
+{
+protected:
+   double  soc;        //!< Estimated state of charge in percent.
+   double  mAhPerDay;  //!< Smoothed consumption in mAh per day.
+   double  lastMah;    //!< Consumption of the energy ledger at the last update.
+   int32_t lastSec;    //!< Timestamp of the last update, 0 = no estimate.
+
+public:
+   MyBattery();
+
+   void   update(MyOptions &options, double voltage, double mAh);
+
+   bool   isValid()      { return lastSec != 0; }
+   double getSoc()       { return soc; }
+   double getMahPerDay() { return mAhPerDay; }
+   double getRuntimeDays(MyOptions &options);
+
+   String getJson(MyOptions &options);
+
+   static double getVoltageSoc(const String &curve, double voltage);
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyBattery::MyBattery()
+   : soc(0.0)
+   , mAhPerDay(0.0)
+   , lastMah(0.0)
+   , lastSec(0)
+{
+}
+
+/** Subtracts the consumption since the last update from the state of charge and moves it
+  * towards the state of charge of the voltage. The weight of the voltage and of the new
+  * consumption grows with the elapsed time, so the estimate does not depend on the number
+  * of wakes. The first update starts with the voltage only.
+  */
+void MyBattery::update(MyOptions &options, double voltage, double mAh)
+{
+   long   nowSec     = secondsSincePowerOn();
+   double voltageSoc = getVoltageSoc(options.batteryCurve, voltage);
+   double dtSec      = nowSec - lastSec;
+
+   if (lastSec == 0 || options.batteryCapacityMah <= 0.0) {
+      soc       = voltageSoc;
+      mAhPerDay = 0.0;
+   } else if (dtSec >= BATTERY_UPDATE_SEC) {
+      double used = mAh - lastMah;
+      double rate = used * 86400.0 / dtSec;
+
+      soc -= 100.0 * used / options.batteryCapacityMah;
+      soc += (voltageSoc - soc) * dtSec / (dtSec + BATTERY_VOLTAGE_SEC);
+      soc  = constrain(soc, 0.0, 100.0);
+      if (mAhPerDay <= 0.0) {
+         mAhPerDay = rate;
+      } else {
+         mAhPerDay += (rate - mAhPerDay) * dtSec / (dtSec + BATTERY_RATE_SEC);
+      }
+   } else {
+      return;
+   }
+   lastMah = mAh;
+   lastSec = nowSec;
+}
+
+/** Remaining days at the current consumption, -1 if still unknown. */
+double MyBattery::getRuntimeDays(MyOptions &options)
+{
+   if (!isValid() || mAhPerDay <= 0.0) {
+      return -1.0;
+   }
+   return soc / 100.0 * options.batteryCapacityMah / mAhPerDay;
+}
+
+/** State of charge, consumption and runtime, i.e. {"soc":73.4,"mAhPerDay":96.5,"runtimeDays":53.2}. */
+String MyBattery::getJson(MyOptions &options)
+{
+   return (String) F("{\"soc\":")          + String(soc, 1) +
+                   F(",\"mAhPerDay\":")    + String(mAhPerDay, 1) +
+                   F(",\"runtimeDays\":")  + String(getRuntimeDays(options), 1) + F("}");
+}
+
+/** State of charge of the voltage from a curve of points 'volt:percent' with rising voltages,
+  * i.e. "11.8:0,12.0:25,12.2:50,12.4:75,12.7:100". Interpolated between the points and
+  * limited to the first and the last point.
+  */
+double MyBattery::getVoltageSoc(const String &curve, double voltage)
+{
+   double lastVoltage = 0.0;
+   double lastSoc     = 0.0;
+   bool   isFirst     = true;
+   int    start       = 0;
+
+   while (start < (int) curve.length()) {
+      int end = curve.indexOf(',', start);
+
+      if (end < 0) {
+         end = curve.length();
+      }
+      String point      = curve.substring(start, end);
+      int    colon      = point.indexOf(':');
+      double curveVolt  = point.substring(0, colon).toFloat();
+      double curveSoc   = point.substring(colon + 1).toFloat();
+
+      if (colon > 0) {
+         if (voltage <= curveVolt) {
+            if (isFirst) {
+               return curveSoc;
+            }
+            return lastSoc + (curveSoc - lastSoc) * (voltage - lastVoltage) / (curveVolt - lastVoltage);
+         }
+         lastVoltage = curveVolt;
+         lastSoc     = curveSoc;
+         isFirst     = false;
+      }
+      start = end + 1;
+   }
+   return lastSoc;
+}
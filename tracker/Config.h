@@ -42,3 +42,15 @@
 #define POWER_CONSUMPTION_ACTIVE       70.0    //!< Power consumption if Active in mA
 #define POWER_CONSUMPTION_POWER_ON    140.0    //!< Power consumption if SIM808 Active in mA
 #define POWER_CONSUMPTION_DEEP_SLEEP    0.407  //!< Power consumption if in deep sleep mode in mA
+
+#define ENERGY_MA_ESP_ACTIVE           20.0    //!< Default current of the awake esp8266 in mA
+#define ENERGY_MA_WIFI_AP              50.0    //!< Default additional current of the WiFi access point in mA
+#define ENERGY_MA_MODEM_REGISTERING   140.0    //!< Default current of the SIM808 until it is registered in mA
+#define ENERGY_MA_MODEM_IDLE           60.0    //!< Default current of the registered SIM808 in mA
+#define ENERGY_MA_GPRS_TX             300.0    //!< Default current of the SIM808 sending via gprs in mA
+#define ENERGY_MA_MODEM_SLEEP           2.0    //!< Default current of the SIM808 in sleep mode (+CSCLK) in mA
+#define ENERGY_MA_GPS_SEARCH           45.0    //!< Default additional current of the SIM808 gps part in mA
+#define ENERGY_MA_DEEP_SLEEP            0.407  //!< Default current in deep sleep mode in mA
+
+#define BATTERY_CAPACITY_MAH         7000.0    //!< Default capacity of the battery in mAh
+#define BATTERY_CURVE  "11.8:0,12.0:25,12.2:50,12.4:75,12.7:100" //!< Default rest voltage to state of charge curve of a 12 V lead acid battery
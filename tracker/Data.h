@@ -29,35 +29,67 @@ class MyData
 public:
    /**
      * Data to store in the RTC memory
+     * int32_t instead of long, the longs of the host have 8 bytes.
      */
    class RtcData {
    public:
       MyGps      lastGps;                //!< Last known gps location without timeout.
 
-      long       aktiveTimeSec;          //!< Time in active mode without current millis().
-      long       powerOnTimeSec;         //!< Time the sim808 is on power without current millis..
-      long       deepSleepTimeSec;       //!< Time in deep sleep mode. 
-      long       deepSleepStartSec;      //!< Timestamp of the last deep sleep start.
+      int32_t    aktiveTimeSec;          //!< Time in active mode without current millis().
+      int32_t    powerOnTimeSec;         //!< Time the sim808 is on power without current millis..
+      int32_t    deepSleepTimeSec;       //!< Time in deep sleep mode. 
+      int32_t    deepSleepStartSec;      //!< Timestamp of the last deep sleep start.
                  
-      long       lowPowerActiveTimeSec;  //!< Timestamp of the last deep sleep start.
-      long       lowPowerPowerOnTimeSec; //!< Timestamp of the last deep sleep start.
+      int32_t    lowPowerActiveTimeSec;  //!< Timestamp of the last deep sleep start.
+      int32_t    lowPowerPowerOnTimeSec; //!< Timestamp of the last deep sleep start.
 
-      long       lastBme280ReadSec;      //!< Timestamp of the last BME280 read.
-      long       lastSmsCheckSec;        //!< Timestamp of the last sms check.
-      long       lastGpsReadSec;         //!< Timestamp of the last gps read.
-      long       lastMqttPublishSec;     //!< Timestamp from the last send.
+      int32_t    lastBme280ReadSec;      //!< Timestamp of the last BME280 read.
+      int32_t    lastSmsCheckSec;        //!< Timestamp of the last sms check.
+      int32_t    lastGpsReadSec;         //!< Timestamp of the last gps read.
+      int32_t    lastMqttPublishSec;     //!< Timestamp from the last send.
 
-      long       mqttSendCount;          //!< How many time the mqtt data successfully sent.
-      long       mqttLastSentTime;       //!< Last mqtt sent timestamp.
+      int32_t    mqttSendCount;          //!< How many time the mqtt data successfully sent.
+      int32_t    mqttLastSentTime;       //!< Last mqtt sent timestamp.
+
+      uint32_t   mqttServerIp;           //!< Cached resolved ip of the mqtt server.
+      int32_t    mqttServerIpSec;        //!< Timestamp of the mqtt server name resolution.
+      int32_t    mqttServerCrc;          //!< CRC of the mqtt server name the cached ip belongs to.
+
+      int32_t    modemColdReadyMs;       //!< Average time until the sim808 is ready after a power on.
+      int32_t    modemWarmReadyMs;       //!< Average time until the sim808 is ready after a sleep.
+      int32_t    modemSleepTimeSec;      //!< Time the sim808 was in sleep mode during the deep sleeps.
+      bool       isModemSleeping;        //!< Is the sim808 kept in sleep mode during the deep sleep?
+      bool       isWifiRequested;        //!< WiFi requested via sms or button, the next deep sleep keeps the radio on.
+      bool       isRfDisabled;           //!< Was the last deep sleep with the radio switched off?
+      bool       isSmsReadPending;       //!< Are sms of an overflowed listing left, which the listing marked as read?
+      int32_t    modemBaud;              //!< Negotiated baud rate of the sim808 serial, 0 = not negotiated.
+      MyEnergy   energy;                 //!< Time of every power state since the power on.
+      MyBattery  battery;                //!< State of charge estimate of the battery.
+
+      bool       wasMoving;              //!< Moving state of the last modem wake.
+      double     lastVoltage;            //!< Voltage of the last trend sample.
+      int32_t    lastVoltageSec;         //!< Timestamp of the last trend sample.
+      double     voltageTrend;           //!< Smoothed voltage change in V per hour.
+      double     energyCredit;           //!< Unused daily energy budget in mAh (negative = overspent).
+      double     creditMah;              //!< Consumption at the last credit update.
+      int32_t    creditSec;              //!< Timestamp of the last credit update.
+      int32_t    scheduledWakeSec;       //!< Interval between two modem wakes from the scheduler, 0 = fixed.
+
+      double     fastSleepVoltage;       //!< Voltage below which a wake goes back to sleep before the initialization, 0 = full start.
+      int32_t    fastSleepIntervalSec;   //!< Deep sleep time of the fast path.
+      int32_t    fastWakeSec;            //!< Time after the deep sleep start with a full start for the modem.
+      int32_t    fastSleepCount;         //!< Number of wakes which went back to sleep on the fast path.
+      int32_t    fastSleepUs;            //!< Duration of the last fast path since the start of the esp8266.
+      int32_t    sleepRemainingSec;      //!< Remaining deep sleep time after the current hop.
                  
-      long       crcValue;               //!< CRC of the RtcData
+      int32_t    crcValue;               //!< CRC of the RtcData
 
    public:
       RtcData();
 
       bool isValid();
       void setCRC();
-      long getCRC();
+      int32_t getCRC();
    } rtcData;                  //!< Data to store in the RTC memory.
 
    String status;              //!< Status information
@@ -72,6 +104,10 @@ public:
    long   awakeTimeOffsetSec;  //!< Awake time offset for SaveSettings.
 
    double voltage;             //!< Current supply voltage
+   double voltageMin;          //!< Lowest voltage since the last publish
+   double voltageMax;          //!< Highest voltage since the last publish
+   double voltageSum;          //!< Sum of the voltages since the last publish
+   long   voltageCount;        //!< Number of the voltages since the last publish
    double temperature;         //!< Current BME280 temperature
    double humidity;            //!< Current BME280 humidity
    double pressure;            //!< Current BME280 pressure
@@ -87,12 +123,16 @@ public:
    String signalQuality;       //!< Quality of the signal
    String batteryLevel;        //!< Battery level of the sim808 module
    String batteryVolt;         //!< Battery volt of the sim808 module
+   bool   isModemWarm;         //!< Was the sim808 modul already connected on the last start?
+   long   modemReadyMs;        //!< Duration from the start until the sim808 modul was ready in ms.
    
    long   lastGpsUpdateSec;    //!< Elapsed Time of last read
    bool   waitingForGps;       //!< We are trying to get a location.
    
    bool   isMoving;            //!< Is moving recognized
    double movingDistance;      //!< Minimum distance for moving flag
+
+   MyProfiler profiler;        //!< Phase timers of the modem and the mqtt communication.
    
    StringList consoleCmds;     //!< open commands to send to the sim808 module
    StringList logInfos;        //!< received sim808 answers or other logs
@@ -106,12 +146,27 @@ public:
    long   getPowerOnTimeSec();
    long   getLowPowerPowerOnTimeSec();
 
-   double getPowerConsumption();
+   double getPowerConsumption(MyOptions &options);
    double getLowPowerPowerConsumption();
+
+   void   addVoltageStat(double value);
+   void   resetVoltageStat();
+   double getVoltageAvg();
+   String getVoltageStatJson();
 };
 
 /* ******************************************** */
 
+/** The options snapshot is stored in the RTC memory behind the RtcData. */
+uint32_t rtcOptionsOffset()
+{
+   return (sizeof(MyData::RtcData) + 3) / 4;
+}
+
+// No longs in the RtcData, so the host tests have the same layout and the same limit as the esp8266.
+static_assert(RTC_USER_MEMORY_SIZE - 4 * ((sizeof(MyData::RtcData) + 3) / 4) - 8 >= RTC_OPTIONS_MIN_SIZE,
+              "The RtcData leaves not enough RTC memory for the options snapshot");
+
 MyData::RtcData::RtcData()
    : aktiveTimeSec(0)
    , powerOnTimeSec(0)
@@ -125,6 +180,31 @@ MyData::RtcData::RtcData()
    , lastMqttPublishSec(0)
    , mqttSendCount(0)
    , mqttLastSentTime(0)
+   , mqttServerIp(0)
+   , mqttServerIpSec(0)
+   , mqttServerCrc(0)
+   , modemColdReadyMs(0)
+   , modemWarmReadyMs(0)
+   , modemSleepTimeSec(0)
+   , isModemSleeping(false)
+   , isWifiRequested(false)
+   , isRfDisabled(false)
+   , isSmsReadPending(false)
+   , modemBaud(0)
+   , wasMoving(false)
+   , lastVoltage(0.0)
+   , lastVoltageSec(0)
+   , voltageTrend(0.0)
+   , energyCredit(0.0)
+   , creditMah(0.0)
+   , creditSec(0)
+   , scheduledWakeSec(0)
+   , fastSleepVoltage(0.0)
+   , fastSleepIntervalSec(0)
+   , fastWakeSec(0)
+   , fastSleepCount(0)
+   , fastSleepUs(0)
+   , sleepRemainingSec(0)
 {
    crcValue = getCRC();
 }
@@ -142,23 +222,50 @@ void MyData::RtcData::setCRC()
 }
 
 /** Creates a CRC of all the member variables. */
-long MyData::RtcData::getCRC()
+int32_t MyData::RtcData::getCRC()
 {
-   long crc = 0;
+   int32_t crc = 0;
 
    crc = crc32(crc, (unsigned char *) &lastGps,                sizeof(MyGps));
-   crc = crc32(crc, (unsigned char *) &aktiveTimeSec,          sizeof(long));
-   crc = crc32(crc, (unsigned char *) &powerOnTimeSec,         sizeof(long));
-   crc = crc32(crc, (unsigned char *) &deepSleepTimeSec,       sizeof(long));
-   crc = crc32(crc, (unsigned char *) &deepSleepStartSec,      sizeof(long));
-   crc = crc32(crc, (unsigned char *) &lowPowerActiveTimeSec,  sizeof(long));
-   crc = crc32(crc, (unsigned char *) &lowPowerPowerOnTimeSec, sizeof(long));
-   crc = crc32(crc, (unsigned char *) &lastBme280ReadSec,      sizeof(long));
-   crc = crc32(crc, (unsigned char *) &lastSmsCheckSec,        sizeof(long));
-   crc = crc32(crc, (unsigned char *) &lastGpsReadSec,         sizeof(long));
-   crc = crc32(crc, (unsigned char *) &lastMqttPublishSec,     sizeof(long));
-   crc = crc32(crc, (unsigned char *) &mqttSendCount,          sizeof(long));
-   crc = crc32(crc, (unsigned char *) &mqttLastSentTime,       sizeof(long));
+   crc = crc32(crc, (unsigned char *) &aktiveTimeSec,          sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &powerOnTimeSec,         sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &deepSleepTimeSec,       sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &deepSleepStartSec,      sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &lowPowerActiveTimeSec,  sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &lowPowerPowerOnTimeSec, sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &lastBme280ReadSec,      sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &lastSmsCheckSec,        sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &lastGpsReadSec,         sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &lastMqttPublishSec,     sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &mqttSendCount,          sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &mqttLastSentTime,       sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &mqttServerIp,           sizeof(uint32_t));
+   crc = crc32(crc, (unsigned char *) &mqttServerIpSec,        sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &mqttServerCrc,          sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &modemColdReadyMs,       sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &modemWarmReadyMs,       sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &modemSleepTimeSec,      sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &isModemSleeping,        sizeof(bool));
+   crc = crc32(crc, (unsigned char *) &isWifiRequested,        sizeof(bool));
+   crc = crc32(crc, (unsigned char *) &isRfDisabled,           sizeof(bool));
+   crc = crc32(crc, (unsigned char *) &isSmsReadPending,       sizeof(bool));
+   crc = crc32(crc, (unsigned char *) &modemBaud,              sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &energy,                 sizeof(MyEnergy));
+   crc = crc32(crc, (unsigned char *) &battery,                sizeof(MyBattery));
+   crc = crc32(crc, (unsigned char *) &wasMoving,              sizeof(bool));
+   crc = crc32(crc, (unsigned char *) &lastVoltage,            sizeof(double));
+   crc = crc32(crc, (unsigned char *) &lastVoltageSec,         sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &voltageTrend,           sizeof(double));
+   crc = crc32(crc, (unsigned char *) &energyCredit,           sizeof(double));
+   crc = crc32(crc, (unsigned char *) &creditMah,              sizeof(double));
+   crc = crc32(crc, (unsigned char *) &creditSec,              sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &scheduledWakeSec,       sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &fastSleepVoltage,       sizeof(double));
+   crc = crc32(crc, (unsigned char *) &fastSleepIntervalSec,   sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &fastWakeSec,            sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &fastSleepCount,         sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &fastSleepUs,            sizeof(int32_t));
+   crc = crc32(crc, (unsigned char *) &sleepRemainingSec,      sizeof(int32_t));
    
    return crc;
 }
@@ -173,6 +280,10 @@ MyData::MyData()
    , secondsToDeepSleep(-1)
    , awakeTimeOffsetSec(0)
    , voltage(0.0)
+   , voltageMin(0.0)
+   , voltageMax(0.0)
+   , voltageSum(0.0)
+   , voltageCount(0)
    , temperature(0.0)
    , humidity(0.0)
    , pressure(0.0)
@@ -180,6 +291,8 @@ MyData::MyData()
    , movingDistance(0.0)
    , lastGpsUpdateSec(0)
    , waitingForGps(false)
+   , isModemWarm(false)
+   , modemReadyMs(0)
 {
 }
 
@@ -225,14 +338,13 @@ long MyData::getLowPowerPowerOnTimeSec()
    }
 }
 
-/** Calculates the power consumption from power on.
+/** Calculates the power consumption from power on with the energy ledger
+  * and the configured currents of the power states.
   * In mA/h
   */
-double MyData::getPowerConsumption()
+double MyData::getPowerConsumption(MyOptions &options)
 {
-   return (POWER_CONSUMPTION_ACTIVE     * (getActiveTimeSec() - getPowerOnTimeSec()) +
-           POWER_CONSUMPTION_POWER_ON   * getPowerOnTimeSec() +
-           POWER_CONSUMPTION_DEEP_SLEEP * rtcData.deepSleepTimeSec) / 3600.0;
+   return rtcData.energy.getMAh(options.energyMa);
 }
 
 /** Calculates the power consumption on low power from power on.
@@ -244,3 +356,37 @@ double MyData::getLowPowerPowerConsumption()
            POWER_CONSUMPTION_POWER_ON   * getLowPowerPowerOnTimeSec() +
            POWER_CONSUMPTION_DEEP_SLEEP * rtcData.deepSleepTimeSec) / 3600.0;
 }
+
+/** Adds a voltage to the min, avg and max statistic. */
+void MyData::addVoltageStat(double value)
+{
+   if (voltageCount == 0 || value < voltageMin) {
+      voltageMin = value;
+   }
+   if (voltageCount == 0 || value > voltageMax) {
+      voltageMax = value;
+   }
+   voltageSum += value;
+   voltageCount++;
+}
+
+/** Starts a new statistic interval with the current voltage. */
+void MyData::resetVoltageStat()
+{
+   voltageCount = 0;
+   voltageSum   = 0.0;
+   addVoltageStat(voltage);
+}
+
+/** Average voltage of the statistic interval. */
+double MyData::getVoltageAvg()
+{
+   return voltageCount ? voltageSum / voltageCount : voltage;
+}
+
+/** Voltage statistic of the interval, i.e. {"min":12.31,"avg":12.38,"max":12.45,"count":60}. */
+String MyData::getVoltageStatJson()
+{
+   return (String) F("{\"min\":") + String(voltageMin, 2) + F(",\"avg\":") + String(getVoltageAvg(), 2) + 
+          F(",\"max\":") + String(voltageMax, 2) + F(",\"count\":") + String(voltageCount) + F("}");
+}
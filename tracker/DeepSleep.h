@@ -20,37 +20,91 @@
   * DeepSleep functions.
   */
 
-#define NO_DEEP_SLEEP_STARTUP_TIME 120 //!< No deep sleep for the first minute.
+#define NO_DEEP_SLEEP_STARTUP_TIME 120  //!< No deep sleep for the first minute.
+#define MAX_DEEP_SLEEP_HOP_SEC     3600 //!< Longest deep sleep of the esp8266 timer.
 
 
 /**
   * Class to read/save a deepsleep counter and start the deepsleep mode
   * if the voltage is too low.
+  * fastSleep() runs before the initialization of the system and sends the esp8266
+  * back to sleep with only the RTC memory and one adc read as long as the voltage is 
+  * low and no modem wake is due. The decision values are stored by sleep().
+  * With the sim808 the deep sleep switches off the radio of the esp8266, so the timer
+  * wakes start without WiFi. A WiFi request keeps the radio on for the next wake.
+  * Deep sleeps longer than the timer of the esp8266 allows are chained in hops. Every
+  * hop wake only counts down the remaining time in the RTC memory.
   */
 class MyDeepSleep
 {
 protected:
-   MyOptions &myOptions;     //!< Reference to the options
-   MyData    &myData;        //!< Reference to the data
+   MyOptions   &myOptions;   //!< Reference to the options
+   MyData      &myData;      //!< Reference to the data
+   MyScheduler &myScheduler; //!< Reference to the wake scheduler
+
+protected:
+   void sleepHops(long sleepSec);
+   void deepSleep(long sleepSec);
    
 public:
-   MyDeepSleep(MyOptions &options, MyData &data);
+   MyDeepSleep(MyOptions &options, MyData &data, MyScheduler &scheduler);
 
+   void fastSleep();
    bool begin();
+
+   bool isTimerWake();
+   bool isWifiWake();
+   bool isRfAvailable();
    
    bool haveToSleep();
    void sleep(bool start = true);
+   void restartWithWifi();
 };
 
 /* ******************************************** */
 
 /** Constructor */
-MyDeepSleep::MyDeepSleep(MyOptions &options, MyData &data)
+MyDeepSleep::MyDeepSleep(MyOptions &options, MyData &data, MyScheduler &scheduler)
    : myOptions(options)
    , myData(data)
+   , myScheduler(scheduler)
 {
 }
 
+/**
+  * Fast path before the initialization: No serial, no SPIFFS and no options.
+  * Sleeps the next hop of a long deep sleep. Otherwise goes back to sleep if the voltage 
+  * of one adc read is still below the stored limit and the modem wake is not due. 
+  * Returns if the full start is needed, also after a power on or a reset.
+  */
+void MyDeepSleep::fastSleep()
+{
+   MyData::RtcData rtcData;
+
+   ESP.rtcUserMemoryRead(0, (uint32_t *) &rtcData, sizeof(MyData::RtcData));
+   if (!rtcData.isValid() || !isTimerWake()) {
+      return;
+   }
+   if (rtcData.sleepRemainingSec > 0) {
+      myData.rtcData = rtcData;
+      myData.rtcData.energy.wakeUp();
+      sleepHops(rtcData.sleepRemainingSec);
+      return;
+   }
+   if (rtcData.fastSleepVoltage == 0.0 || rtcData.isWifiRequested) {
+      return;
+   }
+   myData.rtcData = rtcData;
+   if (ANALOG_FACTOR * analogRead(A0) >= rtcData.fastSleepVoltage ||
+       secondsSincePowerOn() - rtcData.deepSleepStartSec >= rtcData.fastWakeSec) {
+      return;
+   }
+   myData.rtcData.energy.wakeUp();
+   myData.rtcData.fastSleepCount++;
+   myData.rtcData.fastSleepUs = micros();
+   sleepHops(rtcData.fastSleepIntervalSec);
+}
+
 /**
   * Read the deepsleep counter from the RTC memory.
   * Use a simple random value variable to identify if the counter is still 
@@ -69,15 +123,25 @@ bool MyDeepSleep::begin()
       MyDbg(F("RtcData read"));
       myData.rtcData = rtcData;
    }
+   myData.rtcData.energy.wakeUp();
+   myData.rtcData.battery.update(myOptions, myData.voltage, myData.getPowerConsumption(myOptions));
+   myScheduler.update();
+   if (myData.rtcData.fastSleepVoltage != 0.0 || myData.rtcData.sleepRemainingSec != 0) {
+      // Full start until the next sleep, i.e. if the options are changed or on a reset.
+      myData.rtcData.fastSleepVoltage  = 0.0;
+      myData.rtcData.sleepRemainingSec = 0;
+      myData.rtcData.setCRC();
+      ESP.rtcUserMemoryWrite(0, (uint32_t *) &myData.rtcData, sizeof(MyData::RtcData));
+   }
 
    if (myOptions.isDeepSleepEnabled && secondsSincePowerOn() > NO_DEEP_SLEEP_STARTUP_TIME) {
-      if (myData.voltage < myOptions.powerSaveModeVoltage) {
+      if (myData.isLowPower) {
          long checkTimeElapsed = secondsSincePowerOn() - myData.rtcData.deepSleepStartSec;
 
          // Check from time to time the power and return to deep sleep if the 
-         // power is too low until the deep sleep time is over.
+         // power is too low until the deep sleep time or the scheduled interval is over.
          MyDbg((String) F("CheckTime elapsed: ") + String(checkTimeElapsed) + F(" sec"));
-         if (checkTimeElapsed < myOptions.deepSleepTimeSec) {
+         if (!myScheduler.isModemWake()) {
             sleep(false); // back to sleep
          }
          MyDbg(F("Awake"));
@@ -86,19 +150,43 @@ bool MyDeepSleep::begin()
    return true;
 }
 
+/** Is this start a wake from the deep sleep (not a power on or a reset)? */
+bool MyDeepSleep::isTimerWake()
+{
+   return ESP.getResetInfoPtr()->reason == REASON_DEEP_SLEEP_AWAKE;
+}
+
+/** The WiFi starts after a power on or a reset, on request and always without the sim808
+  * because the mqtt connection needs it.
+  */
+bool MyDeepSleep::isWifiWake()
+{
+#ifdef SIM808_CONNECTED
+   return !isTimerWake() || myData.rtcData.isWifiRequested;
+#else
+   return true;
+#endif
+}
+
+/** Is the radio on or was it switched off with the last deep sleep? */
+bool MyDeepSleep::isRfAvailable()
+{
+   return !isTimerWake() || !myData.rtcData.isRfDisabled;
+}
+
 /** Check if the configured time has elapsed and the voltage is too low then go into deep sleep. */
 bool MyDeepSleep::haveToSleep()
 {
    long activeTimeSec = millis() / 1000 - myData.awakeTimeOffsetSec;
 
    myData.secondsToDeepSleep = -1;
-   if (myOptions.isDeepSleepEnabled && myData.voltage < myOptions.powerSaveModeVoltage) {
+   if (myOptions.isDeepSleepEnabled && myData.isLowPower) {
       myData.secondsToDeepSleep = max(myOptions.activeTimeSec - activeTimeSec, NO_DEEP_SLEEP_STARTUP_TIME - secondsSincePowerOn());
    }
 
    return (myOptions.isDeepSleepEnabled && 
            secondsSincePowerOn() > NO_DEEP_SLEEP_STARTUP_TIME &&
-           myData.voltage        <  myOptions.powerSaveModeVoltage && 
+           myData.isLowPower &&
            activeTimeSec         >= myOptions.activeTimeSec);
 }
 
@@ -107,19 +195,57 @@ void MyDeepSleep::sleep(bool start /* = true */)
 {
    long powerCheckIntervalSec = myOptions.powerCheckIntervalSec;
 
-   if (powerCheckIntervalSec > 60 * 60) {
-      MyDbg(F("Invalid DeepSleep time more than 60 Minutes!"));
-      powerCheckIntervalSec = 60 * 60;
-   }
    MyDbg((String) F("Entering DeepSleep for: ") + String(myOptions.powerCheckIntervalSec) + F("Sec"));
-   delay(1000);
+   Serial.flush();
 
    if (start) {
       myData.rtcData.deepSleepStartSec = secondsSincePowerOn();
+      myData.rtcData.wasMoving         = myData.isMoving;
    }
+   myData.rtcData.fastSleepVoltage     = myOptions.powerSaveModeVoltage + myOptions.powerSaveHysteresis;
+   myData.rtcData.fastSleepIntervalSec = powerCheckIntervalSec;
+   myData.rtcData.fastWakeSec          = myScheduler.getWakeSec();
+   sleepHops(powerCheckIntervalSec);
+}
+
+/** Sleeps the first hop of the sleep time and keeps the rest for the next hops. */
+void MyDeepSleep::sleepHops(long sleepSec)
+{
+   long hopSec = min(sleepSec, (long) MAX_DEEP_SLEEP_HOP_SEC);
+
+   myData.rtcData.sleepRemainingSec = sleepSec - hopSec;
+   deepSleep(hopSec);
+}
+
+/** Restarts the esp8266 with a short deep sleep to switch the radio on again. */
+void MyDeepSleep::restartWithWifi()
+{
+   MyDbg(F("Restart for the WiFi"));
+   Serial.flush();
+   myData.rtcData.isWifiRequested   = true;
+   myData.rtcData.sleepRemainingSec = 0;
+   deepSleep(1);
+}
+
+/** Adds the active and the sleep time, saves the RTC memory and starts the deep sleep. 
+  * The microseconds are calculated in 64 bit, a 32 bit long overflows after 2147 sec.
+  * With the sim808 the radio stays off after the wake if the WiFi is not requested.
+  * The hop wakes never need the radio.
+  */
+void MyDeepSleep::deepSleep(long sleepSec)
+{
+#ifdef SIM808_CONNECTED
+   myData.rtcData.isRfDisabled = !myData.rtcData.isWifiRequested || myData.rtcData.sleepRemainingSec > 0;
+#else
+   myData.rtcData.isRfDisabled = myData.rtcData.sleepRemainingSec > 0;
+#endif
    myData.rtcData.aktiveTimeSec    += millis() / 1000;
-   myData.rtcData.deepSleepTimeSec += powerCheckIntervalSec;
+   myData.rtcData.deepSleepTimeSec += sleepSec;
+   if (myData.rtcData.isModemSleeping) {
+      myData.rtcData.modemSleepTimeSec += sleepSec;
+   }
+   myData.rtcData.energy.deepSleep(sleepSec);
    myData.rtcData.setCRC();
    ESP.rtcUserMemoryWrite(0, (uint32_t *) &myData.rtcData, sizeof(MyData::RtcData));
-   ESP.deepSleep(powerCheckIntervalSec * 1000000);
+   ESP.deepSleep((uint64_t) sleepSec * 1000000ULL, myData.rtcData.isRfDisabled ? WAKE_RF_DISABLED : WAKE_RF_DEFAULT);
 }
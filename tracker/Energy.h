@@ -0,0 +1,214 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Energy.h
+  *
+  * Energy ledger with the time spent in every power state of the system.
+  */
+
+/** Power states with their own current. The modem states exclude each other, 
+  * all other states are added to them.
+  */
+enum EnergyState {
+   ENERGY_ESP_ACTIVE,        //!< esp8266 awake.
+   ENERGY_WIFI_AP,           //!< WiFi access point switched on.
+   ENERGY_MODEM_REGISTERING, //!< Sim808 starting, registering to the network and connecting the gprs.
+   ENERGY_MODEM_IDLE,        //!< Sim808 registered without data transfer.
+   ENERGY_GPRS_TX,           //!< Sim808 sending via gprs (mqtt or http upload).
+   ENERGY_MODEM_SLEEP,       //!< Sim808 in sleep mode (+CSCLK).
+   ENERGY_GPS_SEARCH,        //!< Gps part of the sim808 switched on.
+   ENERGY_DEEP_SLEEP,        //!< esp8266 in deep sleep.
+   ENERGY_COUNT              //!< Number of states.
+};
+
+/**
+  * Accounts the time of every power state at every state transition.
+  * The ledger is a part of the RTC data, so it has no pointers and 
+  * sums up all wakes and deep sleeps since the power on.
+  * The consumption is calculated with the configured currents of the states.
+  */
+class MyEnergy
+{
+protected:
+   int32_t activeMask;              //!< Bit mask of the states which are on.
+   int32_t lastMs;                  //!< millis() of the last accounting.
+   double  stateSec[ENERGY_COUNT];  //!< Accounted time of every state.
+
+public:
+   MyEnergy();
+
+   void wakeUp();
+   void account();
+
+   void set(EnergyState state, bool on);
+   void setModem(EnergyState state);
+   void modemOff();
+   void transmit(bool on);
+   void deepSleep(long sleepSec);
+
+   bool   isOn(EnergyState state) { return (activeMask & (1L << state)) != 0; }
+   double getSec(EnergyState state);
+   double getMAh(EnergyState state, const double *currentMa);
+   double getMAh(const double *currentMa);
+
+   String getJson(const double *currentMa);
+
+   static const __FlashStringHelper *stateName(EnergyState state);
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyEnergy::MyEnergy()
+   : activeMask(1L << ENERGY_ESP_ACTIVE)
+   , lastMs(0)
+{
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      stateSec[i] = 0.0;
+   }
+}
+
+/** Starts the accounting of a new wake after the RTC data is read. 
+  * Only the sleeping sim808 keeps its state over the deep sleep.
+  */
+void MyEnergy::wakeUp()
+{
+   activeMask = (1L << ENERGY_ESP_ACTIVE) | (activeMask & (1L << ENERGY_MODEM_SLEEP));
+   lastMs     = millis();
+}
+
+/** Adds the time since the last accounting to all states which are on. */
+void MyEnergy::account()
+{
+   long   nowMs = millis();
+   double sec   = (nowMs - lastMs) / 1000.0;
+
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      if (activeMask & (1L << i)) {
+         stateSec[i] += sec;
+      }
+   }
+   lastMs = nowMs;
+}
+
+/** Switches a state on or off. */
+void MyEnergy::set(EnergyState state, bool on)
+{
+   if (isOn(state) != on) {
+      account();
+      if (on) {
+         activeMask |= 1L << state;
+      } else {
+         activeMask &= ~(1L << state);
+      }
+   }
+}
+
+/** Switches the sim808 to one of the modem states. */
+void MyEnergy::setModem(EnergyState state)
+{
+   if (!isOn(state)) {
+      modemOff();
+      set(state, true);
+   }
+}
+
+/** Switches all modem states off, i.e. on power off. */
+void MyEnergy::modemOff()
+{
+   set(ENERGY_MODEM_REGISTERING, false);
+   set(ENERGY_MODEM_IDLE,        false);
+   set(ENERGY_GPRS_TX,           false);
+   set(ENERGY_MODEM_SLEEP,       false);
+}
+
+/** Start or end of a gprs transfer of the registered sim808. Nothing without a modem. */
+void MyEnergy::transmit(bool on)
+{
+   if (on && isOn(ENERGY_MODEM_IDLE)) {
+      setModem(ENERGY_GPRS_TX);
+   } else if (!on && isOn(ENERGY_GPRS_TX)) {
+      setModem(ENERGY_MODEM_IDLE);
+   }
+}
+
+/** Accounts the current wake and the following deep sleep. The sleeping sim808 is accounted too. */
+void MyEnergy::deepSleep(long sleepSec)
+{
+   account();
+   stateSec[ENERGY_DEEP_SLEEP] += sleepSec;
+   if (isOn(ENERGY_MODEM_SLEEP)) {
+      stateSec[ENERGY_MODEM_SLEEP] += sleepSec;
+   }
+}
+
+/** Accounted time of the state including the running time. */
+double MyEnergy::getSec(EnergyState state)
+{
+   account();
+   return stateSec[state];
+}
+
+/** Consumption of the state in mAh with the current of the state in mA. */
+double MyEnergy::getMAh(EnergyState state, const double *currentMa)
+{
+   return currentMa[state] * getSec(state) / 3600.0;
+}
+
+/** Consumption of all states in mAh. */
+double MyEnergy::getMAh(const double *currentMa)
+{
+   double mAh = 0.0;
+
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      mAh += getMAh((EnergyState) i, currentMa);
+   }
+   return mAh;
+}
+
+/** Consumption of every state in mAh, i.e. {"espActive":1.25,"gprsTx":0.31,...,"total":2.10}. 
+  * States without accounted time are not listed.
+  */
+String MyEnergy::getJson(const double *currentMa)
+{
+   String json = F("{");
+
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      if (getSec((EnergyState) i) > 0.0) {
+         json += (String) F("\"") + stateName((EnergyState) i) + F("\":") + 
+                 String(getMAh((EnergyState) i, currentMa), 3) + F(",");
+      }
+   }
+   json += (String) F("\"total\":") + String(getMAh(currentMa), 3) + F("}");
+   return json;
+}
+
+/** Name of the state in the json, the options and on the web page. */
+const __FlashStringHelper *MyEnergy::stateName(EnergyState state)
+{
+   switch (state) {
+      case ENERGY_ESP_ACTIVE:        return F("espActive");
+      case ENERGY_WIFI_AP:           return F("wifiAp");
+      case ENERGY_MODEM_REGISTERING: return F("modemRegistering");
+      case ENERGY_MODEM_IDLE:        return F("modemIdle");
+      case ENERGY_GPRS_TX:           return F("gprsTx");
+      case ENERGY_MODEM_SLEEP:       return F("modemSleep");
+      case ENERGY_GPS_SEARCH:        return F("gpsSearch");
+      case ENERGY_DEEP_SLEEP:        return F("deepSleep");
+      default:                       return F("unknown");
+   }
+}
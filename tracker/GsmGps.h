@@ -21,10 +21,27 @@
   */
 
 
+#include "AtEngine.h"
+
 #define  TINY_GSM_YIELD() { MyDelay(1); } //!< Overwrite the yield macro with our own delay function.
+#define  TINY_GSM_SEND_HOOK() { MyAtEngine::beforeSyncCommand(); }       //!< Synchronous commands wait for the queued command in flight.
+#define  TINY_GSM_URC_HOOK(line) MyAtEngine::dispatchUrc(line)          //!< Urcs received in synchronous commands are routed to the handlers.
 #include "Sim808.h"
 #include "Serial.h"
 
+#define SMS_INDEX_SIZE        4             //!< Maximum number of +CMTI indicated sms waiting to be read.
+#define STATUS_CHECK_SEC      60            //!< Interval of the signal, battery and network query.
+#define MODEM_PROBE_MS        500           //!< Time to wait for an answer of an already running modul.
+#define MODEM_CACHE_FILE_NAME "/modem.txt"  //!< Cached identity of the sim808 modul and the sim card.
+#define MODEM_CACHE_BUILD     __DATE__ " " __TIME__ //!< The cache is only valid for the same firmware.
+#define MODEM_BAUD_DEFAULT    9600          //!< Baud rate of a new modul with auto baud.
+#define MODEM_BAUD_TEST_MS    500           //!< Timeout of one echo test at a new baud rate.
+#define MODEM_BAUD_TESTS      3             //!< Number of echo tests a new baud rate has to pass.
+#define MODEM_BAUD_COUNT      5             //!< Number of the supported baud rates.
+
+/** Baud rates of the sim808 which the SoftwareSerial can handle, in ascending order. */
+static const long modemBaudRates[MODEM_BAUD_COUNT] = { 9600, 19200, 38400, 57600, 115200 };
+
 /**
   * SIM808 Communication class to handle gprs and gps activities.
   */
@@ -34,53 +51,105 @@ protected:
    long          lastGsmChecSec;   //!< Check intervall for signal and battery quality.
    long          lastGpsCheckSec;  //!< GPS Check intervall
    long          startGpsCheck;    //!< Timstamp of first getGps try
+   bool          pdpDeactivated;   //!< Is the gprs context deactivated by the network?
+   bool          socketClosed;     //!< Is the socket closed by the server?
+   bool          gpsRequested;     //!< Is the gps position part of the status query in flight?
+   long          newSmsIndex[SMS_INDEX_SIZE]; //!< Indices of the +CMTI indicated sms.
+   int           newSmsCount;      //!< Number of the indicated sms.
+   long          modemBaud;        //!< Current baud rate of the serial line.
 
 public:
    MySerial      gsmSerial;        //!< Serial interface to the sim808 modul.
    MyGsmSim808   gsmSim808;        //!< SIM808 interface class 
    TinyGsmClient gsmClient;        //!< Gsm client interface
+   MyAtEngine    atEngine;         //!< Queue for the non blocking commands.
+   bool          smsCheckRequested; //!< Should all unread sms be checked, i.e. after the start or if too many are indicated?
    
    MyOptions    &myOptions;        //!< Reference to the options.
    MyData       &myData;           //!< Reference to the data.
+   MyTrack      &myTrack;          //!< Reference to the gps track backlog.
 
 protected:
    void enableGps(bool enable);
-   bool getGps();
-   bool getGpsFromGsm();
+   bool requestGps();
+   void gpsReceived(bool ok, MyGps &gps);
+   void requestGpsFromGsm();
+   void gsmGpsReceived(bool ok, MyGps &gps);
    bool sleepMode2();
+   bool wakeUp();
+   bool probeModem();
+   bool connectModem();
+   void setSerialBaud(long rate);
+   bool testBaud();
+   bool changeBaud(long rate);
+   void negotiateBaud();
+   void readModemInfo(bool warm);
+   bool loadModemCache(const String &ccid);
+   void saveModemCache(const String &ccid);
+
+   void readSignalQuality(const String &info);
+   void readBattery      (const String &info);
+   void readRegistration (const String &info);
+
+   static void onStatus       (void *context, int result, const String &response);
+   static void onGsmGps       (void *context, int result, const String &response);
+
+   static void onSmsUrc       (void *context, const String &line);
+   static void onPdpDeactUrc  (void *context, const String &line);
+   static void onClosedUrc    (void *context, const String &line);
+   static void onSocketDataUrc(void *context, const String &line);
 
 public:
-   MyGsmGps(MyOptions &options, MyData &data, short pinRx, short pinTx);
+   MyGsmGps(MyOptions &options, MyData &data, MyTrack &track, short pinRx, short pinTx);
 
    bool begin();
    void handleClient();
    bool stop();
+   bool sleep();
    bool waitingForGps();
 
    bool sendAT(String cmd);
 
-   bool getSMS(SmsData &sms);
+   int  getSMSList(const String &status, SmsData *list, int size, int &total);
+   bool readNewSMS(SmsData &sms);
    bool sendSMS(String phoneNumber, String message);
    bool deleteSMS(long index);
+   bool deleteReadSMS();
+
+   bool getHostIp(const String &host, IPAddress &ip);
 };
 
 /* ******************************************** */
 
 /** Constructor */
-MyGsmGps::MyGsmGps(MyOptions &options, MyData &data, short pinRx, short pinTx)
+MyGsmGps::MyGsmGps(MyOptions &options, MyData &data, MyTrack &track, short pinRx, short pinTx)
    : gsmSerial(data.logInfos, options.isDebugActive, pinRx, pinTx)
    , gsmSim808(gsmSerial)
-   , gsmClient(gsmSim808)
+   , gsmClient(gsmSim808, 0)
+   , atEngine(gsmSerial)
+   , smsCheckRequested(false)
    , myOptions(options)
    , myData(data)
+   , myTrack(track)
    , lastGsmChecSec(0)
    , lastGpsCheckSec(0)
    , startGpsCheck(0)
+   , pdpDeactivated(false)
+   , socketClosed(false)
+   , gpsRequested(false)
+   , newSmsCount(0)
+   , modemBaud(MODEM_BAUD_DEFAULT)
 {
-   gsmSerial.begin(9600);
+   gsmSerial.begin(modemBaud);
+   atEngine.onUrc(F("+CMTI:"),       onSmsUrc,        this);
+   atEngine.onUrc(F("+PDP: DEACT"),  onPdpDeactUrc,   this);
+   atEngine.onUrc(F(", CLOSED"),     onClosedUrc,     this);
+   atEngine.onUrc(F("+CIPRXGET: 1,"), onSocketDataUrc, this);
 }
 
-/** Initialized the sim808 modul and start optionally the gsm and/ or gps part. */
+/** Initialized the sim808 modul and start optionally the gsm and/ or gps part. 
+  * An already connected modul is used as it is without the restart and the gprs connect.
+  */
 bool MyGsmGps::begin()
 {
    if (!myOptions.powerOn) {
@@ -89,130 +158,258 @@ bool MyGsmGps::begin()
    }
 
    if (!myData.isGsmActive) {
+      long startMs = millis();
+
       MyDbg(F("MyGsmGps::begin"));
-      myData.status = F("Sim808 Initializing...");
-      MyDbg(myData.status);
-      for (int i = 0; !gsmSim808.restart() && i <= 5; i++) {
-         if (!myOptions.powerOn) {
-            MyDbg(F("Sim808 Initializing ... canceled"));
-            return false;
-         }
-         if (i == 5) { // not working!
-            myData.status = F("Sim808 restart failed");
-            MyDbg(myData.status);
-            return false;
-         }
-         MyDbg(F("."), false, false);
-         MyDelay(500);
+      myData.rtcData.energy.setModem(ENERGY_MODEM_REGISTERING);
+      // A running modul still uses the negotiated baud rate.
+      setSerialBaud(myData.rtcData.modemBaud ? myData.rtcData.modemBaud : MODEM_BAUD_DEFAULT);
+      myData.isModemWarm = probeModem();
+      if (myData.isModemWarm) {
+         myData.status = F("Sim808 already connected");
+         MyDbg(myData.status);
+         myData.profiler.start(PHASE_MODEM_INFO);
+         wakeUp();
+         readModemInfo(true);
+         myData.profiler.stop(PHASE_MODEM_INFO);
+      } else if (!connectModem()) {
+         // The failed phases cost the same power, so they are measured too.
+         myData.profiler.stop(PHASE_MODEM_RESTART);
+         myData.profiler.stop(PHASE_NETWORK);
+         return false;
       }
-      myData.status = F("Sim808 connected");
-      MyDbg(myData.status);
+      // Sms received before the indication was enabled are read with the first check.
+      smsCheckRequested   = true;
+      newSmsCount         = 0;
+      myData.modemReadyMs = millis() - startMs;
+      MyDbg((String) F("Sim808 ready: ") + String(myData.modemReadyMs) + 
+         (myData.isModemWarm ? F(" ms (warm)") : F(" ms (cold)")));
 
-      gsmSim808.setBaud(9600);
+      // Average of the start times for the sleep or power off decision.
+      int32_t &averageMs = myData.isModemWarm ? myData.rtcData.modemWarmReadyMs : myData.rtcData.modemColdReadyMs;
 
-      myData.status = F("Sim808 Waiting for network...");
-      MyDbg(myData.status);
-      for (int i = 0; !gsmSim808.waitForNetwork() && i <= 5; i++) {
-         if (!myOptions.powerOn) {
-            MyDbg(F("Sim808 Waiting for network... canceled"));
-            return false;
-         }
-         if (i == 5) { // not working!
-            myData.status = F("Sim808 network failed");
-            MyDbg(myData.status);
-            return false;
-         }
-         MyDbg(F("."), false, false);
-         MyDelay(500);
+      averageMs = averageMs == 0 ? myData.modemReadyMs : (3 * averageMs + myData.modemReadyMs) / 4;
+      myData.isGsmActive = true;
+      myData.rtcData.energy.setModem(ENERGY_MODEM_IDLE);
+   }
+   
+   if (myData.isGsmActive && myOptions.isGpsEnabled && !myData.isGpsActive) {
+      enableGps(true);
+   }
+
+   return true;
+}
+
+/** Checks if the modul is already running, registered and has an active gprs context,
+  * i.e. after a restart of the esp8266 without a power off of the modul.
+  */
+bool MyGsmGps::probeModem()
+{
+   bool ret;
+
+   myData.profiler.start(PHASE_MODEM_PROBE);
+   ret = gsmSim808.testAT(MODEM_PROBE_MS) && 
+         gsmSim808.isNetworkConnected() && gsmSim808.isGprsConnected();
+   myData.profiler.stop(PHASE_MODEM_PROBE);
+   return ret;
+}
+
+/** Restarts the modul, waits for the network and connects the gprs. */
+bool MyGsmGps::connectModem()
+{
+   myData.status = F("Sim808 Initializing...");
+   MyDbg(myData.status);
+   myData.profiler.start(PHASE_MODEM_RESTART);
+   for (int i = 0; !gsmSim808.restart() && i <= 5; i++) {
+      if (!myOptions.powerOn) {
+         MyDbg(F("Sim808 Initializing ... canceled"));
+         return false;
       }
-      if (!gsmSim808.isNetworkConnected()) {
-         myData.status = F("Sim808 network failed");
+      if (i == 5) { // not working!
+         myData.status = F("Sim808 restart failed");
          MyDbg(myData.status);
-      } else {
-         myData.status = F("Sim808 network connected");
+         return false;
+      }
+      // The modul could still use the fixed baud rate of an earlier negotiation.
+      setSerialBaud(modemBaudRates[(i + 1) % MODEM_BAUD_COUNT]);
+      MyDbg(F("."), false, false);
+      MyDelay(500);
+   }
+   myData.profiler.stop(PHASE_MODEM_RESTART);
+   myData.status = F("Sim808 connected");
+   MyDbg(myData.status);
+
+   negotiateBaud();
+
+   myData.status = F("Sim808 Waiting for network...");
+   MyDbg(myData.status);
+   myData.profiler.start(PHASE_NETWORK);
+   for (int i = 0; !gsmSim808.waitForNetwork() && i <= 5; i++) {
+      if (!myOptions.powerOn) {
+         MyDbg(F("Sim808 Waiting for network... canceled"));
+         return false;
+      }
+      if (i == 5) { // not working!
+         myData.status = F("Sim808 network failed");
          MyDbg(myData.status);
+         return false;
+      }
+      MyDbg(F("."), false, false);
+      MyDelay(500);
+   }
+   myData.profiler.stop(PHASE_NETWORK);
+   if (!gsmSim808.isNetworkConnected()) {
+      myData.status = F("Sim808 network failed");
+      MyDbg(myData.status);
+   } else {
+      myData.status = F("Sim808 network connected");
+      MyDbg(myData.status);
 
-         MyDbg((String) F("GPRS: ") + myOptions.gprsAP + 
-            F(" User: ") + myOptions.gprsUser + F(" Password: ") + myOptions.gprsPassword);
-         if (!gsmSim808.gprsConnect(myOptions.gprsAP.c_str(), myOptions.gprsUser.c_str(), myOptions.gprsPassword.c_str())) {
-            myData.status = F("Sim808 gprs connection failed!");
-            MyDbg(myData.status);
-            return false;
-         }
-         myData.status = F("Sim808 gsm connected");
+      MyDbg((String) F("GPRS: ") + myOptions.gprsAP + 
+         F(" User: ") + myOptions.gprsUser + F(" Password: ") + myOptions.gprsPassword);
+      myData.profiler.start(PHASE_GPRS);
+      if (!gsmSim808.gprsConnect(myOptions.gprsAP.c_str(), myOptions.gprsUser.c_str(), myOptions.gprsPassword.c_str())) {
+         myData.profiler.stop(PHASE_GPRS);
+         myData.status = F("Sim808 gprs connection failed!");
          MyDbg(myData.status);
+         return false;
+      }
+      myData.profiler.stop(PHASE_GPRS);
+      myData.status = F("Sim808 gsm connected");
+      MyDbg(myData.status);
 
-         myData.modemInfo = gsmSim808.getModemInfo();
-         MyDbg((String) F("Modem info: ") + myData.modemInfo);
+      myData.profiler.start(PHASE_MODEM_INFO);
+      readModemInfo(false);
+
+      if (!gsmSim808.enableSmsIndication()) {
+         MyDbg(F("sms indication failed"));
+      }
+      myData.profiler.stop(PHASE_MODEM_INFO);
+   }
+   return true;
+}
 
-         myData.modemIP = gsmSim808.getLocalIP();
-         MyDbg((String) F("Modem IP: ") + myData.modemIP);
+/** Reads the modem ip. The modem info, the imei and the operator are taken from the cache 
+  * on a warm start. After a power on only the operator is read again if the sim card and 
+  * the firmware are the same as in the cache.
+  */
+void MyGsmGps::readModemInfo(bool warm)
+{
+   String ccid = warm ? String() : gsmSim808.getSimCCID();
 
-         myData.imei = gsmSim808.getIMEI();
-         MyDbg((String) F("sim808: ") + myData.modemInfo);
+   myData.modemIP = gsmSim808.getLocalIP();
+   MyDbg((String) F("Modem IP: ") + myData.modemIP);
 
-         myData.cop = gsmSim808.getOperator();
-         MyDbg((String) F("cop: ") + myData.modemInfo);
+   if (loadModemCache(ccid)) {
+      MyDbg((String) F("Modem info: ") + myData.modemInfo + F(" (cached)"));
+      if (warm) {
+         return;
       }
-      myData.isGsmActive = true;
+   } else {
+      if (warm) {
+         ccid = gsmSim808.getSimCCID();
+      }
+      myData.modemInfo = gsmSim808.getModemInfo();
+      MyDbg((String) F("Modem info: ") + myData.modemInfo);
+
+      myData.imei = gsmSim808.getIMEI();
+      MyDbg((String) F("IMEI: ") + myData.imei);
    }
-   
-   if (myData.isGsmActive && myOptions.isGpsEnabled && !myData.isGpsActive) {
-      enableGps(true);
+
+   myData.cop = gsmSim808.getOperator();
+   MyDbg((String) F("cop: ") + myData.cop);
+   saveModemCache(ccid);
+}
+
+/** Loads the modem identity from the cache file if it belongs to the same firmware 
+  * and the same sim card (an empty ccid matches every sim card).
+  */
+bool MyGsmGps::loadModemCache(const String &ccid)
+{
+   File file = SPIFFS.open(MODEM_CACHE_FILE_NAME, "r");
+
+   if (!file) {
+      return false;
    }
 
+   String build     = Trim(file.readStringUntil('\n'), F("\r"));
+   String cacheCcid = Trim(file.readStringUntil('\n'), F("\r"));
+   String imei      = Trim(file.readStringUntil('\n'), F("\r"));
+   String modemInfo = Trim(file.readStringUntil('\n'), F("\r"));
+   String cop       = Trim(file.readStringUntil('\n'), F("\r"));
+
+   file.close();
+   if (build != F(MODEM_CACHE_BUILD) || imei == "" || (ccid != "" && ccid != cacheCcid)) {
+      return false;
+   }
+   myData.imei      = imei;
+   myData.modemInfo = modemInfo;
+   myData.cop       = cop;
    return true;
 }
 
-/** Checks the gps from time to time if enabled. */
+/** Stores the modem identity in the cache file. */
+void MyGsmGps::saveModemCache(const String &ccid)
+{
+   File file = SPIFFS.open(MODEM_CACHE_FILE_NAME, "w+");
+
+   if (!file) {
+      MyDbg(F("Failed to write modem cache"));
+      return;
+   }
+   file.println(F(MODEM_CACHE_BUILD));
+   file.println(ccid);
+   file.println(myData.imei);
+   file.println(myData.modemInfo);
+   file.println(myData.cop);
+   file.close();
+}
+
+/** Checks the gps from time to time if enabled. 
+  * The commands are queued and the results are processed in the callbacks
+  * so the gps, sms and mqtt parts do not wait for each other.
+  */
 void MyGsmGps::handleClient()
 {
+   gsmSerial.handleLog();
    if (!myData.isGsmActive) {
       return;
    }
 
-   if (secondsElapsedAndUpdate(lastGsmChecSec, 60000)) { // Check every minute
-      myData.signalQuality = String(gsmSim808.getSignalQuality());
-      myData.batteryLevel  = String(gsmSim808.getBattPercent());
-      myData.batteryVolt   = String(gsmSim808.getBattVoltage() / 1000.0F, 2);
+   atEngine.loop();
 
-      MyDbg((String) F("(sim808) signalQuality: ") + myData.signalQuality);
-      MyDbg((String) F("(sim808) batteryLevel: ")  + myData.batteryLevel);
-      MyDbg((String) F("(sim808) batteryVolt: ")   + myData.batteryVolt);
+   if (pdpDeactivated) {
+      pdpDeactivated = false;
+      MyDbg(F("Sim808 gprs deactivated, reconnecting..."));
+      if (!gsmSim808.gprsConnect(myOptions.gprsAP.c_str(), myOptions.gprsUser.c_str(), myOptions.gprsPassword.c_str())) {
+         MyDbg(F("Sim808 gprs connection failed!"));
+      }
    }
+   if (socketClosed) {
+      socketClosed = false;
+      gsmClient.stop();
+   }
+
+   // The due queries are sent as one compound command with one answer.
+   String command;
+   String info;
 
+   if (!atEngine.isQueued(F("+CSQ")) && secondsElapsedAndUpdate(lastGsmChecSec, STATUS_CHECK_SEC)) {
+      command = F("+CSQ;+CBC;+CREG?");
+      info    = F("+CSQ:;+CBC:;+CREG:");
+   }
    if (secondsElapsedAndUpdate(lastGpsCheckSec, 10)) { // Wait 10 sec between retries
-      if (secondsElapsed(myData.rtcData.lastGpsReadSec, myOptions.gpsCheckIntervalSec)) {
-         if (!myData.isGpsActive) {
-            enableGps(true);
-         }
-         MyDbg(F("getGPS"));
-         if (startGpsCheck == 0) {
-            startGpsCheck = secondsSincePowerOn();
-         }
-         if (getGps()) {
-            MyDbg(F(" -> ok"));
-            startGpsCheck = 0;
-            myData.rtcData.lastGpsReadSec = secondsSincePowerOn();
-         } else {
-            long waitForGpsTime = secondsSincePowerOn() - startGpsCheck;
-
-            // Ignore gps if we cannot get a position in X minutes.
-            if (waitForGpsTime > myOptions.gpsTimeoutSec) {
-               getGpsFromGsm(); // fallback from gsm
-
-               MyDbg(F(" -> gps timeout!"));
-               startGpsCheck = 0;
-               myData.waitingForGps = false;
-               myData.rtcData.lastGpsReadSec = secondsSincePowerOn();
-            } else {
-               if (myOptions.gpsTimeoutSec - waitForGpsTime > 0) {
-                  MyDbg((String) F(" -> no gps fix (timeout in ") + String(myOptions.gpsTimeoutSec - waitForGpsTime) + F(" seconds!)"));
-               }
-            }
-         }
+      if (secondsElapsed(myData.rtcData.lastGpsReadSec, myOptions.gpsCheckIntervalSec) && requestGps()) {
+         command += command.length() > 0 ? F(";+CGNSINF")  : F("+CGNSINF");
+         info    += info.length()    > 0 ? F(";+CGNSINF:") : F("+CGNSINF:");
+         gpsRequested = true;
       }
    }
+   if (command.length() > 0 && !atEngine.send(command, info, 1000L, onStatus, this)) {
+      gpsRequested = false;
+   }
+
+   atEngine.loop();
 }
 
 /** Stops the sim808 modul and go to deep sleep mode. */
@@ -221,6 +418,10 @@ bool MyGsmGps::stop()
    bool ret = true;
    
    MyDbg(F("gprs gps stopping"));
+   myData.profiler.start(PHASE_MODEM_STOP);
+   atEngine.waitForIdle();
+   atEngine.clear();
+   gpsRequested = false;
    enableGps(false);
    if (gsmSim808.isGprsConnected()) {
       ret = gsmSim808.gprsDisconnect();
@@ -231,6 +432,95 @@ bool MyGsmGps::stop()
       myData.status = F("Sim808 stopped!");
       sleepMode2();
    }
+   myData.profiler.stop(PHASE_MODEM_STOP);
+   return ret;
+}
+
+/** Sets the baud rate of the serial line to the modul. */
+void MyGsmGps::setSerialBaud(long rate)
+{
+   if (rate != modemBaud) {
+      modemBaud = rate;
+      gsmSerial.begin(rate);
+   }
+}
+
+/** Echo test of the serial line: every AT has to be answered with OK. */
+bool MyGsmGps::testBaud()
+{
+   for (int i = 0; i < MODEM_BAUD_TESTS; i++) {
+      if (!gsmSim808.testAT(MODEM_BAUD_TEST_MS)) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/** Switches the modul and the serial line to the baud rate with AT+IPR.
+  * If the echo test fails, the modul is switched back to the old baud rate.
+  */
+bool MyGsmGps::changeBaud(long rate)
+{
+   long oldBaud = modemBaud;
+
+   gsmSim808.setBaud(rate);
+   if (gsmSim808.waitResponse() != 1) { // The OK still arrives with the old baud rate.
+      MyDbg((String) F("Sim808 baud rate ") + String(rate) + F(" not supported"));
+      return false;
+   }
+   setSerialBaud(rate);
+   if (testBaud()) {
+      return true;
+   }
+   MyDbg((String) F("Sim808 baud rate ") + String(rate) + F(" failed"));
+   gsmSim808.setBaud(oldBaud);
+   gsmSim808.waitResponse(MODEM_BAUD_TEST_MS);
+   setSerialBaud(oldBaud);
+   if (!testBaud()) {
+      MyDbg(F("Sim808 baud rate fallback failed"));
+   }
+   return false;
+}
+
+/** Steps up through the baud rates up to modemMaxBaud as long as the echo test passes.
+  * The working baud rate is stored in the RTC memory for the next wakeups.
+  */
+void MyGsmGps::negotiateBaud()
+{
+   long maxBaud = MODEM_BAUD_DEFAULT;
+
+   for (int i = 0; i < MODEM_BAUD_COUNT && modemBaudRates[i] <= myOptions.modemMaxBaud; i++) {
+      maxBaud = modemBaudRates[i];
+   }
+   if (modemBaud > maxBaud) {
+      changeBaud(maxBaud);
+   }
+   for (int i = 0; i < MODEM_BAUD_COUNT && modemBaudRates[i] <= maxBaud; i++) {
+      if (modemBaudRates[i] > modemBaud && !changeBaud(modemBaudRates[i])) {
+         break;
+      }
+   }
+   myData.rtcData.modemBaud = modemBaud;
+   MyDbg((String) F("Sim808 baud rate: ") + String(modemBaud));
+}
+
+/** Stops the gps and lets the modul sleep with the network registration and the 
+  * gprs context intact, so the next begin can use it without a restart. 
+  */
+bool MyGsmGps::sleep()
+{
+   bool ret;
+
+   MyDbg(F("gprs gps sleeping"));
+   myData.profiler.start(PHASE_MODEM_STOP);
+   atEngine.waitForIdle();
+   atEngine.clear();
+   gpsRequested = false;
+   enableGps(false);
+   myData.isGsmActive = false;
+   myData.status = F("Sim808 sleeping");
+   ret = sleepMode2();
+   myData.profiler.stop(PHASE_MODEM_STOP);
    return ret;
 }
 
@@ -250,6 +540,7 @@ bool MyGsmGps::sendAT(String cmd)
 
    String response;
 
+   atEngine.waitForIdle();
    gsmSerial.print(cmd);
    gsmSerial.print(F("\r\n"));
    gsmSim808.waitResponse(1000, response);
@@ -258,22 +549,54 @@ bool MyGsmGps::sendAT(String cmd)
 }
 
 /** Entering the power save mode of the sim808 modul. */
+/** Lets the modul sleep if the serial line is idle. The first character on the serial line wakes it up. */
 bool MyGsmGps::sleepMode2()
 {
    MyDbg(F("Entering gsm sleep mode 2"));
-   return sendAT(GF("+CSCLK=2"));
+   gsmSim808.sendAT(GF("+CSCLK=2"));
+   return gsmSim808.waitResponse() == 1;
 }
 
-/** Read one sms if available. */
-bool MyGsmGps::getSMS(SmsData &sms)
+/** Switches the sleep mode of a sleeping modul off. */
+bool MyGsmGps::wakeUp()
 {
+   gsmSim808.sendAT(GF("+CSCLK=0"));
+   return gsmSim808.waitResponse() == 1;
+}
+
+/** Read all sms with the status into the list with one +CMGL listing. */
+int MyGsmGps::getSMSList(const String &status, SmsData *list, int size, int &total)
+{
+   total = 0;
    if (!myData.isGsmActive) {
       MyDbg(F("gsm not active!"));
+      return 0;
+   }
+
+   MyDbg((String) F("getSMSList: ") + status);
+   return gsmSim808.getSMSList(status, list, size, total);
+}
+
+/** Read the next sms which was indicated with a +CMTI urc. */
+bool MyGsmGps::readNewSMS(SmsData &sms)
+{
+   if (!myData.isGsmActive) {
       return false;
    }
 
-   MyDbg(F("getSMS"));
-   return gsmSim808.getSMS(sms);
+   while (newSmsCount > 0) {
+      long index = newSmsIndex[0];
+
+      newSmsCount--;
+      for (int i = 0; i < newSmsCount; i++) {
+         newSmsIndex[i] = newSmsIndex[i + 1];
+      }
+      MyDbg((String) F("readNewSMS: ") + String(index));
+      if (gsmSim808.readSMS(index, sms)) {
+         return true;
+      }
+   }
+   return false;
 }
 
 /** Send one sms to a specific phone number via gsm. */
@@ -300,6 +623,30 @@ bool MyGsmGps::deleteSMS(long index)
    return gsmSim808.deleteSMS(index);
 }
 
+/** Delete all read sms from the sim card. */
+bool MyGsmGps::deleteReadSMS()
+{
+   if (!myData.isGsmActive) {
+      MyDbg(F("gsm not active!"));
+      return false;
+   }
+
+   MyDbg(F("deleteReadSMS"));
+   return gsmSim808.deleteReadSMS();
+}
+
+/** Resolve the ip address of a host name via gprs. */
+bool MyGsmGps::getHostIp(const String &host, IPAddress &ip)
+{
+   if (!myData.isGsmActive) {
+      MyDbg(F("gsm not active!"));
+      return false;
+   }
+
+   MyDbg((String) F("getHostIp: ") + host);
+   return gsmSim808.getHostIp(host, ip);
+}
+
 /** Switch on the gps part of the sim808 modul. */
 void MyGsmGps::enableGps(bool enable)
 {
@@ -313,67 +660,95 @@ void MyGsmGps::enableGps(bool enable)
       myData.status = F("Sim808 gps enabled!");
       MyDbg(myData.status);
       myData.isGpsActive = true;
+      myData.rtcData.energy.set(ENERGY_GPS_SEARCH, true);
    } else {
       gsmSim808.disableGPS();
       myData.status = F("Sim808 gps disabled!");
       MyDbg(myData.status);
       myData.isGpsActive = false;
+      myData.rtcData.energy.set(ENERGY_GPS_SEARCH, false);
    }
 }
 
-/** Read one gps position with the sim808 modul and save the values in the global data. */
-bool MyGsmGps::getGps()
+/** Prepares a gps request, returns false if one is already queued. 
+  * The +CGNSINF is sent with the status query, the position is processed in gpsReceived. 
+  */
+bool MyGsmGps::requestGps()
 {
-   if (!myData.isGsmActive) {
-      MyDbg(F("sim808 gsm not active!"));
+   if (gpsRequested || atEngine.isQueued(F("+CGNSINF"))) {
       return false;
    }
+   if (!myData.isGpsActive) {
+      enableGps(true);
+   }
+   MyDbg(F("getGPS"));
+   if (startGpsCheck == 0) {
+      startGpsCheck = secondsSincePowerOn();
+      myData.profiler.start(PHASE_GPS_FIX);
+   }
+   myData.waitingForGps = true;
+   return true;
+}
 
-   bool ret = false;
-
-   if (myData.isGpsActive) {
-      MyGps gps;
+/** Saves a received gps position in the global data or checks the gps timeout. */
+void MyGsmGps::gpsReceived(bool ok, MyGps &gps)
+{
+   if (ok) {
+      MyDbg(F(" -> ok"));
+      startGpsCheck = 0;
+      myData.profiler.stop(PHASE_GPS_FIX);
+      myData.rtcData.lastGpsReadSec = secondsSincePowerOn();
+      myData.lastGpsUpdateSec       = secondsSincePowerOn();
+
+      MyDbg((String) F("(gps) longitude: ")  + gps.longitudeString());
+      MyDbg((String) F("(gps) latitude: ")   + gps.latitudeString());
+      MyDbg((String) F("(gps) altitude: ")   + gps.altitudeString());
+      MyDbg((String) F("(gps) kmph: ")       + gps.kmphString());
+      MyDbg((String) F("(gps) satellites: ") + gps.satellitesString());
+      MyDbg((String) F("(gps) course: ")     + gps.courseString());
+      MyDbg((String) F("(gps) gpsDate: ")    + gps.date.dateString());
+      MyDbg((String) F("(gps) gpsTime: ")    + gps.time.timeString());
 
-      myData.waitingForGps = true;
-      if (gsmSim808.getGps(gps)) {
-         myData.lastGpsUpdateSec = secondsSincePowerOn();
+      if (myData.rtcData.lastGps.location.latitude() != 0) {
+         myData.movingDistance = gps.location.distanceTo(myData.rtcData.lastGps.location);
+         myData.isMoving       = myData.movingDistance > myOptions.minMovingDistance;
+      }
+      myData.rtcData.lastGps = gps;
+      myData.waitingForGps   = false;
+      myTrack.add(gps);
+   } else {
+      long waitForGpsTime = secondsSincePowerOn() - startGpsCheck;
 
-         MyDbg((String) F("(gps) longitude: ")  + gps.longitudeString());
-         MyDbg((String) F("(gps) latitude: ")   + gps.latitudeString());
-         MyDbg((String) F("(gps) altitude: ")   + gps.altitudeString());
-         MyDbg((String) F("(gps) kmph: ")       + gps.kmphString());
-         MyDbg((String) F("(gps) satellites: ") + gps.satellitesString());
-         MyDbg((String) F("(gps) course: ")     + gps.courseString());
-         MyDbg((String) F("(gps) gpsDate: ")    + gps.date.dateString());
-         MyDbg((String) F("(gps) gpsTime: ")    + gps.time.timeString());
+      // Ignore gps if we cannot get a position in X minutes.
+      if (waitForGpsTime > myOptions.gpsTimeoutSec) {
+         requestGpsFromGsm(); // fallback from gsm
 
-         if (myData.rtcData.lastGps.location.latitude() != 0) {
-            myData.movingDistance = gps.location.distanceTo(myData.rtcData.lastGps.location);
-            myData.isMoving       = myData.movingDistance > myOptions.minMovingDistance;
-         }
-         myData.rtcData.lastGps = gps;
-         myData.waitingForGps   = false;
-         ret = true;
+         MyDbg(F(" -> gps timeout!"));
+         startGpsCheck = 0;
+         myData.profiler.stop(PHASE_GPS_FIX);
+         myData.waitingForGps = false;
+         myData.rtcData.lastGpsReadSec = secondsSincePowerOn();
       } else {
-         MyDbg(F(" -> GPS timeout!"));
+         if (myOptions.gpsTimeoutSec - waitForGpsTime > 0) {
+            MyDbg((String) F(" -> no gps fix (timeout in ") + String(myOptions.gpsTimeoutSec - waitForGpsTime) + F(" seconds!)"));
+         }
       }
    }
-   return ret;
 }
 
-/** Get the Gps position from the gsm modul as fallback. */
-bool MyGsmGps::getGpsFromGsm()
+/** Queues the request of the gps position from the gsm modul as fallback. */
+void MyGsmGps::requestGpsFromGsm()
 {
-   if (!myData.isGsmActive) {
-      MyDbg(F("sim808 gsm not active!"));
-      return false;
-   }
-
-   MyGps gps;
-
-   // Get the GPS position as fallback from the GSM modul.
    MyDbg(F("getGsmGps"));
-   if (gsmSim808.getGsmGps(gps)) {
+   myData.profiler.start(PHASE_GSM_GPS);
+   atEngine.send(F("+CIPGSMLOC=1,1"), F("+CIPGSMLOC:"), 10000L, onGsmGps, this);
+}
+
+/** Saves the gps position from the gsm modul in the global data. */
+void MyGsmGps::gsmGpsReceived(bool ok, MyGps &gps)
+{
+   myData.profiler.stop(PHASE_GSM_GPS);
+   if (ok) {
       myData.lastGpsUpdateSec = secondsSincePowerOn();
             
       MyDbg((String) F("(gsmGps) longitude: ") + gps.longitudeString());
@@ -386,9 +761,122 @@ bool MyGsmGps::getGpsFromGsm()
          myData.isMoving       = myData.movingDistance > myOptions.minMovingDistance;
       }
       myData.rtcData.lastGps = gps;
-      return true;
    } else {
       MyDbg(F(" -> GsmGPS timeout!"));
    }
-   return false;
+}
+
+/** Result of the compound status query i.e. 'AT+CSQ;+CBC;+CREG?;+CGNSINF'. 
+  * Every info line is parsed on its own because the modul stops on the first failing part.
+  */
+void MyGsmGps::onStatus(void *context, int result, const String &response)
+{
+   MyGsmGps *self = (MyGsmGps *) context;
+
+   self->readSignalQuality(MyAtEngine::infoLine(response, F("+CSQ:")));
+   self->readBattery      (MyAtEngine::infoLine(response, F("+CBC:")));
+   self->readRegistration (MyAtEngine::infoLine(response, F("+CREG:")));
+   if (self->gpsRequested) {
+      String gpsInfo = MyAtEngine::infoLine(response, F("+CGNSINF:"));
+      MyGps  gps;
+      bool   ok      = gpsInfo.length() > 0 && MyGsmSim808::parseGps(gpsInfo.substring(9), gps);
+
+      self->gpsRequested = false;
+      self->gpsReceived(ok, gps);
+   }
+}
+
+/** Info line of the +CSQ query i.e. '+CSQ: 19,0'. */
+void MyGsmGps::readSignalQuality(const String &info)
+{
+   if (info.length() > 0) {
+      myData.signalQuality = String(info.substring(5).toInt());
+      MyDbg((String) F("(sim808) signalQuality: ") + myData.signalQuality);
+   }
+}
+
+/** Info line of the +CBC query i.e. '+CBC: 0,85,4050'. */
+void MyGsmGps::readBattery(const String &info)
+{
+   if (info.length() > 0) {
+      int    pos = 5;
+      /* charge state */                 MyGsmSim808::nextField(info, pos);
+      String percent   = MyGsmSim808::nextField(info, pos);
+      String milliVolt = MyGsmSim808::nextField(info, pos);
+
+      myData.batteryLevel = String(percent.toInt());
+      myData.batteryVolt  = String(milliVolt.toInt() / 1000.0F, 2);
+      MyDbg((String) F("(sim808) batteryLevel: ") + myData.batteryLevel);
+      MyDbg((String) F("(sim808) batteryVolt: ")  + myData.batteryVolt);
+   }
+}
+
+/** Info line of the +CREG? query i.e. '+CREG: 0,1' (1 = home network, 5 = roaming). */
+void MyGsmGps::readRegistration(const String &info)
+{
+   if (info.length() > 0) {
+      int    pos    = 6;
+      /* mode */      MyGsmSim808::nextField(info, pos);
+      String status = MyGsmSim808::nextField(info, pos);
+
+      status.trim();
+      if (status != "1" && status != "5") {
+         myData.status = F("Sim808 network lost");
+         MyDbg((String) F("(sim808) registration: ") + status);
+      }
+   }
+}
+
+/** Result of the +CIPGSMLOC request. */
+void MyGsmGps::onGsmGps(void *context, int result, const String &response)
+{
+   MyGsmGps *self = (MyGsmGps *) context;
+   MyGps     gps;
+   bool      ok   = result == AT_RESULT_OK && MyGsmSim808::parseGsmGps(response.substring(response.indexOf(':') + 1), gps);
+
+   self->gsmGpsReceived(ok, gps);
+}
+
+/** A new sms is stored on the sim card. 
+  * Sample: +CMTI: "SM",3
+  */
+void MyGsmGps::onSmsUrc(void *context, const String &line)
+{
+   MyGsmGps *self  = (MyGsmGps *) context;
+   int       comma = line.lastIndexOf(',');
+
+   MyDbg((String) F("(sim808) ") + line);
+   if (comma == -1 || self->newSmsCount >= SMS_INDEX_SIZE) {
+      self->smsCheckRequested = true;
+   } else {
+      self->newSmsIndex[self->newSmsCount++] = line.substring(comma + 1).toInt();
+   }
+}
+
+/** The network has deactivated the gprs context, reconnect in handleClient. */
+void MyGsmGps::onPdpDeactUrc(void *context, const String &line)
+{
+   MyGsmGps *self = (MyGsmGps *) context;
+
+   MyDbg((String) F("(sim808) ") + line);
+   self->pdpDeactivated = true;
+}
+
+/** The server has closed the socket. */
+void MyGsmGps::onClosedUrc(void *context, const String &line)
+{
+   MyGsmGps *self = (MyGsmGps *) context;
+
+   MyDbg((String) F("(sim808) ") + line);
+   self->socketClosed = true;
+}
+
+/** New socket data '+CIPRXGET: 1,<mux>', the next available() of the client reads it directly
+  * instead of waiting for its periodic poll.
+  */
+void MyGsmGps::onSocketDataUrc(void *context, const String &line)
+{
+   MyGsmGps *self = (MyGsmGps *) context;
+
+   self->gsmSim808.notifyData(line.substring(line.indexOf(',') + 1).toInt());
 }
@@ -21,62 +21,125 @@
   */
 
 
+#define GSM_COLD_READY_MS 30000 //!< Assumed time until the sim808 is ready after a power on as long as nothing is measured.
+#define GSM_WARM_READY_MS  2000 //!< Assumed time until the sim808 is ready after a sleep as long as nothing is measured.
+
 /**
   * Class to switch on/off the DC-DC modul LM2596.
+  * Decides also if the sim808 should stay in sleep mode during the deep sleep
+  * of the esp8266 instead of being switched off. The DC-DC on/off pin has to keep 
+  * its level during the deep sleep for this.
   */
 class MyGsmPower
 {
 protected:
-   MyData &myData;          //!< Reference to the data
+   MyOptions &myOptions;    //!< Reference to the options
+   MyData    &myData;       //!< Reference to the data
 
    int     pinPower;        //!< esp8266 pin connected with pin 5 of the LM2596 modul. 
    long    powerOnStartSec; //!< Timestamp of power on.
       
 public:
-   MyGsmPower(MyData &data, int pin);
+   MyGsmPower(MyOptions &options, MyData &data, int pin);
    
    bool begin();
 
    void on();
    void off();   
+
+   bool keepAsleep(long sleepSec);
+   void sleep();
 };
 
 /* ******************************************** */
 
 /** Constructor */
-MyGsmPower::MyGsmPower(MyData &data, int pin)
-   : myData(data)
+MyGsmPower::MyGsmPower(MyOptions &options, MyData &data, int pin)
+   : myOptions(options)
+   , myData(data)
    , pinPower(pin)
    , powerOnStartSec(0)
 {
 }
 
-/** Set the pin mode to input -> switch off the DC-DC module */
+/** Set the pin mode to input -> switch off the DC-DC module 
+  * The module stays on if the sim808 was kept in sleep mode during the deep sleep. 
+  */
 bool MyGsmPower::begin()
 {
    MyDbg(F("MyGsmPower::begin"));
-   pinMode(pinPower, INPUT);
+   if (myData.rtcData.isModemSleeping && myOptions.powerOn) {
+      MyDbg(F("sim808 kept asleep"));
+      pinMode(pinPower, OUTPUT);
+      digitalWrite(pinPower, LOW); 
+      myData.isPowerOn = true;
+      powerOnStartSec  = millis() / 1000;
+   } else {
+      pinMode(pinPower, INPUT);
+      myData.rtcData.energy.modemOff();
+   }
+   myData.rtcData.isModemSleeping = false;
    return true;
 }
 
 /** Switch on the DC-DC module */
 void MyGsmPower::on()
 {
+   if (myData.isPowerOn) {
+      return;
+   }
    MyDbg(F("MyGsmPower::on"));
    pinMode(pinPower, OUTPUT);
    digitalWrite(pinPower, LOW); 
    myData.isPowerOn = true;
    powerOnStartSec  = millis() / 1000;
+   myData.rtcData.energy.setModem(ENERGY_MODEM_REGISTERING);
    MyDelay(1000);
 }
 
 /** Switch off the DC-DC module */
 void MyGsmPower::off()
 {
-   MyDbg(F("MyGsmPower::off"));
+   long powerOnSec = millis() / 1000 - powerOnStartSec;
+
+   MyDbg((String) F("MyGsmPower::off (on for ") + String(powerOnSec) + F(" sec)"));
    pinMode(pinPower, INPUT);
    digitalWrite(pinPower, HIGH); 
-   myData.rtcData.powerOnTimeSec += millis() / 1000 - powerOnStartSec;
+   myData.rtcData.powerOnTimeSec += powerOnSec;
+   myData.rtcData.energy.modemOff();
+   myData.isPowerOn = false;
+   powerOnStartSec = 0;
+}
+
+/** Is it cheaper to keep the sim808 in sleep mode for the given time than to switch 
+  * it off and pay the network registration and the gprs attach on the next wakeup?
+  * The costs are calculated in mAs from the measured start times in the RTC memory
+  * and the configured currents of the energy ledger.
+  */
+bool MyGsmPower::keepAsleep(long sleepSec)
+{
+   if (!myOptions.isGsmSleepEnabled || !myData.isPowerOn) {
+      return false;
+   }
+
+   long   coldMs    = myData.rtcData.modemColdReadyMs ? myData.rtcData.modemColdReadyMs : GSM_COLD_READY_MS;
+   long   warmMs    = myData.rtcData.modemWarmReadyMs ? myData.rtcData.modemWarmReadyMs : GSM_WARM_READY_MS;
+   double sleepCost = myOptions.energyMa[ENERGY_MODEM_SLEEP]       * sleepSec;
+   double startCost = myOptions.energyMa[ENERGY_MODEM_REGISTERING] * (coldMs - warmMs) / 1000.0;
+
+   MyDbg((String) F("sim808 sleep: ") + String(sleepCost, 0) + F(" mAs, restart: ") + String(startCost, 0) + F(" mAs"));
+   return sleepCost < startCost;
+}
+
+/** Leaves the DC-DC module on for the sleeping sim808 during the deep sleep. */
+void MyGsmPower::sleep()
+{
+   long powerOnSec = millis() / 1000 - powerOnStartSec;
+
+   MyDbg((String) F("MyGsmPower::sleep (on for ") + String(powerOnSec) + F(" sec)"));
+   myData.rtcData.powerOnTimeSec += powerOnSec;
+   myData.rtcData.isModemSleeping = true;
+   myData.rtcData.energy.setModem(ENERGY_MODEM_SLEEP);
    myData.isPowerOn = false;
    powerOnStartSec = 0;
 }
@@ -26,8 +26,11 @@
 #define topic_deep_sleep             "/DeepSleep"              //!< Deep sleep on/off
 
 #define topic_voltage                "/Voltage"                //!< Power supply voltage
+#define topic_voltage_stat           "/VoltageStat"            //!< Min, avg and max voltage since the last publish
 #define topic_mAh                    "/mAh"                    //!< Power consumption
 #define topic_mAhLowPower            "/mAhLowPower"            //!< Power consumption in low power
+#define topic_energy                 "/Energy"                 //!< Power consumption of every power state
+#define topic_battery                "/Battery"                //!< State of charge and remaining runtime of the battery
 #define topic_alive                  "/Alive"                  //!< Alive time in sec
 #define topic_rssi                   "/RSSI"                   //!< Wifi conection quality
 
@@ -47,6 +50,13 @@
 
 #define topic_gps                    "/Gps"                    //!< Gps longitude, latitude, altitude, moving speed
 #define topic_gps_distance           "/GpsDistance"            //!< Gps distance to last position         
+#define topic_gps_track              "/GpsTrack"               //!< Stored gps positions (QoS 1)
+
+#define topic_config                 "/Config"                 //!< Retained versioned config 'v=1;key=value;...'
+#define topic_diagnostics            "/Diagnostics"            //!< Phase durations of the current wake in ms
+
+/** This function has to be overwritten to resolve the mqtt server name via gsm or wifi. */
+bool myResolveHost(const String &host, IPAddress &ip);
 
 /**
   * MQTT client for sending the collected data to a MQTT server
@@ -55,6 +65,11 @@ class MyMqtt : protected PubSubClient
 {
 protected:
    static MyOptions *g_myOptions;   //!< Static option pointer for the callback function.
+   static bool       g_hasConfig;   //!< Is the retained config received in this session.
+   static bool       g_isConfigChanged; //!< Has the config changed the options, so they are saved after the session.
+
+   static bool isTopic(const String &topic, const char *subTopic);
+   static void applyConfig(const String &config);
 
 public:
    static void mqttCallback(char* topic, byte* payload, unsigned int len);
@@ -62,18 +77,23 @@ public:
 protected:
    MyOptions &myOptions;            //!< Reference to the options. 
    MyData    &myData;               //!< Reference to the data.
+   MyTrack   &myTrack;              //!< Reference to the gps track backlog.
    bool       publishInProgress;    //!< Are we publishing right now.
 
 protected:
    bool mySubscribe(String subTopic);
-   bool myPublish(String subTopic, String value);
+   bool myPublish(String subTopic, String value, bool retained = true, uint8_t qos = 0);
+   void publishTrack();
+   bool setServerAddress(bool forceResolve);
+   bool isSendDue();
 
 public:
-   MyMqtt(Client &client, MyOptions &options, MyData &data);
+   MyMqtt(Client &client, MyOptions &options, MyData &data, MyTrack &track);
    ~MyMqtt();
    
    bool begin();
    void handleClient();
+   void stop();
    
    bool waitingForMqtt();
 };
@@ -81,10 +101,11 @@ public:
 /* ******************************************** */
 
 /** Constructor/Destructor */
-MyMqtt::MyMqtt(Client &client, MyOptions &options, MyData &data)
+MyMqtt::MyMqtt(Client &client, MyOptions &options, MyData &data, MyTrack &track)
    : PubSubClient(client)
    , myOptions(options)
    , myData(data)
+   , myTrack(track)
    , publishInProgress(false)
 {
    g_myOptions = &options;
@@ -113,7 +134,7 @@ bool MyMqtt::mySubscribe(String subTopic)
 /** Helper function to publish on mqtt 
  *  It put the mqttName from optione before the topic.
 */
-bool MyMqtt::myPublish(String subTopic, String value)
+bool MyMqtt::myPublish(String subTopic, String value, bool retained, uint8_t qos)
 {
    if (!myData.isGsmActive) {
       return false;
@@ -126,26 +147,119 @@ bool MyMqtt::myPublish(String subTopic, String value)
 
       topic = myOptions.mqttName + F("/") + myOptions.mqttId + subTopic;
       MyDbg((String) F("MyMqtt::publish: [") + topic + F("]=[") + value + F("]"), true);
-      ret = PubSubClient::publish(topic.c_str(), value.c_str(), true);
+      ret = PubSubClient::publish(topic.c_str(), value.c_str(), retained, qos);
+      // Processes the received messages i.e. the retained config without waiting.
+      PubSubClient::loop();
    }
    return ret;
 }
 
-/** Check if we have to wait for sending mqtt data. */
-bool MyMqtt::waitingForMqtt()
+/** Publishes the stored gps track with QoS 1.
+ *  Up to mqttInflightWindow positions are sent without waiting for the PUBACK.
+ *  The positions are only removed if all of them are acknowledged.
+ *  A backlog is left for the http upload.
+ */
+void MyMqtt::publishTrack()
 {
-   if (!myData.isGsmActive) {
+   if (myTrack.isBacklog()) {
+      MyDbg(F("MQTT track left for the http upload"), true);
+      return;
+   }
+
+   File file = SPIFFS.open(TRACK_FILE_NAME, "r");
+
+   if (!file) {
+      return;
+   }
+
+   long count = 0;
+   bool ok    = true;
+
+   PubSubClient::setInflightWindow(myOptions.mqttInflightWindow);
+   while (ok && file.available()) {
+      String line = file.readStringUntil('\n');
+
+      line.trim();
+      if (line.length() > 0) {
+         ok = myPublish(topic_gps_track, line, false, 1);
+      }
+      count++;
+   }
+   file.close();
+   if (ok && PubSubClient::waitInflight(0)) {
+      myTrack.removeHead(count);
+   } else {
+      MyDbg(F("MQTT track not acknowledged"), true);
+   }
+}
+
+/** Sets the server ip from the rtc cache or resolves the server name if the cache is expired.
+  * Returns true if the cached ip is used.
+  */
+bool MyMqtt::setServerAddress(bool forceResolve)
+{
+   MyData::RtcData &rtcData   = myData.rtcData;
+   int32_t          serverCrc = crc32(0, (unsigned char *) myOptions.mqttServer.c_str(), myOptions.mqttServer.length());
+   IPAddress        ip;
+
+   if (ip.fromString(myOptions.mqttServer)) {
+      PubSubClient::setServer(ip, myOptions.mqttPort);
       return false;
    }
-   if (publishInProgress) {
+   if (!forceResolve && myOptions.mqttDnsCacheSec > 0 &&
+       rtcData.mqttServerIp != 0 && rtcData.mqttServerCrc == serverCrc &&
+       !secondsElapsed(rtcData.mqttServerIpSec, myOptions.mqttDnsCacheSec)) {
+      ip = rtcData.mqttServerIp;
+      MyDbg((String) F("MQTT server ip (cached): ") + ip.toString(), true);
+      PubSubClient::setServer(ip, myOptions.mqttPort);
       return true;
    }
-   if (myData.isMoving) {
+
+   bool resolved;
+   
+   rtcData.mqttServerIp = 0;
+   myData.profiler.start(PHASE_MQTT_DNS);
+   resolved = myResolveHost(myOptions.mqttServer, ip);
+   myData.profiler.stop(PHASE_MQTT_DNS);
+   if (resolved) {
+      MyDbg((String) F("MQTT server ip: ") + ip.toString() + F(" (") + String(myData.profiler.getLastMs(PHASE_MQTT_DNS)) + F(" ms)"), true);
+      if (myOptions.mqttDnsCacheSec > 0) {
+         rtcData.mqttServerIp    = ip;
+         rtcData.mqttServerIpSec = secondsSincePowerOn();
+         rtcData.mqttServerCrc   = serverCrc;
+      }
+      PubSubClient::setServer(ip, myOptions.mqttPort);
+   } else {
+      MyDbg(F("MQTT server name not resolved!"), true);
+      PubSubClient::setServer(myOptions.mqttServer.c_str(), myOptions.mqttPort);
+   }
+   return false;
+}
+
+/** Is the send interval elapsed? Every scheduled modem wake sends, 
+  * without the scheduler the interval depends on the moving state.
+  */
+bool MyMqtt::isSendDue()
+{
+   if (myOptions.isSchedulerEnabled && myData.rtcData.scheduledWakeSec != 0) {
+      return secondsElapsed(myData.rtcData.lastMqttPublishSec, myData.rtcData.scheduledWakeSec);
+   } else if (myData.isMoving) {
       return secondsElapsed(myData.rtcData.lastMqttPublishSec, myOptions.mqttSendOnMoveEverySec);
    } else {
       return secondsElapsed(myData.rtcData.lastMqttPublishSec, myOptions.mqttSendOnNonMoveEverySec);
    }
-   return false;
+}
+
+/** Check if we have to wait for sending mqtt data. */
+bool MyMqtt::waitingForMqtt()
+{
+   if (!myData.isGsmActive) {
+      return false;
+   }
+   if (publishInProgress) {
+      return true;
+   }
+   return isSendDue();
 }
 
 /** Sets the MQTT server settings */
@@ -164,19 +278,19 @@ void MyMqtt::handleClient()
       return;
    }
 
-   bool send = false;
-
-   if (myData.isMoving) {
-      send = secondsElapsed(myData.rtcData.lastMqttPublishSec, myOptions.mqttSendOnMoveEverySec);
-   } else {
-      send = secondsElapsed(myData.rtcData.lastMqttPublishSec, myOptions.mqttSendOnNonMoveEverySec);
-   }
-   if (send && !publishInProgress) {
+   if (isSendDue() && !publishInProgress) {
+      myData.profiler.start(PHASE_MQTT_CONNECT);
+      myData.rtcData.energy.transmit(true);
       publishInProgress = true;
       if (!PubSubClient::connected()) {
+         bool ipFromCache = setServerAddress(false);
+         
          for (int i = 0; !PubSubClient::connected() && i < 5; i++) {  
             MyDbg(F("Attempting MQTT connection..."), true);
             if (PubSubClient::connect(myOptions.mqttName.c_str(), myOptions.mqttUser.c_str(), myOptions.mqttPassword.c_str())) {  
+               // The retained config arrives while we are publishing.
+               g_hasConfig = false;
+               mySubscribe(topic_config);
                // mySubscribe(topic_deep_sleep);
                // mySubscribe(topic_power_on);
 #ifdef SIM808_CONNECTED
@@ -187,19 +301,32 @@ void MyMqtt::handleClient()
                MyDbg(F(" connected"), true);
             } else {  
                MyDbg((String) F("   Mqtt failed, rc = ") + String(PubSubClient::state()), true);
+               if (ipFromCache) { // The cached ip could be outdated.
+                  ipFromCache = setServerAddress(true);
+               }
                MyDbg(F(" Try again in 5 seconds"), true);
                MyDelay(5000);
                MyDbg(F("."), true, false);
             }  
          }  
       }
+      myData.profiler.stop(PHASE_MQTT_CONNECT);
+      MyDbg((String) F("MQTT connect: ") + String(myData.profiler.getLastMs(PHASE_MQTT_CONNECT)) + F(" ms"), true);
       if (PubSubClient::connected()) {
          char gpsJson[255];
 
+         myData.profiler.start(PHASE_MQTT_PUBLISH);
          MyDbg(F("Attempting MQTT publishing"), true);
          myPublish(topic_voltage,     String(myData.voltage, 2));
-         myPublish(topic_mAh,         String(myData.getPowerConsumption()));
+         if (myPublish(topic_voltage_stat, myData.getVoltageStatJson())) {
+            myData.resetVoltageStat();
+         }
+         myPublish(topic_mAh,         String(myData.getPowerConsumption(myOptions)));
          myPublish(topic_mAhLowPower, String(myData.getLowPowerPowerConsumption()));
+         myPublish(topic_energy,      myData.rtcData.energy.getJson(myOptions.energyMa));
+         if (myData.rtcData.battery.isValid()) {
+            myPublish(topic_battery,  myData.rtcData.battery.getJson(myOptions));
+         }
          myPublish(topic_alive,       formatInterval(myData.getActiveTimeSec()));
 #ifndef SIM808_CONNECTED
          myPublish(topic_rssi,        WifiGetRssiAsQuality(WiFi.RSSI()));
@@ -217,24 +344,105 @@ void MyMqtt::handleClient()
             myPublish(topic_gps, gpsJson);
             myPublish(topic_gps_distance, String(myData.movingDistance));
          }
+         publishTrack();
 #endif
          myData.rtcData.mqttSendCount++;
          myData.rtcData.mqttLastSentTime = myData.rtcData.lastGps.time;
-         MyDbg(F("mqtt published"), true);
-         MyDelay(5000);
+         myData.profiler.stop(PHASE_MQTT_PUBLISH);
+         MyDbg((String) F("mqtt published: ") + String(myData.profiler.getLastMs(PHASE_MQTT_PUBLISH)) + F(" ms"), true);
+         if (myOptions.isMqttDiagnostics) {
+            myPublish(topic_diagnostics, myData.profiler.getWakeJson(), false);
+         }
+         if (myOptions.isMqttOneShot) {
+            stop();
+         } else {
+            MyDelay(5000);
+         }
+      }
+      if (g_isConfigChanged) {
+         g_isConfigChanged = false;
+         myOptions.save();
       }
       // Set time even on error
       myData.rtcData.lastMqttPublishSec = secondsSincePowerOn();
+      myData.rtcData.energy.transmit(false);
       publishInProgress = false;
    }
 }
 
-MyOptions *MyMqtt::g_myOptions = NULL;
+/** Sends the DISCONNECT and closes the socket so no keepalive keeps the modem busy. */
+void MyMqtt::stop()
+{
+   if (PubSubClient::connected()) {
+      myData.profiler.start(PHASE_MQTT_DISCONNECT);
+      PubSubClient::disconnect();
+      myData.profiler.stop(PHASE_MQTT_DISCONNECT);
+      MyDbg((String) F("MQTT disconnect: ") + String(myData.profiler.getLastMs(PHASE_MQTT_DISCONNECT)) + F(" ms"), true);
+   }
+}
+
+MyOptions *MyMqtt::g_myOptions       = NULL;
+bool       MyMqtt::g_hasConfig       = false;
+bool       MyMqtt::g_isConfigChanged = false;
+
+/** Checks the received topic against our 'mqttName/mqttId/subTopic' topic. */
+bool MyMqtt::isTopic(const String &topic, const char *subTopic)
+{
+   return topic == g_myOptions->mqttName + F("/") + g_myOptions->mqttId + subTopic;
+}
+
+/** Applies the config 'v=version;key=value;...' if the version differs from the last applied one. 
+ *  Only changed versions are parsed. The options are saved after the session and not in the callback.
+ */
+void MyMqtt::applyConfig(const String &config)
+{
+   int  idx     = config.indexOf(';');
+   long version = 0;
+
+   if (config.startsWith(F("v="))) {
+      version = atol(config.substring(2, idx == -1 ? config.length() : idx).c_str());
+   }
+   if (version <= 0) {
+      MyDbg(F("MQTT config without version!"), true);
+      return;
+   }
+   if (version == g_myOptions->remoteConfigVersion) {
+      MyDbg((String) F("MQTT config unchanged: v=") + String(version), true);
+      return;
+   }
+
+   while (idx != -1) {
+      int    next  = config.indexOf(';', idx + 1);
+      String entry = config.substring(idx + 1, next == -1 ? config.length() : next);
+
+      entry.trim();
+
+      int eq = entry.indexOf('=');
+
+      if (eq > 0) {
+         String key   = entry.substring(0, eq);
+         String value = entry.substring(eq + 1);
+
+         key.trim();
+         value.trim();
+         if (g_myOptions->setOption(key, value)) {
+            MyDbg((String) F("MQTT config '") + key + F("=") + value + F("'"), true);
+         } else {
+            MyDbg((String) F("MQTT wrong config entry: ") + entry, true);
+         }
+      } else if (entry.length() > 0) {
+         MyDbg((String) F("MQTT wrong config entry: ") + entry, true);
+      }
+      idx = next;
+   }
+   g_myOptions->remoteConfigVersion = version;
+   g_isConfigChanged = true;
+}
 
 /** Static function for MQTT callback on registered topics. */
 void MyMqtt::mqttCallback(char* topic, byte* payload, unsigned int len) 
 {
-   if (topic == NULL || payload == NULL || len <= 0 || len > 200) {
+   if (topic == NULL || payload == NULL || len <= 0 || len > 500) {
       return;
    }
 
@@ -246,27 +454,33 @@ void MyMqtt::mqttCallback(char* topic, byte* payload, unsigned int len)
    MyDbg(F("]"), true);
 
    if (MyMqtt::g_myOptions) {
-      if (strTopic == g_myOptions->mqttName + topic_deep_sleep) {
+      if (isTopic(strTopic, topic_config)) {
+         if (!g_hasConfig) {
+            g_hasConfig = true;
+            applyConfig((char *) payload);
+         }
+      }
+      if (isTopic(strTopic, topic_deep_sleep)) {
          g_myOptions->isDeepSleepEnabled = atoi((char *) payload);
-         MyDbg(strTopic + g_myOptions->isDeepSleepEnabled ? F(" - On") : F(" - Off"), true);
+         MyDbg(strTopic + (g_myOptions->isDeepSleepEnabled ? F(" - On") : F(" - Off")), true);
       }
-      if (strTopic == g_myOptions->mqttName + topic_power_on) {
+      if (isTopic(strTopic, topic_power_on)) {
          g_myOptions->powerOn = atoi((char *) payload);
-         MyDbg(strTopic + g_myOptions->powerOn ? F(" - On") : F(" - Off"), true);
+         MyDbg(strTopic + (g_myOptions->powerOn ? F(" - On") : F(" - Off")), true);
       }
-      if (strTopic == g_myOptions->mqttName + topic_gps_enabled) {
+      if (isTopic(strTopic, topic_gps_enabled)) {
          g_myOptions->isGpsEnabled = atoi((char *) payload);
-         MyDbg(strTopic + g_myOptions->isGpsEnabled ? F(" - Enabled") : F(" - Disabled"), true);
+         MyDbg(strTopic + (g_myOptions->isGpsEnabled ? F(" - Enabled") : F(" - Disabled")), true);
       }
-      if (strTopic == g_myOptions->mqttName + topic_send_on_move_every) {
+      if (isTopic(strTopic, topic_send_on_move_every)) {
          g_myOptions->mqttSendOnMoveEverySec = atoi((char *) payload);
          MyDbg(strTopic + " - " + String(g_myOptions->mqttSendOnMoveEverySec), true);
       }
-      if (strTopic == g_myOptions->mqttName + topic_send_on_non_move_every) {
+      if (isTopic(strTopic, topic_send_on_non_move_every)) {
          g_myOptions->mqttSendOnNonMoveEverySec = atoi((char *) payload);
          MyDbg(strTopic + " - " + String(g_myOptions->mqttSendOnNonMoveEverySec), true);
       }
-      if (strTopic == g_myOptions->mqttName + topic_send_every) {
+      if (isTopic(strTopic, topic_send_every)) {
          g_myOptions->mqttSendOnNonMoveEverySec = atoi((char *)payload);
          MyDbg(strTopic + " - " + String(g_myOptions->mqttSendOnNonMoveEverySec), true);
       }
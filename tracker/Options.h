@@ -20,7 +20,50 @@
   * Configuration data with load and save to the SPIFFS.
   */
 
-#define OPTION_FILE_NAME "/options.txt" //!< Option file name.
+#define OPTION_FILE_NAME     "/options.txt" //!< Option file name.
+#define RTC_USER_MEMORY_SIZE 512            //!< Bytes of the RTC user memory of the esp8266.
+#define RTC_OPTIONS_MIN_SIZE 96             //!< Minimum bytes of the RTC memory which are left for the options snapshot.
+#define OPTION_SNAPSHOT_MASK 8              //!< Bytes of the bit mask of the stored options (up to 64 options).
+
+uint32_t rtcOptionsOffset(); // 4 byte block of the options snapshot in the RTC memory, see Data.h
+
+/**
+  * Compact binary copy of the options in the RTC memory behind the RtcData.
+  * Only the options which differ from the defaults are stored, so a usual 
+  * configuration fits into the free bytes of the RTC memory. The bit mask tells
+  * which options are stored. The CRC includes the compile time, so a new firmware 
+  * with other defaults or another order never reads an old snapshot.
+  */
+class MyOptionsSnapshot
+{
+public:
+   uint32_t crc;                              //!< CRC of the generation, the data and the compile time.
+   uint16_t generation;                       //!< Incremented on every save.
+   uint16_t size;                             //!< Used bytes of the data.
+   uint8_t  data[RTC_USER_MEMORY_SIZE];       //!< Bit mask of the stored options followed by their values.
+
+   bool     isWriting;                        //!< Copy the options into the data or out of it?
+   bool     isOverflow;                       //!< Did the options not fit into the data?
+   int      index;                            //!< Number of the next option.
+   int      pos;                              //!< Position of the next value in the data.
+
+public:
+   MyOptionsSnapshot(bool writing);
+
+   static int capacity();
+
+   uint32_t getCRC();
+
+   void transfer(bool   &value, bool   def);
+   void transfer(long   &value, long   def);
+   void transfer(double &value, double def);
+   void transfer(String &value, const String &def);
+
+protected:
+   bool isStored(bool changed);
+   void copy(void *value, int len);
+};
+
 
 /** 
   * Class with the complete configuration data of the programm.
@@ -33,9 +76,11 @@ public:
    String gprsAP;                    //!< GRPS access point of the sim card supplier.
    String gprsUser;                  //!< GRPS access point User.
    String gprsPassword;              //!< GRPS access point Password.
+   long   modemMaxBaud;              //!< Highest baud rate to negotiate with the sim808 (9600 = no negotiation).
    bool   connectWifiAP;             //!< Should we connect to wifi
    String wifiAP;                    //!< WiFi AP name.
    String wifiPassword;              //!< WiFi AP password.
+   long   wifiIdleSec;               //!< Switch off the WiFi if no station is connected for this time (0 = never).
    bool   isDebugActive;             //!< Is detailed debugging enabled?
    long   bme280CheckIntervalSec;    //!< Time interval to read the temp, hum and pressure.
    bool   powerOn;                   //!< Is the GSM power from the DC-DC modul switched on? 
@@ -45,25 +90,52 @@ public:
    long   gpsCheckIntervalSec;       //!< Time interval to check the gps position.
    long   minMovingDistance;         //!< Minimum distance to accept as moving or not.
    String phoneNumber;               //!< Pone number for sms answers.
-   long   smsCheckIntervalSec;       //!< SMS check intervall.
+   long   smsCheckIntervalSec;       //!< Interval of the full sms check beside the +CMTI indication.
    bool   isDeepSleepEnabled;        //!< Should the system go into deepsleep if needed.
    double powerSaveModeVoltage;      //!< Minimum voltage to stay always alive.
+   double powerSaveHysteresis;       //!< Voltage above powerSaveModeVoltage to leave the power saving mode.
+   long   voltageSampleMs;           //!< Time between two reads of the supply voltage.
    long   powerCheckIntervalSec;     //!< Time interval to check the power supply.
    long   activeTimeSec;             //!< Maximum alive time after deepsleep.
    long   deepSleepTimeSec;          //!< Time to stay in deep sleep (without check interrupts)
+   bool   isGsmSleepEnabled;         //!< Keep the sim808 in sleep mode during short deep sleeps instead of switching it off.
+   double energyMa[ENERGY_COUNT];    //!< Current of every power state in mA for the energy ledger.
+   bool   isSchedulerEnabled;        //!< Compute the modem wake interval from motion, backlog, voltage trend and budget.
+   double dailyBudgetMah;            //!< Energy budget per day in mAh for the scheduler (0 = no budget).
+   double batteryCapacityMah;        //!< Capacity of the battery in mAh for the state of charge.
+   String batteryCurve;              //!< Rest voltage to state of charge curve of the battery, i.e. "11.8:0,12.7:100".
    bool   isMqttEnabled;             //!< Should the system connect to a MQTT server?
    String mqttName;                  //!< MQTT server name.
    String mqttId;                    //!< MQTT ID.
    String mqttServer;                //!< MQTT server url.
    long   mqttPort;                  //!< MQTT server port.
+   long   mqttDnsCacheSec;           //!< How long the resolved MQTT server ip is valid (0 = no cache).
    String mqttUser;                  //!< MQTT user.
    String mqttPassword;              //!< MQTT password.
    long   mqttSendOnMoveEverySec;    //!< Send data interval to MQTT server on moving.
    long   mqttSendOnNonMoveEverySec; //!< Send data interval to MQTT server on non moving.
+   bool   isMqttOneShot;             //!< Disconnect from the MQTT server directly after publishing.
+   bool   isMqttDiagnostics;         //!< Send the phase durations of every wake to the MQTT server.
+   long   mqttInflightWindow;        //!< Number of unacknowledged track messages (QoS 1).
+   String httpUploadUrl;             //!< Url for the http upload of a big track backlog (empty = mqtt only).
+   long   httpBacklogSize;           //!< Track file size in bytes from which it is uploaded via http.
+   long   remoteConfigVersion;       //!< Version of the last applied MQTT config.
+
+   long   snapshotGeneration;        //!< Generation of the RTC snapshot the options are loaded from, 0 = option file.
+   long   snapshotSize;              //!< Bytes of the RTC snapshot, 0 = too big for the RTC memory.
+   long   loadUs;                    //!< Duration of the last load.
+
+protected:
+   void transfer(MyOptionsSnapshot &snapshot);
+   bool loadSnapshot();
+   void saveSnapshot();
+   bool loadFile();
 
 public:
    MyOptions();
 
+   bool setOption(const String &key, const String &value);
+
    bool load();
    bool save();
 };
@@ -75,9 +147,11 @@ MyOptions::MyOptions()
    , gprsAP(GPRS_AP)
    , gprsUser(GPRS_USER)
    , gprsPassword(GPRS_PASSWORD)
+   , modemMaxBaud(57600)
    , wifiAP(WIFI_SID)
    , connectWifiAP(false)
    , wifiPassword(WIFI_PW)
+   , wifiIdleSec(600)           // 10 Min
    , bme280CheckIntervalSec(60) // 1 Min
    , powerOn(false)
    , isSmsEnabled(false)
@@ -86,26 +160,180 @@ MyOptions::MyOptions()
    , gpsCheckIntervalSec(300)   //  5 Min
    , minMovingDistance(3000)    //  3 km
    , phoneNumber(PHONE_NUMBER)
-   , smsCheckIntervalSec(600)   //  1 Min
+   , smsCheckIntervalSec(3600)  //  1 Hour
    , isDeepSleepEnabled(false)
    , powerSaveModeVoltage(16.0)
+   , powerSaveHysteresis(0.2)
+   , voltageSampleMs(1000)      //  1 Sec
    , powerCheckIntervalSec(300) //  5 Min
    , activeTimeSec(60)          //  1 Min
    , deepSleepTimeSec(900)      // 15 Min
+   , isGsmSleepEnabled(false)
+   , isSchedulerEnabled(false)
+   , dailyBudgetMah(0.0)
+   , batteryCapacityMah(BATTERY_CAPACITY_MAH)
+   , batteryCurve(BATTERY_CURVE)
    , isMqttEnabled(false)
    , mqttName(MQTT_NAME)
    , mqttId(MQTT_ID)
    , mqttServer(MQTT_SERVER)
    , mqttPort(MQTT_PORT)
+   , mqttDnsCacheSec(86400)           //  24 h
    , mqttUser(MQTT_USER)
    , mqttPassword(MQTT_PASSWORD)
    , mqttSendOnMoveEverySec(900)      //  15 Min
    , mqttSendOnNonMoveEverySec(10800) // 180 Min
+   , isMqttOneShot(false)
+   , isMqttDiagnostics(false)
+   , mqttInflightWindow(4)
+   , httpBacklogSize(2048)            //  ~20 positions
+   , remoteConfigVersion(0)
+   , snapshotGeneration(0)
+   , snapshotSize(0)
+   , loadUs(0)
 {
+   energyMa[ENERGY_ESP_ACTIVE]        = ENERGY_MA_ESP_ACTIVE;
+   energyMa[ENERGY_WIFI_AP]           = ENERGY_MA_WIFI_AP;
+   energyMa[ENERGY_MODEM_REGISTERING] = ENERGY_MA_MODEM_REGISTERING;
+   energyMa[ENERGY_MODEM_IDLE]        = ENERGY_MA_MODEM_IDLE;
+   energyMa[ENERGY_GPRS_TX]           = ENERGY_MA_GPRS_TX;
+   energyMa[ENERGY_MODEM_SLEEP]       = ENERGY_MA_MODEM_SLEEP;
+   energyMa[ENERGY_GPS_SEARCH]        = ENERGY_MA_GPS_SEARCH;
+   energyMa[ENERGY_DEEP_SLEEP]        = ENERGY_MA_DEEP_SLEEP;
 }
 
-/** Load the key-value pairs from the option file into the option values. */
+/** Sets one option value by its key name. Returns false on an unknown key. */
+bool MyOptions::setOption(const String &key, const String &value)
+{
+   long   lValue = atol(value.c_str());
+   double fValue = atof(value.c_str());
+
+   if (key == F("isDebugActive")) {
+      isDebugActive = lValue;
+   } else if (key == F("gprsAP")) {
+      gprsAP = value;
+   } else if (key == F("gprsUser")) {
+      gprsUser = value;
+   } else if (key == F("gprsPassword")) {
+      gprsPassword = value;
+   } else if (key == F("modemMaxBaud")) {
+      modemMaxBaud = lValue;
+   } else if (key == F("wifiAP")) {
+      wifiAP = value;
+   } else if (key == F("connectWifiAP")) {
+      connectWifiAP = lValue;
+   } else if (key == F("wifiPassword")) {
+      wifiPassword = value;
+   } else if (key == F("wifiIdleSec")) {
+      wifiIdleSec = lValue;
+   } else if (key == F("powerOn")) {
+      powerOn = lValue;
+   } else if (key == F("bme280CheckIntervalSec")) {
+      bme280CheckIntervalSec = lValue;
+   } else if (key == F("isSmsEnabled")) {
+      isSmsEnabled = lValue;
+   } else if (key == F("isGpsEnabled")) {
+      isGpsEnabled = lValue;
+   } else if (key == F("gpsTimeoutSec")) {
+      gpsTimeoutSec = lValue;
+   } else if (key == F("gpsCheckIntervalSec")) {
+      gpsCheckIntervalSec = lValue;
+   } else if (key == F("minMovingDistance")) {
+      minMovingDistance = lValue;
+   } else if (key == F("phoneNumber")) {
+      phoneNumber = value;
+   } else if (key == F("smsCheckIntervalSec")) {
+      smsCheckIntervalSec = lValue;
+   } else if (key == F("isDeepSleepEnabled")) {
+      isDeepSleepEnabled = lValue;
+   } else if (key == F("powerSaveModeVoltage")) {
+      powerSaveModeVoltage = fValue;
+   } else if (key == F("powerSaveHysteresis")) {
+      powerSaveHysteresis = fValue;
+   } else if (key == F("voltageSampleMs")) {
+      voltageSampleMs = lValue;
+   } else if (key == F("powerCheckIntervalSec")) {
+      powerCheckIntervalSec = lValue;
+   } else if (key == F("activeTimeSec")) {
+      activeTimeSec = lValue;
+   } else if (key == F("deepSleepTimeSec")) {
+      deepSleepTimeSec = lValue;
+   } else if (key == F("isGsmSleepEnabled")) {
+      isGsmSleepEnabled = lValue;
+   } else if (key == F("isSchedulerEnabled")) {
+      isSchedulerEnabled = lValue;
+   } else if (key == F("dailyBudgetMah")) {
+      dailyBudgetMah = fValue;
+   } else if (key == F("batteryCapacityMah")) {
+      batteryCapacityMah = fValue;
+   } else if (key == F("batteryCurve")) {
+      batteryCurve = value;
+   } else if (key == F("isMqttEnabled")) {
+      isMqttEnabled = lValue;
+   } else if (key == F("mqttName")) {
+      mqttName = value;
+   } else if (key == F("mqttId")) {
+      mqttId = value;
+   } else if (key == F("mqttServer")) {
+      mqttServer = value;
+   } else if (key == F("mqttPort")) {
+      mqttPort = lValue;
+   } else if (key == F("mqttDnsCacheSec")) {
+      mqttDnsCacheSec = lValue;
+   } else if (key == F("mqttUser")) {
+      mqttUser = value;
+   } else if (key == F("mqttPassword")) {
+      mqttPassword = value;
+   } else if (key == F("mqttSendOnMoveEverySec")) {
+      mqttSendOnMoveEverySec = lValue;
+   } else if (key == F("mqttSendOnNonMoveEverySec")) {
+      mqttSendOnNonMoveEverySec = lValue;
+   } else if (key == F("isMqttOneShot")) {
+      isMqttOneShot = lValue;
+   } else if (key == F("isMqttDiagnostics")) {
+      isMqttDiagnostics = lValue;
+   } else if (key == F("mqttInflightWindow")) {
+      mqttInflightWindow = lValue;
+   } else if (key == F("httpUploadUrl")) {
+      httpUploadUrl = value;
+   } else if (key == F("httpBacklogSize")) {
+      httpBacklogSize = lValue;
+   } else if (key == F("remoteConfigVersion")) {
+      remoteConfigVersion = lValue;
+   } else if (key.startsWith(F("energyMa_"))) {
+      for (int i = 0; i < ENERGY_COUNT; i++) {
+         if (key.substring(9) == MyEnergy::stateName((EnergyState) i)) {
+            energyMa[i] = fValue;
+            return true;
+         }
+      }
+      return false;
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/** Load the options from the RTC snapshot or if it is not valid from the option file. 
+  * The snapshot saves the SPIFFS read and the key parsing on every wake. 
+  */
 bool MyOptions::load()
+{
+   unsigned long startUs = micros();
+   bool          ret     = loadSnapshot();
+
+   if (!ret) {
+      ret = loadFile();
+      if (ret) {
+         saveSnapshot();
+      }
+   }
+   loadUs = micros() - startUs;
+   return ret;
+}
+
+/** Load the key-value pairs from the option file into the option values. */
+bool MyOptions::loadFile()
 {
    bool ret  = false;
    File file = SPIFFS.open(OPTION_FILE_NAME, "r");
@@ -122,76 +350,14 @@ bool MyOptions::load()
             MyDbg((String) F("Wrong option entry: ") + line);
             ret = false;
          } else {
-            String key    = line.substring(0, idx);
-            String value  = line.substring(idx + 1);
-            long   lValue = atol(value.c_str());
-            double fValue = atof(value.c_str());
+            String key   = line.substring(0, idx);
+            String value = line.substring(idx + 1);
 
             value.replace("\r", "");
             value.replace("\n", "");
             MyDbg((String) F("Load option '") + key + F("=") + value + F("'"));
 
-            if (key == F("isDebugActive")) {
-               isDebugActive = lValue;
-            } else if (key == F("gprsAP")) {
-               gprsAP = value;
-            } else if (key == F("gprsUser")) {
-               gprsUser = value;
-            } else if (key == F("gprsPassword")) {
-               gprsPassword = value;
-            } else if (key == F("wifiAP")) {
-               wifiAP = value;
-            } else if (key == F("connectWifiAP")) {
-               connectWifiAP = lValue;
-            } else if (key == F("wifiPassword")) {
-               wifiPassword = value;
-            } else if (key == F("powerOn")) {
-               powerOn = lValue;
-            } else if (key == F("bme280CheckIntervalSec")) {
-               bme280CheckIntervalSec = lValue;
-            } else if (key == F("isSmsEnabled")) {
-               isSmsEnabled = lValue;
-            } else if (key == F("isGpsEnabled")) {
-               isGpsEnabled = lValue;
-            } else if (key == F("gpsTimeoutSec")) {
-               gpsTimeoutSec = lValue;
-            } else if (key == F("gpsCheckIntervalSec")) {
-               gpsCheckIntervalSec = lValue;
-            } else if (key == F("minMovingDistance")) {
-               minMovingDistance = lValue;
-            } else if (key == F("phoneNumber")) {
-               phoneNumber = value;
-            } else if (key == F("smsCheckIntervalSec")) {
-               smsCheckIntervalSec = lValue;
-            } else if (key == F("isDeepSleepEnabled")) {
-               isDeepSleepEnabled = lValue;
-            } else if (key == F("powerSaveModeVoltage")) {
-               powerSaveModeVoltage = fValue;
-            } else if (key == F("powerCheckIntervalSec")) {
-               powerCheckIntervalSec = lValue;
-            } else if (key == F("activeTimeSec")) {
-               activeTimeSec = lValue;
-            } else if (key == F("deepSleepTimeSec")) {
-               deepSleepTimeSec = lValue;
-            } else if (key == F("isMqttEnabled")) {
-               isMqttEnabled = lValue;
-            } else if (key == F("mqttName")) {
-               mqttName = value;
-            } else if (key == F("mqttId")) {
-               mqttId = value;
-            } else if (key == F("mqttServer")) {
-               mqttServer = value;
-            } else if (key == F("mqttPort")) {
-               mqttPort = lValue;
-            } else if (key == F("mqttUser")) {
-               mqttUser = value;
-            } else if (key == F("mqttPassword")) {
-               mqttPassword = value;
-            } else if (key == F("mqttSendOnMoveEverySec")) {
-               mqttSendOnMoveEverySec = lValue;
-            } else if (key == F("mqttSendOnNonMoveEverySec")) {
-               mqttSendOnNonMoveEverySec = lValue;
-            } else {
+            if (!setOption(key, value)) {
                MyDbg((String) F("Wrong option entry: ") + line);
                ret = false;
             }
@@ -202,12 +368,15 @@ bool MyOptions::load()
    if (ret) {
       MyDbg(F("Settings loaded"));
    }
+   snapshotGeneration = 0;
    return ret;
 }
 
 /** Save all the options as key-value pair to the option file. */
 bool MyOptions::save()
 {
+  saveSnapshot();
+
   File file = SPIFFS.open(OPTION_FILE_NAME, "w+");
 
   if (!file) {
@@ -217,9 +386,11 @@ bool MyOptions::save()
      file.println((String) F("gprsAP=")                    + gprsAP);
      file.println((String) F("gprsUser=")                  + gprsUser);
      file.println((String) F("gprsPassword=")              + gprsPassword);
+     file.println((String) F("modemMaxBaud=")              + String(modemMaxBaud));
      file.println((String) F("connectWifiAP=")             + String(connectWifiAP));
      file.println((String) F("wifiAP=")                    + wifiAP);
      file.println((String) F("wifiPassword=")              + wifiPassword);
+     file.println((String) F("wifiIdleSec=")               + String(wifiIdleSec));
      file.println((String) F("powerOn=")                   + String(powerOn));
      file.println((String) F("bme280CheckIntervalSec=")    + String(bme280CheckIntervalSec));
      file.println((String) F("isSmsEnabled=")              + String(isSmsEnabled));
@@ -231,21 +402,251 @@ bool MyOptions::save()
      file.println((String) F("smsCheckIntervalSec=")       + String(smsCheckIntervalSec));
      file.println((String) F("isDeepSleepEnabled=")        + String(isDeepSleepEnabled));
      file.println((String) F("powerSaveModeVoltage=")      + String(powerSaveModeVoltage, 2));
+     file.println((String) F("powerSaveHysteresis=")       + String(powerSaveHysteresis, 2));
+     file.println((String) F("voltageSampleMs=")           + String(voltageSampleMs));
      file.println((String) F("powerCheckIntervalSec=")     + String(powerCheckIntervalSec));
      file.println((String) F("activeTimeSec=")             + String(activeTimeSec));
      file.println((String) F("deepSleepTimeSec=")          + String(deepSleepTimeSec));
+     file.println((String) F("isGsmSleepEnabled=")         + String(isGsmSleepEnabled));
+     file.println((String) F("isSchedulerEnabled=")        + String(isSchedulerEnabled));
+     file.println((String) F("dailyBudgetMah=")            + String(dailyBudgetMah, 1));
+     file.println((String) F("batteryCapacityMah=")        + String(batteryCapacityMah, 1));
+     file.println((String) F("batteryCurve=")              + batteryCurve);
+     for (int i = 0; i < ENERGY_COUNT; i++) {
+        file.println((String) F("energyMa_") + MyEnergy::stateName((EnergyState) i) + F("=") + String(energyMa[i], 3));
+     }
      file.println((String) F("isMqttEnabled=")             + String(isMqttEnabled));
      file.println((String) F("mqttName=")                  + mqttName);
      file.println((String) F("mqttId=")                    + mqttId);
      file.println((String) F("mqttServer=")                + mqttServer);
      file.println((String) F("mqttPort=")                  + String(mqttPort));
+     file.println((String) F("mqttDnsCacheSec=")           + String(mqttDnsCacheSec));
      file.println((String) F("mqttUser=")                  + mqttUser);
      file.println((String) F("mqttPassword=")              + mqttPassword);
      file.println((String) F("mqttSendOnMoveEverySec=")    + String(mqttSendOnMoveEverySec));
      file.println((String) F("mqttSendOnNonMoveEverySec=") + String(mqttSendOnNonMoveEverySec));
+     file.println((String) F("isMqttOneShot=")             + String(isMqttOneShot));
+     file.println((String) F("isMqttDiagnostics=")         + String(isMqttDiagnostics));
+     file.println((String) F("mqttInflightWindow=")        + String(mqttInflightWindow));
+     file.println((String) F("httpUploadUrl=")             + httpUploadUrl);
+     file.println((String) F("httpBacklogSize=")           + String(httpBacklogSize));
+     file.println((String) F("remoteConfigVersion=")       + String(remoteConfigVersion));
      file.close();
      MyDbg(F("Settings saved"));
      return true;
   }
   return false;
 }
+
+/** Copies all the options into the snapshot or out of it in a fixed order. */
+void MyOptions::transfer(MyOptionsSnapshot &snapshot)
+{
+   MyOptions defaults;
+
+   snapshot.transfer(isDebugActive,             defaults.isDebugActive);
+   snapshot.transfer(gprsAP,                    defaults.gprsAP);
+   snapshot.transfer(gprsUser,                  defaults.gprsUser);
+   snapshot.transfer(gprsPassword,              defaults.gprsPassword);
+   snapshot.transfer(modemMaxBaud,              defaults.modemMaxBaud);
+   snapshot.transfer(connectWifiAP,             defaults.connectWifiAP);
+   snapshot.transfer(wifiAP,                    defaults.wifiAP);
+   snapshot.transfer(wifiPassword,              defaults.wifiPassword);
+   snapshot.transfer(wifiIdleSec,               defaults.wifiIdleSec);
+   snapshot.transfer(powerOn,                   defaults.powerOn);
+   snapshot.transfer(bme280CheckIntervalSec,    defaults.bme280CheckIntervalSec);
+   snapshot.transfer(isSmsEnabled,              defaults.isSmsEnabled);
+   snapshot.transfer(isGpsEnabled,              defaults.isGpsEnabled);
+   snapshot.transfer(gpsTimeoutSec,             defaults.gpsTimeoutSec);
+   snapshot.transfer(gpsCheckIntervalSec,       defaults.gpsCheckIntervalSec);
+   snapshot.transfer(minMovingDistance,         defaults.minMovingDistance);
+   snapshot.transfer(phoneNumber,               defaults.phoneNumber);
+   snapshot.transfer(smsCheckIntervalSec,       defaults.smsCheckIntervalSec);
+   snapshot.transfer(isDeepSleepEnabled,        defaults.isDeepSleepEnabled);
+   snapshot.transfer(powerSaveModeVoltage,      defaults.powerSaveModeVoltage);
+   snapshot.transfer(powerSaveHysteresis,       defaults.powerSaveHysteresis);
+   snapshot.transfer(voltageSampleMs,           defaults.voltageSampleMs);
+   snapshot.transfer(powerCheckIntervalSec,     defaults.powerCheckIntervalSec);
+   snapshot.transfer(activeTimeSec,             defaults.activeTimeSec);
+   snapshot.transfer(deepSleepTimeSec,          defaults.deepSleepTimeSec);
+   snapshot.transfer(isGsmSleepEnabled,         defaults.isGsmSleepEnabled);
+   snapshot.transfer(isSchedulerEnabled,        defaults.isSchedulerEnabled);
+   snapshot.transfer(dailyBudgetMah,            defaults.dailyBudgetMah);
+   snapshot.transfer(batteryCapacityMah,        defaults.batteryCapacityMah);
+   snapshot.transfer(batteryCurve,              defaults.batteryCurve);
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      snapshot.transfer(energyMa[i],            defaults.energyMa[i]);
+   }
+   snapshot.transfer(isMqttEnabled,             defaults.isMqttEnabled);
+   snapshot.transfer(mqttName,                  defaults.mqttName);
+   snapshot.transfer(mqttId,                    defaults.mqttId);
+   snapshot.transfer(mqttServer,                defaults.mqttServer);
+   snapshot.transfer(mqttPort,                  defaults.mqttPort);
+   snapshot.transfer(mqttDnsCacheSec,           defaults.mqttDnsCacheSec);
+   snapshot.transfer(mqttUser,                  defaults.mqttUser);
+   snapshot.transfer(mqttPassword,              defaults.mqttPassword);
+   snapshot.transfer(mqttSendOnMoveEverySec,    defaults.mqttSendOnMoveEverySec);
+   snapshot.transfer(mqttSendOnNonMoveEverySec, defaults.mqttSendOnNonMoveEverySec);
+   snapshot.transfer(isMqttOneShot,             defaults.isMqttOneShot);
+   snapshot.transfer(isMqttDiagnostics,         defaults.isMqttDiagnostics);
+   snapshot.transfer(mqttInflightWindow,        defaults.mqttInflightWindow);
+   snapshot.transfer(httpUploadUrl,             defaults.httpUploadUrl);
+   snapshot.transfer(httpBacklogSize,           defaults.httpBacklogSize);
+   snapshot.transfer(remoteConfigVersion,       defaults.remoteConfigVersion);
+}
+
+/** Reads the options from the RTC snapshot. Returns false if there is no valid snapshot. */
+bool MyOptions::loadSnapshot()
+{
+   MyOptionsSnapshot snapshot(false);
+
+   ESP.rtcUserMemoryRead(rtcOptionsOffset(), (uint32_t *) &snapshot, 8);
+   if (snapshot.size < OPTION_SNAPSHOT_MASK || snapshot.size > MyOptionsSnapshot::capacity()) {
+      return false;
+   }
+   ESP.rtcUserMemoryRead(rtcOptionsOffset() + 2, (uint32_t *) snapshot.data, (snapshot.size + 3) & ~3);
+   if (snapshot.crc != snapshot.getCRC()) {
+      MyDbg(F("Options snapshot invalid"));
+      return false;
+   }
+   transfer(snapshot);
+   if (snapshot.isOverflow) {
+      return false;
+   }
+   snapshotGeneration = snapshot.generation;
+   snapshotSize       = snapshot.size;
+   MyDbg((String) F("Settings loaded from the RTC memory (") + String(snapshot.size) + F(" bytes)"));
+   return true;
+}
+
+/** Writes the options as snapshot behind the RtcData. If they do not fit the snapshot is invalidated. */
+void MyOptions::saveSnapshot()
+{
+   MyOptionsSnapshot snapshot(true);
+   MyOptionsSnapshot last(false);
+
+   ESP.rtcUserMemoryRead(rtcOptionsOffset(), (uint32_t *) &last, 8);
+   transfer(snapshot);
+   snapshot.generation = last.generation + 1;
+   snapshot.size       = snapshot.isOverflow ? 0 : snapshot.pos;
+   snapshot.crc        = snapshot.getCRC();
+   snapshotSize        = snapshot.size;
+   ESP.rtcUserMemoryWrite(rtcOptionsOffset(), (uint32_t *) &snapshot, 8 + ((snapshot.size + 3) & ~3));
+   if (snapshot.isOverflow) {
+      MyDbg(F("Options too big for the RTC memory"));
+   }
+}
+
+/* ******************************************** */
+
+/** Constructor with an empty bit mask. */
+MyOptionsSnapshot::MyOptionsSnapshot(bool writing)
+   : crc(0)
+   , generation(0)
+   , size(0)
+   , isWriting(writing)
+   , isOverflow(false)
+   , index(0)
+   , pos(OPTION_SNAPSHOT_MASK)
+{
+   memset(data, 0, sizeof(data));
+}
+
+/** Free bytes behind the RtcData and the header of the snapshot. */
+int MyOptionsSnapshot::capacity()
+{
+   return RTC_USER_MEMORY_SIZE - 4 * rtcOptionsOffset() - 8;
+}
+
+/** CRC of the generation, the used data and the compile time of the firmware. */
+uint32_t MyOptionsSnapshot::getCRC()
+{
+   long crc = crc32(0, (unsigned char *) __DATE__ __TIME__, sizeof(__DATE__ __TIME__));
+
+   crc = crc32(crc, (unsigned char *) &generation, sizeof(uint16_t));
+   crc = crc32(crc, (unsigned char *) &size,       sizeof(uint16_t));
+   crc = crc32(crc, data, size);
+   return crc;
+}
+
+/** Stores a bool option only with its bit. */
+void MyOptionsSnapshot::transfer(bool &value, bool def)
+{
+   value = isStored(value != def) ? !def : def;
+}
+
+/** Stores a long option as 4 bytes. */
+void MyOptionsSnapshot::transfer(long &value, long def)
+{
+   int32_t v = value;
+
+   if (isStored(value != def)) {
+      copy(&v, sizeof(int32_t));
+      value = v;
+   } else {
+      value = def;
+   }
+}
+
+/** Stores a double option with all its 8 bytes. */
+void MyOptionsSnapshot::transfer(double &value, double def)
+{
+   if (isStored(value != def)) {
+      copy(&value, sizeof(double));
+   } else {
+      value = def;
+   }
+}
+
+/** Stores a string option with its length byte. */
+void MyOptionsSnapshot::transfer(String &value, const String &def)
+{
+   uint8_t len = value.length();
+   char    buffer[256];
+
+   if (!isStored(value != def)) {
+      value = def;
+   } else if (isWriting) {
+      if (value.length() > 255) {
+         isOverflow = true;
+         return;
+      }
+      copy(&len, 1);
+      copy((void *) value.c_str(), len);
+   } else {
+      copy(&len, 1);
+      copy(buffer, len);
+      buffer[isOverflow ? 0 : len] = 0;
+      value = buffer;
+   }
+}
+
+/** Sets or reads the bit of the next option. */
+bool MyOptionsSnapshot::isStored(bool changed)
+{
+   int     i   = index++;
+   uint8_t bit = 1 << (i % 8);
+
+   if (i >= OPTION_SNAPSHOT_MASK * 8) {
+      isOverflow = true;
+      return false;
+   }
+   if (isWriting && changed) {
+      data[i / 8] |= bit;
+   }
+   return (data[i / 8] & bit) != 0;
+}
+
+/** Copies the bytes of a value into the data or out of it. */
+void MyOptionsSnapshot::copy(void *value, int len)
+{
+   if (pos + len > (isWriting ? capacity() : size)) {
+      isOverflow = true;
+      return;
+   }
+   if (isWriting) {
+      memcpy(data + pos, value, len);
+   } else {
+      memcpy(value, data + pos, len);
+   }
+   pos += len;
+}
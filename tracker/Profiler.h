@@ -0,0 +1,324 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Profiler.h
+  *
+  * Phase timers of the modem bring-up, the gps and the mqtt communication.
+  */
+
+#define PROFILE_FILE_NAME   "/profile.txt" //!< Lifetime statistic of the phases.
+#define PROFILE_BUCKETS     8              //!< Number of histogram buckets per phase.
+#define PROFILE_BUCKET_MS   500            //!< Upper limit of the first bucket, every next bucket doubles it.
+
+/** Timed phases of one wake. */
+enum ProfilePhase {
+   PHASE_MODEM_PROBE,     //!< Check for an already running modul.
+   PHASE_MODEM_RESTART,   //!< Restart of the modul until it answers.
+   PHASE_NETWORK,         //!< Network registration.
+   PHASE_GPRS,            //!< Gprs connect.
+   PHASE_MODEM_INFO,      //!< Modem information and sms indication.
+   PHASE_GPS_FIX,         //!< First gps request until the fix or the timeout.
+   PHASE_GSM_GPS,         //!< Gps position from the gsm modul as fallback.
+   PHASE_MQTT_DNS,        //!< Name resolution of the mqtt server.
+   PHASE_MQTT_CONNECT,    //!< Mqtt connect including the retries.
+   PHASE_MQTT_PUBLISH,    //!< Publishing of all values.
+   PHASE_MQTT_DISCONNECT, //!< Mqtt disconnect.
+   PHASE_MODEM_STOP,      //!< Stopping or sleeping of the modul.
+   PHASE_HTTP_UPLOAD,     //!< Http upload of the track backlog.
+   PHASE_COUNT            //!< Number of phases.
+};
+
+/**
+  * Measures the duration of the phases in the current wake and collects a
+  * lifetime histogram of all wakes in the SPIFFS.
+  */
+class MyProfiler
+{
+public:
+   /**
+     * Lifetime statistic of one phase.
+     */
+   class Statistic {
+   public:
+      long count;                     //!< Number of measurements.
+      long totalMs;                   //!< Sum of all durations.
+      long maxMs;                     //!< Longest duration.
+      long buckets[PROFILE_BUCKETS];  //!< Histogram of the durations.
+
+   public:
+      Statistic();
+
+      void add(long ms);
+   };
+
+protected:
+   long      startMs[PHASE_COUNT];    //!< Start of the running phases (-1 = not running).
+   long      lastMs[PHASE_COUNT];     //!< Duration of the last measurement of the phase.
+   long      wakeMs[PHASE_COUNT];     //!< Sum of the durations in the current wake.
+   long      wakeCount[PHASE_COUNT];  //!< Number of measurements in the current wake.
+   Statistic lifetime[PHASE_COUNT];   //!< Statistic over all wakes.
+   bool      isChanged;               //!< Has the lifetime statistic to be saved?
+
+public:
+   MyProfiler();
+
+   void begin();
+   bool save();
+   void clear();
+
+   void start(ProfilePhase phase);
+   void stop(ProfilePhase phase);
+   bool isRunning(ProfilePhase phase);
+
+   long getLastMs(ProfilePhase phase) { return lastMs[phase]; }
+   long getWakeMs(ProfilePhase phase) { return wakeMs[phase]; }
+   long getWakeCount(ProfilePhase phase) { return wakeCount[phase]; }
+   const Statistic &getLifetime(ProfilePhase phase) { return lifetime[phase]; }
+
+   String getWakeJson();
+   String getJson();
+
+   static const __FlashStringHelper *phaseName(ProfilePhase phase);
+   static int bucketOf(long ms);
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyProfiler::Statistic::Statistic()
+   : count(0)
+   , totalMs(0)
+   , maxMs(0)
+{
+   for (int i = 0; i < PROFILE_BUCKETS; i++) {
+      buckets[i] = 0;
+   }
+}
+
+/** Adds one measurement. */
+void MyProfiler::Statistic::add(long ms)
+{
+   count++;
+   totalMs += ms;
+   if (ms > maxMs) {
+      maxMs = ms;
+   }
+   buckets[bucketOf(ms)]++;
+}
+
+/** Constructor */
+MyProfiler::MyProfiler()
+   : isChanged(false)
+{
+   for (int i = 0; i < PHASE_COUNT; i++) {
+      startMs[i]   = -1;
+      lastMs[i]    = 0;
+      wakeMs[i]    = 0;
+      wakeCount[i] = 0;
+   }
+}
+
+/** Loads the lifetime statistic from the SPIFFS.
+  * Sample: 2=14,253400,31200,0,0,0,0,3,9,2,0
+  *         phase=count,totalMs,maxMs,buckets...
+  */
+void MyProfiler::begin()
+{
+   File file = SPIFFS.open(PROFILE_FILE_NAME, "r");
+
+   if (!file) {
+      return;
+   }
+   while (file.available()) {
+      String line  = Trim(file.readStringUntil('\n'), F("\r"));
+      int    pos   = line.indexOf('=');
+      int    phase = line.substring(0, pos).toInt();
+      long   values[3 + PROFILE_BUCKETS];
+
+      if (pos <= 0 || phase < 0 || phase >= PHASE_COUNT) {
+         continue;
+      }
+      for (int i = 0; i < 3 + PROFILE_BUCKETS; i++) {
+         int end = line.indexOf(',', pos + 1);
+
+         values[i] = line.substring(pos + 1, end == -1 ? line.length() : end).toInt();
+         pos       = end == -1 ? line.length() : end;
+      }
+
+      Statistic &stat = lifetime[phase];
+
+      stat.count   = values[0];
+      stat.totalMs = values[1];
+      stat.maxMs   = values[2];
+      for (int i = 0; i < PROFILE_BUCKETS; i++) {
+         stat.buckets[i] = values[3 + i];
+      }
+   }
+   file.close();
+}
+
+/** Saves the lifetime statistic if there are new measurements, i.e. before the deep sleep. */
+bool MyProfiler::save()
+{
+   if (!isChanged) {
+      return true;
+   }
+
+   File file = SPIFFS.open(PROFILE_FILE_NAME, "w+");
+
+   if (!file) {
+      MyDbg(F("Failed to write profile"));
+      return false;
+   }
+   for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      Statistic &stat = lifetime[phase];
+      String     line = String(phase) + F("=") + String(stat.count) + F(",") + 
+                        String(stat.totalMs) + F(",") + String(stat.maxMs);
+
+      for (int i = 0; i < PROFILE_BUCKETS; i++) {
+         line += F(",");
+         line += String(stat.buckets[i]);
+      }
+      file.println(line);
+   }
+   file.close();
+   isChanged = false;
+   return true;
+}
+
+/** Removes the lifetime statistic. */
+void MyProfiler::clear()
+{
+   for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      lifetime[phase] = Statistic();
+   }
+   SPIFFS.remove(PROFILE_FILE_NAME);
+   isChanged = false;
+}
+
+/** Starts the timer of the phase if it is not already running. */
+void MyProfiler::start(ProfilePhase phase)
+{
+   if (startMs[phase] == -1) {
+      startMs[phase] = millis();
+   }
+}
+
+/** Stops the timer of a running phase and adds the duration to the statistic. */
+void MyProfiler::stop(ProfilePhase phase)
+{
+   if (startMs[phase] == -1) {
+      return;
+   }
+
+   long ms = millis() - startMs[phase];
+
+   startMs[phase] = -1;
+   lastMs[phase]  = ms;
+   wakeMs[phase] += ms;
+   wakeCount[phase]++;
+   lifetime[phase].add(ms);
+   isChanged = true;
+}
+
+/** Is the timer of the phase running? */
+bool MyProfiler::isRunning(ProfilePhase phase)
+{
+   return startMs[phase] != -1;
+}
+
+/** Durations of the phases in the current wake in ms, i.e. {"restart":1850,"network":3400}. 
+  * Phases which did not run are not listed.
+  */
+String MyProfiler::getWakeJson()
+{
+   String json = F("{");
+
+   for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      if (wakeCount[phase] > 0) {
+         if (json.length() > 1) {
+            json += F(",");
+         }
+         json += (String) F("\"") + phaseName((ProfilePhase) phase) + F("\":") + String(wakeMs[phase]);
+      }
+   }
+   json += F("}");
+   return json;
+}
+
+/** The current wake and the lifetime statistic of all phases. 
+  * Sample: {"restart":{"wake":1850,"count":14,"avg":1920,"max":3100,"hist":[0,0,5,9,0,0,0,0]},...}
+  */
+String MyProfiler::getJson()
+{
+   String json = F("{");
+
+   for (int phase = 0; phase < PHASE_COUNT; phase++) {
+      Statistic &stat = lifetime[phase];
+
+      if (phase > 0) {
+         json += F(",");
+      }
+      json += (String) F("\"") + phaseName((ProfilePhase) phase) + F("\":{\"wake\":") + String(wakeMs[phase]) +
+              F(",\"count\":") + String(stat.count) +
+              F(",\"avg\":")   + String(stat.count ? stat.totalMs / stat.count : 0) +
+              F(",\"max\":")   + String(stat.maxMs) + F(",\"hist\":[");
+      for (int i = 0; i < PROFILE_BUCKETS; i++) {
+         if (i > 0) {
+            json += F(",");
+         }
+         json += String(stat.buckets[i]);
+      }
+      json += F("]}");
+   }
+   json += F("}");
+   return json;
+}
+
+/** Short name of the phase for the json output. */
+const __FlashStringHelper *MyProfiler::phaseName(ProfilePhase phase)
+{
+   switch (phase) {
+      case PHASE_MODEM_PROBE:     return F("probe");
+      case PHASE_MODEM_RESTART:   return F("restart");
+      case PHASE_NETWORK:         return F("network");
+      case PHASE_GPRS:            return F("gprs");
+      case PHASE_MODEM_INFO:      return F("modemInfo");
+      case PHASE_GPS_FIX:         return F("gpsFix");
+      case PHASE_GSM_GPS:         return F("gsmGps");
+      case PHASE_MQTT_DNS:        return F("mqttDns");
+      case PHASE_MQTT_CONNECT:    return F("mqttConnect");
+      case PHASE_MQTT_PUBLISH:    return F("mqttPublish");
+      case PHASE_MQTT_DISCONNECT: return F("mqttDisconnect");
+      case PHASE_MODEM_STOP:      return F("modemStop");
+      case PHASE_HTTP_UPLOAD:     return F("httpUpload");
+      default:                    return F("unknown");
+   }
+}
+
+/** Histogram bucket of a duration: < 0.5s, < 1s, < 2s, ... , >= 32s */
+int MyProfiler::bucketOf(long ms)
+{
+   int  bucket = 0;
+   long limit  = PROFILE_BUCKET_MS;
+
+   while (bucket < PROFILE_BUCKETS - 1 && ms >= limit) {
+      bucket++;
+      limit *= 2;
+   }
+   return bucket;
+}
@@ -0,0 +1,122 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file RingBuffer.h
+  *
+  * Lock-free byte ring for one producer and one consumer.
+  */
+
+/** Orders the data access against the index update for the other side. */
+#define RING_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/**
+  * Single producer single consumer ring buffer with SIZE - 1 usable bytes.
+  * Only the producer writes head and only the consumer writes tail, so no
+  * lock is needed. push() does not allocate. A byte which does not fit is
+  * dropped and counted as overrun.
+  * SIZE has to be a power of two.
+  */
+template <uint16_t SIZE>
+class MyRingBuffer
+{
+protected:
+   uint8_t           data[SIZE]; //!< The buffered bytes.
+   volatile uint16_t head;       //!< Next write position, written by the producer.
+   volatile uint16_t tail;       //!< Next read position, written by the consumer.
+   volatile uint32_t overruns;   //!< Number of dropped bytes, written by the producer.
+
+public:
+   MyRingBuffer();
+
+   bool     push(uint8_t c);
+   int      pop();
+   int      peek();
+   int      available();
+   void     clear();
+   uint32_t getOverruns() { return overruns; }
+};
+
+/* ******************************************** */
+
+/** Constructor */
+template <uint16_t SIZE>
+MyRingBuffer<SIZE>::MyRingBuffer()
+   : head(0)
+   , tail(0)
+   , overruns(0)
+{
+   static_assert((SIZE & (SIZE - 1)) == 0, "SIZE has to be a power of two");
+}
+
+/** Producer: Appends the byte or counts an overrun if the ring is full. */
+template <uint16_t SIZE>
+bool MyRingBuffer<SIZE>::push(uint8_t c)
+{
+   uint16_t next = (head + 1) & (SIZE - 1);
+
+   if (next == tail) {
+      overruns = overruns + 1;
+      return false;
+   }
+   data[head] = c;
+   RING_BARRIER();
+   head = next;
+   return true;
+}
+
+/** Consumer: Removes and returns the oldest byte or -1 if the ring is empty. */
+template <uint16_t SIZE>
+int MyRingBuffer<SIZE>::pop()
+{
+   uint16_t pos = tail;
+
+   if (pos == head) {
+      return -1;
+   }
+   RING_BARRIER();
+   uint8_t c = data[pos];
+   RING_BARRIER();
+   tail = (pos + 1) & (SIZE - 1);
+   return c;
+}
+
+/** Consumer: Returns the oldest byte without removing it or -1 if the ring is empty. */
+template <uint16_t SIZE>
+int MyRingBuffer<SIZE>::peek()
+{
+   uint16_t pos = tail;
+
+   if (pos == head) {
+      return -1;
+   }
+   RING_BARRIER();
+   return data[pos];
+}
+
+/** Consumer: Number of bytes to read. */
+template <uint16_t SIZE>
+int MyRingBuffer<SIZE>::available()
+{
+   return (head - tail) & (SIZE - 1);
+}
+
+/** Consumer: Drops all buffered bytes. */
+template <uint16_t SIZE>
+void MyRingBuffer<SIZE>::clear()
+{
+   tail = head;
+}
@@ -0,0 +1,166 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Scheduler.h
+  *
+  * Adaptive duty cycle of the modem wakes.
+  */
+
+#define SCHEDULER_TREND_SEC      600   //!< Minimum time between two voltage samples of the trend.
+#define SCHEDULER_CHARGING_VPH   0.05  //!< Voltage rise in V per hour which is seen as charging.
+#define SCHEDULER_DRAINING_VPH   0.05  //!< Voltage drop in V per hour which is seen as fast draining.
+#define SCHEDULER_MAX_WAKE_SEC   86400 //!< Longest interval between two modem wakes.
+#define SCHEDULER_RESERVE_DAYS   7.0   //!< Remaining runtime of the battery below which the interval is doubled.
+
+/**
+  * Computes the interval between two modem wakes from the last moving state,
+  * the track backlog, the voltage trend, the remaining runtime of the battery 
+  * and the daily energy budget.
+  * The budget is a credit in mAh which grows with dailyBudgetMah per day and
+  * shrinks with the consumption of the energy ledger. A positive credit shortens
+  * the interval, a negative credit stretches it, so the consumption follows
+  * the budget over the days.
+  * All the state is kept in the RTC memory, so update() runs on every wake.
+  */
+class MyScheduler
+{
+protected:
+   MyOptions &myOptions;    //!< Reference to the options
+   MyData    &myData;       //!< Reference to the data
+   MyTrack   &myTrack;      //!< Reference to the gps track backlog
+
+protected:
+   void updateTrend();
+   void updateCredit();
+   long computeWakeSec();
+
+public:
+   MyScheduler(MyOptions &options, MyData &data, MyTrack &track);
+
+   void update();
+
+   long getWakeSec();
+   bool isModemWake();
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyScheduler::MyScheduler(MyOptions &options, MyData &data, MyTrack &track)
+   : myOptions(options)
+   , myData(data)
+   , myTrack(track)
+{
+}
+
+/** Updates the voltage trend and the energy credit and computes the next wake interval.
+  * Has to be called on every wake after the voltage is read.
+  */
+void MyScheduler::update()
+{
+   if (!myOptions.isSchedulerEnabled) {
+      return;
+   }
+   updateTrend();
+   updateCredit();
+   myData.rtcData.scheduledWakeSec = computeWakeSec();
+   MyDbg((String) F("Scheduler: trend ") + String(myData.rtcData.voltageTrend, 3) + 
+         F(" V/h, credit ") + String(myData.rtcData.energyCredit, 1) + 
+         F(" mAh, wake every ") + formatInterval(myData.rtcData.scheduledWakeSec));
+}
+
+/** Smoothed voltage change in V per hour. Samples closer than SCHEDULER_TREND_SEC are skipped
+  * because the noise of the adc would be bigger than the change.
+  */
+void MyScheduler::updateTrend()
+{
+   long   nowSec = secondsSincePowerOn();
+   long   dtSec  = nowSec - myData.rtcData.lastVoltageSec;
+
+   if (myData.rtcData.lastVoltageSec == 0) {
+      myData.rtcData.lastVoltage    = myData.voltage;
+      myData.rtcData.lastVoltageSec = nowSec;
+   } else if (dtSec >= SCHEDULER_TREND_SEC) {
+      double vph = (myData.voltage - myData.rtcData.lastVoltage) * 3600.0 / dtSec;
+
+      myData.rtcData.voltageTrend   = (3.0 * myData.rtcData.voltageTrend + vph) / 4.0;
+      myData.rtcData.lastVoltage    = myData.voltage;
+      myData.rtcData.lastVoltageSec = nowSec;
+   }
+}
+
+/** Adds the budget of the elapsed time and subtracts the consumption since the last update.
+  * The credit is limited to one daily budget in both directions.
+  */
+void MyScheduler::updateCredit()
+{
+   long   nowSec = secondsSincePowerOn();
+   double mAh    = myData.getPowerConsumption(myOptions);
+   double budget = myOptions.dailyBudgetMah;
+
+   if (myData.rtcData.creditSec != 0 && budget > 0.0) {
+      myData.rtcData.energyCredit += budget * (nowSec - myData.rtcData.creditSec) / 86400.0 - 
+                                     (mAh - myData.rtcData.creditMah);
+      myData.rtcData.energyCredit  = constrain(myData.rtcData.energyCredit, -budget, budget);
+   }
+   myData.rtcData.creditMah = mAh;
+   myData.rtcData.creditSec = nowSec;
+}
+
+/** Send interval of the moving state, halved for a backlog or while charging,
+  * doubled while the battery drains fast or has less than a week left and scaled 
+  * with the energy credit.
+  */
+long MyScheduler::computeWakeSec()
+{
+   double wakeSec     = myData.rtcData.wasMoving ? myOptions.mqttSendOnMoveEverySec : myOptions.mqttSendOnNonMoveEverySec;
+   double trend       = myData.rtcData.voltageTrend;
+   double runtimeDays = myData.rtcData.battery.getRuntimeDays(myOptions);
+
+   if (myTrack.isBacklog()) {
+      wakeSec /= 2.0;
+   }
+   if (myData.voltage >= myOptions.powerSaveModeVoltage || trend > SCHEDULER_CHARGING_VPH) {
+      wakeSec /= 2.0;
+   } else if (trend < -SCHEDULER_DRAINING_VPH) {
+      wakeSec *= 2.0;
+   }
+   if (runtimeDays >= 0.0 && runtimeDays < SCHEDULER_RESERVE_DAYS) {
+      wakeSec *= 2.0;
+   }
+   if (myOptions.dailyBudgetMah > 0.0) {
+      double credit = myData.rtcData.energyCredit / myOptions.dailyBudgetMah; // -1 .. 1
+
+      wakeSec = credit < 0.0 ? wakeSec * (1.0 - 4.0 * credit) : wakeSec / (1.0 + credit);
+   }
+   return constrain((long) wakeSec, myOptions.powerCheckIntervalSec, (long) SCHEDULER_MAX_WAKE_SEC);
+}
+
+/** Interval between two modem wakes, the fixed deep sleep time if the scheduler is off. */
+long MyScheduler::getWakeSec()
+{
+   if (!myOptions.isSchedulerEnabled || myData.rtcData.scheduledWakeSec == 0) {
+      return myOptions.deepSleepTimeSec;
+   }
+   return myData.rtcData.scheduledWakeSec;
+}
+
+/** Has the modem to be powered on this wake or can the esp8266 go back to sleep? */
+bool MyScheduler::isModemWake()
+{
+   return secondsSincePowerOn() - myData.rtcData.deepSleepStartSec >= getWakeSec();
+}
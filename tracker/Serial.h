@@ -20,8 +20,16 @@
   * Class to hook the serial communication and store the information in the console stringlist.
   */
 
+#include "RingBuffer.h"
+
+#define SERIAL_RX_SIZE  1024 //!< Receive buffer of the SoftwareSerial interrupt (default 64 bytes).
+#define SERIAL_LOG_SIZE 1024 //!< Complete log lines which are not in the console yet (power of two).
+
 /** 
   * Helper class to hook the SoftwareSerial calls to log the information for the console. 
+  * The receive buffer of the SoftwareSerial interrupt is enlarged, so it can not overflow 
+  * while the parser is busy. Read and written lines are only copied into a ring, the 
+  * console string list is filled later in handleLog().
   */
 class MySerial : public SoftwareSerial
 {
@@ -33,9 +41,22 @@ protected:
    StringList &logInfos;     //!< Hook pointer for the data logging.
    bool       &debug;        //!< Enable or disable the hooking.
 
+   MyRingBuffer<SERIAL_LOG_SIZE> logRing;   //!< Log lines with the direction and a '\n'.
+   uint32_t    rxOverruns;                  //!< Number of overflows of the receive buffer.
+   uint32_t    logLost;                     //!< Number of log lines which did not fit into the ring.
+   uint32_t    reportedOverruns;            //!< Overruns already reported in the console.
+
+protected:
+   void logLine(char direction, const char *line, int len);
+
 public:
    MySerial(StringList &li, bool &dbg, uint8_t receivePin, uint8_t transmitPin, bool inverse_logic = false);
 
+   void handleLog();
+
+   uint32_t getRxOverruns()  { return rxOverruns; }
+   uint32_t getLogOverruns() { return logLost; }
+
    virtual int    read();
    virtual size_t write(uint8_t byte);
 };
@@ -44,11 +65,14 @@ public:
 
 /** Constructor */
 MySerial::MySerial(StringList &li, bool &dbg, uint8_t receivePin, uint8_t transmitPin, bool inverse_logic /*= false*/)
-   : SoftwareSerial(receivePin, transmitPin, inverse_logic)
+   : SoftwareSerial(receivePin, transmitPin, inverse_logic, SERIAL_RX_SIZE)
    , inIdx(0)
    , outIdx(0)
    , logInfos(li)
    , debug(dbg)
+   , rxOverruns(0)
+   , logLost(0)
+   , reportedOverruns(0)
 {
 }
 
@@ -68,12 +92,7 @@ int MySerial::read()
          }
       } else {
          if (inIdx > 0) {
-            inData[inIdx] = 0;
-
-            String info = (String) F("< ") + (String) inData;
-            logInfos.addTail(info);
-            // Pass thrue to the default Serial for debugging
-            Serial.println(info);
+            logLine('<', inData, inIdx);
          }
          inIdx = 0;
       }
@@ -96,16 +115,52 @@ size_t MySerial::write(uint8_t byte)
          }
       } else {
          if (outIdx > 0) {
-            outData[outIdx] = 0;
-
-            String info = (String) F("> ") + (String)outData;
-
-            logInfos.addTail(info);
-            // Pass thrue to the default Serial for debugging
-            Serial.println(info);
+            logLine('>', outData, outIdx);
          }
          outIdx = 0;
       }
    }
    return ret;
 }
+
+/** Copies a complete line into the log ring or drops it if it does not fit. */
+void MySerial::logLine(char direction, const char *line, int len)
+{
+   if (SERIAL_LOG_SIZE - 1 - logRing.available() < len + 2) {
+      logLost++;
+      return;
+   }
+   logRing.push(direction);
+   for (int i = 0; i < len; i++) {
+      logRing.push(line[i]);
+   }
+   logRing.push('\n');
+}
+
+/** Moves the logged lines into the console and reports new overruns. */
+void MySerial::handleLog()
+{
+   while (logRing.available() > 0) {
+      String info = (String) (char) logRing.pop() + ' ';
+      int    c;
+
+      while ((c = logRing.pop()) >= 0 && c != '\n') {
+         info += (char) c;
+      }
+      logInfos.addTail(info);
+      // Pass thrue to the default Serial for debugging
+      Serial.println(info);
+   }
+
+   if (overflow()) {
+      rxOverruns++;
+   }
+
+   uint32_t overruns = rxOverruns + logLost;
+
+   if (overruns != reportedOverruns) {
+      reportedOverruns = overruns;
+      MyDbg((String) F("Serial overruns: ") + String(rxOverruns) + F(" receive, ") +
+            String(logLost) + F(" log lines"));
+   }
+}
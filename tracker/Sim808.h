@@ -23,9 +23,15 @@
 
 #define TINY_GSM_MODEM_SIM808 //!< Defines the modul as a SIM808 type for the TinyGsmClient library 
 #define TINY_GSM_DEBUG Serial //!< ???
+#define TINY_GSM_RX_BUFFER 512 //!< Receive fifo per socket, big enough for a mqtt config message in one +CIPRXGET
+#define TINY_GSM_MUX_COUNT 1   //!< Only the mqtt socket, so maintain() checks one slot
 
 #include <TinyGsmClient.h>
 
+#define SMS_LIST_SIZE 8 //!< Maximum number of sms read with one +CMGL listing.
+#define HTTP_DATA_MS   60000 //!< Maximum time to transfer the data of one +HTTPDATA.
+#define HTTP_ACTION_MS 60000 //!< Maximum time until the server has answered the +HTTPACTION.
+
 /** 
   * Helper class for storing one SMS data. 
   */
@@ -46,13 +52,30 @@ public:
   */
 class MyGsmSim808 : public TinyGsmSim808
 {
+protected:
+   void readSmsEntry(SmsData &sms);
+
 public:
    MyGsmSim808(Stream &stream);
 
    bool getGps    (MyGps &gps);
    bool getGsmGps (MyGps &gps);
-   bool getSMS    (SmsData &sms);
+
+   static bool parseGps    (const String &info, MyGps &gps);
+   static bool parseGsmGps (const String &info, MyGps &gps);
+   static String nextField (const String &data, int &pos);
+   bool enableSmsIndication();
+   int  getSMSList(const String &status, SmsData *list, int size, int &total);
+   bool readSMS   (long index, SmsData &sms);
    bool deleteSMS (long index);
+   bool deleteReadSMS();
+   bool getHostIp (const String &host, IPAddress &ip);
+
+   bool httpBegin (const String &url, const String &contentType);
+   bool httpData  (long size);
+   bool httpDataEnd();
+   int  httpPost  ();
+   bool httpEnd   ();
 };
 
 /* ******************************************** */
@@ -73,24 +96,34 @@ bool MyGsmSim808::getGps(MyGps &gps)
       return false;
    }
 
-   gps.setRunStatus        (stream.readStringUntil(','));
-   gps.setFixStatus        (stream.readStringUntil(','));
-   gps.setDateTime         (stream.readStringUntil(','));
-   gps.setLatitude         (stream.readStringUntil(','));
-   gps.setLongitude        (stream.readStringUntil(','));
-   gps.setAltitude         (stream.readStringUntil(',')); 
-   gps.setSpeed            (stream.readStringUntil(','));  
-   gps.setCourse           (stream.readStringUntil(','));  
-   gps.setFixMode          (stream.readStringUntil(','));   
-   /* reserved */          (stream.readStringUntil(','));
-   gps.setHdop             (stream.readStringUntil(','));  
-   gps.setPdop             (stream.readStringUntil(','));  
-   gps.setVdop             (stream.readStringUntil(',')); 
-   /* reserved */          (stream.readStringUntil(','));
-   gps.setSatellitesInView (stream.readStringUntil(','));
-   gps.setSatellitesUsed   (stream.readStringUntil(','));  
-   stream.readStringUntil('\n');
+   String info = stream.readStringUntil('\n');
+
    waitResponse();
+   return parseGps(info, gps);
+}
+
+/** Parse the values of a +CGNSINF line (without the prefix) in the own MyGps data class. */
+bool MyGsmSim808::parseGps(const String &info, MyGps &gps)
+{
+   int pos = 0;
+
+   gps.clear();
+   gps.setRunStatus        (nextField(info, pos));
+   gps.setFixStatus        (nextField(info, pos));
+   gps.setDateTime         (nextField(info, pos));
+   gps.setLatitude         (nextField(info, pos));
+   gps.setLongitude        (nextField(info, pos));
+   gps.setAltitude         (nextField(info, pos)); 
+   gps.setSpeed            (nextField(info, pos));  
+   gps.setCourse           (nextField(info, pos));  
+   gps.setFixMode          (nextField(info, pos));   
+   /* reserved */          (nextField(info, pos));
+   gps.setHdop             (nextField(info, pos));  
+   gps.setPdop             (nextField(info, pos));  
+   gps.setVdop             (nextField(info, pos)); 
+   /* reserved */          (nextField(info, pos));
+   gps.setSatellitesInView (nextField(info, pos));
+   gps.setSatellitesUsed   (nextField(info, pos));  
    
    return gps.fixStatus;
 }
@@ -108,15 +141,25 @@ bool MyGsmSim808::getGsmGps(MyGps &gps)
       return false;
    }
 
-   String locationCode = stream.readStringUntil(',');
-   String longitude    = stream.readStringUntil(',');
-   String latitude     = stream.readStringUntil(',');
-   String gsmDate      = stream.readStringUntil(',');
-   String gsmTime      = stream.readStringUntil(',');
-   stream.readStringUntil('\n');
+   String info = stream.readStringUntil('\n');
+
    waitResponse();
+   return parseGsmGps(info, gps);
+}
+
+/** Parse the values of a +CIPGSMLOC line (without the prefix) in the own MyGps data class. */
+bool MyGsmSim808::parseGsmGps(const String &info, MyGps &gps)
+{
+   int    pos          = 0;
+   String locationCode = nextField(info, pos);
+   String longitude    = nextField(info, pos);
+   String latitude     = nextField(info, pos);
+   String gsmDate      = nextField(info, pos);
+   String gsmTime      = nextField(info, pos);
 
+   gps.clear();
    locationCode.trim();
+   gsmTime.trim();
    if (locationCode == "0") {
       String dateTime = gsmDate + gsmTime;
 
@@ -132,32 +175,84 @@ bool MyGsmSim808::getGsmGps(MyGps &gps)
    return gps.fixStatus;
 }
 
-/** Read one SMS from the sim card into the own SmsData class. */
-bool MyGsmSim808::getSMS(SmsData &sms)
+/** Returns the next comma separated field of the data starting at pos. */
+String MyGsmSim808::nextField(const String &data, int &pos)
+{
+   int    end   = data.indexOf(',', pos);
+   String field = data.substring(pos, end == -1 ? data.length() : end);
+
+   pos = end == -1 ? data.length() : end + 1;
+   return field;
+}
+
+/** Switch to text mode and let the modul indicate every new sms with a +CMTI urc. 
+  * Sample: AT+CNMI=2,1,0,0,0
+  *         +CMTI: "SM",3
+  */
+bool MyGsmSim808::enableSmsIndication()
 {
-   // PDU Mode (Hex)
    sendAT(GF("+CMGF=1")); 
    if (waitResponse() != 1) {
       return false;
    }
-   
-   // Read unread sms
-   sendAT(GF("+CMGL=\"REC UNREAD\""));
-   int status = waitResponse(GFP(GSM_OK), GF("+CMGL:"));
+   sendAT(GF("+CNMI=2,1,0,0,0"));
+   return waitResponse() == 1;
+}
 
-   if (status == 2) {
-      sms.index           = atoi(stream.readStringUntil(',').c_str());
-      sms.status          = stream.readStringUntil(',');
-      sms.phoneNumber     = stream.readStringUntil(',');
-      sms.referenceNumber = stream.readStringUntil(',');
-      sms.dateTime        = stream.readStringUntil('\n');
-      sms.message         = stream.readStringUntil('\n');
-      sms.message         = Trim(sms.message, F("\r\n"));
-      waitResponse(); 
-      return true;
+/** Read all sms with the status of one +CMGL listing into the list. The modul has to be in text mode
+  * and marks the listed sms as read. Returns the number of sms in the list, total is the number 
+  * of listed sms which can be bigger than the list.
+  * Sample: AT+CMGL="REC UNREAD"
+  *         +CMGL: 1,"REC UNREAD","+41791234567","","19/01/26,08:21:47+04"
+  *         Status
+  *         +CMGL: 2,"REC UNREAD","+41791234567","","19/01/26,08:22:03+04"
+  *         Gps
+  *         OK
+  */
+int MyGsmSim808::getSMSList(const String &status, SmsData *list, int size, int &total)
+{
+   int count = 0;
+
+   total = 0;
+   sendAT(GF("+CMGL=\""), status, GF("\""));
+   while (waitResponse(5000L, GFP(GSM_OK), GF("+CMGL:")) == 2) {
+      SmsData skipped;
+      SmsData &sms = count < size ? list[count++] : skipped;
+
+      sms.index = atoi(stream.readStringUntil(',').c_str());
+      readSmsEntry(sms);
+      total++;
+   }
+   return count;
+}
+
+/** Read the fields after the index of a +CMGL or +CMGR answer and the message line. */
+void MyGsmSim808::readSmsEntry(SmsData &sms)
+{
+   sms.status          = stream.readStringUntil(',');
+   sms.phoneNumber     = stream.readStringUntil(',');
+   sms.referenceNumber = stream.readStringUntil(',');
+   sms.dateTime        = stream.readStringUntil('\n');
+   sms.message         = stream.readStringUntil('\n');
+   sms.message         = Trim(sms.message, F("\r\n"));
+}
+
+/** Read the sms with the index of a +CMTI urc. The modul has to be in text mode.
+  * Sample: AT+CMGR=3
+  *         +CMGR: "REC UNREAD","+41791234567","","19/01/26,08:21:47+04"
+  *         Status
+  */
+bool MyGsmSim808::readSMS(long index, SmsData &sms)
+{
+   sendAT(GF("+CMGR="), index);
+   if (waitResponse(GFP(GSM_OK), GF("+CMGR:")) != 2) {
+      return false;
    }
-       
-   return false;
+
+   sms.index = index;
+   readSmsEntry(sms);
+   waitResponse();
+   return true;
 }
 
 /** Delete a specific sms from the sim card. */
@@ -170,3 +265,120 @@ bool MyGsmSim808::deleteSMS(long index)
 
    return true; 
 }
+
+/** Delete all read sms from the sim card with one command, i.e. after a +CMGL listing. 
+  * Sms received after the listing are unread and stay on the sim card.
+  */
+bool MyGsmSim808::deleteReadSMS()
+{
+   sendAT(GF("+CMGD=1,1"));
+   return waitResponse(25000L) == 1;
+}
+
+/** Resolve a host name via the gprs dns of the sim808 modul.
+  * Sample: AT+CDNSGIP="test.mosquitto.org"
+  *         OK
+  *         +CDNSGIP: 1,"test.mosquitto.org","37.187.106.16"
+  */
+bool MyGsmSim808::getHostIp(const String &host, IPAddress &ip)
+{
+   sendAT(GF("+CDNSGIP=\""), host, GF("\""));
+   if (waitResponse() != 1) {
+      return false;
+   }
+   if (waitResponse(15000L, GF("+CDNSGIP:")) != 1) {
+      return false;
+   }
+
+   String status = stream.readStringUntil(',');
+   
+   status.trim();
+   if (status != "1") {
+      stream.readStringUntil('\n');
+      return false;
+   }
+   
+   /* host */  stream.readStringUntil(',');
+   String ipStr = stream.readStringUntil('\n');
+
+   ipStr = Trim(ipStr, F("\r\n\""));
+   if (ipStr.indexOf('"') >= 0) { // Only the first of several ips
+      ipStr = ipStr.substring(0, ipStr.indexOf('"'));
+   }
+   return ip.fromString(ipStr);
+}
+
+/** Starts a http session with the url and the content type of the data.
+  * A session left over from an interrupted upload is terminated first.
+  * Sample: AT+HTTPINIT
+  *         AT+HTTPPARA="CID",1
+  *         AT+HTTPPARA="URL","http://server/track"
+  *         AT+HTTPPARA="CONTENT","text/csv"
+  */
+bool MyGsmSim808::httpBegin(const String &url, const String &contentType)
+{
+   sendAT(GF("+HTTPINIT"));
+   if (waitResponse() != 1) {
+      httpEnd();
+      sendAT(GF("+HTTPINIT"));
+      if (waitResponse() != 1) {
+         return false;
+      }
+   }
+   sendAT(GF("+HTTPPARA=\"CID\",1"));
+   if (waitResponse() != 1) {
+      return false;
+   }
+   sendAT(GF("+HTTPPARA=\"URL\",\""), url, GF("\""));
+   if (waitResponse() != 1) {
+      return false;
+   }
+   sendAT(GF("+HTTPPARA=\"CONTENT\",\""), contentType, GF("\""));
+   return waitResponse() == 1;
+}
+
+/** Announces the size of the post data. If true is returned exactly size bytes 
+  * have to be written to the stream, then httpDataEnd has to be called.
+  * Sample: AT+HTTPDATA=5120,60000
+  *         DOWNLOAD
+  */
+bool MyGsmSim808::httpData(long size)
+{
+   sendAT(GF("+HTTPDATA="), size, GF(","), HTTP_DATA_MS);
+   return waitResponse(5000L, GF("DOWNLOAD")) == 1;
+}
+
+/** Waits until the modul has received all the post data. */
+bool MyGsmSim808::httpDataEnd()
+{
+   return waitResponse(HTTP_DATA_MS) == 1;
+}
+
+/** Posts the data and returns the http status code of the server or -1.
+  * Sample: AT+HTTPACTION=1
+  *         OK
+  *         +HTTPACTION: 1,200,0
+  */
+int MyGsmSim808::httpPost()
+{
+   sendAT(GF("+HTTPACTION=1"));
+   if (waitResponse() != 1) {
+      return -1;
+   }
+   if (waitResponse(HTTP_ACTION_MS, GF("+HTTPACTION:")) != 1) {
+      return -1;
+   }
+
+   /* method */    stream.readStringUntil(',');
+   String status = stream.readStringUntil(',');
+
+   /* length */    stream.readStringUntil('\n');
+   return status.toInt();
+}
+
+/** Terminates the http session. */
+bool MyGsmSim808::httpEnd()
+{
+   sendAT(GF("+HTTPTERM"));
+   return waitResponse() == 1;
+}
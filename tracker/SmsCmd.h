@@ -29,9 +29,11 @@ protected:
    MyGsmGps  &myGsmGps;  //!< Reference to the gsm/gps instance.
    MyOptions &myOptions; //!< Reference to the options.
    MyData    &myData;    //!< Reference to the data.
+   SmsData    smsList[SMS_LIST_SIZE]; //!< Sms of one +CMGL listing.
 
 protected:   
    void checkSms   ();   
+   void processSms (const SmsData &sms);
 
    String getGoogleMapGpsUrl();
 
@@ -50,6 +52,7 @@ protected:
    void cmdSms     (const SmsData &sms);
    void cmdMqtt    (const SmsData &sms);
    void cmdPhone   (const SmsData &sms);
+   void cmdWifi    (const SmsData &sms);
    void cmdDefault (const SmsData &sms);
       
 public:
@@ -76,10 +79,20 @@ bool MySmsCmd::begin()
    return true;
 }
 
-/** Check the sms if the time from the options is elapsed. */
+/** Read the sms indicated by the modul at once. All unread sms are only checked 
+  * after the start, if too many are indicated or if the time from the options is 
+  * elapsed as safety net.
+  */
 void MySmsCmd::handleClient()
 {
-   if (secondsElapsedAndUpdate(myData.rtcData.lastSmsCheckSec, myOptions.smsCheckIntervalSec)) {
+   SmsData sms;
+
+   while (myGsmGps.readNewSMS(sms)) {
+      myGsmGps.deleteSMS(sms.index);
+      processSms(sms);
+   }
+   if (secondsElapsedAndUpdate(myData.rtcData.lastSmsCheckSec, myOptions.smsCheckIntervalSec) || myGsmGps.smsCheckRequested) {
+      myGsmGps.smsCheckRequested = false;
       checkSms();
    }
 }
@@ -98,42 +111,75 @@ String MySmsCmd::getGoogleMapGpsUrl()
    }
 }
 
-/** Checks for new sms and parse the commands from the message */
+/** Reads all unread sms with one listing, deletes them with one command and 
+  * parse the commands from the messages. If there are more sms than the list
+  * the listed sms are deleted one by one and the rest, which is marked as read 
+  * by the listing, is read with the next listing. If a delete fails the read
+  * listing is pending in the RTC data until it is done on one of the next checks.
+  */
 void MySmsCmd::checkSms()
 {
    if (!myData.isGsmActive) {
       return;
    }
    
-   SmsData sms;
+   String status  = myData.rtcData.isSmsReadPending ? F("REC READ") : F("REC UNREAD");
+   int    total   = 0;
+   int    count   = 0;
+   bool   deleted = true;
 
    MyDbg(F("checkSMS"));
-   while (myGsmGps.getSMS(sms)) {
-      String messageLower = sms.message;
-
-      messageLower.toLowerCase();
-      myGsmGps.deleteSMS(sms.index);
-
-      MyDbg((String) F("SMS: ") + sms.message + F(" [") + sms.phoneNumber + F("]"));
-      if (messageLower.indexOf(F("on")) == 0) {
-         cmdOn(sms);
-      } else if (messageLower.indexOf(F("off")) == 0) {
-         cmdOff(sms);
-      } else if (messageLower.indexOf(F("status")) == 0) {
-         cmdStatus(sms);
-      } else if (messageLower.indexOf(F("psm")) == 0) {
-         cmdPsm(sms);
-      } else if (messageLower.indexOf(F("gps")) == 0) {
-         cmdGps(sms);
-      } else if (messageLower.indexOf(F("sms")) == 0) {
-         cmdSms(sms);
-      } else if (messageLower.indexOf(F("mqtt")) == 0) {
-         cmdMqtt(sms);
-      } else if (messageLower.indexOf(F("phone")) == 0) {
-         cmdPhone(sms);
+   do {
+      count = myGsmGps.getSMSList(status, smsList, SMS_LIST_SIZE, total);
+      if (count == 0) {
+         break;
+      }
+      if (total <= count) {
+         deleted = myGsmGps.deleteReadSMS();
       } else {
-         cmdDefault(sms);
+         for (int i = 0; i < count; i++) {
+            deleted = myGsmGps.deleteSMS(smsList[i].index) && deleted;
+         }
+         status = F("REC READ");
+         myData.rtcData.isSmsReadPending = true;
       }
+      for (int i = 0; i < count; i++) {
+         processSms(smsList[i]);
+      }
+   } while (total > count && deleted);
+   if (total <= count && deleted) {
+      myData.rtcData.isSmsReadPending = false;
+   }
+}
+
+/** Parse and execute the command of one sms. */
+void MySmsCmd::processSms(const SmsData &sms)
+{
+   String messageLower = sms.message;
+
+   messageLower.toLowerCase();
+
+   MyDbg((String) F("SMS: ") + sms.message + F(" [") + sms.phoneNumber + F("]"));
+   if (messageLower.indexOf(F("on")) == 0) {
+      cmdOn(sms);
+   } else if (messageLower.indexOf(F("off")) == 0) {
+      cmdOff(sms);
+   } else if (messageLower.indexOf(F("status")) == 0) {
+      cmdStatus(sms);
+   } else if (messageLower.indexOf(F("psm")) == 0) {
+      cmdPsm(sms);
+   } else if (messageLower.indexOf(F("gps")) == 0) {
+      cmdGps(sms);
+   } else if (messageLower.indexOf(F("sms")) == 0) {
+      cmdSms(sms);
+   } else if (messageLower.indexOf(F("mqtt")) == 0) {
+      cmdMqtt(sms);
+   } else if (messageLower.indexOf(F("phone")) == 0) {
+      cmdPhone(sms);
+   } else if (messageLower.indexOf(F("wifi")) == 0) {
+      cmdWifi(sms);
+   } else {
+      cmdDefault(sms);
    }
 }
 
@@ -298,6 +344,13 @@ void MySmsCmd::cmdPhone(const SmsData &sms)
    }
 }
 
+/** Command: switch on the WiFi, after a deep sleep with the radio off on the next wake */
+void MySmsCmd::cmdWifi(const SmsData &sms)
+{
+   myData.rtcData.isWifiRequested = true;
+   sendOk(sms);
+}
+
 /** Default sms response if something is wrong */
 void MySmsCmd::cmdDefault(const SmsData &sms)
 {
@@ -312,5 +365,6 @@ void MySmsCmd::cmdDefault(const SmsData &sms)
    info += F("sms[:15] - check every (sec)\n");
    info += F("mqtt[30:60] - (moving:standing (sec)\n");
    info += F("phone:1234\n");
+   info += F("wifi - switch on the WiFi\n");
    sendSms(info);
 }
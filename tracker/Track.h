@@ -0,0 +1,136 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Track.h
+  *
+  * Gps track backlog in the SPIFFS.
+  */
+
+#define TRACK_FILE_NAME     "/track.txt" //!< Gps positions which are not sent yet.
+#define TRACK_TEMP_NAME     "/track.tmp" //!< Temporary file on removing sent positions.
+#define TRACK_MAX_SIZE      32768        //!< Maximum size of the track file in bytes.
+
+/**
+  * Stores every gps position as one json line in the SPIFFS until it is
+  * acknowledged from the mqtt server or uploaded via http.
+  */
+class MyTrack
+{
+protected:
+   MyOptions &myOptions;        //!< Reference to global options
+   MyData    &myData;           //!< Reference to global data
+
+public:
+   MyTrack(MyOptions &options, MyData &data);
+
+   bool add(MyGps &gps);
+   bool removeHead(long count);
+   long size();
+   bool isBacklog();
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyTrack::MyTrack(MyOptions &options, MyData &data)
+   : myOptions(options)
+   , myData(data)
+{
+}
+
+/** Appends the gps position with date and time to the track file. */
+bool MyTrack::add(MyGps &gps)
+{
+   char gpsJson[255];
+
+   if (!gps.getAsGpsJson(gpsJson)) {
+      return false;
+   }
+
+   File file = SPIFFS.open(TRACK_FILE_NAME, "a");
+
+   if (!file) {
+      MyDbg(F("Failed to open track file"));
+      return false;
+   }
+   if (file.size() > TRACK_MAX_SIZE) {
+      MyDbg(F("Track file full"));
+      file.close();
+      return false;
+   }
+   file.println((String) F("{\"date\":\"") + gps.date.dateString() +
+                F("\",\"time\":\"") + gps.time.timeString() + F("\",") + (gpsJson + 1));
+   file.close();
+   return true;
+}
+
+/** Removes the first count positions from the track file. */
+bool MyTrack::removeHead(long count)
+{
+   File file = SPIFFS.open(TRACK_FILE_NAME, "r");
+
+   if (!file) {
+      return false;
+   }
+
+   File temp     = SPIFFS.open(TRACK_TEMP_NAME, "w");
+   bool hasLines = false;
+
+   if (!temp) {
+      MyDbg(F("Failed to write track file"));
+      file.close();
+      return false;
+   }
+   for (long i = 0; file.available(); i++) {
+      String line = file.readStringUntil('\n');
+
+      if (i >= count) {
+         temp.print(line + '\n');
+         hasLines = true;
+      }
+   }
+   file.close();
+   temp.close();
+
+   SPIFFS.remove(TRACK_FILE_NAME);
+   if (hasLines) {
+      SPIFFS.rename(TRACK_TEMP_NAME, TRACK_FILE_NAME);
+   } else {
+      SPIFFS.remove(TRACK_TEMP_NAME);
+   }
+   MyDbg((String) F("Track positions removed: ") + String(count));
+   return true;
+}
+
+/** Size of the track file in bytes. */
+long MyTrack::size()
+{
+   File file = SPIFFS.open(TRACK_FILE_NAME, "r");
+   long ret  = 0;
+
+   if (file) {
+      ret = file.size();
+      file.close();
+   }
+   return ret;
+}
+
+/** Is the track too big for mqtt so it has to be uploaded via http? */
+bool MyTrack::isBacklog()
+{
+   return myOptions.httpUploadUrl.length() > 0 && size() >= myOptions.httpBacklogSize;
+}
@@ -0,0 +1,193 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Upload.h
+  *
+  * Http upload of the gps track backlog via the http stack of the sim808 modul.
+  */
+
+#define HTTP_BATCH_SIZE     8192 //!< Maximum size of the track lines uploaded with one post.
+#define HTTP_RETRIES        3    //!< Number of tries per batch.
+#define HTTP_RETRY_DELAY_MS 2000 //!< Wait before the next try, doubled on every try.
+#define HTTP_RETRY_SEC      300  //!< Wait before the next upload if a batch has failed.
+
+/**
+  * Uploads a big track backlog in batches with one http post per batch.
+  * The json lines of the track file are sent as csv rows with one header line,
+  * which is about half the size. The rows are written directly from the file
+  * to the modul and every batch is removed from the track file as soon as the
+  * server has accepted it, so an interrupted upload continues with the next
+  * batch on the next try.
+  */
+class MyUpload
+{
+protected:
+   MyGsmSim808 &gsmSim808;         //!< Reference to the sim808 modul.
+   MyOptions   &myOptions;         //!< Reference to the options.
+   MyData      &myData;            //!< Reference to the data.
+   MyTrack     &myTrack;           //!< Reference to the gps track backlog.
+   long         lastUploadSec;     //!< Time of the last upload.
+
+protected:
+   long nextBatch(long &lines);
+   bool postBatch(long lines, long size);
+
+public:
+   MyUpload(MyGsmSim808 &sim808, MyOptions &options, MyData &data, MyTrack &track);
+
+   void handleClient();
+   bool upload();
+
+   static String csvLine(const String &json, bool keys);
+};
+
+/* ******************************************** */
+
+/** Constructor */
+MyUpload::MyUpload(MyGsmSim808 &sim808, MyOptions &options, MyData &data, MyTrack &track)
+   : gsmSim808(sim808)
+   , myOptions(options)
+   , myData(data)
+   , myTrack(track)
+   , lastUploadSec(0)
+{
+}
+
+/** Uploads the track if it is a backlog. After a failure it waits HTTP_RETRY_SEC. */
+void MyUpload::handleClient()
+{
+   if (!myData.isGsmActive || !myTrack.isBacklog()) {
+      return;
+   }
+   if (secondsElapsedAndUpdate(lastUploadSec, HTTP_RETRY_SEC)) {
+      upload();
+   }
+}
+
+/** Uploads the complete track batch by batch. Returns false if a batch has failed. */
+bool MyUpload::upload()
+{
+   long lines;
+   long size;
+   bool ok = true;
+
+   myData.profiler.start(PHASE_HTTP_UPLOAD);
+   myData.rtcData.energy.transmit(true);
+   while (ok && (size = nextBatch(lines)) > 0) {
+      ok = false;
+      for (int i = 0; !ok && i < HTTP_RETRIES; i++) {
+         if (i > 0) {
+            MyDbg((String) F("HTTP upload retry ") + String(i));
+            MyDelay((long) HTTP_RETRY_DELAY_MS << (i - 1));
+         }
+         ok = postBatch(lines, size);
+      }
+      if (ok) {
+         myTrack.removeHead(lines);
+      }
+   }
+   myData.rtcData.energy.transmit(false);
+   myData.profiler.stop(PHASE_HTTP_UPLOAD);
+   MyDbg((String) F("HTTP upload: ") + String(myData.profiler.getLastMs(PHASE_HTTP_UPLOAD)) + F(" ms") +
+         (ok ? F("") : F(" (failed)")));
+   return ok;
+}
+
+/** Number of lines of the next batch and the size of the csv data, 0 = nothing to upload. */
+long MyUpload::nextBatch(long &lines)
+{
+   File file = SPIFFS.open(TRACK_FILE_NAME, "r");
+   long json = 0;
+   long size = 0;
+
+   lines = 0;
+   if (!file) {
+      return 0;
+   }
+   while (file.available() && (lines == 0 || json < HTTP_BATCH_SIZE)) {
+      String line = file.readStringUntil('\n');
+
+      if (size == 0) {
+         size = csvLine(line, true).length();
+      }
+      json += line.length() + 1;
+      size += csvLine(line, false).length();
+      lines++;
+   }
+   file.close();
+   return size;
+}
+
+/** Posts the first lines of the track file as csv. Returns true if the server has accepted them. */
+bool MyUpload::postBatch(long lines, long size)
+{
+   File file = SPIFFS.open(TRACK_FILE_NAME, "r");
+   int  status = -1;
+
+   if (!file) {
+      return false;
+   }
+   MyDbg((String) F("HTTP upload: ") + String(lines) + F(" positions, ") + String(size) + F(" bytes"));
+   if (gsmSim808.httpBegin(myOptions.httpUploadUrl, F("text/csv"))) {
+      if (gsmSim808.httpData(size)) {
+         for (long i = 0; i < lines; i++) {
+            String line = file.readStringUntil('\n');
+
+            if (i == 0) {
+               gsmSim808.stream.print(csvLine(line, true));
+            }
+            gsmSim808.stream.print(csvLine(line, false));
+         }
+         if (gsmSim808.httpDataEnd()) {
+            status = gsmSim808.httpPost();
+         }
+      }
+      gsmSim808.httpEnd();
+   }
+   file.close();
+   MyDbg((String) F("HTTP status: ") + String(status));
+   return status >= 200 && status < 300;
+}
+
+/** Converts a json line with string values to a csv row with the keys or the values.
+  * Sample: {"date":"26-1-2019","time":"8:21:0","long":"8.0","lat":"47.0"}
+  *         date,time,long,lat
+  *         26-1-2019,8:21:0,8.0,47.0
+  */
+String MyUpload::csvLine(const String &json, bool keys)
+{
+   String csv;
+   int    pos   = json.indexOf('"');
+   bool   isKey = true;
+
+   while (pos != -1) {
+      int end = json.indexOf('"', pos + 1);
+
+      if (end == -1) {
+         break;
+      }
+      if (isKey == keys) {
+         if (csv.length() > 0) {
+            csv += ',';
+         }
+         csv += json.substring(pos + 1, end);
+      }
+      isKey = !isKey;
+      pos   = json.indexOf('"', end + 1);
+   }
+   return csv.length() > 0 ? csv + '\n' : csv;
+}
@@ -49,7 +49,7 @@ public:
 long secondsSincePowerOn();
 
 /** Checks if the intervalSec is from the last checkIntervalSec elapsed */
-bool secondsElapsed(long &lastCheckSec, const long &intervalSec)
+bool secondsElapsed(long lastCheckSec, const long &intervalSec)
 {
    long currentSec = secondsSincePowerOn();
 
@@ -71,6 +71,16 @@ bool secondsElapsedAndUpdate(long &lastCheckSec, const long &intervalSec)
    return false;
 }
 
+/** Same for the 32 bit timestamps of the RTC data. */
+bool secondsElapsedAndUpdate(int32_t &lastCheckSec, const long &intervalSec)
+{
+   long lastSec = lastCheckSec;
+   bool ret     = secondsElapsedAndUpdate(lastSec, intervalSec);
+
+   lastCheckSec = lastSec;
+   return ret;
+}
+
 #define POLY 0xedb88320 //!< CRC-32 (Ethernet, ZIP, etc.) polynomial in reversed bit order.
 
 /** Simple crc function. Can multiple called but the first time crc should be 0.  */
@@ -20,10 +20,16 @@
   * Class to read the power supply voltage.
   */
 
-#define ANALOG_FACTOR 0.03 //!< Factor to the analog voltage divider
+#define ANALOG_FACTOR       0.03 //!< Factor to the analog voltage divider
+#define VOLTAGE_MEDIAN_SIZE 5    //!< Number of adc reads in the median window.
+#define VOLTAGE_IIR_FACTOR  0.25 //!< Weight of a new median in the smoothed voltage.
 
 /**
   * Voltage Reader. Works with the voltage divider resistors and the analog input reader.
+  * The adc is read only every voltageSampleMs because frequent reads disturb the WiFi
+  * of the esp8266. The median of the last reads removes single spikes and a first order 
+  * iir filter smoothes the medians. The low power state switches on below powerSaveModeVoltage
+  * and only switches off again above powerSaveModeVoltage + powerSaveHysteresis.
   */
 class MyVoltage
 {
@@ -32,6 +38,13 @@ protected:
    MyData    &myData;           //!< Reference to global data
 
    long       lowPowerStartSec; //!< Switch off timestamp
+   long       lastSampleMs;     //!< Timestamp of the last adc read.
+   double     samples[VOLTAGE_MEDIAN_SIZE]; //!< Median window of the last adc reads.
+   int        sampleIndex;      //!< Next position in the median window.
+
+protected:
+   void   readSample();
+   double median();
 
 public:
    MyVoltage(MyOptions &options, MyData &data);
@@ -48,29 +61,49 @@ MyVoltage::MyVoltage(MyOptions &options, MyData &data)
    : myOptions(options)
    , myData(data)
    , lowPowerStartSec(0)
+   , lastSampleMs(0)
+   , sampleIndex(0)
 {
+   for (int i = 0; i < VOLTAGE_MEDIAN_SIZE; i++) {
+      samples[i] = 0.0;
+   }
 }
 
-/** Reads the voltage at startup. */
+/** Reads the voltage at startup with a full median window. */
 bool MyVoltage::begin()
 {
    MyDbg(F("MyVoltage::begin"));
    pinMode(A0, INPUT);
-   myData.voltage    = ANALOG_FACTOR * analogRead(A0); // Volt
+   for (int i = 0; i < VOLTAGE_MEDIAN_SIZE; i++) {
+      readSample();
+   }
+   myData.voltage    = median(); // Volt
    myData.isLowPower = myData.voltage < myOptions.powerSaveModeVoltage;
+   myData.resetVoltageStat();
    lowPowerStartSec  = millis() / 1000;
+   return true;
 }
 
-/** Reads the power supply voltage and save the value in the data class. 
+/** Reads the power supply voltage every voltageSampleMs and save the value in the data class. 
   * Add the lowPower time to the lowPowerActive and lowPowerPowerOn time. 
   */
 void MyVoltage::readVoltage()
 {
+   if (millis() - lastSampleMs < myOptions.voltageSampleMs) {
+      return;
+   }
+
    bool isLowPower = false;
    long currSec    = millis() / 1000;
    
-   myData.voltage = ANALOG_FACTOR * analogRead(A0); // Volt
-   isLowPower     = myData.voltage < myOptions.powerSaveModeVoltage;
+   readSample();
+   myData.voltage += VOLTAGE_IIR_FACTOR * (median() - myData.voltage); // Volt
+   myData.addVoltageStat(myData.voltage);
+   if (myData.isLowPower) {
+      isLowPower = myData.voltage < myOptions.powerSaveModeVoltage + myOptions.powerSaveHysteresis;
+   } else {
+      isLowPower = myData.voltage < myOptions.powerSaveModeVoltage;
+   }
 
    if (myData.isLowPower && !isLowPower) { // Change to high power
       long lowPowerSec = currSec - lowPowerStartSec;
@@ -87,3 +120,27 @@ void MyVoltage::readVoltage()
    }
    myData.isLowPower = isLowPower;
 }
+
+/** Reads the adc into the median window. */
+void MyVoltage::readSample()
+{
+   samples[sampleIndex] = ANALOG_FACTOR * analogRead(A0);
+   sampleIndex          = (sampleIndex + 1) % VOLTAGE_MEDIAN_SIZE;
+   lastSampleMs         = millis();
+}
+
+/** Median of the window with an insertion sort of a copy. */
+double MyVoltage::median()
+{
+   double sorted[VOLTAGE_MEDIAN_SIZE];
+
+   for (int i = 0; i < VOLTAGE_MEDIAN_SIZE; i++) {
+      int j = i;
+
+      for (; j > 0 && sorted[j - 1] > samples[i]; j--) {
+         sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = samples[i];
+   }
+   return sorted[VOLTAGE_MEDIAN_SIZE / 2];
+}
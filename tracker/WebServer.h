@@ -81,18 +81,23 @@ public:
    static void handleLoadConsoleInfo();
    static void loadRestart();
    static void handleLoadRestartInfo();
+   static void handleLoadProfile();
    static void handleNotFound();
    static void handleWebRequests();
 
 public:
-   bool isWebServerActive; //!< Is the webserver currently active.
+   bool          isWebServerActive; //!< Is the webserver currently active.
+   bool          isRouted;          //!< Are the urls registered at the server?
+   unsigned long lastActivityMs;    //!< Last time a station was connected to the access point.
 
 public:
    MyWebServer(MyOptions &options, MyData &data);
    ~MyWebServer();
 
    bool begin();
+   void stop();
    void handleClient();
+   void handleIdle();
 };
 
 /* ******************************************** */
@@ -107,6 +112,8 @@ MyData        *MyWebServer::myData    = NULL;
 /** Constructor/Destructor */
 MyWebServer::MyWebServer(MyOptions &options, MyData &data)
    : isWebServerActive(false)
+   , isRouted(false)
+   , lastActivityMs(0)
 {
    myOptions = &options;
    myData    = &data;      
@@ -129,9 +136,11 @@ bool MyWebServer::begin()
 
    MyDbg(F("MyWebServer::begin"));
    WiFi.persistent(false);
+   WiFi.forceSleepWake();
    WiFi.mode(WIFI_AP_STA);
    WiFi.softAP(SOFT_AP_NAME, SOFT_AP_PW);
    WiFi.softAPConfig(ip, ip, IPAddress(255, 255, 255, 0));  
+   myData->rtcData.energy.set(ENERGY_WIFI_AP, true);
    dnsServer.setErrorReplyCode(DNSReplyCode::NoError);
    dnsServer.start(53, F("*"), ip);
    myData->softAPIP         = WiFi.softAPIP().toString();
@@ -159,27 +168,49 @@ bool MyWebServer::begin()
       WiFi.mode(WIFI_AP);
    }
    
-   server.on(F("/"),              handleRoot);
-   server.on(F("/Main.html"),     loadMain);
-   server.on(F("/MainInfo"),      handleLoadMainInfo);
-   server.on(F("/Update.html"),   loadUpdate);
-   server.on(F("/Settings.html"), loadSettings);
-   server.on(F("/SettingsInfo"),  handleLoadSettingsInfo);
-   server.on(F("/SaveSettings"),  handleSaveSettings);
-   server.on(F("/InfoInfo"),      handleLoadInfoInfo);
-   server.on(F("/Console.html"),  loadConsole);
-   server.on(F("/ConsoleInfo"),   handleLoadConsoleInfo);
-   server.on(F("/Restart.html"),  loadRestart);
-   server.on(F("/RestartInfo"),   handleLoadRestartInfo);
-   server.onNotFound(handleWebRequests);
+   if (!isRouted) {
+      server.on(F("/"),              handleRoot);
+      server.on(F("/Main.html"),     loadMain);
+      server.on(F("/MainInfo"),      handleLoadMainInfo);
+      server.on(F("/Update.html"),   loadUpdate);
+      server.on(F("/Settings.html"), loadSettings);
+      server.on(F("/SettingsInfo"),  handleLoadSettingsInfo);
+      server.on(F("/SaveSettings"),  handleSaveSettings);
+      server.on(F("/InfoInfo"),      handleLoadInfoInfo);
+      server.on(F("/Console.html"),  loadConsole);
+      server.on(F("/ConsoleInfo"),   handleLoadConsoleInfo);
+      server.on(F("/Restart.html"),  loadRestart);
+      server.on(F("/RestartInfo"),   handleLoadRestartInfo);
+      server.on(F("/Profile"),       handleLoadProfile);
+      server.onNotFound(handleWebRequests);
+      isRouted = true;
+   }
 
    server.begin(); 
    MyDbg(F("Server listening"), true);
 
    isWebServerActive = true;
+   lastActivityMs    = millis();
+   myData->rtcData.isWifiRequested = false;
    return true;
 }
 
+/** Stops the webserver and switches off the WiFi radio. */
+void MyWebServer::stop()
+{
+   MyDbg(F("MyWebServer::stop"));
+   isWebServerActive = false;
+   server.stop();
+   dnsServer.stop();
+   WiFi.disconnect();
+   WiFi.softAPdisconnect(true);
+   WiFi.mode(WIFI_OFF);
+   WiFi.forceSleepBegin();
+   if (myData) {
+      myData->rtcData.energy.set(ENERGY_WIFI_AP, false);
+   }
+}
+
 /** Handle the http requests. */
 void MyWebServer::handleClient()
 {
@@ -189,6 +220,20 @@ void MyWebServer::handleClient()
    }
 }
 
+/** Switches off the WiFi if no station was connected to the access point for wifiIdleSec. */
+void MyWebServer::handleIdle()
+{
+   if (!isWebServerActive || myOptions->wifiIdleSec == 0) {
+      return;
+   }
+   if (WiFi.softAPgetStationNum() > 0) {
+      lastActivityMs = millis();
+   } else if (millis() - lastActivityMs > myOptions->wifiIdleSec * 1000) {
+      MyDbg(F("WiFi idle"));
+      stop();
+   }
+}
+
 /** Helper function to start a HTML table. */
 void MyWebServer::AddTableBegin(String &info)
 {
@@ -401,6 +446,8 @@ void MyWebServer::handleLoadMainInfo()
 #endif   
 
    AddTableTr(info, F("Battery"),         String(myData->voltage,     2) + F(" V"));
+   AddTableTr(info, F("Battery min/avg/max"), String(myData->voltageMin, 2) + F(" / ") + 
+              String(myData->getVoltageAvg(), 2) + F(" / ") + String(myData->voltageMax, 2) + F(" V"));
    AddTableTr(info, F("Temperature"),     String(myData->temperature, 1) + F(" °C"));
    AddTableTr(info, F("Humidity"),        String(myData->humidity,    1) + F(" %"));
    AddTableTr(info, F("Pressure"),        String(myData->pressure,    1) + F(" hPa"));
@@ -408,7 +455,7 @@ void MyWebServer::handleLoadMainInfo()
    AddTableTr(info, F("Active Time"),     formatInterval(myData->getActiveTimeSec()));
    AddTableTr(info, F("PowerUpTime"),     formatInterval(myData->getPowerOnTimeSec()));
    AddTableTr(info, F("DeepSleepTime"),   formatInterval(myData->rtcData.deepSleepTimeSec));
-   AddTableTr(info, F("mAh"),             String(myData->getPowerConsumption(), 2));
+   AddTableTr(info, F("mAh"),             String(myData->getPowerConsumption(*myOptions), 2));
    AddTableTr(info, F("Low power mAh"),   String(myData->getLowPowerPowerConsumption(), 2));
 #endif   
    if (myData->rtcData.lastGps.fixStatus) {
@@ -493,6 +540,7 @@ void MyWebServer::handleLoadSettingsInfo()
    AddOption(info, F("gprsAP"),       F("GPRS AP"),       myOptions->gprsAP);
    AddOption(info, F("gprsUser"),     F("GPRS User"),     myOptions->gprsUser);
    AddOption(info, F("gprsPassword"), F("GPRS Password"), myOptions->gprsPassword);
+   AddOption(info, F("modemMaxBaud"), F("Sim808 max baud rate"), String(myOptions->modemMaxBaud));
 #endif
 
    AddBr(info);
@@ -506,6 +554,9 @@ void MyWebServer::handleLoadSettingsInfo()
 
       AddOption(info, F("wifiAP"), F("WiFi SSID"), myOptions->wifiAP, false);
       AddOption(info, F("wifiPassword"), F("WiFi Password"), myOptions->wifiPassword, false, true);
+#ifdef SIM808_CONNECTED
+      AddOption(info, F("wifiIdleSec"), F("WiFi off when idle for (Interval)"), formatInterval(myOptions->wifiIdleSec), false);
+#endif
    }
 
 #ifdef SIM808_CONNECTED
@@ -549,11 +600,17 @@ void MyWebServer::handleLoadSettingsInfo()
 
       AddOption(info, F("mqttServer"),                F("MQTT Server"),                            myOptions->mqttServer);
       AddOption(info, F("mqttPort"),                  F("MQTT Port"),                              String(myOptions->mqttPort));
+      AddOption(info, F("mqttDnsCacheSec"),           F("MQTT Server ip cached for (Interval)"),   formatInterval(myOptions->mqttDnsCacheSec));
       AddOption(info, F("mqttUser"),                  F("MQTT User"),                              myOptions->mqttUser);
       AddOption(info, F("mqttPassword"),              F("MQTT Password"),                          myOptions->mqttPassword, true, true);
 #ifdef SIM808_CONNECTED
       AddOption(info, F("mqttSendOnMoveEverySec"),    F("MQTT Send on moving every (Interval)"),   formatInterval(myOptions->mqttSendOnMoveEverySec));
-      AddOption(info, F("mqttSendOnNonMoveEverySec"), F("MQTT Send on standing every (Interval)"), formatInterval(myOptions->mqttSendOnNonMoveEverySec), false);
+      AddOption(info, F("mqttSendOnNonMoveEverySec"), F("MQTT Send on standing every (Interval)"), formatInterval(myOptions->mqttSendOnNonMoveEverySec));
+      AddOption(info, F("mqttInflightWindow"),        F("MQTT Track messages in flight"),          String(myOptions->mqttInflightWindow));
+      AddOption(info, F("isMqttOneShot"),             F("MQTT Disconnect after sending"),          myOptions->isMqttOneShot);
+      AddOption(info, F("isMqttDiagnostics"),         F("MQTT Send phase durations"),              myOptions->isMqttDiagnostics);
+      AddOption(info, F("httpUploadUrl"),             F("HTTP Backlog upload url"),                myOptions->httpUploadUrl);
+      AddOption(info, F("httpBacklogSize"),           F("HTTP Backlog from size (bytes)"),         String(myOptions->httpBacklogSize), false);
 #else
       AddOption(info, F("mqttSendOnNonMoveEverySec"), F("MQTT Send every (Interval)"),             formatInterval(myOptions->mqttSendOnNonMoveEverySec), false);
 #endif
@@ -568,10 +625,34 @@ void MyWebServer::handleLoadSettingsInfo()
          AddOption(info, F("isDeepSleepEnabled"), F("Power saving mode active"), myOptions->isDeepSleepEnabled, false);
       }
       AddOption(info, F("powerSaveModeVoltage"),  F("Power saving mode below (Volt)"), String(myOptions->powerSaveModeVoltage, 2));
+      AddOption(info, F("powerSaveHysteresis"),   F("Power saving mode hysteresis (Volt)"), String(myOptions->powerSaveHysteresis, 2));
+      AddOption(info, F("voltageSampleMs"),       F("Read voltage every (ms)"),         String(myOptions->voltageSampleMs));
       AddOption(info, F("powerCheckIntervalSec"), F("Check power every (Interval)"),   formatInterval(myOptions->powerCheckIntervalSec));
 
       AddOption(info, F("activeTimeSec"),    F("Active time (Interval)"),    formatInterval(myOptions->activeTimeSec));
-      AddOption(info, F("deepSleepTimeSec"), F("DeepSleep time (Interval)"), formatInterval(myOptions->deepSleepTimeSec), false);
+      AddOption(info, F("deepSleepTimeSec"), F("DeepSleep time (Interval)"), formatInterval(myOptions->deepSleepTimeSec));
+#ifdef SIM808_CONNECTED
+      AddOption(info, F("isGsmSleepEnabled"), F("Sim808 sleeps instead of power off if cheaper"), myOptions->isGsmSleepEnabled);
+#endif
+      AddOption(info, F("isSchedulerEnabled"), F("Adaptive wake interval"),     myOptions->isSchedulerEnabled);
+      AddOption(info, F("dailyBudgetMah"),     F("Energy budget per day (mAh)"), String(myOptions->dailyBudgetMah, 1));
+      AddOption(info, F("batteryCapacityMah"), F("Battery capacity (mAh)"),      String(myOptions->batteryCapacityMah, 1));
+      AddOption(info, F("batteryCurve"),       F("Battery curve (Volt:%,...)"),   myOptions->batteryCurve, false);
+   }
+
+   AddBr(info);
+   {
+      HtmlTag fieldset(info, F("fieldset"));
+      {
+         HtmlTag legend(info, F("legend"));
+
+         info += F("Energy (mA)");
+      }
+      for (int i = 0; i < ENERGY_COUNT; i++) {
+         String name = MyEnergy::stateName((EnergyState) i);
+
+         AddOption(info, (String) F("energyMa_") + name, (String) F("Current ") + name + F(" (mA)"), String(myOptions->energyMa[i], 3));
+      }
    }
 
    AddIntervalInfo(info);
@@ -590,9 +671,11 @@ void MyWebServer::handleSaveSettings()
    GetOption(F("gprsAP"),                    myOptions->gprsAP);
    GetOption(F("gprsUser"),                  myOptions->gprsUser);
    GetOption(F("gprsPassword"),              myOptions->gprsPassword);
+   GetOption(F("modemMaxBaud"),              myOptions->modemMaxBaud);
    GetOption(F("connectWifiAP"),             myOptions->connectWifiAP);
    GetOption(F("wifiAP"),                    myOptions->wifiAP);
    GetOption(F("wifiPassword"),              myOptions->wifiPassword);
+   GetOption(F("wifiIdleSec"),               myOptions->wifiIdleSec);
    GetOption(F("isDebugActive"),             myOptions->isDebugActive);
    GetOption(F("bme280CheckIntervalSec"),    myOptions->bme280CheckIntervalSec);
    GetOption(F("isSmsEnabled"),              myOptions->isSmsEnabled);
@@ -604,18 +687,34 @@ void MyWebServer::handleSaveSettings()
    GetOption(F("minMovingDistance"),         myOptions->minMovingDistance);
    GetOption(F("isDeepSleepEnabled"),        myOptions->isDeepSleepEnabled);
    GetOption(F("powerSaveModeVoltage"),      myOptions->powerSaveModeVoltage);
+   GetOption(F("powerSaveHysteresis"),       myOptions->powerSaveHysteresis);
+   GetOption(F("voltageSampleMs"),           myOptions->voltageSampleMs);
    GetOption(F("powerCheckIntervalSec"),     myOptions->powerCheckIntervalSec);
    GetOption(F("activeTimeSec"),             myOptions->activeTimeSec);
    GetOption(F("deepSleepTimeSec"),          myOptions->deepSleepTimeSec);
+   GetOption(F("isGsmSleepEnabled"),         myOptions->isGsmSleepEnabled);
+   GetOption(F("isSchedulerEnabled"),        myOptions->isSchedulerEnabled);
+   GetOption(F("dailyBudgetMah"),            myOptions->dailyBudgetMah);
+   GetOption(F("batteryCapacityMah"),        myOptions->batteryCapacityMah);
+   GetOption(F("batteryCurve"),              myOptions->batteryCurve);
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      GetOption((String) F("energyMa_") + MyEnergy::stateName((EnergyState) i), myOptions->energyMa[i]);
+   }
    GetOption(F("isMqttEnabled"),             myOptions->isMqttEnabled);
    GetOption(F("mqttName"),                  myOptions->mqttName);
    GetOption(F("mqttId"),                    myOptions->mqttId);
    GetOption(F("mqttServer"),                myOptions->mqttServer);
    GetOption(F("mqttPort"),                  myOptions->mqttPort);
+   GetOption(F("mqttDnsCacheSec"),           myOptions->mqttDnsCacheSec);
    GetOption(F("mqttUser"),                  myOptions->mqttUser);
    GetOption(F("mqttPassword"),              myOptions->mqttPassword);
    GetOption(F("mqttSendOnMoveEverySec"),    myOptions->mqttSendOnMoveEverySec);
    GetOption(F("mqttSendOnNonMoveEverySec"), myOptions->mqttSendOnNonMoveEverySec);
+   GetOption(F("isMqttOneShot"),             myOptions->isMqttOneShot);
+   GetOption(F("isMqttDiagnostics"),         myOptions->isMqttDiagnostics);
+   GetOption(F("mqttInflightWindow"),        myOptions->mqttInflightWindow);
+   GetOption(F("httpUploadUrl"),             myOptions->httpUploadUrl);
+   GetOption(F("httpBacklogSize"),           myOptions->httpBacklogSize);
 
    // Reset the rtc data if something has changed.
    myData->awakeTimeOffsetSec = millis() / 1000;
@@ -662,6 +761,7 @@ void MyWebServer::handleLoadInfoInfo()
       AddTableTr(info, F("Modem IP"),          myData->modemIP);
       AddTableTr(info, F("IMEI"),              myData->imei);
       AddTableTr(info, F("COP"),               myData->cop);
+      AddTableTr(info, F("Modem ready"),       String(myData->modemReadyMs) + (myData->isModemWarm ? F(" ms (warm)") : F(" ms (cold)")));
       AddTableTr(info, F("Signal Quality"),    myData->signalQuality);
       AddTableTr(info, F("Battery Level"),     myData->batteryLevel);
       AddTableTr(info, F("Battery Volt"),      myData->batteryVolt);
@@ -686,9 +786,37 @@ void MyWebServer::handleLoadInfoInfo()
    AddTableTr(info, F("Active Time"),          formatInterval(myData->getActiveTimeSec()));
    AddTableTr(info, F("PowerUpTime"),          formatInterval(myData->getPowerOnTimeSec()));
    AddTableTr(info, F("DeepSleepTime"),        formatInterval(myData->rtcData.deepSleepTimeSec));
-   AddTableTr(info, F("mAh"),                  String(myData->getPowerConsumption(), 2));
+   AddTableTr(info, F("mAh"),                  String(myData->getPowerConsumption(*myOptions), 2));
    AddTableTr(info, F("Low power mAh"),        String(myData->getLowPowerPowerConsumption(), 2));
+   if (myData->rtcData.battery.isValid()) {
+      double runtimeDays = myData->rtcData.battery.getRuntimeDays(*myOptions);
+
+      AddTableTr(info, F("Battery charge"),    String(myData->rtcData.battery.getSoc(), 1) + F(" % (") + 
+                 (runtimeDays < 0.0 ? String(F("?")) : String(runtimeDays, 1)) + F(" days)"));
+   }
+   AddTableTr(info, F("Fast sleeps"),          String(myData->rtcData.fastSleepCount) + F(" (") + 
+              String(myData->rtcData.fastSleepUs / 1000.0, 1) + F(" ms)"));
+   AddTableTr(info, F("Settings loaded"),      String(myOptions->loadUs / 1000.0, 1) + 
+              (myOptions->snapshotGeneration ? F(" ms (RTC)") : F(" ms (file)")));
+   AddTableTr(info);
+   for (int i = 0; i < ENERGY_COUNT; i++) {
+      EnergyState state = (EnergyState) i;
+
+      AddTableTr(info, (String) F("mAh ") + MyEnergy::stateName(state), 
+                 String(myData->rtcData.energy.getMAh(state, myOptions->energyMa), 2) + F(" (") + 
+                 formatInterval(myData->rtcData.energy.getSec(state)) + F(")"));
+   }
    AddTableTr(info);                       
+   if (myData->profiler.getWakeCount(PHASE_MQTT_CONNECT) != 0) {
+      MyProfiler &profiler = myData->profiler;
+
+      AddTableTr(info, F("MQTT dns"),          profiler.getWakeCount(PHASE_MQTT_DNS) == 0 ? String(F("cached")) : String(profiler.getLastMs(PHASE_MQTT_DNS)) + F(" ms"));
+      AddTableTr(info, F("MQTT connect"),      String(profiler.getLastMs(PHASE_MQTT_CONNECT))    + F(" ms"));
+      AddTableTr(info, F("MQTT publish"),      String(profiler.getLastMs(PHASE_MQTT_PUBLISH))    + F(" ms"));
+      AddTableTr(info, F("MQTT disconnect"),   String(profiler.getLastMs(PHASE_MQTT_DISCONNECT)) + F(" ms"));
+      AddTableTr(info, F("MQTT config"),       (String) F("v=") + String(myOptions->remoteConfigVersion));
+      AddTableTr(info);
+   }
 #endif   
    AddTableTr(info, F("ESP Chip ID"),          String(ESP.getChipId()));
    AddTableTr(info, F("Flash Chip ID"),        String(ESP.getFlashChipId()));
@@ -775,6 +903,21 @@ void MyWebServer::handleLoadRestartInfo()
    myData->restartInfo = "";
 }
 
+/** Returns the phase durations of the current wake and the lifetime histograms as json. 
+  * The lifetime statistic is removed with /Profile?clear
+  */
+void MyWebServer::handleLoadProfile()
+{
+   if (!myOptions || !myData) {
+      return;
+   }
+
+   if (server.hasArg(F("clear"))) {
+      myData->profiler.clear();
+   }
+   server.send(200, F("application/json"), myData->profiler.getJson());
+}
+
 /** Handle if the url could not be found. */
 void MyWebServer::handleNotFound()
 {
@@ -0,0 +1,251 @@
+#include "TrackerHost.h"
+#include "MqttBroker.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#include <vector>
+
+
+/** Records the results of the queued commands and the routed urcs. */
+class AtRecorder
+{
+public:
+    std::vector<int>    results;
+    std::vector<String> responses;
+    std::vector<String> urcs;
+    size_t              resultsAtUrc;
+
+    AtRecorder() : resultsAtUrc(0) {}
+
+    static void onResult(void *context, int result, const String &response) {
+        AtRecorder *self = (AtRecorder *) context;
+
+        self->results.push_back(result);
+        self->responses.push_back(response);
+    }
+    static void onUrc(void *context, const String &line) {
+        AtRecorder *self = (AtRecorder *) context;
+
+        self->urcs.push_back(line);
+        self->resultsAtUrc = self->results.size();
+    }
+};
+
+/** Runs the engine until all commands are finished or the virtual time is elapsed. */
+void runEngine(MyAtEngine &engine, unsigned long ms)
+{
+    unsigned long startMs = millis();
+
+    do {
+        engine.loop();
+        delay(1);
+    } while (!engine.isIdle() && millis() - startMs < ms);
+}
+
+int test_queue_order_and_results() {
+    IT("sends the queued commands in order and reports ok, error and timeout");
+    Sim808Simulator sim;
+    MyAtEngine engine(sim);
+    AtRecorder recorder;
+
+    sim.script("+GSN", "ERROR");
+    sim.script("+CBC", "");
+    IS_TRUE(engine.send("+CSQ", "+CSQ:", 1000, AtRecorder::onResult, &recorder));
+    IS_TRUE(engine.send("+GSN", "",      1000, AtRecorder::onResult, &recorder));
+    IS_TRUE(engine.send("+CBC", "+CBC:", 1000, AtRecorder::onResult, &recorder));
+    IS_TRUE(engine.send("+COPS?", "+COPS:", 1000, AtRecorder::onResult, &recorder));
+    IS_TRUE(engine.isQueued("+CBC"));
+    runEngine(engine, 5000);
+
+    IS_TRUE(engine.isIdle());
+    IS_TRUE(sim.commands.size() == 4);
+    IS_TRUE(sim.commands[0] == "+CSQ");
+    IS_TRUE(sim.commands[3] == "+COPS?");
+    IS_TRUE(recorder.results.size() == 4);
+    IS_TRUE(recorder.results[0] == AT_RESULT_OK);
+    IS_TRUE(recorder.responses[0].startsWith("+CSQ: " + String(sim.signalQuality)));
+    IS_TRUE(recorder.results[1] == AT_RESULT_ERROR);
+    IS_TRUE(recorder.results[2] == AT_RESULT_TIMEOUT);
+    IS_TRUE(recorder.results[3] == AT_RESULT_OK);
+    IS_TRUE(recorder.responses[3].indexOf(sim.operatorName) >= 0);
+    END_IT
+}
+
+int test_compound_command() {
+    IT("collects the info lines of all parts of a compound command");
+    Sim808Simulator sim;
+    MyAtEngine engine(sim);
+    AtRecorder recorder;
+
+    IS_TRUE(engine.send("+CSQ;+CBC;+COPS?", "+CSQ:;+CBC:;+COPS:", 1000, AtRecorder::onResult, &recorder));
+    IS_TRUE(engine.isQueued("+CBC"));
+    IS_FALSE(engine.isQueued("+CB"));
+    runEngine(engine, 2000);
+
+    IS_TRUE(sim.atLines == 1);
+    IS_TRUE(recorder.results.size() == 1);
+    IS_TRUE(recorder.results[0] == AT_RESULT_OK);
+    IS_TRUE(MyAtEngine::infoLine(recorder.responses[0], "+CSQ:") == "+CSQ: " + String(sim.signalQuality) + ",0");
+    IS_TRUE(MyAtEngine::infoLine(recorder.responses[0], "+CBC:").startsWith("+CBC: 0,"));
+    IS_TRUE(MyAtEngine::infoLine(recorder.responses[0], "+COPS:").indexOf(sim.operatorName) >= 0);
+    IS_TRUE(MyAtEngine::infoLine(recorder.responses[0], "+CREG:") == "");
+
+    sim.script("+CBC", "ERROR");
+    IS_TRUE(engine.send("+CSQ;+CBC", "+CSQ:;+CBC:", 1000, AtRecorder::onResult, &recorder));
+    runEngine(engine, 2000);
+    IS_TRUE(recorder.results[1] == AT_RESULT_ERROR);
+    END_IT
+}
+
+int test_queue_full() {
+    IT("refuses commands if the queue is full");
+    Sim808Simulator sim;
+    MyAtEngine engine(sim);
+
+    for (int i = 0; i < AT_QUEUE_SIZE; i++) {
+        IS_TRUE(engine.send("+CSQ", "+CSQ:", 1000, NULL, NULL));
+    }
+    IS_FALSE(engine.send("+CSQ", "+CSQ:", 1000, NULL, NULL));
+    engine.clear();
+    IS_TRUE(engine.isIdle());
+    END_IT
+}
+
+int test_urc_in_command() {
+    IT("routes an urc which arrives in the middle of a command");
+    Sim808Simulator sim;
+    MyAtEngine engine(sim);
+    AtRecorder recorder;
+
+    sim.cnmi = "2,1";
+    sim.setLatency("+CBC", 500);
+    engine.onUrc("+CMTI:", AtRecorder::onUrc, &recorder);
+    IS_TRUE(engine.send("+CBC", "+CBC:", 1000, AtRecorder::onResult, &recorder));
+    engine.loop();
+    delay(100);
+    long index = sim.addSms("+41791234567", "Status");
+    runEngine(engine, 2000);
+
+    IS_TRUE(recorder.urcs.size() == 1);
+    IS_TRUE(recorder.urcs[0] == "+CMTI: \"SM\"," + String(index));
+    IS_TRUE(recorder.resultsAtUrc == 0);
+    IS_TRUE(recorder.results.size() == 1);
+    IS_TRUE(recorder.results[0] == AT_RESULT_OK);
+    IS_TRUE(recorder.responses[0].startsWith("+CBC:"));
+    IS_TRUE(recorder.responses[0].indexOf("CMTI") < 0);
+    END_IT
+}
+
+int test_sync_waits_for_async() {
+    IT("lets a synchronous call wait for the command in flight");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    AtRecorder recorder;
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.setLatency("+CBC", 300);
+    IS_TRUE(gsmGps.atEngine.send("+CBC", "+CBC:", 1000, AtRecorder::onResult, &recorder));
+    gsmGps.atEngine.loop();
+    IS_TRUE(gsmGps.gsmSim808.getSignalQuality() == sim.signalQuality);
+    IS_TRUE(recorder.results.size() == 1);
+    IS_TRUE(recorder.results[0] == AT_RESULT_OK);
+    IS_TRUE(recorder.responses[0].startsWith("+CBC:"));
+    END_IT
+}
+
+int test_socket_waits_for_async() {
+    IT("lets the socket maintenance wait for the command in flight");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    AtRecorder recorder;
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(gsmGps.gsmClient.connect("10.1.2.3", 1883));
+    IS_TRUE(gsmGps.gsmClient.available() == 0); // The next poll of the socket is in 500 ms.
+    sim.setLatency("+CBC", 300);
+    IS_TRUE(gsmGps.atEngine.send("+CBC", "+CBC:", 1000, AtRecorder::onResult, &recorder));
+    gsmGps.atEngine.loop();
+    delay(350);
+    IS_TRUE(gsmGps.gsmClient.available() == 0);
+    IS_TRUE(recorder.results.size() == 1);
+    IS_TRUE(recorder.results[0] == AT_RESULT_OK);
+    IS_TRUE(recorder.responses[0].startsWith("+CBC:"));
+    gsmGps.gsmClient.stop();
+    END_IT
+}
+
+int test_urc_in_sync_command() {
+    IT("routes an urc which arrives in a synchronous command");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    SmsData sms;
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.addSms("+41791234567", "Status");
+    IS_TRUE(gsmGps.gsmSim808.getSignalQuality() == sim.signalQuality);
+    IS_TRUE(gsmGps.readNewSMS(sms));
+    IS_TRUE(sms.message == "Status");
+    END_IT
+}
+
+int test_sms_while_waiting_for_gps() {
+    IT("handles a sms while the gps is still waiting for a fix");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MySmsCmd smsCmd(gsmGps, myOptions, myData);
+
+    myOptions.phoneNumber = "+41791234567";
+    sim.setGpsColdStart(1000);
+    IS_TRUE(hostBegin(gsmGps, sim));
+    hostRun(gsmGps, 1000);
+    IS_TRUE(gsmGps.waitingForGps());
+
+    sim.addSms("+41791234567", "Gps");
+    for (int i = 0; i < 2000 && sim.sentSms.empty(); i++) {
+        gsmGps.handleClient();
+        smsCmd.handleClient();
+        delay(1);
+    }
+    IS_TRUE(gsmGps.waitingForGps());
+    IS_TRUE(sim.sms.empty());
+    IS_TRUE(sim.sentSms.size() == 1);
+    IS_TRUE(sim.sentSms[0].message == "No Gps position.\n");
+    END_IT
+}
+
+int test_pdp_deactivation() {
+    IT("reconnects the gprs after a pdp deactivation urc");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.clearStatistics();
+    sim.ipUp = false;
+    sim.sendUrc("+PDP: DEACT");
+    hostRun(gsmGps, 1000);
+    IS_TRUE(sim.count("+CIICR") == 1);
+    IS_TRUE(sim.ipUp);
+    END_IT
+}
+
+int main()
+{
+    SUITE("AtEngine");
+    test_queue_order_and_results();
+    test_compound_command();
+    test_queue_full();
+    test_urc_in_command();
+    test_sync_waits_for_async();
+    test_socket_waits_for_async();
+    test_urc_in_sync_command();
+    test_sms_while_waiting_for_gps();
+    test_pdp_deactivation();
+    FINISH
+}
@@ -0,0 +1,157 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#include <math.h>
+
+
+#define SIM_NOISE_V    0.02  //!< Noise of the adc on the rest voltage.
+#define SIM_ACTIVE_MA  20.0  //!< Current of the awake esp8266.
+
+/** Synthetic battery of a discharge simulation. */
+struct SimBattery {
+    const char *name;
+    const char *curve;          //!< True rest voltage curve of the battery.
+    double      soc;            //!< True state of charge in percent.
+    double      mAhPerDay;      //!< True consumption per day.
+    double      ledgerFactor;   //!< Consumption of the energy ledger per true consumption.
+};
+
+/** Rest voltage of a state of charge on a curve, the inverse of MyBattery::getVoltageSoc. */
+double curveVoltage(const String &curve, double soc)
+{
+    double low  = 10.0;
+    double high = 15.0;
+
+    for (int i = 0; i < 40; i++) {
+        double voltage = (low + high) / 2.0;
+
+        if (MyBattery::getVoltageSoc(curve, voltage) < soc) {
+            low = voltage;
+        } else {
+            high = voltage;
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+/** Discharges the battery with one wake per hour and updates the estimator with the noisy
+  * rest voltage and the energy ledger at the start of the wake. The consumption is the awake
+  * time of the esp8266. Returns the biggest error of the state of charge.
+  */
+double discharge(MyBattery &battery, SimBattery &sim, int days)
+{
+    MyEnergy &energy   = myData.rtcData.energy;
+    double    maxError = 0.0;
+    long      awakeSec = sim.mAhPerDay / 24.0 / SIM_ACTIVE_MA * 3600.0;
+
+    for (int i = 0; i < ENERGY_COUNT; i++) {
+        myOptions.energyMa[i] = 0.0;
+    }
+    myOptions.energyMa[ENERGY_ESP_ACTIVE] = SIM_ACTIVE_MA * sim.ledgerFactor;
+    for (int hour = 0; hour < days * 24; hour++) {
+        double noise = SIM_NOISE_V * (rand() % 201 - 100) / 100.0;
+
+        energy.wakeUp();
+        battery.update(myOptions, curveVoltage(sim.curve, sim.soc) + noise, myData.getPowerConsumption(myOptions));
+        maxError = max(maxError, fabs(battery.getSoc() - sim.soc));
+        delay(awakeSec * 1000L);
+        energy.deepSleep(3600 - awakeSec);
+        myData.rtcData.deepSleepTimeSec += 3600 - awakeSec;
+        sim.soc = max(0.0, sim.soc - 100.0 * sim.mAhPerDay / 24.0 / myOptions.batteryCapacityMah);
+    }
+    TRACE("\n   " << sim.name << ": soc " << sim.soc << " %, estimate " << battery.getSoc() << " %, max error " <<
+          maxError << " %, " << battery.getMahPerDay() << " mAh/day, " << battery.getRuntimeDays(myOptions) << " days");
+    return maxError;
+}
+
+int test_voltage_curve() {
+    IT("interpolates the state of charge of the voltage curve");
+    String leadAcid = BATTERY_CURVE;
+    String lifepo4  = "12.0:0,12.8:10,13.1:30,13.25:70,13.3:90,13.6:100";
+
+    IS_TRUE(MyBattery::getVoltageSoc(leadAcid, 11.0) == 0.0);
+    IS_TRUE(fabs(MyBattery::getVoltageSoc(leadAcid, 12.1) - 37.5) < 0.01);
+    IS_TRUE(fabs(MyBattery::getVoltageSoc(leadAcid, 12.55) - 87.5) < 0.01);
+    IS_TRUE(MyBattery::getVoltageSoc(leadAcid, 14.4) == 100.0);
+    IS_TRUE(fabs(MyBattery::getVoltageSoc(lifepo4, 13.2) - 56.67) < 0.01);
+    IS_TRUE(fabs(curveVoltage(lifepo4, 80.0) - 13.275) < 0.001);
+    IS_TRUE(MyBattery::getVoltageSoc("", 12.0) == 0.0);
+    END_IT
+}
+
+int test_discharge() {
+    IT("follows synthetic discharge curves of lead acid and lithium batteries");
+    srand(1);
+
+    // The real curve differs a little from the configured one.
+    hostReset();
+    MyBattery  leadAcid;
+    SimBattery leadAcidSim = { "lead acid", "11.75:0,12.0:25,12.25:50,12.45:75,12.7:100", 95.0, 100.0, 1.0 };
+    delay(2000);
+    IS_FALSE(leadAcid.isValid());
+    IS_TRUE(leadAcid.getRuntimeDays(myOptions) < 0.0);
+    IS_TRUE(discharge(leadAcid, leadAcidSim, 50) < 10.0);
+    IS_TRUE(fabs(leadAcid.getSoc() - leadAcidSim.soc) < 5.0);
+    double runtimeDays = leadAcidSim.soc / 100.0 * myOptions.batteryCapacityMah / leadAcidSim.mAhPerDay;
+    IS_TRUE(fabs(leadAcid.getMahPerDay() - 100.0) < 1.0);
+    IS_TRUE(fabs(leadAcid.getRuntimeDays(myOptions) - runtimeDays) < runtimeDays * 0.1);
+
+    // The flat curve hides the charge, the ledger misses 30% of the consumption.
+    hostReset();
+    MyBattery  lithium;
+    SimBattery lithiumSim = { "lifepo4", "12.0:0,12.8:10,13.1:30,13.25:70,13.3:90,13.6:100", 90.0, 100.0, 0.7 };
+    myOptions.batteryCurve       = lithiumSim.curve;
+    myOptions.batteryCapacityMah = 5000.0;
+    delay(2000);
+    IS_TRUE(discharge(lithium, lithiumSim, 40) < 10.0);
+    IS_TRUE(fabs(lithium.getSoc() - lithiumSim.soc) < 10.0);
+    IS_TRUE(lithium.getRuntimeDays(myOptions) > 0.0);
+
+    String json = lithium.getJson(myOptions);
+    IS_TRUE(json.startsWith("{\"soc\":"));
+    IS_TRUE(json.indexOf("\"runtimeDays\":") > 0);
+    END_IT
+}
+
+int test_duty_cycle_and_charge() {
+    IT("follows a new duty cycle and a charge and stretches the scheduler interval");
+    hostReset();
+    MyBattery   battery;
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    SimBattery  sim = { "lead acid", BATTERY_CURVE, 80.0, 100.0, 1.0 };
+    srand(2);
+    delay(2000);
+
+    discharge(battery, sim, 5);
+    sim.name      = "four times the wakes";
+    sim.mAhPerDay = 400.0;
+    discharge(battery, sim, 4);
+    IS_TRUE(fabs(battery.getMahPerDay() - 400.0) < 40.0);
+
+    // Charged at home, the ledger sees nothing of it.
+    sim.name = "charged";
+    sim.soc  = 100.0;
+    discharge(battery, sim, 2);
+    IS_TRUE(fabs(battery.getSoc() - sim.soc) < 5.0);
+
+    myOptions.isSchedulerEnabled = true;
+    myData.rtcData.battery       = battery;
+    myData.voltage               = 12.0;
+    scheduler.update();
+    long wakeSec = scheduler.getWakeSec();
+    myOptions.batteryCapacityMah = 2000.0;
+    IS_TRUE(myData.rtcData.battery.getRuntimeDays(myOptions) < SCHEDULER_RESERVE_DAYS);
+    scheduler.update();
+    IS_TRUE(scheduler.getWakeSec() == 2 * wakeSec);
+    END_IT
+}
+
+int main()
+{
+    SUITE("Battery");
+    test_voltage_curve();
+    test_discharge();
+    test_duty_cycle_and_charge();
+    FINISH
+}
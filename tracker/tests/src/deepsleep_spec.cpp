@@ -0,0 +1,234 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+/** Low power options with a power check every 5 minutes and a modem wake every hour. */
+void setupLowPower()
+{
+   hostReset();
+   myOptions.isDeepSleepEnabled    = true;
+   myOptions.powerSaveModeVoltage  = 12.0;
+   myOptions.powerCheckIntervalSec = 300;
+   myOptions.deepSleepTimeSec      = 3600;
+   delay((NO_DEEP_SLEEP_STARTUP_TIME + 10) * 1000L);
+   setAnalogValue(390); // 11.7 V
+}
+
+/** The esp8266 wakes from the deep sleep with the RAM lost. */
+void wake()
+{
+   myData.rtcData    = MyData::RtcData();
+   myData.isLowPower = false;
+}
+
+int test_fast_sleep() {
+    IT("goes back to sleep from the rtc memory and one adc read until the modem wake");
+    setupLowPower();
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    MyDeepSleep deepSleep(myOptions, myData, scheduler);
+    MyVoltage   voltage(myOptions, myData);
+    long        sleeps;
+    long        reads;
+
+    voltage.begin();
+    IS_TRUE(myData.isLowPower);
+    deepSleep.sleep();
+    IS_TRUE(ESP.deepSleepUs == 300 * 1000000ULL);
+
+    sleeps = ESP.deepSleepCount;
+    reads  = getAnalogReads();
+    for (int i = 0; i < 20 && ESP.deepSleepCount == sleeps + i; i++) {
+       wake();
+       deepSleep.fastSleep();
+    }
+    IS_TRUE(ESP.deepSleepCount - sleeps == 11);
+    IS_TRUE(getAnalogReads() - reads == 12);
+    IS_TRUE(myData.rtcData.fastSleepCount == 11);
+    IS_TRUE(myData.rtcData.deepSleepTimeSec == 12 * 300);
+    IS_TRUE(myData.rtcData.energy.getSec(ENERGY_DEEP_SLEEP) == 12 * 300);
+
+    // Full start: the modem wake is due.
+    IS_TRUE(myData.secondsSincePowerOn() - myData.rtcData.deepSleepStartSec >= myOptions.deepSleepTimeSec);
+    deepSleep.sleep();
+    sleeps = ESP.deepSleepCount;
+
+    // Within the hysteresis it stays asleep, above it starts.
+    setAnalogValue(403); // 12.09 V
+    wake();
+    deepSleep.fastSleep();
+    IS_TRUE(ESP.deepSleepCount == sleeps + 1);
+    setAnalogValue(410); // 12.3 V
+    wake();
+    deepSleep.fastSleep();
+    IS_TRUE(ESP.deepSleepCount == sleeps + 1);
+
+    // The full start switches the fast path off until the next sleep.
+    deepSleep.begin();
+    setAnalogValue(390);
+    wake();
+    deepSleep.fastSleep();
+    IS_TRUE(ESP.deepSleepCount == sleeps + 1);
+    END_IT
+}
+
+int test_fast_sleep_benchmark() {
+    IT("measures the awake time of the fast path against the full start");
+    setupLowPower();
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    MyDeepSleep deepSleep(myOptions, myData, scheduler);
+    MyVoltage   voltage(myOptions, myData);
+    uint64_t    fullUs;
+    uint64_t    fastUs;
+
+    myOptions.save();
+    voltage.begin();
+    deepSleep.sleep();
+
+    // setup() without the fast path: the voltage is still low, the modem wake is not due.
+    wake();
+    Serial.begin(115200);
+    delay(1000);
+    SPIFFS.begin();
+    myOptions.load();
+    voltage.begin();
+    deepSleep.begin();
+    fullUs = ESP.awakeUs;
+
+    wake();
+    deepSleep.fastSleep();
+    fastUs = ESP.awakeUs;
+
+    TRACE("\n   full start " << fullUs / 1000 << " ms, fast path " << fastUs / 1000 << " ms\n");
+    IS_TRUE(fullUs >= 1000000);
+    IS_TRUE(fastUs < 100000);
+    IS_TRUE(myData.rtcData.fastSleepUs == (long) fastUs);
+    END_IT
+}
+
+int test_wifi_wake() {
+    IT("switches the radio off for the timer wakes and keeps it on for a wifi request");
+    setupLowPower();
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    MyDeepSleep deepSleep(myOptions, myData, scheduler);
+    MyVoltage   voltage(myOptions, myData);
+    long        sleeps;
+
+    ESP.resetInfo.reason = REASON_DEFAULT_RST;
+    IS_TRUE(deepSleep.isWifiWake());
+    IS_TRUE(deepSleep.isRfAvailable());
+    voltage.begin();
+    deepSleep.sleep();
+    IS_TRUE(ESP.deepSleepMode == WAKE_RF_DISABLED);
+
+    wake();
+    setAnalogValue(410);
+    deepSleep.fastSleep();
+    deepSleep.begin();
+    IS_TRUE(deepSleep.isTimerWake());
+    IS_FALSE(deepSleep.isWifiWake());
+    IS_FALSE(deepSleep.isRfAvailable());
+
+    // Sms or button: the next wake starts the WiFi even with a low voltage.
+    myData.rtcData.isWifiRequested = true;
+    deepSleep.sleep();
+    IS_TRUE(ESP.deepSleepMode == WAKE_RF_DEFAULT);
+    sleeps = ESP.deepSleepCount;
+    wake();
+    setAnalogValue(390);
+    deepSleep.fastSleep();
+    IS_TRUE(ESP.deepSleepCount == sleeps);
+    deepSleep.begin();
+    IS_TRUE(deepSleep.isWifiWake());
+    IS_TRUE(deepSleep.isRfAvailable());
+
+    // Without a deep sleep the esp8266 restarts for the WiFi.
+    myData.rtcData.isWifiRequested = false;
+    deepSleep.restartWithWifi();
+    IS_TRUE(ESP.deepSleepUs == 1000000);
+    IS_TRUE(ESP.deepSleepMode == WAKE_RF_DEFAULT);
+    wake();
+    deepSleep.begin();
+    IS_TRUE(deepSleep.isWifiWake());
+    END_IT
+}
+
+int test_sleep_hops() {
+    IT("chains hops of the esp8266 timer for a power check interval longer than one hour");
+    setupLowPower();
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    MyDeepSleep deepSleep(myOptions, myData, scheduler);
+    MyVoltage   voltage(myOptions, myData);
+    long        sleeps;
+    long        reads;
+    uint64_t    hopsUs;
+
+    myOptions.powerCheckIntervalSec = 12600; // 3.5 h
+    myOptions.deepSleepTimeSec      = 86400;
+    voltage.begin();
+    deepSleep.sleep();
+    IS_TRUE(ESP.deepSleepUs == MAX_DEEP_SLEEP_HOP_SEC * 1000000ULL);
+    IS_TRUE(ESP.deepSleepMode == WAKE_RF_DISABLED);
+    IS_TRUE(myData.rtcData.sleepRemainingSec == 12600 - MAX_DEEP_SLEEP_HOP_SEC);
+
+    sleeps = ESP.deepSleepCount;
+    reads  = getAnalogReads();
+    hopsUs = ESP.deepSleepUs;
+    for (int i = 0; i < 3; i++) {
+       wake();
+       deepSleep.fastSleep();
+       hopsUs += ESP.deepSleepUs;
+    }
+    IS_TRUE(ESP.deepSleepCount == sleeps + 3);
+    IS_TRUE(getAnalogReads() == reads);
+    IS_TRUE(hopsUs == 12600 * 1000000ULL);
+    IS_TRUE(myData.rtcData.sleepRemainingSec == 0);
+    IS_TRUE(myData.rtcData.deepSleepTimeSec == 12600);
+    IS_TRUE(myData.rtcData.energy.getSec(ENERGY_DEEP_SLEEP) == 12600);
+
+    // End of the interval: the voltage check of the fast path.
+    wake();
+    deepSleep.fastSleep();
+    IS_TRUE(getAnalogReads() == reads + 1);
+    IS_TRUE(ESP.deepSleepCount == sleeps + 4);
+    IS_TRUE(myData.rtcData.sleepRemainingSec == 12600 - MAX_DEEP_SLEEP_HOP_SEC);
+
+    // A reset between the hops starts the system.
+    ESP.resetInfo.reason = REASON_EXT_SYS_RST;
+    wake();
+    deepSleep.fastSleep();
+    IS_TRUE(ESP.deepSleepCount == sleeps + 4);
+    deepSleep.begin();
+    IS_TRUE(myData.rtcData.sleepRemainingSec == 0);
+    END_IT
+}
+
+int test_hop_microseconds() {
+    IT("passes the microseconds of hops longer than 2147 sec without an overflow");
+    setupLowPower();
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    MyDeepSleep deepSleep(myOptions, myData, scheduler);
+    MyVoltage   voltage(myOptions, myData);
+    long        hopSec[] = { 2147, 2148, MAX_DEEP_SLEEP_HOP_SEC };
+
+    voltage.begin();
+    for (int i = 0; i < 3; i++) {
+       myOptions.powerCheckIntervalSec = hopSec[i];
+       deepSleep.sleep();
+       IS_TRUE(ESP.deepSleepUs == (uint64_t) hopSec[i] * 1000000ULL);
+       IS_TRUE(myData.rtcData.sleepRemainingSec == 0);
+       wake();
+    }
+    END_IT
+}
+
+int main()
+{
+    SUITE("DeepSleep");
+    test_fast_sleep();
+    test_fast_sleep_benchmark();
+    test_wifi_wake();
+    test_sleep_hops();
+    test_hop_microseconds();
+    FINISH
+}
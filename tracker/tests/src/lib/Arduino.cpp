@@ -0,0 +1,140 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Arduino.cpp
+  *
+  * Minimal host replacement of the Arduino core with a virtual clock.
+  */
+
+#include "Arduino.h"
+
+static unsigned long long g_micros = 0; //!< The virtual clock in microseconds.
+static bool               g_trace  = getenv("TRACE") != NULL; //!< Write the debug output?
+
+HardwareSerial Serial;
+EspClass       ESP;
+
+static uint8_t g_rtcMemory[512]; //!< RTC user memory of the esp8266, offsets in 4 byte blocks.
+
+unsigned long millis()
+{
+   return g_micros / 1000;
+}
+
+unsigned long micros()
+{
+   return g_micros;
+}
+
+void delay(unsigned long ms)
+{
+   g_micros += ms * 1000ULL;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+   g_micros += us;
+}
+
+void advanceMicros(unsigned long us)
+{
+   g_micros += us;
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+   return LOW;
+}
+
+static int  g_analogValue = 0; //!< Value of the analog input.
+static long g_analogReads = 0; //!< Number of analogRead calls.
+
+int analogRead(uint8_t pin)
+{
+   g_analogReads++;
+   return g_analogValue;
+}
+
+void setAnalogValue(int value)
+{
+   g_analogValue = value;
+}
+
+long getAnalogReads()
+{
+   return g_analogReads;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+   if (g_trace) {
+      fputc(c, stdout);
+      if (c == '\n') {
+         fflush(stdout);
+      }
+   }
+   return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+   if (g_trace) {
+      fwrite(buffer, 1, size, stdout);
+      fflush(stdout);
+   }
+   return size;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+{
+   if (offset * 4 + size > sizeof(g_rtcMemory)) {
+      return false;
+   }
+   memcpy(data, g_rtcMemory + offset * 4, size);
+   return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+   if (offset * 4 + size > sizeof(g_rtcMemory)) {
+      return false;
+   }
+   memcpy(g_rtcMemory + offset * 4, data, size);
+   return true;
+}
+
+void EspClass::deepSleep(uint64_t timeUs, RFMode mode)
+{
+   deepSleepCount++;
+   deepSleepUs      = timeUs;
+   deepSleepMode    = mode;
+   awakeUs          = g_micros;
+   resetInfo.reason = REASON_DEEP_SLEEP_AWAKE;
+   g_micros         = 0;
+}
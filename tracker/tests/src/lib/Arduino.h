@@ -0,0 +1,158 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Arduino.h
+  *
+  * Minimal host replacement of the Arduino core with a virtual clock.
+  */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <algorithm>
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+typedef uint8_t byte;    //!< Arduino byte type.
+typedef bool    boolean; //!< Arduino boolean type.
+
+using std::min;
+using std::max;
+
+#define PROGMEM                                   //!< No flash memory on the host.
+#define pgm_read_byte_near(x) (*(const uint8_t *)(x)) //!< Direct memory read on the host.
+
+#define PI         3.1415926535897932384626433832795 //!< Pi
+#define HALF_PI    1.5707963267948966192313216916398 //!< Pi / 2
+#define TWO_PI     6.283185307179586476925286766559  //!< Pi * 2
+#define DEG_TO_RAD 0.017453292519943295769236907684886 //!< Degree to radian factor
+#define RAD_TO_DEG 57.295779513082320876798154814105   //!< Radian to degree factor
+
+#define radians(deg) ((deg) * DEG_TO_RAD) //!< Degree to radian conversion
+#define degrees(rad) ((rad) * RAD_TO_DEG) //!< Radian to degree conversion
+#define sq(x)        ((x) * (x))          //!< Square of x
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt))) //!< Limits a value to a range
+
+#define INPUT  0x00 //!< Pin mode input
+#define OUTPUT 0x01 //!< Pin mode output
+#define LOW    0x00 //!< Pin level low
+#define HIGH   0x01 //!< Pin level high
+#define A0     17   //!< Analog input of the esp8266
+
+/* The host runs on a virtual clock. Waiting only advances the clock, so the
+ * tests run independent of the real time and are reproducible. */
+unsigned long millis();
+unsigned long micros();
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+void          yield();
+
+/** Host only: Advances the virtual clock without calling any code. */
+void          advanceMicros(unsigned long us);
+
+void          pinMode(uint8_t pin, uint8_t mode);
+void          digitalWrite(uint8_t pin, uint8_t value);
+int           digitalRead(uint8_t pin);
+int           analogRead(uint8_t pin);
+
+/** Host only: Sets the value of the next analogRead calls and counts the reads. */
+void          setAnalogValue(int value);
+long          getAnalogReads();
+
+/**
+  * Debug output of the host. It is only written to stdout if the
+  * environment variable TRACE is set like in the PubSubClient tests.
+  */
+class HardwareSerial : public Stream
+{
+public:
+   void begin(unsigned long baud) {}
+
+   virtual int    available() { return 0; }
+   virtual int    read()      { return -1; }
+   virtual int    peek()      { return -1; }
+   virtual size_t write(uint8_t c);
+   virtual size_t write(const uint8_t *buffer, size_t size);
+};
+
+extern HardwareSerial Serial; //!< Debug output of the host.
+
+/** Radio mode of the esp8266 after the deep sleep. */
+enum RFMode {
+   RF_DEFAULT  = 0, //!< Calibration depends on the init data.
+   RF_CAL      = 1, //!< Calibration on every wake.
+   RF_NO_CAL   = 2, //!< No calibration.
+   RF_DISABLED = 4  //!< Radio switched off.
+};
+
+#define WAKE_RF_DEFAULT  RF_DEFAULT  //!< Deep sleep mode names of the esp8266 core
+#define WAKE_RFCAL       RF_CAL      //!< Deep sleep mode names of the esp8266 core
+#define WAKE_NO_RFCAL    RF_NO_CAL   //!< Deep sleep mode names of the esp8266 core
+#define WAKE_RF_DISABLED RF_DISABLED //!< Deep sleep mode names of the esp8266 core
+
+/** Reset reasons of the esp8266. */
+enum rst_reason {
+   REASON_DEFAULT_RST      = 0, //!< Power on.
+   REASON_WDT_RST          = 1, //!< Hardware watchdog.
+   REASON_EXCEPTION_RST    = 2, //!< Exception.
+   REASON_SOFT_WDT_RST     = 3, //!< Software watchdog.
+   REASON_SOFT_RESTART     = 4, //!< ESP.restart().
+   REASON_DEEP_SLEEP_AWAKE = 5, //!< Wake from the deep sleep.
+   REASON_EXT_SYS_RST      = 6  //!< Reset pin.
+};
+
+/** Reset information of the esp8266. */
+struct rst_info {
+   uint32_t reason; //!< One of rst_reason.
+};
+
+/**
+  * esp8266 functions on the host. The RTC user memory survives the deep sleep 
+  * and the deep sleep restarts the virtual clock like the wake of the esp8266.
+  * Unlike on the esp8266 deepSleep returns, so the tests can check the state.
+  */
+class EspClass
+{
+public:
+   long     deepSleepCount; //!< Host only: Number of deep sleeps.
+   uint64_t deepSleepUs;    //!< Host only: Time of the last deep sleep.
+   RFMode   deepSleepMode;  //!< Host only: Radio mode of the last deep sleep.
+   uint64_t awakeUs;        //!< Host only: Virtual time from the wake to the last deep sleep.
+   rst_info resetInfo;      //!< Reason of the last start, a deep sleep sets REASON_DEEP_SLEEP_AWAKE.
+
+public:
+   EspClass() : deepSleepCount(0), deepSleepUs(0), deepSleepMode(RF_DEFAULT), awakeUs(0) { resetInfo.reason = REASON_DEFAULT_RST; }
+
+   void      wdtFeed() {}
+   rst_info *getResetInfoPtr() { return &resetInfo; }
+   bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+   bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+   void deepSleep(uint64_t timeUs, RFMode mode = RF_DEFAULT);
+};
+
+extern EspClass ESP; //!< esp8266 functions of the host.
+
+#endif
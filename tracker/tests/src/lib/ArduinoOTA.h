@@ -0,0 +1,55 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file ArduinoOTA.h
+  *
+  * Host stub of the esp8266 ArduinoOTA which is only referenced by Utils.h.
+  */
+
+#ifndef ArduinoOTA_h
+#define ArduinoOTA_h
+
+#include <functional>
+
+/** Error codes of the ota update. */
+typedef enum {
+   OTA_AUTH_ERROR,
+   OTA_BEGIN_ERROR,
+   OTA_CONNECT_ERROR,
+   OTA_RECEIVE_ERROR,
+   OTA_END_ERROR
+} ota_error_t;
+
+/**
+  * Ota update stub without any function on the host.
+  */
+class ArduinoOTAClass
+{
+public:
+   void setHostname(const char *hostname) {}
+   void setPort(uint16_t port) {}
+   void onStart(std::function<void()> fn) {}
+   void onEnd(std::function<void()> fn) {}
+   void onProgress(std::function<void(unsigned int, unsigned int)> fn) {}
+   void onError(std::function<void(ota_error_t)> fn) {}
+   void begin() {}
+   void handle() {}
+};
+
+static ArduinoOTAClass ArduinoOTA; //!< The global ota stub.
+
+#endif
@@ -0,0 +1,138 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file FS.cpp
+  *
+  * Host replacement of the esp8266 SPIFFS file system in memory.
+  */
+
+#include "FS.h"
+
+FS SPIFFS;
+
+File::File(std::string *content, size_t pos, bool canWrite)
+   : handle(new Handle())
+{
+   handle->content  = content;
+   handle->pos      = pos;
+   handle->canWrite = canWrite;
+}
+
+int File::available()
+{
+   if (!*this) {
+      return 0;
+   }
+   return handle->content->size() - handle->pos;
+}
+
+int File::read()
+{
+   if (!available()) {
+      return -1;
+   }
+   return (uint8_t) (*handle->content)[handle->pos++];
+}
+
+int File::peek()
+{
+   if (!available()) {
+      return -1;
+   }
+   return (uint8_t) (*handle->content)[handle->pos];
+}
+
+size_t File::write(uint8_t c)
+{
+   return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+   if (!*this || !handle->canWrite) {
+      return 0;
+   }
+   handle->content->replace(handle->pos, size, (const char *) buf, size);
+   handle->pos += size;
+   return size;
+}
+
+bool File::seek(uint32_t pos)
+{
+   if (!*this || pos > handle->content->size()) {
+      return false;
+   }
+   handle->pos = pos;
+   return true;
+}
+
+size_t File::position() const
+{
+   return *this ? handle->pos : 0;
+}
+
+size_t File::size() const
+{
+   return *this ? handle->content->size() : 0;
+}
+
+void File::close()
+{
+   handle.reset();
+}
+
+/** Opens a file with the fopen modes "r", "w", "a" and their "+" variants. */
+File FS::open(const String &path, const char *mode)
+{
+   std::string name = path.c_str();
+   bool        plus = strchr(mode, '+') != NULL;
+
+   if (mode[0] == 'r') {
+      if (files.find(name) == files.end()) {
+         return File();
+      }
+      return File(&files[name], 0, plus);
+   } else if (mode[0] == 'w') {
+      files[name].clear();
+      return File(&files[name], 0, true);
+   } else if (mode[0] == 'a') {
+      return File(&files[name], files[name].size(), true);
+   }
+   return File();
+}
+
+bool FS::exists(const String &path)
+{
+   return files.find(path.c_str()) != files.end();
+}
+
+bool FS::remove(const String &path)
+{
+   return files.erase(path.c_str()) > 0;
+}
+
+bool FS::rename(const String &pathFrom, const String &pathTo)
+{
+   std::map<std::string, std::string>::iterator it = files.find(pathFrom.c_str());
+
+   if (it == files.end() || exists(pathTo)) {
+      return false;
+   }
+   files[pathTo.c_str()] = it->second;
+   files.erase(pathFrom.c_str());
+   return true;
+}
@@ -0,0 +1,89 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file FS.h
+  *
+  * Host replacement of the esp8266 SPIFFS file system in memory.
+  */
+
+#ifndef FS_h
+#define FS_h
+
+#include <map>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+/**
+  * One open file of the memory file system.
+  * Copies share the same file position like the esp8266 File.
+  */
+class File : public Stream
+{
+protected:
+   struct Handle {
+      std::string *content;  //!< File content inside the file system.
+      size_t       pos;      //!< Current read or write position.
+      bool         canWrite; //!< Opened for writing?
+   };
+   std::shared_ptr<Handle> handle; //!< Shared handle, empty if the open failed.
+
+public:
+   File() {}
+   File(std::string *content, size_t pos, bool canWrite);
+
+   operator bool() const { return handle && handle->content; }
+
+   virtual int    available();
+   virtual int    read();
+   virtual int    peek();
+   virtual size_t write(uint8_t c);
+   virtual size_t write(const uint8_t *buf, size_t size);
+
+   using Print::write;
+
+   bool   seek(uint32_t pos);
+   size_t position() const;
+   size_t size() const;
+   void   close();
+};
+
+/**
+  * Memory file system with the SPIFFS interface.
+  */
+class FS
+{
+protected:
+   std::map<std::string, std::string> files; //!< File name and content.
+
+public:
+   bool begin()  { return true; }
+   void end()    {}
+   bool format() { files.clear(); return true; }
+
+   File open(const String &path, const char *mode);
+   bool exists(const String &path);
+   bool remove(const String &path);
+   bool rename(const String &pathFrom, const String &pathTo);
+
+   /** Host only: Direct access to the file content. */
+   std::string &content(const String &path) { return files[path.c_str()]; }
+};
+
+extern FS SPIFFS; //!< The global memory file system.
+
+#endif
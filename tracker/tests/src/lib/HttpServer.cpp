@@ -0,0 +1,68 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file HttpServer.cpp
+  *
+  * Http server stand-in for the +HTTPACTION posts of the simulator.
+  */
+
+#include "HttpServer.h"
+
+/** Constructor */
+HttpServer::HttpServer()
+   : status(200)
+   , failures(0)
+{
+}
+
+/** Handler to set with Sim808Simulator::setHttpHandler. */
+SimHttpHandler HttpServer::handler()
+{
+   return [this](const String &url, const String &contentType, const std::string &body) {
+      return post(url, contentType, body);
+   };
+}
+
+/** Records the post and returns the status code. */
+int HttpServer::post(const String &url, const String &contentType, const std::string &body)
+{
+   HttpRequest request;
+
+   request.url         = url;
+   request.contentType = contentType;
+   request.body        = body;
+   request.status      = status;
+   if (failures > 0) {
+      failures--;
+      request.status = 500;
+   }
+   requests.push_back(request);
+   return request.status;
+}
+
+/** Data of all successful posts one after the other. */
+std::string HttpServer::accepted()
+{
+   std::string ret;
+
+   for (size_t i = 0; i < requests.size(); i++) {
+      if (requests[i].status >= 200 && requests[i].status < 300) {
+         ret += requests[i].body;
+      }
+   }
+   return ret;
+}
@@ -0,0 +1,61 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file HttpServer.h
+  *
+  * Http server stand-in for the +HTTPACTION posts of the simulator.
+  */
+
+#ifndef HttpServer_h
+#define HttpServer_h
+
+#include <string>
+#include <vector>
+#include "Sim808Simulator.h"
+
+/**
+  * One post received by the server.
+  */
+class HttpRequest
+{
+public:
+   String      url;         //!< Url of the post.
+   String      contentType; //!< Content type of the post.
+   std::string body;        //!< Data of the post.
+   int         status;      //!< Answered status code.
+};
+
+/**
+  * Server which records every post and answers it with a configurable status.
+  */
+class HttpServer
+{
+public:
+   std::vector<HttpRequest> requests; //!< Every received post.
+   int                      status;   //!< Status code of the accepted posts.
+   int                      failures; //!< Number of posts to answer with 500.
+
+public:
+   HttpServer();
+
+   SimHttpHandler handler();
+   int            post(const String &url, const String &contentType, const std::string &body);
+
+   std::string    accepted();
+};
+
+#endif
@@ -0,0 +1,110 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file IPAddress.cpp
+  *
+  * Host replacement of the Arduino IPAddress class.
+  */
+
+#include "IPAddress.h"
+#include <string.h>
+
+IPAddress::IPAddress()
+{
+   memset(address, 0, sizeof(address));
+}
+
+IPAddress::IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth)
+{
+   address[0] = first;
+   address[1] = second;
+   address[2] = third;
+   address[3] = fourth;
+}
+
+IPAddress::IPAddress(uint32_t value)
+{
+   *this = value;
+}
+
+IPAddress::IPAddress(const uint8_t *value)
+{
+   *this = value;
+}
+
+/** Parses a dotted ip address. Returns false on a host name. */
+bool IPAddress::fromString(const char *str)
+{
+   uint8_t  parts[4];
+   int      part  = 0;
+   uint16_t acc   = 0;
+   bool     digit = false;
+
+   for (; *str; str++) {
+      char c = *str;
+
+      if (c >= '0' && c <= '9') {
+         acc   = acc * 10 + (c - '0');
+         digit = true;
+         if (acc > 255) {
+            return false;
+         }
+      } else if (c == '.' && digit && part < 3) {
+         parts[part++] = acc;
+         acc   = 0;
+         digit = false;
+      } else {
+         return false;
+      }
+   }
+   if (part != 3 || !digit) {
+      return false;
+   }
+   parts[3] = acc;
+   memcpy(address, parts, sizeof(address));
+   return true;
+}
+
+String IPAddress::toString() const
+{
+   return String(address[0]) + '.' + String(address[1]) + '.' + String(address[2]) + '.' + String(address[3]);
+}
+
+IPAddress::operator uint32_t() const
+{
+   uint32_t ret;
+
+   memcpy(&ret, address, sizeof(ret));
+   return ret;
+}
+
+bool IPAddress::operator == (const uint8_t *rhs) const
+{
+   return memcmp(address, rhs, sizeof(address)) == 0;
+}
+
+IPAddress &IPAddress::operator = (const uint8_t *value)
+{
+   memcpy(address, value, sizeof(address));
+   return *this;
+}
+
+IPAddress &IPAddress::operator = (uint32_t value)
+{
+   memcpy(address, &value, sizeof(address));
+   return *this;
+}
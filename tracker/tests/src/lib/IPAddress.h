@@ -0,0 +1,58 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file IPAddress.h
+  *
+  * Host replacement of the Arduino IPAddress class.
+  */
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+#include "WString.h"
+
+/**
+  * IPv4 address in network byte order like the esp8266 IPAddress.
+  */
+class IPAddress
+{
+protected:
+   uint8_t address[4]; //!< The four octets.
+
+public:
+   IPAddress();
+   IPAddress(uint8_t first, uint8_t second, uint8_t third, uint8_t fourth);
+   IPAddress(uint32_t value);
+   IPAddress(const uint8_t *value);
+
+   bool   fromString(const char *str);
+   bool   fromString(const String &str) { return fromString(str.c_str()); }
+   String toString() const;
+
+   operator uint32_t() const;
+   bool operator == (const IPAddress &rhs) const { return (uint32_t) *this == (uint32_t) rhs; }
+   bool operator == (const uint8_t *rhs) const;
+
+   uint8_t  operator [] (int index) const { return address[index]; }
+   uint8_t &operator [] (int index)       { return address[index]; }
+
+   IPAddress &operator = (const uint8_t *value);
+   IPAddress &operator = (uint32_t value);
+};
+
+#endif
@@ -0,0 +1,323 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file MqttBroker.cpp
+  *
+  * Minimal MQTT 3.1.1 broker stand-in for the simulated sockets.
+  */
+
+#include <algorithm>
+#include <string.h>
+#include "MqttBroker.h"
+
+/** Reads a length prefixed MQTT string at pos. */
+static String readMqttString(const std::string &body, size_t &pos)
+{
+   if (pos + 2 > body.size()) {
+      pos = body.size();
+      return String();
+   }
+
+   size_t len = ((uint8_t) body[pos] << 8) | (uint8_t) body[pos + 1];
+
+   pos += 2;
+   if (pos + len > body.size()) {
+      len = body.size() - pos;
+   }
+
+   std::string ret = body.substr(pos, len);
+
+   pos += len;
+   return String(ret);
+}
+
+/** Encodes a length prefixed MQTT string. */
+static std::string mqttString(const String &str)
+{
+   std::string ret;
+
+   ret += (char) (str.length() >> 8);
+   ret += (char) (str.length() & 0xFF);
+   ret += str.c_str();
+   return ret;
+}
+
+/** Constructor */
+MqttBroker::MqttBroker()
+   : disconnects(0)
+   , pings(0)
+   , connackCode(0)
+   , dropPubacks(0)
+   , closeAfter(-1)
+   , closeAfterConnack(-1)
+{
+}
+
+/** Accepts a new client connection. */
+SimEndpoint *MqttBroker::accept()
+{
+   return new MqttSession(*this);
+}
+
+/** Sets a retained message like a publish with retain flag from another client. */
+void MqttBroker::retain(const String &topic, const std::string &payload)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   if (payload.empty()) {
+      retained.erase(topic);
+   } else {
+      retained[topic] = payload;
+   }
+}
+
+/** Number of publishes on the topic. */
+int MqttBroker::count(const String &topic)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   int                         ret = 0;
+
+   for (size_t i = 0; i < published.size(); i++) {
+      if (published[i].topic == topic) {
+         ret++;
+      }
+   }
+   return ret;
+}
+
+/** Payload of the last publish on the topic. */
+std::string MqttBroker::lastPayload(const String &topic)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+
+   for (size_t i = published.size(); i > 0; i--) {
+      if (published[i - 1].topic == topic) {
+         return published[i - 1].payload;
+      }
+   }
+   return std::string();
+}
+
+/** Checks the topic against a filter with the '+' and '#' wildcards. */
+bool MqttBroker::matches(const String &filter, const String &topic)
+{
+   unsigned int f = 0;
+   unsigned int t = 0;
+
+   while (f < filter.length()) {
+      if (filter[f] == '#') {
+         return true;
+      }
+      if (filter[f] == '+') {
+         while (t < topic.length() && topic[t] != '/') {
+            t++;
+         }
+         f++;
+         continue;
+      }
+      if (t >= topic.length() || filter[f] != topic[t]) {
+         return false;
+      }
+      f++;
+      t++;
+   }
+   return t == topic.length();
+}
+
+/** Constructor */
+MqttSession::MqttSession(MqttBroker &mqttBroker)
+   : broker(mqttBroker)
+   , open(true)
+{
+}
+
+bool MqttSession::connected()
+{
+   std::lock_guard<std::mutex> lock(broker.mutex);
+
+   return open;
+}
+
+/** Receives the bytes of the client and handles every complete packet. */
+void MqttSession::write(const uint8_t *buf, size_t size)
+{
+   std::lock_guard<std::mutex> lock(broker.mutex);
+
+   in.append((const char *) buf, size);
+   while (open && in.size() >= 2) {
+      size_t len        = 0;
+      size_t pos        = 1;
+      int    multiplier = 1;
+
+      do {
+         if (pos >= in.size()) {
+            return; // Remaining length incomplete
+         }
+         len        += ((uint8_t) in[pos] & 0x7F) * multiplier;
+         multiplier *= 128;
+      } while ((uint8_t) in[pos++] & 0x80);
+
+      if (in.size() < pos + len) {
+         return; // Packet incomplete
+      }
+
+      uint8_t     header = in[0];
+      std::string body   = in.substr(pos, len);
+
+      in.erase(0, pos + len);
+      handlePacket(header, body);
+   }
+}
+
+size_t MqttSession::available()
+{
+   std::lock_guard<std::mutex> lock(broker.mutex);
+
+   return out.size();
+}
+
+size_t MqttSession::read(uint8_t *buf, size_t size)
+{
+   std::lock_guard<std::mutex> lock(broker.mutex);
+   size_t                      n = std::min(size, out.size());
+
+   memcpy(buf, out.data(), n);
+   out.erase(0, n);
+   return n;
+}
+
+void MqttSession::close()
+{
+   std::lock_guard<std::mutex> lock(broker.mutex);
+
+   open = false;
+}
+
+/** Queues one packet for the client. */
+void MqttSession::send(uint8_t header, const std::string &body)
+{
+   size_t len = body.size();
+
+   out += (char) header;
+   do {
+      uint8_t digit = len % 128;
+
+      len /= 128;
+      out += (char) (len > 0 ? digit | 0x80 : digit);
+   } while (len > 0);
+   out += body;
+}
+
+/** Queues a QoS 0 publish for the client. */
+void MqttSession::sendPublish(const String &topic, const std::string &payload, bool retainFlag)
+{
+   send(0x30 | (retainFlag ? 0x01 : 0x00), mqttString(topic) + payload);
+}
+
+/** Handles one complete packet of the client. */
+void MqttSession::handlePacket(uint8_t header, const std::string &body)
+{
+   size_t pos = 0;
+
+   switch (header & 0xF0) {
+   case 0x10: { // CONNECT
+      readMqttString(body, pos); // Protocol name
+      pos += 4;                  // Level, flags and keepalive
+      broker.clientIds.push_back(readMqttString(body, pos));
+      send(0x20, std::string("\x00", 1) + (char) broker.connackCode);
+      if (broker.connackCode != 0 || (broker.closeAfterConnack > 0 && --broker.closeAfterConnack == 0)) {
+         open = false;
+      }
+      break;
+   }
+   case 0x30: { // PUBLISH
+      MqttMessage msg;
+
+      msg.qos      = (header >> 1) & 0x03;
+      msg.retained = header & 0x01;
+      msg.dup      = header & 0x08;
+      msg.topic    = readMqttString(body, pos);
+      msg.msgId    = 0;
+      if (msg.qos > 0 && pos + 2 <= body.size()) {
+         msg.msgId = ((uint8_t) body[pos] << 8) | (uint8_t) body[pos + 1];
+         pos += 2;
+      }
+      msg.payload = body.substr(pos);
+      broker.published.push_back(msg);
+      if (msg.retained) {
+         if (msg.payload.empty()) {
+            broker.retained.erase(msg.topic);
+         } else {
+            broker.retained[msg.topic] = msg.payload;
+         }
+      }
+      if (msg.qos == 1) {
+         if (broker.dropPubacks > 0) {
+            broker.dropPubacks--;
+         } else {
+            send(0x40, std::string() + (char) (msg.msgId >> 8) + (char) (msg.msgId & 0xFF));
+         }
+      }
+      for (size_t i = 0; i < filters.size(); i++) {
+         if (MqttBroker::matches(filters[i], msg.topic)) {
+            sendPublish(msg.topic, msg.payload, false);
+            break;
+         }
+      }
+      if (broker.closeAfter > 0 && --broker.closeAfter == 0) {
+         open = false;
+      }
+      break;
+   }
+   case 0x80: { // SUBSCRIBE
+      std::string suback = body.substr(0, 2);
+      std::vector<String> newFilters;
+
+      pos = 2;
+      while (pos < body.size()) {
+         String filter = readMqttString(body, pos);
+
+         pos++; // Requested QoS
+         filters.push_back(filter);
+         newFilters.push_back(filter);
+         broker.subscriptions.push_back(filter);
+         suback += (char) 0x00;
+      }
+      send(0x90, suback);
+      for (std::map<String, std::string>::iterator it = broker.retained.begin(); it != broker.retained.end(); it++) {
+         for (size_t i = 0; i < newFilters.size(); i++) {
+            if (MqttBroker::matches(newFilters[i], it->first)) {
+               sendPublish(it->first, it->second, true);
+               break;
+            }
+         }
+      }
+      break;
+   }
+   case 0xA0: // UNSUBSCRIBE
+      send(0xB0, body.substr(0, 2));
+      break;
+   case 0xC0: // PINGREQ
+      broker.pings++;
+      send(0xD0, std::string());
+      break;
+   case 0xE0: // DISCONNECT
+      broker.disconnects++;
+      open = false;
+      break;
+   }
+}
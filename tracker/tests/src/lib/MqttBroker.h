@@ -0,0 +1,104 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file MqttBroker.h
+  *
+  * Minimal MQTT 3.1.1 broker stand-in for the simulated sockets.
+  */
+
+#ifndef MqttBroker_h
+#define MqttBroker_h
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Sim808Simulator.h"
+
+/**
+  * One message published by a client.
+  */
+class MqttMessage
+{
+public:
+   String      topic;    //!< Topic of the message.
+   std::string payload;  //!< Payload of the message.
+   uint8_t     qos;      //!< QoS level 0 or 1.
+   bool        retained; //!< Retain flag.
+   bool        dup;      //!< Duplicate flag of a resent QoS 1 message.
+   uint16_t    msgId;    //!< Message id of a QoS 1 message.
+};
+
+/**
+  * Broker which understands the packets the PubSubClient sends.
+  * It records every publish, keeps the retained messages and delivers them
+  * on subscribe. Every accepted socket gets its own MqttSession.
+  */
+class MqttBroker
+{
+public:
+   std::mutex               mutex;          //!< Lock for sessions running in a server thread.
+   std::vector<MqttMessage> published;      //!< Every received publish.
+   std::map<String, std::string> retained;  //!< Retained messages per topic.
+   std::vector<String>      subscriptions;  //!< Every received topic filter.
+   std::vector<String>      clientIds;      //!< Client id of every connect.
+   int                      disconnects;    //!< Number of received DISCONNECT packets.
+   int                      pings;          //!< Number of received PINGREQ packets.
+   uint8_t                  connackCode;    //!< Return code of the CONNACK, 0 = accepted.
+   int                      dropPubacks;    //!< Number of PUBACKs to swallow.
+   int                      closeAfter;     //!< Close the socket after this number of publishes, -1 = never.
+   int                      closeAfterConnack; //!< Close the socket after the CONNACK of this number of connects, -1 = never.
+
+public:
+   MqttBroker();
+
+   SimEndpoint *accept();
+   void         retain(const String &topic, const std::string &payload);
+
+   int          count(const String &topic);
+   std::string  lastPayload(const String &topic);
+
+   static bool  matches(const String &filter, const String &topic);
+};
+
+/**
+  * Server side of one client connection.
+  */
+class MqttSession : public SimEndpoint
+{
+protected:
+   MqttBroker         &broker;   //!< The broker with the shared state.
+   std::string         in;       //!< Received bytes of the incomplete packet.
+   std::string         out;      //!< Bytes for the client.
+   std::vector<String> filters;  //!< Subscribed topic filters.
+   bool                open;     //!< Is the connection open?
+
+   void send(uint8_t header, const std::string &body);
+   void sendPublish(const String &topic, const std::string &payload, bool retainFlag);
+   void handlePacket(uint8_t header, const std::string &body);
+
+public:
+   MqttSession(MqttBroker &mqttBroker);
+
+   virtual bool   connected();
+   virtual void   write(const uint8_t *buf, size_t size);
+   virtual size_t available();
+   virtual size_t read(uint8_t *buf, size_t size);
+   virtual void   close();
+};
+
+#endif
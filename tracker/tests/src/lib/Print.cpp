@@ -0,0 +1,94 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Print.cpp
+  *
+  * Host replacement of the Arduino Print class.
+  */
+
+#include "Print.h"
+#include <string.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+   size_t n = 0;
+
+   while (size--) {
+      n += write(*buffer++);
+   }
+   return n;
+}
+
+size_t Print::write(const char *str)
+{
+   return str ? write((const uint8_t *) str, strlen(str)) : 0;
+}
+
+size_t Print::print(const __FlashStringHelper *str)
+{
+   return write((const char *) str);
+}
+
+size_t Print::print(const String &str)
+{
+   return write((const uint8_t *) str.c_str(), str.length());
+}
+
+size_t Print::print(const char *str)
+{
+   return write(str);
+}
+
+size_t Print::print(char c)
+{
+   return write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+   return print(String(value, base));
+}
+
+size_t Print::print(int value, int base)
+{
+   return print(String(value, base));
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+   return print(String(value, base));
+}
+
+size_t Print::print(long value, int base)
+{
+   return print(String(value, base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+   return print(String(value, base));
+}
+
+size_t Print::print(double value, int digits)
+{
+   return print(String(value, digits));
+}
+
+size_t Print::println()
+{
+   return write("\r\n");
+}
@@ -0,0 +1,68 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Print.h
+  *
+  * Host replacement of the Arduino Print class.
+  */
+
+#ifndef Print_h
+#define Print_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WString.h"
+
+#define DEC 10 //!< Decimal print base.
+#define HEX 16 //!< Hexadecimal print base.
+#define OCT 8  //!< Octal print base.
+#define BIN 2  //!< Binary print base.
+
+/**
+  * Formatted output on top of the virtual write function.
+  */
+class Print
+{
+public:
+   virtual ~Print() {}
+
+   virtual size_t write(uint8_t c) = 0;
+   virtual size_t write(const uint8_t *buffer, size_t size);
+   size_t write(const char *str);
+   size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+
+   virtual void flush() {}
+
+   size_t print(const __FlashStringHelper *str);
+   size_t print(const String &str);
+   size_t print(const char *str);
+   size_t print(char c);
+   size_t print(unsigned char value, int base = DEC);
+   size_t print(int value, int base = DEC);
+   size_t print(unsigned int value, int base = DEC);
+   size_t print(long value, int base = DEC);
+   size_t print(unsigned long value, int base = DEC);
+   size_t print(double value, int digits = 2);
+
+   size_t println();
+   template <typename T>
+   size_t println(const T &value) { return print(value) + println(); }
+   template <typename T>
+   size_t println(const T &value, int format) { return print(value, format) + println(); }
+};
+
+#endif
@@ -0,0 +1,1078 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Sim808Simulator.cpp
+  *
+  * Host simulation of the SIM808 modul on the AT command level.
+  */
+
+#include <algorithm>
+#include "Sim808Simulator.h"
+
+/** Frames one answer line like the SIM808. */
+static std::string line(const String &text)
+{
+   return std::string("\r\n") + text.c_str() + "\r\n";
+}
+
+/** Great circle distance in meter like MyLocation::distanceBetween. */
+static double distanceBetween(double lat1, double lon1, double lat2, double lon2)
+{
+   double dLat = radians(lat2 - lat1);
+   double dLon = radians(lon2 - lon1);
+   double a    = sq(sin(dLat / 2)) + cos(radians(lat1)) * cos(radians(lat2)) * sq(sin(dLon / 2));
+
+   return 2 * atan2(sqrt(a), sqrt(1 - a)) * 6372795;
+}
+
+/** Returns the comma separated parameters after the '=' without quotes. */
+static std::vector<String> params(const String &cmd)
+{
+   std::vector<String> ret;
+   int                 idx     = cmd.indexOf('=');
+   bool                inQuote = false;
+   String              param;
+
+   if (idx == -1) {
+      return ret;
+   }
+   for (unsigned int i = idx + 1; i < cmd.length(); i++) {
+      char c = cmd[i];
+
+      if (c == '"') {
+         inQuote = !inQuote;
+      } else if (c == ',' && !inQuote) {
+         ret.push_back(param);
+         param = "";
+      } else {
+         param += c;
+      }
+   }
+   ret.push_back(param);
+   return ret;
+}
+
+/** Returns the parameter or an empty string. */
+static String param(const std::vector<String> &p, size_t idx)
+{
+   return idx < p.size() ? p[idx] : String();
+}
+
+/** Constructor */
+Sim808Simulator::Sim808Simulator()
+   : lastOutputUs(0)
+   , lastUpdateUs(0)
+   , byteUs(0)
+   , pendingBaud(0)
+   , hostSerial(NULL)
+   , inputMode(INPUT_COMMAND)
+   , inputSize(0)
+   , lastInput(0)
+   , lastInputUs(0)
+   , inputMux(0)
+   , trackIdx(0)
+   , gpsColdStart(0)
+   , gpsQueries(0)
+   , httpInit(false)
+   , hasGsmLocation(false)
+   , nextSmsIndex(1)
+   , echo(true)
+   , registration(1)
+   , simStatus("READY")
+   , signalQuality(18)
+   , batteryPercent(85)
+   , batteryMilliVolt(4050)
+   , imei("866782000000001")
+   , iccid("89410000000000000001")
+   , modemInfo("SIM808 R14.18")
+   , operatorName("Sim Operator")
+   , localIp("10.170.42.7")
+   , baud(9600)
+   , ipr(0)
+   , reliableBaud(0)
+   , sleepMode(0)
+   , gpsPower(false)
+   , gprsAttached(false)
+   , ipUp(false)
+   , quickSend(false)
+   , atLines(0)
+   , bytesIn(0)
+   , bytesOut(0)
+   , wakeUps(0)
+   , baudErrors(0)
+{
+   for (int mux = 0; mux < SIM_MUX_COUNT; mux++) {
+      sockets[mux].endpoint  = NULL;
+      sockets[mux].port      = 0;
+      sockets[mux].notified  = false;
+      sockets[mux].wasOpened = false;
+   }
+   setBaud(9600);
+
+   // Typical answer times of a SIM808 in ms.
+   latencies[""]            = 20;
+   latencies["+CGNSINF"]    = 50;
+   latencies["+CIPGSMLOC"]  = 3000;
+   latencies["+CFUN"]       = 300;
+   latencies["+SAPBR=1"]    = 1500;
+   latencies["+CGATT=1"]    = 500;
+   latencies["+CIICR"]      = 1000;
+   latencies["+CIPSHUT"]    = 200;
+   latencies["+CIPSTART"]   = 700;
+   latencies["+CIPSEND"]    = 50;
+   latencies["+CDNSGIP"]    = 600;
+   latencies["+CMGS"]       = 2500;
+   latencies["+HTTPACTION"] = 1500;
+}
+
+/** Destructor */
+Sim808Simulator::~Sim808Simulator()
+{
+   for (int mux = 0; mux < SIM_MUX_COUNT; mux++) {
+      closeSocket(mux);
+   }
+}
+
+/** Sets the baud rate of the serial line, 10 bits per byte. */
+void Sim808Simulator::setBaud(long rate)
+{
+   baud   = rate;
+   byteUs = 10000000UL / rate;
+}
+
+/** Connects the serial port of the tracker. Bytes with a different baud rate are garbled. */
+void Sim808Simulator::setHostSerial(const SoftwareSerial &serial)
+{
+   hostSerial = &serial;
+}
+
+/** Switches to the baud rate of the +IPR as soon as its answer is sent with the old one. */
+void Sim808Simulator::applyBaud()
+{
+   if (pendingBaud && output.empty()) {
+      setBaud(pendingBaud);
+      pendingBaud = 0;
+   }
+}
+
+/** Is the tracker using the baud rate of the modul? */
+bool Sim808Simulator::baudMatches()
+{
+   return !hostSerial || !hostSerial->baudRate() || hostSerial->baudRate() == baud;
+}
+
+/** Answer byte as the tracker receives it, garbled with a wrong or too high baud rate. */
+int Sim808Simulator::deliver(uint8_t c)
+{
+   if (!baudMatches() || (reliableBaud && baud > reliableBaud)) {
+      return c | 0x80;
+   }
+   return c;
+}
+
+/** Sets the latency of a command prefix like "+CGNSINF", "" is the default.
+  * For commands with a later result (+CIPSTART, +CDNSGIP, +CMGS) it is the
+  * time until this result.
+  */
+void Sim808Simulator::setLatency(const String &command, long ms)
+{
+   latencies[command] = ms;
+}
+
+/** Answers the next count commands starting with the command prefix with the
+  * given lines (separated by '\n') instead of the simulated answer.
+  * An empty response leaves the command unanswered.
+  */
+void Sim808Simulator::script(const String &command, const String &response, int count)
+{
+   Script s;
+
+   s.command  = command;
+   s.response = response;
+   s.count    = count;
+   scripts.push_back(s);
+}
+
+/** Sets the function which opens the server side of the sockets. */
+void Sim808Simulator::setConnector(SimConnector socketConnector)
+{
+   connector = socketConnector;
+}
+
+/** Sets the function which answers the http posts. */
+void Sim808Simulator::setHttpHandler(SimHttpHandler handler)
+{
+   httpHandler = handler;
+}
+
+/** Adds a host name to the dns of the simulated network. */
+void Sim808Simulator::addHost(const String &name, const String &ip)
+{
+   hosts[name] = ip;
+}
+
+/** Appends one position to the gps trajectory. */
+void Sim808Simulator::addGpsFix(const SimGpsFix &fix)
+{
+   track.push_back(fix);
+}
+
+/** Appends a straight trajectory from the first to the second position.
+  * The time of the first position is 'yyyyMMddhhmmss' and every step adds stepSec.
+  */
+void Sim808Simulator::addGpsTrack(double lat1, double lon1, double lat2, double lon2, int steps, const String &startTime, long stepSec)
+{
+   long   startSec = startTime.substring(8, 10).toInt() * 3600 + startTime.substring(10, 12).toInt() * 60 + startTime.substring(12, 14).toInt();
+   double distance = distanceBetween(lat1, lon1, lat2, lon2);
+
+   for (int i = 0; i < steps; i++) {
+      SimGpsFix fix;
+      double    f   = steps > 1 ? (double) i / (steps - 1) : 0.0;
+      long      sec = (startSec + i * stepSec) % 86400;
+      char      time[16];
+
+      snprintf(time, sizeof(time), "%02ld%02ld%02ld.000", sec / 3600, (sec / 60) % 60, sec % 60);
+      fix.latitude   = lat1 + (lat2 - lat1) * f;
+      fix.longitude  = lon1 + (lon2 - lon1) * f;
+      fix.altitude   = 400.0;
+      fix.speed      = steps > 1 && stepSec > 0 ? distance / (steps - 1) / stepSec * 3.6 : 0.0;
+      fix.course     = 0.0;
+      fix.satellites = 8;
+      fix.dateTime   = startTime.substring(0, 8) + time;
+      track.push_back(fix);
+   }
+}
+
+/** Number of +CGNSINF queries after the gps power on without a fix. */
+void Sim808Simulator::setGpsColdStart(int queries)
+{
+   gpsColdStart = queries;
+}
+
+/** Sets the cell tower position of the +CIPGSMLOC. Date 'yyyy/MM/dd', time 'hh:mm:ss'. */
+void Sim808Simulator::setGsmLocation(double latitude, double longitude, const String &date, const String &time)
+{
+   hasGsmLocation = true;
+   gsmLocation    = String(longitude, 6) + ',' + String(latitude, 6) + ',' + date + ',' + time;
+}
+
+/** Stores a received sms on the sim card and returns its index. */
+long Sim808Simulator::addSms(const String &phoneNumber, const String &message, const String &dateTime)
+{
+   SimSms s;
+
+   s.index       = nextSmsIndex++;
+   s.status      = "REC UNREAD";
+   s.phoneNumber = phoneNumber;
+   s.dateTime    = dateTime;
+   s.message     = message;
+   sms.push_back(s);
+   if (cnmi.length() > 0) {
+      sendUrc((String) "+CMTI: \"SM\"," + String(s.index));
+   }
+   return s.index;
+}
+
+/** Sends an unsolicited line like the modul does: at once or after the answer line 
+  * which is currently on the serial line. The rest of the pending answer follows the urc.
+  */
+void Sim808Simulator::sendUrc(const String &text)
+{
+   std::string        data = line(text);
+   unsigned long long now  = micros();
+   size_t             pos  = 0;
+
+   while (pos < output.size() && 
+          (output[pos].second <= now || (pos > 0 && output[pos - 1].first != '\n'))) {
+      pos++;
+   }
+   if (pos == output.size()) {
+      queue(data, 0);
+      return;
+   }
+
+   unsigned long long start = std::max(now, pos > 0 ? output[pos - 1].second : 0ULL);
+   unsigned long long end   = start + (data.size() + 1) * byteUs;
+   unsigned long long shift = end > output[pos].second ? end - output[pos].second : 0;
+
+   for (size_t i = pos; i < output.size(); i++) {
+      output[i].second += shift;
+   }
+   lastOutputUs += shift;
+   for (size_t i = 0; i < data.size(); i++) {
+      start += byteUs;
+      output.insert(output.begin() + pos + i, std::make_pair((uint8_t) data[i], start));
+   }
+}
+
+/** Number of received commands which start with the command prefix. */
+int Sim808Simulator::count(const String &command)
+{
+   int ret = 0;
+
+   for (size_t i = 0; i < commands.size(); i++) {
+      if (commands[i].startsWith(command)) {
+         ret++;
+      }
+   }
+   return ret;
+}
+
+/** Resets the command log and the byte counters. */
+void Sim808Simulator::clearStatistics()
+{
+   commands.clear();
+   atLines  = 0;
+   bytesIn  = 0;
+   bytesOut = 0;
+   wakeUps  = 0;
+   baudErrors = 0;
+}
+
+/** Queues the answer bytes. They arrive after the delay with the baud rate. */
+void Sim808Simulator::queue(const std::string &data, long delayMs)
+{
+   unsigned long long start = micros() + delayMs * 1000ULL;
+
+   if (start < lastOutputUs) {
+      start = lastOutputUs;
+   }
+   for (size_t i = 0; i < data.size(); i++) {
+      start += byteUs;
+      output.push_back(std::make_pair((uint8_t) data[i], start));
+   }
+   lastOutputUs = start;
+}
+
+/** Sends the urcs of the sockets if the serial line is idle. */
+void Sim808Simulator::update()
+{
+   unsigned long long now = micros();
+
+   if (now == lastUpdateUs) {
+      return;
+   }
+   lastUpdateUs = now;
+   applyBaud();
+   if (!output.empty() || inputMode != INPUT_COMMAND || !inputLine.empty()) {
+      return;
+   }
+   for (int mux = 0; mux < SIM_MUX_COUNT; mux++) {
+      Socket &s = sockets[mux];
+
+      if (!s.endpoint) {
+         continue;
+      }
+      if (s.endpoint->available() > 0) {
+         if (!s.notified) {
+            s.notified = true;
+            queue(line((String) "+CIPRXGET: 1," + String(mux)), 0);
+         }
+      } else if (!s.endpoint->connected()) {
+         closeSocket(mux);
+         queue(line(String(mux) + F(", CLOSED")), 0);
+      }
+   }
+}
+
+/** Latency of the longest matching command prefix. */
+long Sim808Simulator::latencyFor(const String &command)
+{
+   long         ret = latencies[""];
+   unsigned int len = 0;
+
+   for (std::map<String, long>::iterator it = latencies.begin(); it != latencies.end(); it++) {
+      if (it->first.length() >= len && command.startsWith(it->first)) {
+         ret = it->second;
+         len = it->first.length();
+      }
+   }
+   return ret;
+}
+
+/** Returns the active script of the command or NULL. */
+Sim808Simulator::Script *Sim808Simulator::findScript(const String &command)
+{
+   for (size_t i = 0; i < scripts.size(); i++) {
+      if (scripts[i].count > 0 && command.startsWith(scripts[i].command)) {
+         return &scripts[i];
+      }
+   }
+   return NULL;
+}
+
+int Sim808Simulator::available()
+{
+   unsigned long long now   = micros();
+   int                count = 0;
+
+   update();
+   for (size_t i = 0; i < output.size() && output[i].second <= now; i++) {
+      count++;
+   }
+   return count;
+}
+
+int Sim808Simulator::read()
+{
+   update();
+   if (output.empty() || output.front().second > micros()) {
+      return -1;
+   }
+
+   uint8_t c = output.front().first;
+
+   output.pop_front();
+   bytesOut++;
+   return deliver(c);
+}
+
+int Sim808Simulator::peek()
+{
+   update();
+   if (output.empty() || output.front().second > micros()) {
+      return -1;
+   }
+   return deliver(output.front().first);
+}
+
+/** Receives one byte from the tracker. The transfer time elapses on the virtual clock. */
+size_t Sim808Simulator::write(uint8_t c)
+{
+   long hostBaud = hostSerial && hostSerial->baudRate() ? hostSerial->baudRate() : baud;
+
+   applyBaud();
+   advanceMicros(10000000UL / hostBaud);
+   bytesIn++;
+
+   unsigned long long now = micros();
+
+   if (sleepMode == 2 && now - lastInputUs > SIM_SLEEP_IDLE_MS * 1000ULL) {
+      lastInputUs = now; // The first character only wakes up the sleeping modul.
+      wakeUps++;
+      return 1;
+   }
+   lastInputUs = now;
+
+   if (!baudMatches()) {
+      if (ipr != 0) {
+         baudErrors++;
+         return 1;
+      }
+      setBaud(hostBaud); // Auto baud
+   }
+
+   if (inputMode != INPUT_COMMAND && c == '\n' && lastInput == '\r') {
+      lastInput = c; // Line end of the command line before the data.
+      return 1;
+   }
+   lastInput = c;
+
+   switch (inputMode) {
+   case INPUT_DATA:
+      inputData += (char) c;
+      if (inputData.size() >= inputSize) {
+         finishSend();
+      }
+      break;
+   case INPUT_HTTP:
+      inputData += (char) c;
+      if (inputData.size() >= inputSize) {
+         finishHttpData();
+      }
+      break;
+   case INPUT_SMS:
+      if (c == 0x1A) {
+         finishSms();
+      } else if (c == 0x1B) {
+         inputMode = INPUT_COMMAND;
+         queue(line(F("OK")), latencyFor(""));
+      } else {
+         inputData += (char) c;
+      }
+      break;
+   default:
+      if (echo) {
+         queue(std::string(1, (char) c), 0);
+      }
+      if (c == '\r') {
+         std::string cmdLine = inputLine;
+
+         inputLine.clear();
+         processLine(cmdLine);
+      } else if (c != '\n') {
+         inputLine += (char) c;
+      }
+      break;
+   }
+   return 1;
+}
+
+/** Processes one AT command line with all its compound commands. */
+void Sim808Simulator::processLine(const std::string &cmdLine)
+{
+   String text = cmdLine.c_str();
+
+   text.trim();
+   if (text.length() < 2 || !String(text.substring(0, 2)).equalsIgnoreCase(F("AT"))) {
+      return;
+   }
+   atLines++;
+
+   std::vector<String> cmds;
+   String              cmd;
+   bool                inQuote = false;
+
+   for (unsigned int i = 2; i < text.length(); i++) {
+      if (text[i] == '"') {
+         inQuote = !inQuote;
+      }
+      if (text[i] == ';' && !inQuote) {
+         cmds.push_back(cmd);
+         cmd = "";
+      } else {
+         cmd += text[i];
+      }
+   }
+   cmds.push_back(cmd);
+
+   std::string body;
+   std::string deferred;
+   long        delayMs    = 0;
+   long        deferredMs = 0;
+   int         result     = SIM_RESULT_OK;
+
+   for (size_t i = 0; i < cmds.size(); i++) {
+      Script *s = findScript(cmds[i]);
+
+      commands.push_back(cmds[i]);
+      if (s) {
+         String response = s->response;
+
+         s->count--;
+         if (response.length() > 0) {
+            response.replace(F("\n"), F("\r\n"));
+            queue(line(response), latencyFor(cmds[i]));
+         }
+         return;
+      }
+
+      std::string later;
+
+      result = processCommand(cmds[i], body, later);
+      if (!later.empty()) {
+         deferred  += later;
+         deferredMs = std::max(deferredMs, latencyFor(cmds[i]));
+         delayMs    = std::max(delayMs, latencyFor(""));
+      } else {
+         delayMs    = std::max(delayMs, latencyFor(cmds[i]));
+      }
+      if (result == SIM_RESULT_ERROR || inputMode != INPUT_COMMAND) {
+         break;
+      }
+   }
+
+   if (inputMode == INPUT_HTTP) {
+      queue(body + line(F("DOWNLOAD")), latencyFor(""));
+      return;
+   }
+   if (inputMode != INPUT_COMMAND) { // The latency of the command is used for the result after the data.
+      queue(body + "> ", latencyFor(""));
+      return;
+   }
+   if (result == SIM_RESULT_OK) {
+      body += line(F("OK"));
+   } else if (result == SIM_RESULT_ERROR) {
+      body = line(F("ERROR"));
+   }
+   queue(body, delayMs);
+   if (!deferred.empty()) {
+      queue(deferred, deferredMs);
+   }
+}
+
+/** Processes one command without the 'AT' and appends the answer lines to the body.
+  * Results which arrive later like '1, CONNECT OK' are appended to deferred.
+  */
+int Sim808Simulator::processCommand(const String &cmd, std::string &body, std::string &deferred)
+{
+   int result = SIM_RESULT_OK;
+
+   if (cmd.length() == 0 || cmd == F("&W")) {
+      // OK
+   } else if (cmd == F("E0") || cmd == F("E1")) {
+      echo = cmd == F("E1");
+   } else if (cmd.startsWith(F("&F")) || cmd == F("Z")) {
+      echo = cmd.indexOf(F("E0")) == -1;
+   } else if (cmd == F("I")) {
+      body += line(modemInfo);
+   } else if (cmd == F("+GSN")) {
+      body += line(imei);
+   } else if (cmd == F("+ICCID")) {
+      body += line((String) "+ICCID: " + iccid);
+   } else if (cmd == F("+CCID")) {
+      body += line(iccid);
+   } else if (cmd == F("+CPIN?")) {
+      body += line((String) "+CPIN: " + simStatus);
+   } else if (cmd.startsWith(F("+CLTS="))) {
+      // OK
+   } else if (cmd.startsWith(F("+IPR="))) {
+      long rate = param(params(cmd), 0).toInt();
+
+      if (rate < 0 || (rate > 0 && (rate % 1200 != 0 || 460800 % rate != 0))) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         ipr         = rate;
+         pendingBaud = rate;
+      }
+   } else if (cmd == F("+IPR?")) {
+      body += line((String) "+IPR: " + String(ipr));
+   } else if (cmd.startsWith(F("+CFUN="))) {
+      if (cmd == F("+CFUN=1,1")) {
+         resetModem();
+      }
+   } else if (cmd.startsWith(F("+CSCLK="))) {
+      sleepMode = param(params(cmd), 0).toInt();
+   } else if (cmd == F("+CSQ")) {
+      body += line((String) "+CSQ: " + String(signalQuality) + F(",0"));
+   } else if (cmd == F("+CBC")) {
+      body += line((String) "+CBC: 0," + String(batteryPercent) + ',' + String(batteryMilliVolt));
+   } else if (cmd == F("+CREG?")) {
+      body += line((String) "+CREG: 0," + String(registration));
+   } else if (cmd == F("+COPS?")) {
+      body += line((String) "+COPS: 0,0,\"" + operatorName + '"');
+   } else if (!cmdNetwork(cmd, body, deferred, result) &&
+              !cmdSocket (cmd, body, deferred, result) &&
+              !cmdSms    (cmd, body, deferred, result) &&
+              !cmdGps    (cmd, body, deferred, result) &&
+              !cmdHttp   (cmd, body, deferred, result)) {
+      result = SIM_RESULT_ERROR;
+   }
+   return result;
+}
+
+/** Gprs bearer, ip connection and dns. */
+bool Sim808Simulator::cmdNetwork(const String &cmd, std::string &body, std::string &deferred, int &result)
+{
+   std::vector<String> p          = params(cmd);
+   bool                registered = registration == 1 || registration == 5;
+
+   if (cmd == F("+CIPSHUT")) {
+      for (int mux = 0; mux < SIM_MUX_COUNT; mux++) {
+         closeSocket(mux);
+      }
+      ipUp = false;
+      body += line(F("SHUT OK"));
+      result = SIM_RESULT_NONE;
+   } else if (cmd == F("+CGATT?")) {
+      body += line((String) "+CGATT: " + String(gprsAttached ? 1 : 0));
+   } else if (cmd.startsWith(F("+CGATT=")) || cmd.startsWith(F("+SAPBR=1,")) || cmd.startsWith(F("+SAPBR=0,"))) {
+      bool attach = param(p, 0) == "1";
+
+      if (attach && !registered) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         gprsAttached = attach;
+         if (!attach) {
+            for (int mux = 0; mux < SIM_MUX_COUNT; mux++) {
+               closeSocket(mux);
+            }
+            ipUp = false;
+         }
+      }
+   } else if (cmd.startsWith(F("+SAPBR=2,"))) {
+      body += line((String) "+SAPBR: 1," + (gprsAttached ? F("1,\"") : F("3,\"")) + (gprsAttached ? localIp : F("0.0.0.0")) + '"');
+   } else if (cmd.startsWith(F("+SAPBR=3,")) || cmd.startsWith(F("+CGDCONT=")) || cmd.startsWith(F("+CGACT=")) ||
+              cmd.startsWith(F("+CIPMUX=")) || cmd.startsWith(F("+CDNSCFG="))) {
+      // OK
+   } else if (cmd.startsWith(F("+CIPQSEND="))) {
+      quickSend = param(p, 0) == "1";
+   } else if (cmd.startsWith(F("+CSTT="))) {
+      if (apn.length() > 0 && param(p, 0) != apn) {
+         result = SIM_RESULT_ERROR;
+      }
+   } else if (cmd == F("+CIICR")) {
+      if (!gprsAttached) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         ipUp = true;
+      }
+   } else if (cmd == F("+CIFSR")) {
+      if (!ipUp) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         body += line(localIp);
+         result = SIM_RESULT_NONE;
+      }
+   } else if (cmd.startsWith(F("+CDNSGIP="))) {
+      String host = param(p, 0);
+
+      if (!ipUp) {
+         result = SIM_RESULT_ERROR;
+      } else if (hosts.find(host) != hosts.end()) {
+         deferred += line((String) "+CDNSGIP: 1,\"" + host + F("\",\"") + hosts[host] + '"');
+      } else {
+         deferred += line(F("+CDNSGIP: 0,8"));
+      }
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/** Tcp sockets in the multi ip and manual receive mode. */
+bool Sim808Simulator::cmdSocket(const String &cmd, std::string &body, std::string &deferred, int &result)
+{
+   std::vector<String> p   = params(cmd);
+   int                 mux = param(p, 0).toInt();
+
+   if (mux < 0 || mux >= SIM_MUX_COUNT) {
+      mux = 0;
+   }
+
+   Socket &s = sockets[mux];
+
+   if (cmd.startsWith(F("+CIPSSL="))) {
+      // OK
+   } else if (cmd.startsWith(F("+CIPSTART="))) {
+      String host = param(p, 2);
+      String ip   = hosts.find(host) != hosts.end() ? hosts[host] : host;
+
+      if (!ipUp) {
+         result = SIM_RESULT_ERROR;
+      } else if (s.endpoint) {
+         body += line(F("ALREADY CONNECT"));
+         result = SIM_RESULT_NONE;
+      } else {
+         s.host     = host;
+         s.port     = param(p, 3).toInt();
+         s.notified = false;
+         s.endpoint = connector ? connector(ip, s.port) : NULL;
+         if (s.endpoint) {
+            s.wasOpened = true;
+            deferred += line(String(mux) + F(", CONNECT OK"));
+         } else {
+            deferred += line(String(mux) + F(", CONNECT FAIL"));
+         }
+      }
+   } else if (cmd.startsWith(F("+CIPSEND="))) {
+      if (!s.endpoint) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         inputMode = INPUT_DATA;
+         inputMux  = mux;
+         inputSize = param(p, 1).toInt();
+         inputData.clear();
+         result = SIM_RESULT_NONE;
+      }
+   } else if (cmd.startsWith(F("+CIPRXGET="))) {
+      int mode = param(p, 0).toInt();
+
+      mux = param(p, 1).toInt();
+      if (mux < 0 || mux >= SIM_MUX_COUNT) {
+         mux = 0;
+      }
+
+      Socket &rs = sockets[mux];
+
+      if (mode == 0 || mode == 1) {
+         // OK, manual receive mode is always active
+      } else if (!rs.endpoint) {
+         result = SIM_RESULT_ERROR;
+      } else if (mode == 2) {
+         size_t  size = param(p, 2).toInt();
+         size_t  n    = std::min(std::min(size, rs.endpoint->available()), (size_t) SIM_MAX_RX_SIZE);
+         uint8_t data[SIM_MAX_RX_SIZE];
+
+         n = rs.endpoint->read(data, n);
+
+         size_t remaining = rs.endpoint->available();
+
+         body += std::string("\r\n+CIPRXGET: 2,") + String(mux).c_str() + ',' + String((unsigned long) n).c_str() + ',' +
+                 String((unsigned long) remaining).c_str() + "\r\n" + std::string((const char *) data, n) + "\r\n";
+         if (remaining == 0) {
+            rs.notified = false;
+         }
+      } else if (mode == 4) {
+         size_t size = rs.endpoint->available();
+
+         rs.notified = rs.notified || size > 0;
+         body += line((String) "+CIPRXGET: 4," + String(mux) + ',' + String((unsigned long) size));
+      } else {
+         result = SIM_RESULT_ERROR;
+      }
+   } else if (cmd.startsWith(F("+CIPSTATUS="))) {
+      if (s.endpoint || s.wasOpened) {
+         body += line((String) "+CIPSTATUS: " + String(mux) + F(",0,\"TCP\",\"") + s.host + F("\",\"") + String(s.port) +
+                      (s.endpoint ? F("\",\"CONNECTED\"") : F("\",\"CLOSED\"")));
+      } else {
+         body += line((String) "+CIPSTATUS: " + String(mux) + F(",,\"\",\"\",\"\",\"INITIAL\""));
+      }
+   } else if (cmd.startsWith(F("+CIPCLOSE="))) {
+      if (!s.endpoint) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         closeSocket(mux);
+         body += line(String(mux) + F(", CLOSE OK"));
+         result = SIM_RESULT_NONE;
+      }
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/** Sms storage in text mode. */
+bool Sim808Simulator::cmdSms(const String &cmd, std::string &body, std::string &deferred, int &result)
+{
+   std::vector<String> p = params(cmd);
+
+   if (cmd.startsWith(F("+CMGF=")) || cmd.startsWith(F("+CSCS=")) || cmd.startsWith(F("+CPMS="))) {
+      // OK
+   } else if (cmd.startsWith(F("+CNMI="))) {
+      cnmi = cmd.substring(6);
+   } else if (cmd.startsWith(F("+CMGL="))) {
+      String stat       = param(p, 0);
+      bool   markAsRead = param(p, 1) != "1";
+      bool   first      = true;
+
+      for (size_t i = 0; i < sms.size(); i++) {
+         SimSms &s = sms[i];
+
+         if (stat == F("ALL") || stat == s.status) {
+            body += first ? "\r\n" : "";
+            body += ((String) "+CMGL: " + String(s.index) + F(",\"") + s.status + F("\",\"") + s.phoneNumber +
+                     F("\",\"\",\"") + s.dateTime + F("\"\r\n") + s.message + F("\r\n")).c_str();
+            first = false;
+            if (markAsRead && s.status == F("REC UNREAD")) {
+               s.status = "REC READ";
+            }
+         }
+      }
+   } else if (cmd.startsWith(F("+CMGR="))) {
+      long index = param(p, 0).toInt();
+
+      for (size_t i = 0; i < sms.size(); i++) {
+         SimSms &s = sms[i];
+
+         if (s.index == index) {
+            body += ((String) "\r\n+CMGR: \"" + s.status + F("\",\"") + s.phoneNumber + F("\",\"\",\"") +
+                     s.dateTime + F("\"\r\n") + s.message + F("\r\n")).c_str();
+            if (param(p, 1) != "1" && s.status == F("REC UNREAD")) {
+               s.status = "REC READ";
+            }
+         }
+      }
+   } else if (cmd.startsWith(F("+CMGD="))) {
+      long index = param(p, 0).toInt();
+      int  flag  = param(p, 1).toInt();
+
+      for (size_t i = 0; i < sms.size(); ) {
+         SimSms &s      = sms[i];
+         bool    remove = false;
+
+         if (flag == 0) {
+            remove = s.index == index;
+         } else if (flag == 4) {
+            remove = true;
+         } else {
+            remove = s.status == F("REC READ") || (flag >= 2 && s.status.startsWith(F("STO")));
+         }
+         if (remove) {
+            sms.erase(sms.begin() + i);
+         } else {
+            i++;
+         }
+      }
+   } else if (cmd.startsWith(F("+CMGS="))) {
+      inputMode   = INPUT_SMS;
+      inputNumber = param(p, 0);
+      inputData.clear();
+      result = SIM_RESULT_NONE;
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/** Gps part and the gsm location. */
+bool Sim808Simulator::cmdGps(const String &cmd, std::string &body, std::string &deferred, int &result)
+{
+   if (cmd == F("+CGNSPWR?")) {
+      body += line((String) "+CGNSPWR: " + String(gpsPower ? 1 : 0));
+   } else if (cmd.startsWith(F("+CGNSPWR="))) {
+      gpsPower   = param(params(cmd), 0) == "1";
+      gpsQueries = 0;
+   } else if (cmd == F("+CGNSINF")) {
+      char info[255];
+
+      if (!gpsPower) {
+         snprintf(info, sizeof(info), "+CGNSINF: 0,,,,,,,,,,,,,,,,,,,,");
+      } else if (gpsQueries++ < gpsColdStart || trackIdx >= track.size()) {
+         snprintf(info, sizeof(info), "+CGNSINF: 1,0,,,,,,,0,,,,,,%d,0,,,,,", 6);
+      } else {
+         SimGpsFix &fix = track[trackIdx];
+
+         if (trackIdx + 1 < track.size()) {
+            trackIdx++;
+         }
+         snprintf(info, sizeof(info), "+CGNSINF: 1,1,%s,%.6f,%.6f,%.3f,%.2f,%.1f,1,,%.1f,%.1f,%.1f,,%d,%d,,,%d,,",
+                  fix.dateTime.c_str(), fix.latitude, fix.longitude, fix.altitude, fix.speed, fix.course,
+                  0.9, 1.2, 0.8, fix.satellites + 3, fix.satellites, 42);
+      }
+      body += line(info);
+   } else if (cmd.startsWith(F("+CIPGSMLOC="))) {
+      if (!gprsAttached) {
+         result = SIM_RESULT_ERROR;
+      } else if (hasGsmLocation) {
+         body += line((String) "+CIPGSMLOC: 0," + gsmLocation);
+      } else {
+         body += line(F("+CIPGSMLOC: 601"));
+      }
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/** Http session of the bearer profile 1 with post requests only. */
+bool Sim808Simulator::cmdHttp(const String &cmd, std::string &body, std::string &deferred, int &result)
+{
+   std::vector<String> p = params(cmd);
+
+   if (cmd == F("+HTTPINIT")) {
+      if (httpInit || !gprsAttached) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         httpInit    = true;
+         httpUrl     = "";
+         httpContent = "";
+         httpBody.clear();
+      }
+   } else if (cmd == F("+HTTPTERM")) {
+      if (!httpInit) {
+         result = SIM_RESULT_ERROR;
+      }
+      httpInit = false;
+   } else if (cmd.startsWith(F("+HTTPPARA="))) {
+      if (!httpInit) {
+         result = SIM_RESULT_ERROR;
+      } else if (param(p, 0) == F("URL")) {
+         httpUrl = param(p, 1);
+      } else if (param(p, 0) == F("CONTENT")) {
+         httpContent = param(p, 1);
+      }
+   } else if (cmd.startsWith(F("+HTTPDATA="))) {
+      if (!httpInit) {
+         result = SIM_RESULT_ERROR;
+      } else {
+         inputMode = INPUT_HTTP;
+         inputSize = param(p, 0).toInt();
+         inputData.clear();
+         result = SIM_RESULT_NONE;
+      }
+   } else if (cmd.startsWith(F("+HTTPACTION="))) {
+      if (!httpInit || param(p, 0) != "1") {
+         result = SIM_RESULT_ERROR;
+      } else {
+         int status = !gprsAttached ? 601 : httpHandler ? httpHandler(httpUrl, httpContent, httpBody) : 603;
+
+         deferred += line((String) "+HTTPACTION: 1," + String(status) + F(",0"));
+      }
+   } else {
+      return false;
+   }
+   return true;
+}
+
+/** Stores the data of the +HTTPDATA for the next +HTTPACTION. */
+void Sim808Simulator::finishHttpData()
+{
+   inputMode = INPUT_COMMAND;
+   httpBody  = inputData;
+   queue(line(F("OK")), latencyFor(""));
+}
+
+/** Sends the data of the +CIPSEND to the server side. */
+void Sim808Simulator::finishSend()
+{
+   Socket &s = sockets[inputMux];
+
+   inputMode = INPUT_COMMAND;
+   if (!s.endpoint || !s.endpoint->connected()) {
+      queue(line(String(inputMux) + F(", SEND FAIL")), latencyFor(F("+CIPSEND")));
+      return;
+   }
+   s.endpoint->write((const uint8_t *) inputData.data(), inputData.size());
+   if (quickSend) {
+      queue(line((String) "DATA ACCEPT:" + String(inputMux) + ',' + String((unsigned long) inputData.size())), latencyFor(F("+CIPSEND")));
+   } else {
+      queue(line(String(inputMux) + F(", SEND OK")), latencyFor(F("+CIPSEND")));
+   }
+   if (!s.notified && s.endpoint->available() > 0) { // The answer of the server arrives directly.
+      s.notified = true;
+      queue(line((String) "+CIPRXGET: 1," + String(inputMux)), 0);
+   }
+}
+
+/** Stores the sms of the +CMGS as sent. */
+void Sim808Simulator::finishSms()
+{
+   SimSms s;
+
+   inputMode     = INPUT_COMMAND;
+   s.index       = sentSms.size() + 1;
+   s.status      = "STO SENT";
+   s.phoneNumber = inputNumber;
+   s.message     = inputData.c_str();
+   sentSms.push_back(s);
+   queue(line((String) "+CMGS: " + String(s.index)) + line(F("OK")), latencyFor(F("+CMGS")));
+}
+
+/** Closes the server side of the socket. */
+void Sim808Simulator::closeSocket(int mux)
+{
+   Socket &s = sockets[mux];
+
+   if (s.endpoint) {
+      s.endpoint->close();
+      delete s.endpoint;
+      s.endpoint = NULL;
+   }
+   s.notified = false;
+}
+
+/** Modul restart with +CFUN=1,1. */
+void Sim808Simulator::resetModem()
+{
+   for (int mux = 0; mux < SIM_MUX_COUNT; mux++) {
+      closeSocket(mux);
+      sockets[mux].wasOpened = false;
+   }
+   echo         = true;
+   sleepMode    = 0;
+   gpsPower     = false;
+   gprsAttached = false;
+   ipUp         = false;
+   quickSend    = false;
+   httpInit     = false;
+   cnmi         = "";
+   pendingBaud  = 0;
+   if (ipr != 0) {
+      setBaud(ipr);
+   }
+}
@@ -0,0 +1,256 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Sim808Simulator.h
+  *
+  * Host simulation of the SIM808 modul on the AT command level.
+  */
+
+#ifndef Sim808Simulator_h
+#define Sim808Simulator_h
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+#include "SoftwareSerial.h"
+
+#define SIM_MUX_COUNT     6    //!< Number of sockets of the SIM808 in multi ip mode.
+#define SIM_MAX_RX_SIZE   1460 //!< Maximum data size of one +CIPRXGET=2.
+#define SIM_SLEEP_IDLE_MS 5000 //!< Idle time of the serial line until the modul sleeps with +CSCLK=2.
+
+#define SIM_RESULT_OK     0    //!< Command answered with OK.
+#define SIM_RESULT_ERROR  1    //!< Command answered with ERROR.
+#define SIM_RESULT_NONE   2    //!< Command has its own final answer like 'SHUT OK' or a prompt.
+
+/**
+  * Server side of one simulated tcp socket.
+  * The simulator owns the endpoint and deletes it after the socket is closed.
+  */
+class SimEndpoint
+{
+public:
+   virtual ~SimEndpoint() {}
+
+   virtual bool   connected() = 0;                             //!< Is the server side still open?
+   virtual void   write(const uint8_t *buf, size_t size) = 0;  //!< Data sent from the tracker.
+   virtual size_t available() = 0;                             //!< Bytes waiting for the tracker.
+   virtual size_t read(uint8_t *buf, size_t size) = 0;         //!< Reads the bytes for the tracker.
+   virtual void   close() = 0;                                 //!< The tracker closed the socket.
+};
+
+/** Opens the server side of a +CIPSTART or returns NULL if the connection is refused. */
+typedef std::function<SimEndpoint *(const String &host, uint16_t port)> SimConnector;
+
+/** Answers the post of a +HTTPACTION=1 with the http status code. */
+typedef std::function<int (const String &url, const String &contentType, const std::string &body)> SimHttpHandler;
+
+/**
+  * One position of the simulated gps trajectory.
+  */
+class SimGpsFix
+{
+public:
+   double latitude;    //!< Latitude in degrees.
+   double longitude;   //!< Longitude in degrees.
+   double altitude;    //!< Altitude in meter.
+   double speed;       //!< Speed in km/h.
+   double course;      //!< Course in degrees.
+   int    satellites;  //!< Satellites used for the fix.
+   String dateTime;    //!< UTC in the form 'yyyyMMddhhmmss.000'.
+};
+
+/**
+  * One sms on the simulated sim card.
+  */
+class SimSms
+{
+public:
+   long   index;       //!< Storage index on the sim card.
+   String status;      //!< "REC UNREAD", "REC READ" or "STO SENT".
+   String phoneNumber; //!< Sender or receiver.
+   String dateTime;    //!< Service center time stamp 'yy/MM/dd,hh:mm:ss+zz'.
+   String message;     //!< Sms text.
+};
+
+/**
+  * Stream implementation that behaves like the SIM808 on the serial line.
+  *
+  * Every command is answered after a configurable latency and the answer bytes
+  * arrive with the configured baud rate on the virtual clock. Commands can be
+  * scripted to fail or to stay unanswered, the gps part replays a trajectory
+  * and the tcp sockets are connected to SimEndpoint instances like the
+  * MqttBroker stand-in or a TcpBridge to a real local server.
+  */
+class Sim808Simulator : public Stream
+{
+protected:
+   /** Server side state of one +CIPSTART socket. */
+   class Socket
+   {
+   public:
+      SimEndpoint *endpoint;  //!< Server side, NULL if not connected.
+      String       host;      //!< Host of the +CIPSTART.
+      uint16_t     port;      //!< Port of the +CIPSTART.
+      bool         notified;  //!< Is the +CIPRXGET: 1 urc sent for the waiting data?
+      bool         wasOpened; //!< Was the socket connected once?
+   };
+
+   /** One scripted answer of a command. */
+   class Script
+   {
+   public:
+      String command;  //!< Command prefix without 'AT'.
+      String response; //!< Answer lines separated by '\n', empty = no answer.
+      int    count;    //!< How many times the script is used.
+   };
+
+   /** Input modes of the serial line. */
+   enum InputMode {
+      INPUT_COMMAND,   //!< Reading AT command lines.
+      INPUT_DATA,      //!< Reading the data of a +CIPSEND.
+      INPUT_HTTP,      //!< Reading the data of a +HTTPDATA.
+      INPUT_SMS        //!< Reading the text of a +CMGS until Ctrl-Z.
+   };
+
+   std::deque<std::pair<uint8_t, unsigned long long> > output; //!< Answer bytes with their arrival time in us.
+   unsigned long long   lastOutputUs;  //!< Arrival time of the last queued byte.
+   unsigned long long   lastUpdateUs;  //!< Time of the last urc check.
+   unsigned long        byteUs;        //!< Transfer time of one byte.
+   long                 pendingBaud;   //!< Baud rate of a +IPR which is used after the OK, 0 = none.
+   const SoftwareSerial *hostSerial;   //!< Serial port of the tracker to compare the baud rate.
+
+   InputMode            inputMode;     //!< Current input mode.
+   std::string          inputLine;     //!< Current command line.
+   std::string          inputData;     //!< Current +CIPSEND data or sms text.
+   size_t               inputSize;     //!< Expected +CIPSEND size.
+   uint8_t              lastInput;     //!< Last received byte.
+   unsigned long long   lastInputUs;   //!< Time of the last received byte for the sleep mode.
+   int                  inputMux;      //!< Socket of the +CIPSEND.
+   String               inputNumber;   //!< Receiver of the +CMGS.
+
+   std::map<String, long>    latencies; //!< Latency in ms per command prefix.
+   std::vector<Script>       scripts;   //!< Scripted answers.
+   std::map<String, String>  hosts;     //!< Dns table.
+   SimConnector              connector; //!< Creates the server side of the sockets.
+   SimHttpHandler            httpHandler; //!< Server of the http posts.
+   bool                      httpInit;    //!< Is the http session started with +HTTPINIT?
+   String                    httpUrl;     //!< +HTTPPARA="URL"
+   String                    httpContent; //!< +HTTPPARA="CONTENT"
+   std::string               httpBody;    //!< Data of the last +HTTPDATA.
+   Socket                    sockets[SIM_MUX_COUNT]; //!< The tcp sockets.
+
+   std::vector<SimGpsFix>    track;          //!< Gps trajectory.
+   size_t                    trackIdx;       //!< Next trajectory position.
+   int                       gpsColdStart;   //!< +CGNSINF queries without fix after power on.
+   int                       gpsQueries;     //!< +CGNSINF queries since gps power on.
+   bool                      hasGsmLocation; //!< Is a +CIPGSMLOC position available?
+   String                    gsmLocation;    //!< +CIPGSMLOC answer 'lon,lat,date,time'.
+   long                      nextSmsIndex;   //!< Index for the next stored sms.
+
+protected:
+   void   queue(const std::string &data, long delayMs);
+   void   update();
+   long   latencyFor(const String &command);
+   Script *findScript(const String &command);
+
+   void   processLine(const std::string &line);
+   int    processCommand(const String &cmd, std::string &body, std::string &deferred);
+   void   finishSend();
+   void   finishSms();
+   void   finishHttpData();
+   void   closeSocket(int mux);
+   void   resetModem();
+   void   applyBaud();
+   bool   baudMatches();
+   int    deliver(uint8_t c);
+
+   bool   cmdNetwork(const String &cmd, std::string &body, std::string &deferred, int &result);
+   bool   cmdSocket (const String &cmd, std::string &body, std::string &deferred, int &result);
+   bool   cmdSms    (const String &cmd, std::string &body, std::string &deferred, int &result);
+   bool   cmdGps    (const String &cmd, std::string &body, std::string &deferred, int &result);
+   bool   cmdHttp   (const String &cmd, std::string &body, std::string &deferred, int &result);
+
+public:
+   /* Simulated modul state, can be changed directly by the tests. */
+   bool   echo;             //!< Command echo (ATE1).
+   int    registration;     //!< +CREG status, 1 = home network.
+   String simStatus;        //!< +CPIN status.
+   int    signalQuality;    //!< +CSQ rssi value.
+   int    batteryPercent;   //!< +CBC percent.
+   int    batteryMilliVolt; //!< +CBC voltage.
+   String imei;             //!< +GSN
+   String iccid;            //!< +ICCID of the sim card.
+   String modemInfo;        //!< ATI
+   String operatorName;     //!< +COPS?
+   String localIp;          //!< Ip after +CIICR.
+   String apn;              //!< Expected apn of the +CSTT, empty = any.
+   long   baud;             //!< Serial baud rate.
+   long   ipr;              //!< +IPR fixed baud rate, kept over a restart, 0 = auto baud.
+   long   reliableBaud;     //!< Highest baud rate the tracker receives without bit errors, 0 = all.
+   int    sleepMode;        //!< +CSCLK
+   bool   gpsPower;         //!< +CGNSPWR
+   bool   gprsAttached;     //!< +CGATT
+   bool   ipUp;             //!< Wireless connection up (+CIICR).
+   bool   quickSend;        //!< +CIPQSEND=1
+   String cnmi;             //!< Parameters of the +CNMI.
+
+   std::vector<SimSms> sms;      //!< Sms storage of the sim card.
+   std::vector<SimSms> sentSms;  //!< Sms sent with +CMGS.
+
+   /* Statistics */
+   std::vector<String> commands; //!< Every received command without the 'AT', compound commands split.
+   unsigned long       atLines;  //!< Number of received command lines (round trips).
+   unsigned long       bytesIn;  //!< Bytes received from the tracker.
+   unsigned long       bytesOut; //!< Bytes sent to the tracker.
+   unsigned long       wakeUps;  //!< Characters lost to wake up the modul from the sleep mode.
+   unsigned long       baudErrors; //!< Characters received with a wrong baud rate.
+
+public:
+   Sim808Simulator();
+   virtual ~Sim808Simulator();
+
+   void setBaud(long rate);
+   void setHostSerial(const SoftwareSerial &serial);
+   void setLatency(const String &command, long ms);
+   void script(const String &command, const String &response, int count = 1);
+   void setConnector(SimConnector socketConnector);
+   void setHttpHandler(SimHttpHandler handler);
+   void addHost(const String &name, const String &ip);
+
+   void addGpsFix(const SimGpsFix &fix);
+   void addGpsTrack(double lat1, double lon1, double lat2, double lon2, int steps, const String &startTime, long stepSec);
+   void setGpsColdStart(int queries);
+   void setGsmLocation(double latitude, double longitude, const String &date, const String &time);
+
+   long addSms(const String &phoneNumber, const String &message, const String &dateTime = "19/01/26,08:21:47+04");
+   void sendUrc(const String &text);
+
+   int  count(const String &command);
+   void clearStatistics();
+
+   virtual int    available();
+   virtual int    read();
+   virtual int    peek();
+   virtual size_t write(uint8_t c);
+
+   using Print::write;
+};
+
+#endif
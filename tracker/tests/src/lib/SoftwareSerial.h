@@ -0,0 +1,70 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file SoftwareSerial.h
+  *
+  * Host replacement of the SoftwareSerial which is connected to a simulated peer.
+  */
+
+#ifndef SoftwareSerial_h
+#define SoftwareSerial_h
+
+#include "Arduino.h"
+
+/**
+  * Serial port which forwards all reads and writes to a peer stream,
+  * i.e. the Sim808Simulator instead of the real sim808 modul.
+  */
+class SoftwareSerial : public Stream
+{
+protected:
+   Stream      *peer;       //!< The connected device.
+   long         speed;      //!< Baud rate of the begin.
+   unsigned int bufSize;    //!< Size of the receive buffer.
+   bool         overflowed; //!< Has the receive buffer overflowed since the last check?
+
+public:
+   SoftwareSerial(int receivePin, int transmitPin, bool inverse_logic = false, unsigned int buffSize = 64)
+      : peer(NULL), speed(0), bufSize(buffSize), overflowed(false) {}
+
+   void begin(long baud) { speed = baud; }
+
+   /** Returns and resets the overflow flag of the receive buffer. */
+   bool overflow() { bool ret = overflowed; overflowed = false; return ret; }
+
+   /** Host only: Baud rate of the last begin. */
+   long baudRate() const { return speed; }
+
+   /** Host only: Size of the receive buffer of the constructor. */
+   unsigned int bufferSize() const { return bufSize; }
+
+   /** Host only: The peer has no limit, so the overflow is simulated. */
+   void setOverflow() { overflowed = true; }
+
+   /** Host only: Connects the serial port to the simulated device. */
+   void setPeer(Stream &stream) { peer = &stream; }
+
+   virtual int    available()       { return peer ? peer->available() : 0; }
+   virtual int    read()            { return peer ? peer->read() : -1; }
+   virtual int    peek()            { return peer ? peer->peek() : -1; }
+   virtual size_t write(uint8_t c)  { return peer ? peer->write(c) : 0; }
+   virtual void   flush()           { if (peer) peer->flush(); }
+
+   using Print::write;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Stream.cpp
+  *
+  * Host replacement of the Arduino Stream class with timed reads on the virtual clock.
+  */
+
+#include "Arduino.h"
+#include "Stream.h"
+
+/** Reads one char and waits on the virtual clock until the timeout elapsed. */
+int Stream::timedRead()
+{
+   unsigned long start = millis();
+
+   do {
+      int c = read();
+
+      if (c >= 0) {
+         return c;
+      }
+      delay(1);
+   } while (millis() - start < timeout);
+   return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+   size_t count = 0;
+
+   while (count < length) {
+      int c = timedRead();
+
+      if (c < 0) {
+         break;
+      }
+      *buffer++ = (char) c;
+      count++;
+   }
+   return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length)
+{
+   size_t index = 0;
+
+   while (index < length) {
+      int c = timedRead();
+
+      if (c < 0 || c == terminator) {
+         break;
+      }
+      *buffer++ = (char) c;
+      index++;
+   }
+   return index;
+}
+
+String Stream::readString()
+{
+   String ret;
+   int    c = timedRead();
+
+   while (c >= 0) {
+      ret += (char) c;
+      c = timedRead();
+   }
+   return ret;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+   String ret;
+   int    c = timedRead();
+
+   while (c >= 0 && c != terminator) {
+      ret += (char) c;
+      c = timedRead();
+   }
+   return ret;
+}
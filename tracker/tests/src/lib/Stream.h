@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file Stream.h
+  *
+  * Host replacement of the Arduino Stream class with timed reads on the virtual clock.
+  */
+
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+
+/**
+  * Input stream with the Arduino timeout semantic.
+  * A timed read waits on the virtual clock of the host, so a missing answer
+  * costs no real time.
+  */
+class Stream : public Print
+{
+protected:
+   unsigned long timeout;    //!< Number of milliseconds to wait for the next char.
+
+   int timedRead();
+
+public:
+   Stream() : timeout(1000) {}
+
+   virtual int available() = 0;
+   virtual int read() = 0;
+   virtual int peek() = 0;
+
+   void          setTimeout(unsigned long timeoutMs) { timeout = timeoutMs; }
+   unsigned long getTimeout() { return timeout; }
+
+   size_t readBytes(char *buffer, size_t length);
+   size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); }
+   size_t readBytesUntil(char terminator, char *buffer, size_t length);
+   String readString();
+   String readStringUntil(char terminator);
+};
+
+#endif
@@ -0,0 +1,248 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file TcpBridge.cpp
+  *
+  * Bridge of the simulated sockets to real tcp servers on the local host.
+  */
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "TcpBridge.h"
+
+/** Constructor */
+TcpEndpoint::TcpEndpoint(int socketFd)
+   : fd(socketFd)
+   , open(true)
+{
+   int flag = 1;
+
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+}
+
+/** Destructor */
+TcpEndpoint::~TcpEndpoint()
+{
+   close();
+}
+
+/** Connects to a tcp server, returns NULL if the connection is refused. */
+TcpEndpoint *TcpEndpoint::connectTo(const String &host, uint16_t port)
+{
+   struct addrinfo  hints;
+   struct addrinfo *result = NULL;
+   int              fd     = -1;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family   = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   if (getaddrinfo(host.c_str(), String(port).c_str(), &hints, &result) != 0) {
+      return NULL;
+   }
+   for (struct addrinfo *ai = result; ai && fd == -1; ai = ai->ai_next) {
+      fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd != -1 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+         ::close(fd);
+         fd = -1;
+      }
+   }
+   freeaddrinfo(result);
+   return fd == -1 ? NULL : new TcpEndpoint(fd);
+}
+
+/** Reads everything the server has sent, waits up to waitMs real time for the first byte. */
+void TcpEndpoint::receive(int waitMs)
+{
+   struct pollfd pfd;
+   char          buf[1024];
+
+   pfd.fd     = fd;
+   pfd.events = POLLIN;
+   while (open && poll(&pfd, 1, waitMs) > 0) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+      if (n <= 0) {
+         open = false;
+         break;
+      }
+      in.append(buf, n);
+      waitMs = 0;
+   }
+}
+
+bool TcpEndpoint::connected()
+{
+   receive(0);
+   return open;
+}
+
+void TcpEndpoint::write(const uint8_t *buf, size_t size)
+{
+   while (open && size > 0) {
+      ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+
+      if (n <= 0) {
+         open = false;
+         return;
+      }
+      buf  += n;
+      size -= n;
+   }
+   receive(TCP_REPLY_WAIT_MS);
+}
+
+size_t TcpEndpoint::available()
+{
+   receive(0);
+   return in.size();
+}
+
+size_t TcpEndpoint::read(uint8_t *buf, size_t size)
+{
+   size_t n = std::min(size, in.size());
+
+   memcpy(buf, in.data(), n);
+   in.erase(0, n);
+   return n;
+}
+
+void TcpEndpoint::close()
+{
+   if (fd != -1) {
+      ::close(fd);
+      fd = -1;
+   }
+   open = false;
+}
+
+/** Constructor, listens on a free loopback port. */
+MqttTcpServer::MqttTcpServer(MqttBroker &mqttBroker)
+   : broker(mqttBroker)
+   , listenFd(-1)
+   , port(0)
+   , running(true)
+{
+   struct sockaddr_in addr;
+   socklen_t          len = sizeof(addr);
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port        = 0;
+
+   listenFd = socket(AF_INET, SOCK_STREAM, 0);
+   if (listenFd == -1 ||
+       bind(listenFd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+       listen(listenFd, 4) != 0 ||
+       getsockname(listenFd, (struct sockaddr *) &addr, &len) != 0) {
+      running = false;
+      return;
+   }
+   port   = ntohs(addr.sin_port);
+   thread = std::thread(&MqttTcpServer::run, this);
+}
+
+/** Destructor */
+MqttTcpServer::~MqttTcpServer()
+{
+   stop();
+}
+
+/** Stops the server thread and closes the listening socket. */
+void MqttTcpServer::stop()
+{
+   running = false;
+   if (thread.joinable()) {
+      thread.join();
+   }
+   if (listenFd != -1) {
+      ::close(listenFd);
+      listenFd = -1;
+   }
+}
+
+/** Server thread: Accepts the clients and pumps the bytes through their MqttSession. */
+void MqttTcpServer::run()
+{
+   std::vector<std::pair<int, MqttSession *> > clients;
+
+   while (running) {
+      std::vector<struct pollfd> pfds(1);
+
+      pfds[0].fd     = listenFd;
+      pfds[0].events = POLLIN;
+      for (size_t i = 0; i < clients.size(); i++) {
+         struct pollfd pfd;
+
+         pfd.fd     = clients[i].first;
+         pfd.events = POLLIN;
+         pfds.push_back(pfd);
+      }
+      if (poll(pfds.data(), pfds.size(), 10) <= 0) {
+         continue;
+      }
+      if (pfds[0].revents & POLLIN) {
+         int fd   = ::accept(listenFd, NULL, NULL);
+         int flag = 1;
+
+         if (fd != -1) {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+            clients.push_back(std::make_pair(fd, (MqttSession *) broker.accept()));
+         }
+      }
+      for (size_t i = 0; i < clients.size(); i++) {
+         int          fd      = clients[i].first;
+         MqttSession *session = clients[i].second;
+         bool         closed  = false;
+
+         if (i + 1 < pfds.size() && pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            uint8_t buf[1024];
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+
+            if (n <= 0) {
+               closed = true;
+            } else {
+               session->write(buf, n);
+            }
+         }
+         while (session->available() > 0) {
+            uint8_t buf[1024];
+            size_t  n = session->read(buf, sizeof(buf));
+
+            send(fd, buf, n, MSG_NOSIGNAL);
+         }
+         if (closed || !session->connected()) {
+            ::close(fd);
+            delete session;
+            clients.erase(clients.begin() + i);
+            i--;
+         }
+      }
+   }
+   for (size_t i = 0; i < clients.size(); i++) {
+      ::close(clients[i].first);
+      delete clients[i].second;
+   }
+}
@@ -0,0 +1,84 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file TcpBridge.h
+  *
+  * Bridge of the simulated sockets to real tcp servers on the local host.
+  */
+
+#ifndef TcpBridge_h
+#define TcpBridge_h
+
+#include <atomic>
+#include <thread>
+#include "MqttBroker.h"
+
+#define TCP_REPLY_WAIT_MS 50 //!< Real time to wait for an answer after sending.
+
+/**
+  * Server side of a simulated socket which is connected to a real tcp server.
+  *
+  * The simulated modul runs on the virtual clock, so after every send the
+  * endpoint waits a short real time for the answer of the server. Otherwise
+  * the tracker would run into its timeouts before the server could answer.
+  */
+class TcpEndpoint : public SimEndpoint
+{
+protected:
+   int         fd;      //!< Socket of the connection.
+   std::string in;      //!< Received bytes for the tracker.
+   bool        open;    //!< Is the connection open?
+
+   void receive(int waitMs);
+
+public:
+   TcpEndpoint(int socketFd);
+   virtual ~TcpEndpoint();
+
+   static TcpEndpoint *connectTo(const String &host, uint16_t port);
+
+   virtual bool   connected();
+   virtual void   write(const uint8_t *buf, size_t size);
+   virtual size_t available();
+   virtual size_t read(uint8_t *buf, size_t size);
+   virtual void   close();
+};
+
+/**
+  * Runs the MqttBroker stand-in on a loopback tcp port in its own thread,
+  * so the TcpEndpoint can be tested like a connection to a local broker.
+  */
+class MqttTcpServer
+{
+protected:
+   MqttBroker        &broker;   //!< The broker state.
+   int                listenFd; //!< Listening socket.
+   uint16_t           port;     //!< Local port of the listening socket.
+   std::atomic<bool>  running;  //!< Thread stop flag.
+   std::thread        thread;   //!< Server thread.
+
+   void run();
+
+public:
+   MqttTcpServer(MqttBroker &mqttBroker);
+   ~MqttTcpServer();
+
+   uint16_t getPort() { return port; }
+   void     stop();
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file TrackerHost.h
+  *
+  * Host harness which includes the tracker modules with the simulated hardware.
+  */
+
+#ifndef TrackerHost_h
+#define TrackerHost_h
+
+#include <SoftwareSerial.h>
+#include <ArduinoOTA.h>
+#include <FS.h>
+
+#define SIM808_CONNECTED
+
+#include "Config.h"
+#include "Utils.h"
+#include "StringList.h"
+#include "Gps.h"
+#include "Energy.h"
+#include "Options.h"
+#include "Battery.h"
+#include "Profiler.h"
+#include "Data.h"
+#include "Track.h"
+#include "Scheduler.h"
+#include "Voltage.h"
+#include "DeepSleep.h"
+#include "GsmPower.h"
+#include "GsmGps.h"
+#include "SmsCmd.h"
+#include "Mqtt.h"
+#include "Upload.h"
+
+#include "Sim808Simulator.h"
+
+MyOptions   myOptions;                                   //!< The global options.
+MyData      myData;                                      //!< The global collected data.
+MyTrack     myTrack(myOptions, myData);                  //!< Gps track backlog in the SPIFFS.
+MyGsmGps   *hostGsmGps = NULL;                           //!< Modul used for the dns requests.
+
+/** Same hooks as in tracker.ino. */
+long secondsSincePowerOn()
+{
+   return myData.secondsSincePowerOn();
+}
+
+void myDebugInfo(String info, bool fromWebserver, bool newline)
+{
+   if (getenv("TRACE")) {
+      Serial.print(info);
+      if (newline) {
+         Serial.println();
+      }
+   }
+}
+
+void myDelayLoop()
+{
+   if (hostGsmGps) {
+      hostGsmGps->gsmSerial.handleLog();
+   }
+}
+
+bool myResolveHost(const String &host, IPAddress &ip)
+{
+   return hostGsmGps && hostGsmGps->getHostIp(host, ip);
+}
+
+/** Resets the global state between two tests. */
+void hostReset()
+{
+   myOptions              = MyOptions();
+   myData.rtcData         = MyData::RtcData();
+   myData.isPowerOn       = false;
+   myData.isGsmActive     = false;
+   myData.isGpsActive     = false;
+   myData.waitingForGps   = false;
+   myData.isMoving        = false;
+   myData.movingDistance  = 0.0;
+   myData.profiler        = MyProfiler();
+   hostGsmGps             = NULL;
+   SPIFFS.format();
+}
+
+/** Connects the tracker modul with the simulator and starts it like tracker.ino. */
+bool hostBegin(MyGsmGps &gsmGps, Sim808Simulator &sim)
+{
+   hostGsmGps = &gsmGps;
+   gsmGps.gsmSerial.setPeer(sim);
+   sim.setHostSerial(gsmGps.gsmSerial);
+   myOptions.powerOn = true;
+   return gsmGps.begin();
+}
+
+/** Runs the non blocking handleClient of the modul for the given virtual time. */
+void hostRun(MyGsmGps &gsmGps, unsigned long ms)
+{
+   unsigned long startMs = millis();
+
+   while (millis() - startMs < ms) {
+      gsmGps.handleClient();
+      delay(1);
+   }
+}
+
+#endif
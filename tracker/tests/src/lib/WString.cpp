@@ -0,0 +1,493 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file WString.cpp
+  *
+  * Host replacement of the Arduino String class on top of std::string.
+  */
+
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/** Formats an unsigned number in the given base like utoa. */
+static std::string formatNumber(unsigned long value, unsigned char base)
+{
+   std::string ret;
+
+   if (base < 2 || base > 36) {
+      base = 10;
+   }
+   do {
+      int digit = value % base;
+
+      ret.insert(ret.begin(), (char) (digit < 10 ? '0' + digit : 'a' + digit - 10));
+      value /= base;
+   } while (value);
+   return ret;
+}
+
+/** Formats a signed number in the given base like ltoa. */
+static std::string formatNumber(long value, unsigned char base)
+{
+   if (value < 0 && base == 10) {
+      return "-" + formatNumber((unsigned long) -value, base);
+   }
+   return formatNumber((unsigned long) value, base);
+}
+
+/** Formats a floating point number like dtostrf. */
+static std::string formatFloat(double value, unsigned char decimalPlaces)
+{
+   char buf[64];
+
+   snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+   return buf;
+}
+
+String::String()
+{
+}
+
+String::String(const char *cstr)
+   : buffer(cstr ? cstr : "")
+{
+}
+
+String::String(const String &str)
+   : buffer(str.buffer)
+{
+}
+
+String::String(const std::string &str)
+   : buffer(str)
+{
+}
+
+String::String(const __FlashStringHelper *str)
+   : buffer(str ? (const char *) str : "")
+{
+}
+
+String::String(char c)
+   : buffer(1, c)
+{
+}
+
+String::String(unsigned char value, unsigned char base)
+   : buffer(formatNumber((unsigned long) value, base))
+{
+}
+
+String::String(int value, unsigned char base)
+   : buffer(formatNumber((long) value, base))
+{
+}
+
+String::String(unsigned int value, unsigned char base)
+   : buffer(formatNumber((unsigned long) value, base))
+{
+}
+
+String::String(long value, unsigned char base)
+   : buffer(formatNumber(value, base))
+{
+}
+
+String::String(unsigned long value, unsigned char base)
+   : buffer(formatNumber(value, base))
+{
+}
+
+String::String(float value, unsigned char decimalPlaces)
+   : buffer(formatFloat(value, decimalPlaces))
+{
+}
+
+String::String(double value, unsigned char decimalPlaces)
+   : buffer(formatFloat(value, decimalPlaces))
+{
+}
+
+String &String::operator = (const String &rhs)
+{
+   buffer = rhs.buffer;
+   return *this;
+}
+
+String &String::operator = (const char *cstr)
+{
+   buffer = cstr ? cstr : "";
+   return *this;
+}
+
+String &String::operator = (const __FlashStringHelper *str)
+{
+   return *this = (const char *) str;
+}
+
+bool String::reserve(unsigned int size)
+{
+   buffer.reserve(size);
+   return true;
+}
+
+bool String::concat(const String &str)
+{
+   buffer += str.buffer;
+   return true;
+}
+
+bool String::concat(const char *cstr)
+{
+   if (!cstr) {
+      return false;
+   }
+   buffer += cstr;
+   return true;
+}
+
+bool String::concat(const __FlashStringHelper *str)
+{
+   return concat((const char *) str);
+}
+
+bool String::concat(char c)
+{
+   buffer += c;
+   return true;
+}
+
+bool String::concat(unsigned char num)
+{
+   return concat(String(num));
+}
+
+bool String::concat(int num)
+{
+   return concat(String(num));
+}
+
+bool String::concat(unsigned int num)
+{
+   return concat(String(num));
+}
+
+bool String::concat(long num)
+{
+   return concat(String(num));
+}
+
+bool String::concat(unsigned long num)
+{
+   return concat(String(num));
+}
+
+bool String::concat(float num)
+{
+   return concat(String(num));
+}
+
+bool String::concat(double num)
+{
+   return concat(String(num));
+}
+
+bool String::operator == (const char *cstr) const
+{
+   return buffer == (cstr ? cstr : "");
+}
+
+bool String::operator == (const __FlashStringHelper *str) const
+{
+   return *this == (const char *) str;
+}
+
+int String::compareTo(const String &s) const
+{
+   return buffer.compare(s.buffer);
+}
+
+bool String::equalsIgnoreCase(const String &s) const
+{
+   return length() == s.length() && strcasecmp(c_str(), s.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+   return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const
+{
+   if (offset > length() || prefix.length() > length() - offset) {
+      return false;
+   }
+   return buffer.compare(offset, prefix.length(), prefix.buffer) == 0;
+}
+
+bool String::endsWith(const String &suffix) const
+{
+   if (suffix.length() > length()) {
+      return false;
+   }
+   return buffer.compare(length() - suffix.length(), suffix.length(), suffix.buffer) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+   return (*this)[index];
+}
+
+void String::setCharAt(unsigned int index, char c)
+{
+   if (index < length()) {
+      buffer[index] = c;
+   }
+}
+
+char String::operator [] (unsigned int index) const
+{
+   return index < length() ? buffer[index] : 0;
+}
+
+char &String::operator [] (unsigned int index)
+{
+   static char dummy;
+
+   if (index >= length()) {
+      dummy = 0;
+      return dummy;
+   }
+   return buffer[index];
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const
+{
+   if (!bufsize || !buf) {
+      return;
+   }
+   if (index >= length()) {
+      buf[0] = 0;
+      return;
+   }
+
+   unsigned int n = bufsize - 1;
+
+   if (n > length() - index) {
+      n = length() - index;
+   }
+   memcpy(buf, buffer.c_str() + index, n);
+   buf[n] = 0;
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const
+{
+   getBytes((unsigned char *) buf, bufsize, index);
+}
+
+int String::indexOf(char ch) const
+{
+   return indexOf(ch, 0);
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+   if (fromIndex >= length()) {
+      return -1;
+   }
+
+   size_t pos = buffer.find(ch, fromIndex);
+
+   return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::indexOf(const String &str) const
+{
+   return indexOf(str, 0);
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const
+{
+   if (fromIndex >= length()) {
+      return -1;
+   }
+
+   size_t pos = buffer.find(str.buffer, fromIndex);
+
+   return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::lastIndexOf(char ch) const
+{
+   return lastIndexOf(ch, length() - 1);
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const
+{
+   if (fromIndex >= length()) {
+      return -1;
+   }
+
+   size_t pos = buffer.rfind(ch, fromIndex);
+
+   return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::lastIndexOf(const String &str) const
+{
+   return lastIndexOf(str, length() - str.length());
+}
+
+int String::lastIndexOf(const String &str, unsigned int fromIndex) const
+{
+   if (str.length() == 0 || length() == 0 || str.length() > length()) {
+      return -1;
+   }
+   if (fromIndex >= length()) {
+      fromIndex = length() - 1;
+   }
+
+   size_t pos = buffer.rfind(str.buffer, fromIndex);
+
+   return pos == std::string::npos ? -1 : (int) pos;
+}
+
+String String::substring(unsigned int beginIndex) const
+{
+   return substring(beginIndex, length());
+}
+
+String String::substring(unsigned int left, unsigned int right) const
+{
+   if (left > right) {
+      unsigned int temp = right;
+
+      right = left;
+      left  = temp;
+   }
+   if (left >= length()) {
+      return String();
+   }
+   if (right > length()) {
+      right = length();
+   }
+   return String(buffer.substr(left, right - left));
+}
+
+void String::replace(char find, char replace)
+{
+   for (size_t i = 0; i < buffer.length(); i++) {
+      if (buffer[i] == find) {
+         buffer[i] = replace;
+      }
+   }
+}
+
+void String::replace(const String &find, const String &replace)
+{
+   if (find.length() == 0) {
+      return;
+   }
+
+   size_t pos = 0;
+
+   while ((pos = buffer.find(find.buffer, pos)) != std::string::npos) {
+      buffer.replace(pos, find.length(), replace.buffer);
+      pos += replace.length();
+   }
+}
+
+void String::remove(unsigned int index)
+{
+   remove(index, (unsigned int) -1);
+}
+
+void String::remove(unsigned int index, unsigned int count)
+{
+   if (index >= length()) {
+      return;
+   }
+   if (count > length() - index) {
+      count = length() - index;
+   }
+   buffer.erase(index, count);
+}
+
+void String::toLowerCase()
+{
+   for (size_t i = 0; i < buffer.length(); i++) {
+      buffer[i] = tolower((unsigned char) buffer[i]);
+   }
+}
+
+void String::toUpperCase()
+{
+   for (size_t i = 0; i < buffer.length(); i++) {
+      buffer[i] = toupper((unsigned char) buffer[i]);
+   }
+}
+
+void String::trim()
+{
+   size_t begin = 0;
+   size_t end   = buffer.length();
+
+   while (begin < end && isspace((unsigned char) buffer[begin])) {
+      begin++;
+   }
+   while (end > begin && isspace((unsigned char) buffer[end - 1])) {
+      end--;
+   }
+   buffer = buffer.substr(begin, end - begin);
+}
+
+long String::toInt() const
+{
+   return atol(c_str());
+}
+
+float String::toFloat() const
+{
+   return atof(c_str());
+}
+
+/** Helper for the operators which append a value with its concat overload. */
+template <typename T>
+static String concatValue(const String &lhs, const T &rhs)
+{
+   String ret(lhs);
+
+   ret.concat(rhs);
+   return ret;
+}
+
+String operator + (const String &lhs, const String &rhs)              { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, const char *rhs)                { return concatValue(lhs, rhs); }
+String operator + (const char *lhs, const String &rhs)                { return concatValue(String(lhs), rhs); }
+String operator + (const String &lhs, const __FlashStringHelper *rhs) { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, char rhs)          { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, unsigned char rhs) { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, int rhs)           { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, unsigned int rhs)  { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, long rhs)          { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, unsigned long rhs) { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, float rhs)         { return concatValue(lhs, rhs); }
+String operator + (const String &lhs, double rhs)        { return concatValue(lhs, rhs); }
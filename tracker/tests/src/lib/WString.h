@@ -0,0 +1,136 @@
+/*
+   Copyright (C) 2018 SFini
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/**
+  * @file WString.h
+  *
+  * Host replacement of the Arduino String class on top of std::string.
+  */
+
+#ifndef WString_h
+#define WString_h
+
+#include <string>
+
+class __FlashStringHelper;                                             //!< Flash strings are normal strings on the host.
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))        //!< No flash memory on the host.
+
+/**
+  * Arduino compatible String with the same conversion and search semantics.
+  */
+class String
+{
+protected:
+   std::string buffer; //!< The string content.
+
+public:
+   String();
+   String(const char *cstr);
+   String(const String &str);
+   String(const std::string &str);
+   String(const __FlashStringHelper *str);
+   explicit String(char c);
+   explicit String(unsigned char value, unsigned char base = 10);
+   explicit String(int value, unsigned char base = 10);
+   explicit String(unsigned int value, unsigned char base = 10);
+   explicit String(long value, unsigned char base = 10);
+   explicit String(unsigned long value, unsigned char base = 10);
+   explicit String(float value, unsigned char decimalPlaces = 2);
+   explicit String(double value, unsigned char decimalPlaces = 2);
+
+   String &operator = (const String &rhs);
+   String &operator = (const char *cstr);
+   String &operator = (const __FlashStringHelper *str);
+
+   bool reserve(unsigned int size);
+   unsigned int length() const { return buffer.length(); }
+   const char *c_str() const   { return buffer.c_str(); }
+
+   bool concat(const String &str);
+   bool concat(const char *cstr);
+   bool concat(const __FlashStringHelper *str);
+   bool concat(char c);
+   bool concat(unsigned char num);
+   bool concat(int num);
+   bool concat(unsigned int num);
+   bool concat(long num);
+   bool concat(unsigned long num);
+   bool concat(float num);
+   bool concat(double num);
+
+   template <typename T>
+   String &operator += (T rhs) { concat(rhs); return *this; }
+
+   bool operator == (const String &rhs) const { return buffer == rhs.buffer; }
+   bool operator == (const char *cstr) const;
+   bool operator == (const __FlashStringHelper *str) const;
+   bool operator != (const String &rhs) const { return !(*this == rhs); }
+   bool operator != (const char *cstr) const  { return !(*this == cstr); }
+   bool operator != (const __FlashStringHelper *str) const { return !(*this == str); }
+   bool operator <  (const String &rhs) const { return buffer < rhs.buffer; }
+
+   int  compareTo(const String &s) const;
+   bool equals(const String &s) const { return *this == s; }
+   bool equalsIgnoreCase(const String &s) const;
+   bool startsWith(const String &prefix) const;
+   bool startsWith(const String &prefix, unsigned int offset) const;
+   bool endsWith(const String &suffix) const;
+
+   char  charAt(unsigned int index) const;
+   void  setCharAt(unsigned int index, char c);
+   char  operator [] (unsigned int index) const;
+   char &operator [] (unsigned int index);
+   void  getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+   void  toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+
+   int indexOf(char ch) const;
+   int indexOf(char ch, unsigned int fromIndex) const;
+   int indexOf(const String &str) const;
+   int indexOf(const String &str, unsigned int fromIndex) const;
+   int lastIndexOf(char ch) const;
+   int lastIndexOf(char ch, unsigned int fromIndex) const;
+   int lastIndexOf(const String &str) const;
+   int lastIndexOf(const String &str, unsigned int fromIndex) const;
+
+   String substring(unsigned int beginIndex) const;
+   String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+   void replace(char find, char replace);
+   void replace(const String &find, const String &replace);
+   void remove(unsigned int index);
+   void remove(unsigned int index, unsigned int count);
+   void toLowerCase();
+   void toUpperCase();
+   void trim();
+
+   long  toInt() const;
+   float toFloat() const;
+};
+
+String operator + (const String &lhs, const String &rhs);
+String operator + (const String &lhs, const char *rhs);
+String operator + (const char *lhs, const String &rhs);
+String operator + (const String &lhs, const __FlashStringHelper *rhs);
+String operator + (const String &lhs, char rhs);
+String operator + (const String &lhs, unsigned char rhs);
+String operator + (const String &lhs, int rhs);
+String operator + (const String &lhs, unsigned int rhs);
+String operator + (const String &lhs, long rhs);
+String operator + (const String &lhs, unsigned long rhs);
+String operator + (const String &lhs, float rhs);
+String operator + (const String &lhs, double rhs);
+
+#endif
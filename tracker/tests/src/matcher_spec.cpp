@@ -0,0 +1,226 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#include <chrono>
+#include <new>
+#include <string>
+
+
+static bool   g_countAllocs = false; //!< Count the allocations of the code under test.
+static size_t g_allocs      = 0;     //!< Number of counted allocations.
+
+void *operator new(size_t size)
+{
+    if (g_countAllocs) {
+        g_allocs++;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+/** Modul answer from a string, an empty stream lets the virtual time run. */
+class StringStream : public Stream
+{
+public:
+    std::string input;
+    size_t      pos;
+
+    StringStream() : pos(0) {}
+
+    void set(const std::string &data) { input = data; pos = 0; }
+
+    virtual int available() {
+        if (pos >= input.size()) {
+            delay(1);
+            return 0;
+        }
+        return input.size() - pos;
+    }
+    virtual int read() { return pos < input.size() ? (uint8_t) input[pos++] : -1; }
+    virtual int peek() { return pos < input.size() ? (uint8_t) input[pos] : -1; }
+    virtual size_t write(uint8_t c) { return 1; }
+};
+
+/** The former waitResponse which checks every pattern with endsWith on every byte. */
+uint8_t endsWithResponse(Stream &stream, uint32_t timeout, String &data,
+                         const char *r1, const char *r2, const char *r3, const char *r4, const char *r5)
+{
+    const char *r[5] = { r1, r2, r3, r4, r5 };
+    unsigned long startMillis = millis();
+
+    do {
+        while (stream.available() > 0) {
+            int a = stream.read();
+            if (a <= 0) continue;
+            data += (char) a;
+            for (int i = 0; i < 5; i++) {
+                if (r[i] && data.endsWith(r[i])) {
+                    return i + 1;
+                }
+            }
+        }
+    } while (millis() - startMillis < timeout);
+    data = "";
+    return 0;
+}
+
+/** Random text of the alphabet which can not form the +CIPRXGET: and CLOSED urcs. */
+std::string randomText(const char *alphabet, int maxLen)
+{
+    std::string text;
+    int len = rand() % (maxLen + 1);
+
+    for (int i = 0; i < len; i++) {
+        text += alphabet[rand() % strlen(alphabet)];
+    }
+    return text;
+}
+
+int test_matcher_overlapping() {
+    IT("finds overlapping and nested patterns at the same byte as endsWith");
+    TinyGsmMatcher matcher;
+    std::string    stream = "xababcabab\r\nOK\r\n";
+    std::string    data;
+    int            found[4] = { 0, 0, 0, 0 };
+
+    matcher.set(0, "abab");
+    matcher.set(1, "abc");
+    matcher.set(2, "OK\r\n");
+    matcher.set(3, "\r\n");
+    for (size_t i = 0; i < stream.size(); i++) {
+        uint8_t match = matcher.feed(stream[i]);
+
+        data += stream[i];
+        if (match) {
+            found[match - 1]++;
+        }
+        IS_TRUE((match == 1) == (data.size() >= 4 && data.compare(data.size() - 4, 4, "abab") == 0));
+    }
+    IS_TRUE(found[0] == 2);
+    IS_TRUE(found[1] == 1);
+    IS_TRUE(found[2] == 1);
+    IS_TRUE(found[3] == 1);
+
+    matcher.set(0, NULL);
+    matcher.set(1, "");
+    matcher.set(2, "0123456789012345678901234567890123456789");
+    IS_TRUE(matcher.feed('a') == 0);
+    END_IT
+}
+
+int test_fuzz_against_endswith() {
+    IT("returns the same pattern, data and position as the endsWith implementation");
+    StringStream  stream;
+    TinyGsmSim808 modem(stream);
+    int           mismatches = 0;
+    int           timeouts   = 0;
+
+    srand(1);
+    for (int i = 0; i < 2000; i++) {
+        std::string text = randomText("OKER\r\n+CSQ: 01,", 40);
+        std::string patterns[5];
+        const char *r[5];
+
+        for (int p = 0; p < 5; p++) {
+            patterns[p] = randomText("OKER\r\n+CSQ: 01,", 5);
+            r[p] = (patterns[p].empty() || rand() % 4 == 0) ? NULL : patterns[p].c_str();
+        }
+
+        String  expectedData;
+        String  data;
+        stream.set(text);
+        uint8_t expected    = endsWithResponse(stream, 10, expectedData, r[0], r[1], r[2], r[3], r[4]);
+        size_t  expectedPos = stream.pos;
+
+        stream.set(text);
+        uint8_t index = modem.waitResponse(10, data, r[0], r[1], r[2], r[3], r[4]);
+
+        if (index != expected || stream.pos != expectedPos || data != expectedData) {
+            TRACE("\n   mismatch: " << text << " " << (int) index << " != " << (int) expected << "\n");
+            mismatches++;
+        }
+
+        stream.set(text);
+        if (modem.waitResponse(10, r[0], r[1], r[2], r[3], r[4]) != expected || stream.pos != expectedPos) {
+            mismatches++;
+        }
+        timeouts += expected == 0;
+    }
+    TRACE("\n   2000 answers, " << timeouts << " timeouts\n");
+    IS_TRUE(mismatches == 0);
+    IS_TRUE(timeouts > 0 && timeouts < 2000);
+    END_IT
+}
+
+int test_no_allocation() {
+    IT("does not allocate while waiting without data");
+    StringStream  stream;
+    TinyGsmSim808 modem(stream);
+    MyAtEngine    engine(stream);
+    std::string   answer = "\r\n+CSQ: 17,0\r\n\r\n+CREG: 0,1\r\n\r\nOK\r\n";
+
+    engine.onUrc("+CMTI:", NULL, NULL);
+    stream.set(answer);
+    g_allocs      = 0;
+    g_countAllocs = true;
+    uint8_t index = modem.waitResponse(1000L);
+    g_countAllocs = false;
+
+    IS_TRUE(index == 1);
+    IS_TRUE(stream.pos == answer.size());
+    IS_TRUE(g_allocs == 0);
+    END_IT
+}
+
+int test_benchmark() {
+    IT("measures the endsWith and the matcher implementation");
+    StringStream  stream;
+    TinyGsmSim808 modem(stream);
+    std::string   answer = "\r\n+CGNSINF: 1,1,20190126082147.000,47.376887,8.541694,408.000,0.00,"
+                           "0.0,1,,1.1,1.4,0.9,,11,8,,,42,,\r\n\r\nOK\r\n";
+    const int     runs   = 20000;
+
+    auto startOld = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        String data;
+        stream.set(answer);
+        endsWithResponse(stream, 1000, data, GSM_OK, GSM_ERROR, NULL, NULL, NULL);
+    }
+    auto startNew = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++) {
+        stream.set(answer);
+        modem.waitResponse(1000L);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    long oldUs = std::chrono::duration_cast<std::chrono::microseconds>(startNew - startOld).count();
+    long newUs = std::chrono::duration_cast<std::chrono::microseconds>(end - startNew).count();
+
+    TRACE("\n   " << runs << " answers, endsWith: " << oldUs << " us, matcher: " << newUs << " us\n");
+    IS_TRUE(stream.pos == answer.size());
+    END_IT
+}
+
+int main()
+{
+    SUITE("Matcher");
+    test_matcher_overlapping();
+    test_fuzz_against_endswith();
+    test_no_allocation();
+    test_benchmark();
+    FINISH
+}
@@ -0,0 +1,373 @@
+#include "TrackerHost.h"
+#include "MqttBroker.h"
+#include "TcpBridge.h"
+#include "HttpServer.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#define TOPIC(x) "SnorkTracker/01" x
+
+
+/** Starts the modul with a gps trajectory and stores one position in the track file. */
+bool startTracker(Sim808Simulator &sim, MyGsmGps &gsmGps)
+{
+    myOptions.isMqttEnabled = true;
+    myOptions.isMqttOneShot = true;
+    myOptions.isDebugActive = getenv("TRACE") != NULL;
+    sim.addHost("server", "10.1.2.3");
+    sim.addGpsTrack(47.0, 8.0, 47.1, 8.1, 3, "20190126082100", 60);
+    if (!hostBegin(gsmGps, sim)) {
+        return false;
+    }
+    hostRun(gsmGps, 1000);
+    return SPIFFS.exists(TRACK_FILE_NAME);
+}
+
+/** Appends positions to the track file like after a long time without network. */
+void fillTrack(int count)
+{
+    File file = SPIFFS.open(TRACK_FILE_NAME, "a");
+
+    for (int i = 0; i < count; i++) {
+        file.println((String) "{\"date\":\"27-1-2019\",\"time\":\"10:" + String(i / 60) + ":" + String(i % 60) +
+                     "\",\"long\":\"8.100000\",\"lat\":\"47.100000\",\"alt\":\"408.0\",\"kmph\":\"0.0\"}");
+    }
+    file.close();
+}
+
+/** Number of csv rows without the header lines of the posts. */
+int csvRows(HttpServer &server)
+{
+    std::string body = server.accepted();
+    int         rows = 0;
+
+    for (size_t i = 0; i < server.requests.size(); i++) {
+        if (server.requests[i].status == 200) {
+            rows--;
+        }
+    }
+    for (size_t i = 0; i < body.size(); i++) {
+        rows += body[i] == '\n';
+    }
+    return rows;
+}
+
+int test_publish_session() {
+    IT("publishes the data and the track and applies the retained config");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+    String connectHost;
+
+    sim.setConnector([&](const String &host, uint16_t port) {
+        connectHost = host;
+        return broker.accept();
+    });
+    broker.retain(TOPIC("/Config"), "v=3;gpsCheckIntervalSec=600; mqttSendOnNonMoveEverySec = 7200 ;");
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    mqtt.begin();
+    mqtt.handleClient();
+    TRACE("\n   profile: " << myData.profiler.getWakeJson().c_str() << "\n");
+    IS_TRUE(connectHost == "10.1.2.3");
+    IS_TRUE(broker.clientIds.size() == 1);
+    IS_TRUE(broker.clientIds[0] == "SnorkTracker");
+    IS_TRUE(broker.count(TOPIC("/Voltage")) == 1);
+    IS_TRUE(broker.count(TOPIC("/Gps")) == 1);
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 1);
+    IS_TRUE(broker.lastPayload(TOPIC("/GpsTrack")).find("\"date\":\"26-1-2019\"") != std::string::npos);
+    IS_TRUE(broker.disconnects == 1);
+    IS_FALSE(SPIFFS.exists(TRACK_FILE_NAME));
+    IS_TRUE(myOptions.remoteConfigVersion == 3);
+    IS_TRUE(myOptions.gpsCheckIntervalSec == 600);
+    IS_TRUE(myOptions.mqttSendOnNonMoveEverySec == 7200);
+    IS_TRUE(SPIFFS.exists(OPTION_FILE_NAME));
+
+    // The unchanged config is neither waited for nor saved again.
+    SPIFFS.remove(OPTION_FILE_NAME);
+    myData.rtcData.lastMqttPublishSec = 0;
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/Voltage")) == 2);
+    IS_FALSE(SPIFFS.exists(OPTION_FILE_NAME));
+    END_IT
+}
+
+int test_diagnostics() {
+    IT("publishes the phase durations of the wake");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    myOptions.isMqttDiagnostics = true;
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    mqtt.begin();
+    mqtt.handleClient();
+    std::string payload = broker.lastPayload(TOPIC("/Diagnostics"));
+    IS_TRUE(broker.count(TOPIC("/Diagnostics")) == 1);
+    IS_TRUE(payload.find("\"restart\":") != std::string::npos);
+    IS_TRUE(payload.find("\"gprs\":") != std::string::npos);
+    IS_TRUE(payload.find("\"mqttDns\":") != std::string::npos);
+    IS_TRUE(payload.find("\"mqttPublish\":") != std::string::npos);
+    IS_TRUE(payload.find("\"mqttDisconnect\":") == std::string::npos);
+    IS_TRUE(myData.profiler.getWakeCount(PHASE_MQTT_DISCONNECT) == 1);
+    END_IT
+}
+
+int test_track_not_acknowledged() {
+    IT("keeps the track if the server does not acknowledge it");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    broker.dropPubacks = 1;
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    mqtt.begin();
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 1);
+    IS_TRUE(SPIFFS.exists(TRACK_FILE_NAME));
+    END_IT
+}
+
+int test_broken_resend() {
+    IT("closes the connection if the resend of the unacknowledged packets fails");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    PubSubClient client(gsmGps.gsmClient);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    client.setServer("server", 1883);
+    broker.dropPubacks = 1;
+    IS_TRUE(client.connect("resend"));
+    IS_TRUE(client.publish(TOPIC("/GpsTrack"), "{}", false, 1));
+    client.disconnect();
+    IS_TRUE(client.inflightCount() == 1);
+
+    // The server closes the socket after the CONNACK, the resend fails.
+    broker.closeAfterConnack = 1;
+    IS_FALSE(client.connect("resend"));
+    IS_TRUE(client.state() == MQTT_CONNECTION_LOST);
+    IS_FALSE(client.connected());
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 1);
+
+    IS_TRUE(client.connect("resend"));
+    IS_TRUE(client.waitInflight(0));
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 2);
+    IS_TRUE(broker.published.back().dup);
+    END_IT
+}
+
+int test_scheduled_interval() {
+    IT("waits for mqtt only if the interval of the scheduler is elapsed");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    IS_TRUE(startTracker(sim, gsmGps));
+    myOptions.mqttSendOnNonMoveEverySec = 60;
+    myOptions.isSchedulerEnabled        = true;
+    myData.rtcData.scheduledWakeSec     = 300; // Stretched by the scheduler.
+
+    mqtt.begin();
+    IS_TRUE(mqtt.waitingForMqtt());
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/Voltage")) == 1);
+
+    // Only the send interval without the scheduler is elapsed.
+    delay(100000);
+    IS_FALSE(mqtt.waitingForMqtt());
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/Voltage")) == 1);
+
+    delay(250000);
+    IS_TRUE(mqtt.waitingForMqtt());
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/Voltage")) == 2);
+    END_IT
+}
+
+int test_connection_refused() {
+    IT("does not publish if the server refuses the connection");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return (SimEndpoint *) NULL; });
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    mqtt.begin();
+    mqtt.handleClient();
+    IS_TRUE(sim.count("+CIPSTART") == 5);
+    IS_TRUE(broker.published.empty());
+    IS_TRUE(SPIFFS.exists(TRACK_FILE_NAME));
+    END_IT
+}
+
+int test_tcp_bridge() {
+    IT("publishes through the tcp bridge to a local broker");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    MqttTcpServer server(broker);
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+
+    IS_TRUE(server.getPort() != 0);
+    sim.setConnector([&](const String &host, uint16_t port) {
+        return TcpEndpoint::connectTo("127.0.0.1", server.getPort());
+    });
+    broker.retain(TOPIC("/Config"), "v=4;mqttSendOnMoveEverySec=1200");
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    mqtt.begin();
+    mqtt.handleClient();
+    server.stop();
+    IS_TRUE(broker.clientIds.size() == 1);
+    IS_TRUE(broker.count(TOPIC("/Voltage")) == 1);
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 1);
+    IS_TRUE(broker.disconnects == 1);
+    IS_FALSE(SPIFFS.exists(TRACK_FILE_NAME));
+    IS_TRUE(myOptions.remoteConfigVersion == 4);
+    IS_TRUE(myOptions.mqttSendOnMoveEverySec == 1200);
+    END_IT
+}
+
+int test_http_backlog() {
+    IT("uploads a track backlog via http and publishes only the live values");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    HttpServer server;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+    MyUpload upload(gsmGps.gsmSim808, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    sim.setHttpHandler(server.handler());
+    myOptions.httpUploadUrl = "http://server/track";
+    IS_TRUE(startTracker(sim, gsmGps));
+    fillTrack(200);
+    long jsonSize = myTrack.size();
+    IS_TRUE(myTrack.isBacklog());
+
+    upload.handleClient();
+    IS_TRUE(server.requests.size() == 3);
+    IS_TRUE(server.requests[0].url == "http://server/track");
+    IS_TRUE(server.requests[0].contentType == "text/csv");
+    IS_TRUE(server.requests[0].body.find("date,time,long,lat,") == 0);
+    IS_TRUE(server.requests[0].body.find("\n26-1-2019,8:21:0,") != std::string::npos);
+    IS_TRUE(server.requests[2].body.find("\n27-1-2019,10:3:19,8.100000,47.100000,408.0,0.0\n") != std::string::npos);
+    IS_TRUE(csvRows(server) == 201);
+    IS_TRUE(server.accepted().size() * 2 < (size_t) jsonSize);
+    IS_FALSE(SPIFFS.exists(TRACK_FILE_NAME));
+    IS_TRUE(sim.count("+HTTPINIT") == 3);
+    IS_TRUE(sim.count("+HTTPTERM") == 3);
+    IS_TRUE(myData.profiler.getWakeCount(PHASE_HTTP_UPLOAD) == 1);
+    TRACE("\n   json: " << jsonSize << " bytes, csv: " << server.accepted().size() << " bytes in " <<
+          myData.profiler.getLastMs(PHASE_HTTP_UPLOAD) << " ms\n");
+
+    fillTrack(1);
+    mqtt.begin();
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/Gps")) == 1);
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 1);
+    IS_FALSE(SPIFFS.exists(TRACK_FILE_NAME));
+    END_IT
+}
+
+int test_http_resume() {
+    IT("retries a failed batch and resumes the backlog on the next upload");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    HttpServer server;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+    MyUpload upload(gsmGps.gsmSim808, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    sim.setHttpHandler([&](const String &url, const String &contentType, const std::string &body) {
+        if (server.requests.size() == 1) {
+            server.failures = HTTP_RETRIES; // The second batch fails on every try.
+        }
+        return server.post(url, contentType, body);
+    });
+    myOptions.httpUploadUrl = "http://server/track";
+    IS_TRUE(startTracker(sim, gsmGps));
+    fillTrack(200);
+
+    IS_FALSE(upload.upload());
+    IS_TRUE(server.requests.size() == 1 + HTTP_RETRIES);
+    IS_TRUE(csvRows(server) > 0 && csvRows(server) < 201);
+    IS_TRUE(myTrack.isBacklog());
+
+    mqtt.begin();
+    mqtt.handleClient();
+    IS_TRUE(broker.count(TOPIC("/Gps")) == 1);
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 0);
+    IS_TRUE(SPIFFS.exists(TRACK_FILE_NAME));
+
+    server.failures = 1;
+    IS_TRUE(upload.upload());
+    IS_TRUE(csvRows(server) == 201);
+    IS_FALSE(SPIFFS.exists(TRACK_FILE_NAME));
+    END_IT
+}
+
+int test_http_small_track() {
+    IT("sends a small track via mqtt even with an upload url");
+    hostReset();
+    Sim808Simulator sim;
+    MqttBroker broker;
+    HttpServer server;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyMqtt mqtt(gsmGps.gsmClient, myOptions, myData, myTrack);
+    MyUpload upload(gsmGps.gsmSim808, myOptions, myData, myTrack);
+
+    sim.setConnector([&](const String &host, uint16_t port) { return broker.accept(); });
+    sim.setHttpHandler(server.handler());
+    myOptions.httpUploadUrl = "http://server/track";
+    IS_TRUE(startTracker(sim, gsmGps));
+
+    upload.handleClient();
+    mqtt.begin();
+    mqtt.handleClient();
+    IS_TRUE(server.requests.empty());
+    IS_TRUE(broker.count(TOPIC("/GpsTrack")) == 1);
+    IS_FALSE(SPIFFS.exists(TRACK_FILE_NAME));
+    END_IT
+}
+
+int main()
+{
+    SUITE("Mqtt");
+    test_publish_session();
+    test_diagnostics();
+    test_track_not_acknowledged();
+    test_broken_resend();
+    test_scheduled_interval();
+    test_connection_refused();
+    test_tcp_bridge();
+    test_http_backlog();
+    test_http_resume();
+    test_http_small_track();
+    FINISH
+}
@@ -0,0 +1,132 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#include <chrono>
+
+
+/** All options in the format of the option file. */
+String optionLines(MyOptions &options)
+{
+   String lines;
+
+   options.save();
+   File file = SPIFFS.open(OPTION_FILE_NAME, "r");
+   while (file.available()) {
+      lines += file.readStringUntil('\n') + "\n";
+   }
+   file.close();
+   return lines;
+}
+
+/** An upload url which does not fit into the free bytes of the RTC memory. */
+String longUrl()
+{
+   String url = "http://a.very.long.server.name.example.org/tracker/upload?id=";
+
+   while ((int) url.length() <= MyOptionsSnapshot::capacity()) {
+      url += "0123456789";
+   }
+   return url;
+}
+
+/** Real time of n loads in microseconds. */
+double loadUs(int n)
+{
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   for (int i = 0; i < n; i++) {
+      myOptions.load();
+   }
+   return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / n;
+}
+
+int test_snapshot() {
+    IT("loads the changed options from the rtc snapshot");
+    hostReset();
+    MyOptions options;
+
+    options.isDeepSleepEnabled   = true;
+    options.powerSaveModeVoltage = 12.35;
+    options.deepSleepTimeSec     = 7200;
+    options.mqttServer           = "mqtt.lan";
+    options.energyMa[ENERGY_DEEP_SLEEP] = 0.25;
+    String lines = optionLines(options);
+    IS_TRUE(options.snapshotSize > 0);
+    IS_TRUE(options.snapshotSize <= MyOptionsSnapshot::capacity());
+
+    // The file is not read.
+    SPIFFS.remove(OPTION_FILE_NAME);
+    IS_TRUE(myOptions.load());
+    IS_TRUE(myOptions.snapshotGeneration > 0);
+    IS_TRUE(myOptions.isDeepSleepEnabled);
+    IS_TRUE(myOptions.mqttServer == "mqtt.lan");
+    IS_TRUE(optionLines(myOptions) == lines);
+
+    // Every save refreshes the snapshot.
+    IS_TRUE(myOptions.load());
+    long generation = myOptions.snapshotGeneration;
+    myOptions.deepSleepTimeSec = 3600;
+    myOptions.save();
+    myOptions = MyOptions();
+    IS_TRUE(myOptions.load());
+    IS_TRUE(myOptions.snapshotGeneration == generation + 1);
+    IS_TRUE(myOptions.deepSleepTimeSec == 3600);
+    END_IT
+}
+
+int test_fallback() {
+    IT("reads the option file if the snapshot is too big or invalid");
+    hostReset();
+    MyOptions options;
+
+    options.httpUploadUrl = longUrl();
+    options.save();
+    IS_TRUE(options.snapshotSize == 0);
+    IS_TRUE(myOptions.load());
+    IS_TRUE(myOptions.snapshotGeneration == 0);
+    IS_TRUE(myOptions.httpUploadUrl == options.httpUploadUrl);
+
+    options.httpUploadUrl = "";
+    options.save();
+    IS_TRUE(myOptions.load());
+    IS_TRUE(myOptions.snapshotGeneration != 0);
+
+    // A lost RTC memory.
+    uint32_t garbage = 0x12345678;
+    ESP.rtcUserMemoryWrite(rtcOptionsOffset() + 2, &garbage, sizeof(garbage));
+    IS_TRUE(myOptions.load());
+    IS_TRUE(myOptions.snapshotGeneration == 0);
+    IS_TRUE(myOptions.httpUploadUrl == "");
+    END_IT
+}
+
+int test_benchmark() {
+    IT("measures the load from the option file and from the snapshot");
+    hostReset();
+    MyOptions options;
+
+    options.isDeepSleepEnabled = true;
+    options.isMqttEnabled      = true;
+    options.save();
+    double snapshotUs = loadUs(1000);
+    IS_TRUE(myOptions.snapshotGeneration != 0);
+
+    options.httpUploadUrl = longUrl();
+    options.save();
+    double fileUs = loadUs(1000);
+    IS_TRUE(myOptions.snapshotGeneration == 0);
+
+    TRACE("\n   option file " << fileUs << " us, snapshot " << snapshotUs << " us\n");
+    IS_TRUE(snapshotUs < fileUs);
+    END_IT
+}
+
+int main()
+{
+    SUITE("Options");
+    test_snapshot();
+    test_fallback();
+    test_benchmark();
+    FINISH
+}
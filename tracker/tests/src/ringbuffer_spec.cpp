@@ -0,0 +1,138 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#include <thread>
+
+
+int test_order_and_overruns() {
+    IT("keeps the order and counts the overruns of a full ring");
+    MyRingBuffer<8> ring;
+
+    IS_TRUE(ring.pop() == -1);
+    IS_TRUE(ring.peek() == -1);
+    for (int i = 0; i < 7; i++) {
+        IS_TRUE(ring.push(i));
+    }
+    IS_FALSE(ring.push(7));
+    IS_TRUE(ring.getOverruns() == 1);
+    IS_TRUE(ring.available() == 7);
+    IS_TRUE(ring.peek() == 0);
+    for (int i = 0; i < 7; i++) {
+        IS_TRUE(ring.pop() == i);
+    }
+    IS_TRUE(ring.available() == 0);
+
+    for (int i = 0; i < 100; i++) { // Wraps around many times.
+        IS_TRUE(ring.push(i));
+        IS_TRUE(ring.push(i + 1));
+        IS_TRUE(ring.pop() == i);
+        IS_TRUE(ring.pop() == i + 1);
+    }
+    ring.push(1);
+    ring.clear();
+    IS_TRUE(ring.available() == 0);
+    IS_TRUE(ring.getOverruns() == 1);
+    END_IT
+}
+
+int test_threads() {
+    IT("transfers the bytes between two threads without loss or reordering");
+    static MyRingBuffer<64> ring;
+    const long              count  = 1000000;
+    long                    full   = 0;
+    long                    errors = 0;
+
+    std::thread producer([&]() {
+        for (long i = 0; i < count; i++) {
+            while (!ring.push((uint8_t) (i * 7))) {
+                full++; // The byte is sent again to check the order.
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (long i = 0; i < count; ) {
+        int c = ring.pop();
+
+        if (c >= 0) {
+            if (c != (uint8_t) (i * 7)) {
+                errors++;
+            }
+            i++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    TRACE("\n   " << count << " bytes, ring full " << full << " times\n");
+    IS_TRUE(errors == 0);
+    IS_TRUE(ring.available() == 0);
+    IS_TRUE(ring.getOverruns() == (uint32_t) full);
+    END_IT
+}
+
+int test_serial_log() {
+    IT("reads the modul answer from the ring and logs the lines later");
+    Sim808Simulator sim;
+    StringList      log;
+    bool            debug = true;
+    MySerial        serial(log, debug, 0, 0);
+    String          answer;
+
+    serial.setPeer(sim);
+    serial.print("AT+CSQ\r\n");
+    for (int i = 0; i < 1000 && !answer.endsWith("OK\r\n"); i++) {
+        while (serial.available() > 0) {
+            answer += (char) serial.read();
+        }
+        delay(1);
+    }
+    IS_TRUE(answer.indexOf("+CSQ: ") >= 0);
+    IS_TRUE(log.count() == 0);
+
+    serial.handleLog();
+    IS_TRUE(log.count() == 4);
+    IS_TRUE(log.getAt(0) == "> AT+CSQ");
+    IS_TRUE(log.getAt(1) == "< AT+CSQ"); // Echo
+    IS_TRUE(log.getAt(2).startsWith("< +CSQ: "));
+    IS_TRUE(log.getAt(3) == "< OK");
+    IS_TRUE(serial.getRxOverruns() == 0);
+    IS_TRUE(serial.getLogOverruns() == 0);
+    END_IT
+}
+
+int test_serial_overruns() {
+    IT("enlarges the receive buffer and counts the overflows and the log lines which do not fit");
+    StringList      log;
+    bool            debug = true;
+    MySerial        serial(log, debug, 0, 0);
+    char            line[200];
+
+    IS_TRUE(serial.bufferSize() == SERIAL_RX_SIZE);
+    serial.setOverflow();
+    serial.handleLog();
+    serial.handleLog();
+    IS_TRUE(serial.getRxOverruns() == 1);
+
+    memset(line, 'B', sizeof(line));
+    for (int i = 0; i < 10; i++) {
+        for (size_t j = 0; j < sizeof(line); j++) {
+            serial.write(line[j]);
+        }
+        serial.write('\n');
+    }
+    IS_TRUE(serial.getLogOverruns() > 0);
+    serial.handleLog();
+    IS_TRUE(log.count() + log.rolledOut() + serial.getLogOverruns() == 10);
+    END_IT
+}
+
+int main()
+{
+    SUITE("RingBuffer");
+    test_order_and_overruns();
+    test_threads();
+    test_serial_log();
+    test_serial_overruns();
+    FINISH
+}
@@ -0,0 +1,197 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+#include <math.h>
+
+
+#define SIM_DAYS       3     //!< Simulated days per policy.
+#define SIM_CHECK_MS   1000  //!< Duration of a power check wake without the modem.
+#define SIM_START_MS   20000 //!< Start and registration of the modem.
+#define SIM_GPS_MS     30000 //!< Gps fix of the registered modem.
+#define SIM_SEND_MS    5000  //!< Mqtt session of one upload.
+
+/** One wake policy of the simulation. */
+struct SimPolicy {
+    const char *name;
+    bool        isSchedulerEnabled;
+    long        deepSleepTimeSec;
+    double      dailyBudgetMah;
+};
+
+/** Result of one simulation run. */
+struct SimResult {
+    long   uploads;          //!< Modem wakes with an upload.
+    long   movingUploads;    //!< Uploads while moving.
+    double movingAgeSec;     //!< Average age of the last upload while moving.
+    double mAhPerDay;        //!< Consumption of the energy ledger per day.
+};
+
+/** Voltage trace: the battery drains 0.1 V per day and a solar panel charges it over the day. */
+double voltageAt(long sec)
+{
+    double hour    = (sec % 86400) / 3600.0;
+    double voltage = 12.4 - 0.1 * sec / 86400.0;
+
+    if (hour >= 8.0 && hour < 18.0) {
+        voltage += 0.4 * sin(PI * (hour - 8.0) / 10.0);
+    }
+    return voltage;
+}
+
+/** Motion trace: the boat moves from 9 to 13 and from 15 to 18 o'clock. */
+bool movingAt(long sec)
+{
+    double hour = (sec % 86400) / 3600.0;
+
+    return (hour >= 9.0 && hour < 13.0) || (hour >= 15.0 && hour < 18.0);
+}
+
+/** Replays the traces with the wake decision of DeepSleep::begin and the modem phases
+  * accounted in the energy ledger. Every power check interval is one wake.
+  */
+SimResult simulate(const SimPolicy &policy)
+{
+    SimResult    result   = { 0, 0, 0.0, 0.0 };
+    MyScheduler  scheduler(myOptions, myData, myTrack);
+    MyEnergy    &energy   = myData.rtcData.energy;
+    long         startSec;
+    long         lastUploadSec = 0;
+    long         movingChecks  = 0;
+
+    hostReset();
+    myOptions.isSchedulerEnabled = policy.isSchedulerEnabled;
+    myOptions.deepSleepTimeSec   = policy.deepSleepTimeSec;
+    myOptions.dailyBudgetMah     = policy.dailyBudgetMah;
+    startSec = secondsSincePowerOn();
+
+    while (secondsSincePowerOn() - startSec < SIM_DAYS * 86400L) {
+        long nowSec = secondsSincePowerOn() - startSec;
+
+        energy.wakeUp();
+        myData.voltage = voltageAt(nowSec);
+        scheduler.update();
+        delay(SIM_CHECK_MS);
+        if (scheduler.isModemWake()) {
+            myData.isMoving = movingAt(nowSec);
+            energy.setModem(ENERGY_MODEM_REGISTERING);
+            delay(SIM_START_MS);
+            energy.setModem(ENERGY_MODEM_IDLE);
+            energy.set(ENERGY_GPS_SEARCH, true);
+            delay(SIM_GPS_MS);
+            energy.transmit(true);
+            delay(SIM_SEND_MS);
+            energy.transmit(false);
+            energy.set(ENERGY_GPS_SEARCH, false);
+            energy.modemOff();
+            result.uploads++;
+            result.movingUploads += myData.isMoving;
+            lastUploadSec = nowSec;
+            // MyDeepSleep::sleep(true)
+            myData.rtcData.deepSleepStartSec = secondsSincePowerOn();
+            myData.rtcData.wasMoving         = myData.isMoving;
+        }
+        if (movingAt(nowSec)) {
+            result.movingAgeSec += nowSec - lastUploadSec;
+            movingChecks++;
+        }
+        energy.deepSleep(myOptions.powerCheckIntervalSec);
+        myData.rtcData.deepSleepTimeSec += myOptions.powerCheckIntervalSec;
+    }
+    result.movingAgeSec /= movingChecks;
+    result.mAhPerDay     = energy.getMAh(myOptions.energyMa) / SIM_DAYS;
+    TRACE("   " << policy.name << ": " << result.uploads << " uploads, " << result.movingUploads <<
+          " moving, age while moving " << (long) result.movingAgeSec << " sec, " << result.mAhPerDay << " mAh/day\n");
+    return result;
+}
+
+int test_wake_interval() {
+    IT("computes the wake interval from motion, backlog, voltage trend and credit");
+    hostReset();
+    MyScheduler scheduler(myOptions, myData, myTrack);
+
+    delay(2000); // esp8266 start
+    myData.voltage = 12.0;
+    scheduler.update();
+    IS_TRUE(scheduler.getWakeSec() == myOptions.deepSleepTimeSec);
+
+    myOptions.isSchedulerEnabled = true;
+    scheduler.update();
+    IS_TRUE(scheduler.getWakeSec() == myOptions.mqttSendOnNonMoveEverySec);
+    myData.rtcData.wasMoving = true;
+    scheduler.update();
+    IS_TRUE(scheduler.getWakeSec() == myOptions.mqttSendOnMoveEverySec);
+
+    myOptions.httpUploadUrl   = "http://server/track";
+    myOptions.httpBacklogSize = 10;
+    File file = SPIFFS.open(TRACK_FILE_NAME, "w");
+    file.println("{\"date\":\"27-1-2019\",\"time\":\"10:0:0\"}");
+    file.close();
+    scheduler.update();
+    IS_TRUE(scheduler.getWakeSec() == myOptions.mqttSendOnMoveEverySec / 2);
+    SPIFFS.remove(TRACK_FILE_NAME);
+
+    // Charging with 0.3 V per hour.
+    delay(3600 * 1000L);
+    myData.voltage += 0.3;
+    scheduler.update();
+    IS_TRUE(myData.rtcData.voltageTrend > SCHEDULER_CHARGING_VPH);
+    IS_TRUE(scheduler.getWakeSec() == myOptions.mqttSendOnMoveEverySec / 2);
+    myData.rtcData.voltageTrend = -1.0;
+    myData.rtcData.lastVoltage  = myData.voltage;
+    scheduler.update();
+    IS_TRUE(scheduler.getWakeSec() == myOptions.mqttSendOnMoveEverySec * 2);
+
+    myData.rtcData.voltageTrend = 0.0;
+    myOptions.dailyBudgetMah    = 100.0;
+    myData.rtcData.energyCredit = -50.0;
+    myData.rtcData.creditMah    = myData.getPowerConsumption(myOptions);
+    scheduler.update();
+    IS_TRUE(myData.rtcData.energyCredit < -49.0);
+    IS_TRUE(scheduler.getWakeSec() > myOptions.mqttSendOnMoveEverySec * 2);
+    myData.rtcData.energyCredit = 1000.0;
+    scheduler.update();
+    IS_TRUE(myData.rtcData.energyCredit == 100.0);
+    IS_TRUE(scheduler.getWakeSec() == myOptions.mqttSendOnMoveEverySec / 2);
+
+    myData.rtcData.deepSleepStartSec = secondsSincePowerOn();
+    IS_FALSE(scheduler.isModemWake());
+    delay(scheduler.getWakeSec() * 1000L);
+    IS_TRUE(scheduler.isModemWake());
+    END_IT
+}
+
+int test_policy_simulation() {
+    IT("replays voltage and motion traces and compares uploads and mAh of the policies");
+    SimPolicy fast     = { "fixed 15 min",      false,   900,  0.0 };
+    SimPolicy slow     = { "fixed 3 h",         false, 10800,  0.0 };
+    SimPolicy adaptive = { "adaptive",          true,      0,  0.0 };
+    SimPolicy budget   = { "adaptive 60 mAh/d", true,      0, 60.0 };
+
+    SimResult fastResult     = simulate(fast);
+    SimResult slowResult     = simulate(slow);
+    SimResult adaptiveResult = simulate(adaptive);
+    SimResult budgetResult   = simulate(budget);
+
+    // Moving positions per mAh
+    double fastRate     = fastResult.movingUploads     / fastResult.mAhPerDay;
+    double slowRate     = slowResult.movingUploads     / slowResult.mAhPerDay;
+    double adaptiveRate = adaptiveResult.movingUploads / adaptiveResult.mAhPerDay;
+
+    IS_TRUE(adaptiveResult.mAhPerDay < fastResult.mAhPerDay / 2);
+    IS_TRUE(adaptiveResult.movingUploads > slowResult.movingUploads * 2);
+    IS_TRUE(adaptiveRate > fastRate * 1.5);
+    IS_TRUE(adaptiveRate > slowRate * 1.5);
+    IS_TRUE(budgetResult.mAhPerDay < adaptiveResult.mAhPerDay);
+    IS_TRUE(budgetResult.mAhPerDay < budget.dailyBudgetMah * 1.05);
+    IS_TRUE(budgetResult.movingUploads > slowResult.movingUploads * 2);
+    END_IT
+}
+
+int main()
+{
+    SUITE("Scheduler");
+    test_wake_interval();
+    test_policy_simulation();
+    FINISH
+}
@@ -0,0 +1,846 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+/** Server side which sends a fixed block of data after the first request. */
+class DownloadEndpoint : public SimEndpoint
+{
+public:
+    std::string data;
+    bool        open;
+
+    DownloadEndpoint() : open(true) {}
+    virtual bool   connected() { return open; }
+    virtual void   write(const uint8_t *buf, size_t size) {
+        for (int i = 0; i < 4096; i++) {
+            data += (char) ('a' + i % 26);
+        }
+    }
+    virtual size_t available() { return data.size(); }
+    virtual size_t read(uint8_t *buf, size_t size) {
+        size_t n = std::min(size, data.size());
+
+        memcpy(buf, data.data(), n);
+        data.erase(0, n);
+        return n;
+    }
+    virtual void   close() { open = false; }
+};
+
+/** Server side which answers a request after a delay with a short message. */
+class DelayedEndpoint : public DownloadEndpoint
+{
+public:
+    unsigned long readyMs;
+
+    DelayedEndpoint() : readyMs(0) {}
+    virtual void   write(const uint8_t *buf, size_t size) {
+        data    = "pong";
+        readyMs = millis() + 100;
+    }
+    virtual size_t available() { return millis() >= readyMs ? data.size() : 0; }
+};
+
+int test_begin_connects_gprs() {
+    IT("restarts the modul and connects to the gprs network");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(myData.isGsmActive);
+    IS_TRUE(sim.ipUp);
+    IS_TRUE(sim.gpsPower);
+    IS_TRUE(sim.count("+CIICR") == 1);
+    IS_TRUE(myData.modemIP == "10.170.42.7");
+
+    IS_TRUE(gsmGps.stop());
+    IS_FALSE(sim.ipUp);
+    IS_FALSE(sim.gpsPower);
+    IS_TRUE(sim.sleepMode == 2);
+    END_IT
+}
+
+int test_begin_warm_modem() {
+    IT("uses an already connected modul without restart and identity queries");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps coldGsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(coldGsmGps, sim));
+    IS_FALSE(myData.isModemWarm);
+    IS_TRUE(myData.imei == sim.imei);
+    IS_TRUE(SPIFFS.exists(MODEM_CACHE_FILE_NAME));
+    long coldMs = myData.modemReadyMs;
+
+    // esp8266 restarted, the modul stays connected
+    myData.isGsmActive = false;
+    myData.isGpsActive = false;
+    myData.imei        = "";
+    myData.cop         = "";
+    sim.clearStatistics();
+    MyGsmGps warmGsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(warmGsmGps, sim));
+    TRACE("\n   cold: " << coldMs << " ms, warm: " << myData.modemReadyMs << " ms\n");
+    IS_TRUE(myData.isModemWarm);
+    IS_TRUE(myData.isGsmActive);
+    IS_TRUE(myData.modemReadyMs < coldMs);
+    IS_TRUE(myData.imei == sim.imei);
+    IS_TRUE(myData.cop.indexOf(sim.operatorName) >= 0);
+    IS_TRUE(myData.modemIP == sim.localIp);
+    IS_TRUE(sim.count("+CFUN") == 0);
+    IS_TRUE(sim.count("+CIICR") == 0);
+    IS_TRUE(sim.count("+GSN") == 0);
+    IS_TRUE(sim.count("+COPS") == 0);
+    IS_TRUE(sim.count("I") == 0);
+    END_IT
+}
+
+int test_begin_identity_cache() {
+    IT("reads the modul identity again only after a sim card change");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(sim.count("+GSN") == 1);
+
+    Sim808Simulator sameSim;
+    MyGsmGps sameGsmGps(myOptions, myData, myTrack, 0, 0);
+
+    myData.isGsmActive = false;
+    myData.isGpsActive = false;
+    IS_TRUE(hostBegin(sameGsmGps, sameSim));
+    IS_FALSE(myData.isModemWarm);
+    IS_TRUE(sameSim.count("+GSN") == 0);
+    IS_TRUE(sameSim.count("I") == 0);
+    IS_TRUE(sameSim.count("+COPS?") == 1);
+    IS_TRUE(myData.imei == sameSim.imei);
+
+    Sim808Simulator otherSim;
+    MyGsmGps otherGsmGps(myOptions, myData, myTrack, 0, 0);
+
+    myData.isGsmActive = false;
+    myData.isGpsActive = false;
+    otherSim.iccid = "89410000000000000002";
+    otherSim.imei  = "866782000000002";
+    IS_TRUE(hostBegin(otherGsmGps, otherSim));
+    IS_TRUE(otherSim.count("+GSN") == 1);
+    IS_TRUE(myData.imei == otherSim.imei);
+    END_IT
+}
+
+int test_sleep_or_power_off() {
+    IT("keeps the modul asleep only if it is cheaper than a restart");
+    hostReset();
+    MyGsmPower gsmPower(myOptions, myData, 0);
+
+    myData.isPowerOn = true;
+    myData.rtcData.modemColdReadyMs = 30000;
+    myData.rtcData.modemWarmReadyMs = 2000;
+    IS_FALSE(gsmPower.keepAsleep(300));
+    myOptions.isGsmSleepEnabled = true;
+    IS_TRUE(gsmPower.keepAsleep(300));
+    IS_FALSE(gsmPower.keepAsleep(3600));
+    myData.rtcData.modemColdReadyMs = 60000;
+    IS_TRUE(gsmPower.keepAsleep(3600));
+
+    // The modul sleeps until the next modem wake, the power checks in between do not wake it.
+    MyScheduler scheduler(myOptions, myData, myTrack);
+    myData.rtcData.modemColdReadyMs = 30000;
+    myOptions.powerCheckIntervalSec = 300;
+    myOptions.deepSleepTimeSec      = 3600;
+    IS_TRUE(gsmPower.keepAsleep(myOptions.powerCheckIntervalSec));
+    IS_FALSE(gsmPower.keepAsleep(scheduler.getWakeSec()));
+    myOptions.isSchedulerEnabled    = true;
+    myData.rtcData.scheduledWakeSec = 600;
+    IS_TRUE(gsmPower.keepAsleep(scheduler.getWakeSec()));
+    myData.rtcData.modemColdReadyMs = 60000;
+
+    gsmPower.sleep();
+    IS_TRUE(myData.rtcData.isModemSleeping);
+    myData.isPowerOn  = false;
+    myOptions.powerOn = true;
+    gsmPower.begin();
+    IS_TRUE(myData.isPowerOn);
+    IS_FALSE(myData.rtcData.isModemSleeping);
+    END_IT
+}
+
+int test_begin_after_sleep() {
+    IT("wakes up the sleeping modul and uses it without a new registration");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(myData.rtcData.modemColdReadyMs == myData.modemReadyMs);
+    IS_TRUE(gsmGps.sleep());
+    IS_TRUE(sim.sleepMode == 2);
+    IS_TRUE(sim.ipUp);
+    IS_FALSE(sim.gpsPower);
+    delay(60000);
+
+    // esp8266 deep sleep
+    myData.isGpsActive = false;
+    sim.clearStatistics();
+    MyGsmGps warmGsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(warmGsmGps, sim));
+    IS_TRUE(myData.isModemWarm);
+    IS_TRUE(sim.wakeUps == 1);
+    IS_TRUE(sim.sleepMode == 0);
+    IS_TRUE(sim.gpsPower);
+    IS_TRUE(sim.count("+CIICR") == 0);
+    IS_TRUE(myData.rtcData.modemWarmReadyMs == myData.modemReadyMs);
+    END_IT
+}
+
+int test_begin_fails_without_network() {
+    IT("fails if the modul does not register in the network");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.registration = 0;
+    IS_FALSE(hostBegin(gsmGps, sim));
+    IS_FALSE(myData.isGsmActive);
+    IS_TRUE(myData.status == "Sim808 network failed");
+    END_IT
+}
+
+int test_profile_phases() {
+    IT("measures the start phases and keeps the histograms over the wakes");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.setLatency("+CGATT=1", 1200);
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(myData.profiler.getWakeCount(PHASE_MODEM_PROBE) == 1);
+    IS_TRUE(myData.profiler.getWakeCount(PHASE_MODEM_RESTART) == 1);
+    IS_TRUE(myData.profiler.getWakeCount(PHASE_NETWORK) == 1);
+    IS_TRUE(myData.profiler.getLastMs(PHASE_GPRS) >= 1200);
+    IS_FALSE(myData.profiler.isRunning(PHASE_MODEM_INFO));
+    IS_TRUE(myData.profiler.save());
+
+    // Next wake
+    MyProfiler profiler;
+    const MyProfiler::Statistic &gprs = profiler.getLifetime(PHASE_GPRS);
+
+    profiler.begin();
+    IS_TRUE(profiler.getWakeCount(PHASE_GPRS) == 0);
+    IS_TRUE(gprs.count == 1);
+    IS_TRUE(gprs.maxMs == myData.profiler.getLastMs(PHASE_GPRS));
+    IS_TRUE(gprs.buckets[MyProfiler::bucketOf(gprs.maxMs)] == 1);
+    IS_TRUE(MyProfiler::bucketOf(499) == 0);
+    IS_TRUE(MyProfiler::bucketOf(1200) == 2);
+    IS_TRUE(MyProfiler::bucketOf(600000) == PROFILE_BUCKETS - 1);
+    profiler.clear();
+    IS_FALSE(SPIFFS.exists(PROFILE_FILE_NAME));
+    END_IT
+}
+
+int test_energy_ledger() {
+    IT("accounts the time of every power state over the wake and the deep sleep");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmPower gsmPower(myOptions, myData, 0);
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyEnergy &energy = myData.rtcData.energy;
+
+    energy.wakeUp();
+    gsmPower.on();
+    IS_TRUE(energy.isOn(ENERGY_MODEM_REGISTERING));
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_FALSE(energy.isOn(ENERGY_MODEM_REGISTERING));
+    IS_TRUE(energy.isOn(ENERGY_MODEM_IDLE));
+    IS_TRUE(energy.isOn(ENERGY_GPS_SEARCH));
+    double registeringSec = energy.getSec(ENERGY_MODEM_REGISTERING);
+    IS_TRUE(registeringSec >= myData.modemReadyMs / 1000.0);
+
+    energy.transmit(true);
+    IS_FALSE(energy.isOn(ENERGY_MODEM_IDLE));
+    delay(2000);
+    energy.transmit(false);
+    IS_TRUE(energy.isOn(ENERGY_MODEM_IDLE));
+    IS_TRUE(fabs(energy.getSec(ENERGY_GPRS_TX) - 2.0) < 0.01);
+
+    IS_TRUE(gsmGps.sleep());
+    gsmPower.sleep();
+    IS_FALSE(energy.isOn(ENERGY_GPS_SEARCH));
+    IS_TRUE(energy.isOn(ENERGY_MODEM_SLEEP));
+    double activeSec = energy.getSec(ENERGY_ESP_ACTIVE);
+    IS_TRUE(activeSec >= registeringSec + 2.0);
+
+    // esp8266 deep sleep
+    energy.deepSleep(300);
+    energy.wakeUp();
+    IS_TRUE(energy.isOn(ENERGY_MODEM_SLEEP));
+    IS_FALSE(energy.isOn(ENERGY_MODEM_IDLE));
+    IS_TRUE(energy.getSec(ENERGY_DEEP_SLEEP) == 300.0);
+    IS_TRUE(energy.getSec(ENERGY_MODEM_SLEEP) == 300.0);
+    IS_TRUE(fabs(energy.getSec(ENERGY_ESP_ACTIVE) - activeSec) < 0.01);
+
+    double mAh = activeSec * ENERGY_MA_ESP_ACTIVE / 3600.0 + 2.0 * ENERGY_MA_GPRS_TX / 3600.0 + 300 * ENERGY_MA_DEEP_SLEEP / 3600.0;
+    IS_TRUE(myData.getPowerConsumption(myOptions) > mAh);
+    IS_TRUE(fabs(energy.getMAh(ENERGY_GPRS_TX, myOptions.energyMa) - 2.0 * ENERGY_MA_GPRS_TX / 3600.0) < 0.001);
+    String json = energy.getJson(myOptions.energyMa);
+    TRACE("\n   " << json.c_str() << "\n");
+    IS_TRUE(json.startsWith("{\"espActive\":"));
+    IS_TRUE(json.indexOf("\"gprsTx\":0.167") > 0);
+    IS_TRUE(json.indexOf("\"wifiAp\"") < 0);
+    IS_TRUE(json.endsWith("\"total\":" + String(myData.getPowerConsumption(myOptions), 3) + "}"));
+
+    IS_TRUE(myOptions.setOption("energyMa_gprsTx", "250.5"));
+    IS_TRUE(myOptions.energyMa[ENERGY_GPRS_TX] == 250.5);
+    IS_FALSE(myOptions.setOption("energyMa_unknown", "1"));
+    END_IT
+}
+
+int test_gps_trajectory() {
+    IT("replays the gps trajectory after the cold start");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyGps gps;
+
+    sim.setGpsColdStart(2);
+    sim.addGpsTrack(47.0, 8.0, 47.1, 8.1, 3, "20190126082100", 60);
+    IS_TRUE(hostBegin(gsmGps, sim));
+
+    IS_FALSE(gsmGps.gsmSim808.getGps(gps));
+    IS_FALSE(gsmGps.gsmSim808.getGps(gps));
+    IS_TRUE(gsmGps.gsmSim808.getGps(gps));
+    IS_TRUE(fabs(gps.location.latitude() - 47.0) < 0.0001);
+    IS_TRUE(gsmGps.gsmSim808.getGps(gps));
+    IS_TRUE(fabs(gps.location.latitude() - 47.05) < 0.0001);
+    IS_TRUE(fabs(gps.location.longitude() - 8.05) < 0.0001);
+    IS_TRUE(gps.time.minute() == 22);
+    END_IT
+}
+
+int test_gps_track_file() {
+    IT("stores the gps position of handleClient in the track file");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.addGpsTrack(47.0, 8.0, 47.1, 8.1, 3, "20190126082100", 60);
+    IS_TRUE(hostBegin(gsmGps, sim));
+    hostRun(gsmGps, 1000);
+    IS_TRUE(myData.rtcData.lastGps.fixStatus);
+    IS_TRUE(sim.count("+CSQ") == 1);
+    IS_TRUE(sim.count("+CBC") == 1);
+    IS_TRUE(SPIFFS.content(TRACK_FILE_NAME).find("\"date\":\"26-1-2019\"") != std::string::npos);
+    END_IT
+}
+
+int test_gsm_location() {
+    IT("reads the gsm location as gps fallback");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MyGps gps;
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_FALSE(gsmGps.gsmSim808.getGsmGps(gps));
+
+    sim.setGsmLocation(61.496052, 23.7798, "2019/01/26", "08:21:47");
+    IS_TRUE(gsmGps.gsmSim808.getGsmGps(gps));
+    IS_TRUE(fabs(gps.location.latitude() - 61.496052) < 0.0001);
+    IS_TRUE(fabs(gps.location.longitude() - 23.7798) < 0.0001);
+
+    sim.setLatency("+CIPGSMLOC", 12000);
+    IS_FALSE(gsmGps.gsmSim808.getGsmGps(gps));
+    END_IT
+}
+
+int test_sms_read_and_delete() {
+    IT("reads and deletes the received sms");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    SmsData list[SMS_LIST_SIZE];
+    int total = 0;
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(gsmGps.getSMSList("REC UNREAD", list, SMS_LIST_SIZE, total) == 0);
+
+    long index = sim.addSms("+41791234567", "Status");
+    IS_TRUE(gsmGps.getSMSList("REC UNREAD", list, SMS_LIST_SIZE, total) == 1);
+    IS_TRUE(total == 1);
+    IS_TRUE(list[0].index == index);
+    IS_TRUE(list[0].message == "Status");
+    IS_TRUE(list[0].phoneNumber.indexOf("+41791234567") >= 0);
+    IS_TRUE(gsmGps.deleteSMS(list[0].index));
+    IS_TRUE(sim.sms.empty());
+    END_IT
+}
+
+int test_sms_list_recorded() {
+    IT("parses every entry of a recorded +CMGL listing");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    SmsData list[2];
+    int total = 0;
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.script("+CMGL",
+        "+CMGL: 4,\"REC UNREAD\",\"+41791234567\",\"\",\"19/01/26,08:21:47+04\"\n"
+        "Status\n"
+        "+CMGL: 7,\"REC UNREAD\",\"+41797654321\",\"\",\"19/01/26,09:02:11+04\"\n"
+        "gps:on:300\n"
+        "+CMGL: 9,\"REC UNREAD\",\"Swisscom\",\"\",\"19/01/27,17:45:00+04\"\n"
+        "Ihr Guthaben betraegt CHF 12.50\n"
+        "\n"
+        "OK", 2);
+    IS_TRUE(gsmGps.getSMSList("REC UNREAD", list, 2, total) == 2);
+    IS_TRUE(total == 3);
+    IS_TRUE(list[0].index == 4);
+    IS_TRUE(list[0].message == "Status");
+    IS_TRUE(list[1].index == 7);
+    IS_TRUE(list[1].phoneNumber == "\"+41797654321\"");
+    IS_TRUE(list[1].dateTime.startsWith("\"19/01/26,09:02:11+04\""));
+    IS_TRUE(list[1].message == "gps:on:300");
+    IS_TRUE(gsmGps.gsmSim808.getSignalQuality() == sim.signalQuality);
+
+    sim.clearStatistics();
+    IS_TRUE(gsmGps.getSMSList("REC UNREAD", list, 2, total) == 2);
+    IS_TRUE(sim.atLines == 1);
+    END_IT
+}
+
+int test_sms_batch() {
+    IT("reads and deletes all waiting sms with one listing and one delete");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MySmsCmd smsCmd(gsmGps, myOptions, myData);
+
+    myOptions.phoneNumber = "+41791234567";
+    for (int i = 0; i < 3; i++) {
+        sim.addSms("+41791234567", "Gps");
+    }
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.clearStatistics();
+    smsCmd.handleClient();
+    IS_TRUE(sim.count("+CMGL") == 1);
+    IS_TRUE(sim.count("+CMGD") == 1);
+    IS_TRUE(sim.sms.empty());
+    IS_TRUE(sim.sentSms.size() == 3);
+    END_IT
+}
+
+int test_sms_batch_overflow() {
+    IT("reads the sms which do not fit into the list with the next listing");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MySmsCmd smsCmd(gsmGps, myOptions, myData);
+
+    myOptions.phoneNumber = "+41791234567";
+    for (int i = 0; i < SMS_LIST_SIZE + 2; i++) {
+        sim.addSms("+41791234567", "Gps");
+    }
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.clearStatistics();
+    smsCmd.handleClient();
+    IS_TRUE(sim.count("+CMGL") == 2);
+    IS_TRUE(sim.count("+CMGD") == SMS_LIST_SIZE + 1);
+    IS_TRUE(sim.sms.empty());
+    IS_TRUE(sim.sentSms.size() == SMS_LIST_SIZE + 2);
+    END_IT
+}
+
+int test_sms_failed_delete() {
+    IT("reads the rest of an overflowed listing on the next check if a delete fails");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MySmsCmd smsCmd(gsmGps, myOptions, myData);
+    long index[SMS_LIST_SIZE + 2];
+
+    myOptions.phoneNumber = "+41791234567";
+    for (int i = 0; i < SMS_LIST_SIZE + 2; i++) {
+        index[i] = sim.addSms("+41791234567", "Gps");
+    }
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.clearStatistics();
+    sim.script((String) "+CMGD=" + String(index[2]), "ERROR");
+    smsCmd.handleClient();
+    IS_TRUE(sim.count("+CMGL=\"REC UNREAD\"") == 1);
+    IS_TRUE(sim.count("+CMGL=\"REC READ\"") == 0);
+    IS_TRUE(sim.sms.size() == 3);
+    IS_TRUE(myData.rtcData.isSmsReadPending);
+
+    // The next periodic check lists the sms which the first listing marked as read.
+    sim.clearStatistics();
+    gsmGps.smsCheckRequested = true;
+    smsCmd.handleClient();
+    IS_TRUE(sim.count("+CMGL=\"REC READ\"") == 1);
+    IS_TRUE(sim.sms.empty());
+    IS_FALSE(myData.rtcData.isSmsReadPending);
+    IS_TRUE(sim.sentSms.size() == SMS_LIST_SIZE + 3); // The undeleted sms is answered twice.
+    END_IT
+}
+
+int test_sms_command_answer() {
+    IT("answers a sms command with a sms");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MySmsCmd smsCmd(gsmGps, myOptions, myData);
+
+    myOptions.phoneNumber = "+41791234567";
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.addSms("+41791234567", "Gps");
+    smsCmd.handleClient();
+    IS_TRUE(sim.sms.empty());
+    IS_TRUE(sim.sentSms.size() == 1);
+    IS_TRUE(sim.sentSms[0].phoneNumber == "+41791234567");
+    IS_TRUE(sim.sentSms[0].message == "No Gps position.\n");
+    END_IT
+}
+
+int test_sms_indication() {
+    IT("reads an indicated sms at once without polling");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    MySmsCmd smsCmd(gsmGps, myOptions, myData);
+
+    myOptions.phoneNumber = "+41791234567";
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(sim.cnmi.length() > 0);
+    smsCmd.handleClient();
+    IS_TRUE(sim.count("+CMGL") == 1);
+
+    sim.clearStatistics();
+    for (int i = 0; i < 10000; i++) {
+        gsmGps.handleClient();
+        smsCmd.handleClient();
+        delay(1);
+    }
+    IS_TRUE(sim.count("+CMG") == 0);
+
+    unsigned long startMs = millis();
+    long          index   = sim.addSms("+41791234567", "Gps");
+    while (sim.sentSms.empty() && millis() - startMs < 10000) {
+        gsmGps.handleClient();
+        smsCmd.handleClient();
+        delay(1);
+    }
+    TRACE("\n   sms answered after " << millis() - startMs << " ms\n");
+    IS_TRUE(sim.sentSms.size() == 1);
+    IS_TRUE(millis() - startMs < 5000);
+    IS_TRUE(sim.count("+CMGL") == 0);
+    IS_TRUE(sim.count("+CMGR=" + String(index)) == 1);
+    IS_TRUE(sim.sms.empty());
+    END_IT
+}
+
+int test_dns() {
+    IT("resolves host names with the gprs dns");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    IPAddress ip;
+
+    sim.addHost("test.mosquitto.org", "37.187.106.16");
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(myResolveHost("test.mosquitto.org", ip));
+    IS_TRUE(ip == IPAddress(37, 187, 106, 16));
+    IS_FALSE(myResolveHost("unknown.host", ip));
+
+    sim.script("+CDNSGIP", "ERROR");
+    IS_FALSE(myResolveHost("test.mosquitto.org", ip));
+    END_IT
+}
+
+int test_signal_and_battery() {
+    IT("reads the signal quality and the battery");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.signalQuality    = 17;
+    sim.batteryPercent   = 81;
+    sim.batteryMilliVolt = 4012;
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(gsmGps.gsmSim808.getSignalQuality() == 17);
+    IS_TRUE(gsmGps.gsmSim808.getBattPercent() == 81);
+    IS_TRUE(gsmGps.gsmSim808.getBattVoltage() == 4012);
+    END_IT
+}
+
+int test_status_compound_query() {
+    IT("queries the status and the gps with one compound command every minute");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.signalQuality    = 17;
+    sim.batteryMilliVolt = 4012;
+    sim.addGpsTrack(47.0, 8.0, 47.1, 8.1, 3, "20190126082100", 60);
+    IS_TRUE(hostBegin(gsmGps, sim));
+    delay(1000);
+    sim.clearStatistics();
+    hostRun(gsmGps, 1000);
+    IS_TRUE(sim.atLines == 1);
+    IS_TRUE(sim.count("+CSQ") == 1);
+    IS_TRUE(sim.count("+CBC") == 1);
+    IS_TRUE(sim.count("+CREG?") == 1);
+    IS_TRUE(sim.count("+CGNSINF") == 1);
+    IS_TRUE(myData.signalQuality == "17");
+    IS_TRUE(myData.batteryVolt == "4.01");
+    IS_TRUE(myData.rtcData.lastGps.fixStatus);
+
+    sim.signalQuality = 12;
+    hostRun(gsmGps, 30000);
+    IS_TRUE(sim.count("+CSQ") == 1);
+    hostRun(gsmGps, 31000);
+    IS_TRUE(sim.count("+CSQ") == 2);
+    IS_TRUE(sim.count("+CGNSINF") == 1);
+    IS_TRUE(myData.signalQuality == "12");
+    END_IT
+}
+
+int test_unanswered_command() {
+    IT("runs into the timeout if the modul does not answer");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.script("+CSQ", "");
+
+    unsigned long startMs = millis();
+    IS_TRUE(gsmGps.gsmSim808.getSignalQuality() == 99);
+    IS_TRUE(millis() - startMs >= 1000);
+    IS_TRUE(gsmGps.gsmSim808.getSignalQuality() == sim.signalQuality);
+    END_IT
+}
+
+int test_serial_timing() {
+    IT("transfers the bytes with the configured baud rate");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    myOptions.modemMaxBaud = 9600;
+    IS_TRUE(hostBegin(gsmGps, sim));
+    sim.setLatency("+GSN", 0);
+
+    unsigned long startUs = micros();
+    gsmGps.gsmSim808.getIMEI();
+    unsigned long slowUs = micros() - startUs;
+
+    sim.setBaud(115200);
+    gsmGps.gsmSerial.begin(115200);
+    startUs = micros();
+    gsmGps.gsmSim808.getIMEI();
+    unsigned long fastUs = micros() - startUs;
+
+    TRACE("\n   9600: " << slowUs << " us, 115200: " << fastUs << " us\n");
+    IS_TRUE(slowUs > 25 * 1000);
+    IS_TRUE(fastUs < slowUs / 4);
+    END_IT
+}
+
+int test_baud_negotiation() {
+    IT("steps up the baud rate and keeps it in the rtc memory");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(sim.count("+IPR=") == 3);
+    IS_TRUE(sim.ipr == 57600);
+    IS_TRUE(sim.baud == 57600);
+    IS_TRUE(myData.rtcData.modemBaud == 57600);
+    IS_TRUE(gsmGps.gsmSim808.getIMEI() == sim.imei);
+    IS_TRUE(sim.baudErrors == 0);
+
+    // Next wakeup with the baud rate of the rtc memory.
+    IS_TRUE(gsmGps.stop());
+    sim.clearStatistics();
+    MyGsmGps gsmGps2(myOptions, myData, myTrack, 0, 0);
+    IS_TRUE(hostBegin(gsmGps2, sim));
+    IS_TRUE(sim.count("+IPR=") == 0);
+    IS_TRUE(sim.baudErrors == 0);
+
+    // The rtc memory is lost but the modul keeps the fixed baud rate.
+    IS_TRUE(gsmGps2.stop());
+    hostReset();
+    MyGsmGps gsmGps3(myOptions, myData, myTrack, 0, 0);
+    IS_TRUE(hostBegin(gsmGps3, sim));
+    IS_TRUE(sim.baudErrors > 0);
+    IS_TRUE(myData.rtcData.modemBaud == 57600);
+    IS_TRUE(gsmGps3.gsmSim808.getIMEI() == sim.imei);
+    END_IT
+}
+
+int test_baud_fallback() {
+    IT("falls back to the last baud rate which passes the echo test");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.reliableBaud = 38400;
+    myOptions.modemMaxBaud = 115200;
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(sim.count("+IPR=57600") == 1);
+    IS_TRUE(sim.count("+IPR=115200") == 0);
+    IS_TRUE(sim.ipr == 38400);
+    IS_TRUE(sim.baud == 38400);
+    IS_TRUE(myData.rtcData.modemBaud == 38400);
+    IS_TRUE(gsmGps.gsmSim808.getIMEI() == sim.imei);
+
+    sim.script("+IPR=", "ERROR");
+    sim.clearStatistics();
+    myOptions.modemMaxBaud = 9600;
+    IS_TRUE(gsmGps.stop());
+    MyGsmGps gsmGps2(myOptions, myData, myTrack, 0, 0);
+    IS_TRUE(hostBegin(gsmGps2, sim));
+    IS_TRUE(sim.count("+IPR=9600") == 1);
+    IS_TRUE(sim.baud == 38400);
+    IS_TRUE(myData.rtcData.modemBaud == 38400);
+    END_IT
+}
+
+int test_baud_benchmark() {
+    IT("measures the bytes per second of every baud rate");
+    long rates[MODEM_BAUD_COUNT];
+    long bytesPerSec[MODEM_BAUD_COUNT];
+
+    for (int i = 0; i < MODEM_BAUD_COUNT; i++) {
+        hostReset();
+        Sim808Simulator sim;
+        MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+        rates[i] = modemBaudRates[i];
+        myOptions.modemMaxBaud = rates[i];
+        IS_TRUE(hostBegin(gsmGps, sim));
+        IS_TRUE(sim.baud == rates[i]);
+        sim.setLatency("+CGNSINF", 0);
+        sim.clearStatistics();
+
+        unsigned long startUs = micros();
+        for (int j = 0; j < 20; j++) {
+            gsmGps.sendAT("AT+CGNSINF");
+        }
+        unsigned long us = micros() - startUs;
+
+        bytesPerSec[i] = (long) ((sim.bytesIn + sim.bytesOut) * 1000000ULL / us);
+        TRACE("\n   " << rates[i] << " baud: " << bytesPerSec[i] << " bytes/s");
+        IS_TRUE(i == 0 || bytesPerSec[i] > bytesPerSec[i - 1]);
+    }
+    TRACE("\n");
+    IS_TRUE(bytesPerSec[MODEM_BAUD_COUNT - 1] > 4 * bytesPerSec[0]);
+    END_IT
+}
+
+int test_socket_download() {
+    IT("reads a socket download in big blocks");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+    std::string received;
+
+    sim.setConnector([](const String &host, uint16_t port) { return new DownloadEndpoint(); });
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(gsmGps.gsmClient.connect("10.1.2.3", 80));
+    sim.clearStatistics();
+
+    unsigned long startMs = millis();
+    gsmGps.gsmClient.write((const uint8_t *) "GET", 3);
+    while (received.size() < 4096 && millis() - startMs < 30000) {
+        uint8_t buf[128];
+
+        if (gsmGps.gsmClient.available() > 0) {
+            int n = gsmGps.gsmClient.read(buf, sizeof(buf));
+
+            received.append((const char *) buf, n);
+        }
+    }
+    TRACE("\n   4096 bytes: " << sim.count("+CIPRXGET=2") << " reads, " << sim.count("+CIPRXGET=4") << " polls, " <<
+          millis() - startMs << " ms\n");
+    IS_TRUE(received.size() == 4096);
+    IS_TRUE(received.substr(0, 3) == "abc");
+    IS_TRUE(sim.count("+CIPRXGET=2") <= 4096 / TINY_GSM_RX_BUFFER + 2);
+    // The data is read on the +CIPRXGET: 1 urc, +CIPRXGET=4 only polls every 500 ms.
+    IS_TRUE(sim.count("+CIPRXGET=4") <= (millis() - startMs) / 500 + 1);
+    IS_TRUE(sim.count("+CIPRXGET=4") < sim.count("+CIPRXGET=2"));
+    gsmGps.gsmClient.stop();
+    END_IT
+}
+
+int test_socket_data_urc() {
+    IT("reads the data of a +CIPRXGET: 1 urc from the engine without waiting for the poll");
+    hostReset();
+    Sim808Simulator sim;
+    MyGsmGps gsmGps(myOptions, myData, myTrack, 0, 0);
+
+    sim.setConnector([](const String &host, uint16_t port) { return new DelayedEndpoint(); });
+    IS_TRUE(hostBegin(gsmGps, sim));
+    IS_TRUE(gsmGps.gsmClient.connect("10.1.2.3", 80));
+    gsmGps.gsmClient.write((const uint8_t *) "ping", 4);
+    IS_TRUE(gsmGps.gsmClient.available() == 0);
+    sim.clearStatistics();
+
+    // The urc arrives while the loop pumps the at engine.
+    unsigned long startMs = millis();
+    delay(200);
+    for (int i = 0; i < 50; i++) {
+        gsmGps.handleClient();
+        delay(1);
+    }
+    IS_TRUE(gsmGps.gsmClient.available() == 4);
+    IS_TRUE(millis() - startMs < 500);
+    IS_TRUE(sim.count("+CIPRXGET=4") == 0);
+    IS_TRUE(sim.count("+CIPRXGET=2") == 1);
+
+    uint8_t buf[8];
+    IS_TRUE(gsmGps.gsmClient.read(buf, sizeof(buf)) == 4);
+    IS_TRUE(memcmp(buf, "pong", 4) == 0);
+    gsmGps.gsmClient.stop();
+    END_IT
+}
+
+int main()
+{
+    SUITE("Sim808");
+    test_begin_connects_gprs();
+    test_begin_warm_modem();
+    test_begin_identity_cache();
+    test_sleep_or_power_off();
+    test_begin_after_sleep();
+    test_begin_fails_without_network();
+    test_profile_phases();
+    test_energy_ledger();
+    test_gps_trajectory();
+    test_gps_track_file();
+    test_gsm_location();
+    test_sms_read_and_delete();
+    test_sms_list_recorded();
+    test_sms_batch();
+    test_sms_batch_overflow();
+    test_sms_failed_delete();
+    test_sms_command_answer();
+    test_sms_indication();
+    test_dns();
+    test_signal_and_battery();
+    test_status_compound_query();
+    test_unanswered_command();
+    test_serial_timing();
+    test_baud_negotiation();
+    test_baud_fallback();
+    test_baud_benchmark();
+    test_socket_download();
+    test_socket_data_urc();
+    FINISH
+}
@@ -0,0 +1,99 @@
+#include "TrackerHost.h"
+#include "BDDTest.h"
+#include "trace.h"
+
+
+/** Runs the loop of tracker.ino with the voltage read every 10 ms for the given virtual time. */
+int runVoltage(MyVoltage &voltage, long ms, int noise)
+{
+    int  toggles  = 0;
+    bool lowPower = myData.isLowPower;
+
+    for (long i = 0; i < ms / 10; i++) {
+        if (noise) {
+            setAnalogValue(400 + rand() % (2 * noise + 1) - noise);
+        }
+        voltage.readVoltage();
+        if (myData.isLowPower != lowPower) {
+            lowPower = myData.isLowPower;
+            toggles++;
+        }
+        delay(10);
+    }
+    return toggles;
+}
+
+int test_rate_and_median() {
+    IT("reads the adc only every voltageSampleMs and removes single spikes");
+    hostReset();
+    MyVoltage voltage(myOptions, myData);
+
+    setAnalogValue(400);
+    voltage.begin();
+    IS_TRUE(fabs(myData.voltage - 12.0) < 0.001);
+
+    long reads = getAnalogReads();
+    runVoltage(voltage, 10000, 0);
+    IS_TRUE(getAnalogReads() - reads >= 9 && getAnalogReads() - reads <= 10);
+
+    setAnalogValue(0);
+    runVoltage(voltage, 1000, 0);
+    IS_TRUE(fabs(myData.voltage - 12.0) < 0.001);
+    setAnalogValue(300);
+    runVoltage(voltage, 20000, 0);
+    IS_TRUE(fabs(myData.voltage - 9.0) < 0.1);
+    END_IT
+}
+
+int test_hysteresis_and_statistic() {
+    IT("switches the low power state with hysteresis and collects min, avg and max");
+    hostReset();
+    MyVoltage voltage(myOptions, myData);
+
+    srand(1);
+    myOptions.powerSaveModeVoltage = 12.0;
+    myOptions.voltageSampleMs      = 100;
+    setAnalogValue(410);
+    voltage.begin();
+    IS_FALSE(myData.isLowPower);
+
+    // +-0.15 V noise around the threshold
+    int toggles = runVoltage(voltage, 60000, 5);
+    IS_TRUE(toggles <= 1);
+    IS_TRUE(myData.voltageMin < 12.0);
+    IS_TRUE(myData.voltageMax > 12.0);
+    IS_TRUE(fabs(myData.getVoltageAvg() - 12.0) < 0.1);
+    IS_TRUE(myData.voltageCount >= 590);
+
+    myOptions.powerSaveHysteresis = 0.0;
+    int noHysteresis = runVoltage(voltage, 60000, 5);
+    TRACE("\n   toggles with hysteresis: " << toggles << ", without: " << noHysteresis << "\n");
+    IS_TRUE(noHysteresis > toggles);
+
+    myOptions.powerSaveHysteresis = 0.2;
+    setAnalogValue(410);
+    runVoltage(voltage, 3000, 0);
+    IS_FALSE(myData.isLowPower);
+    setAnalogValue(398);
+    runVoltage(voltage, 3000, 0);
+    IS_TRUE(myData.isLowPower);
+    setAnalogValue(405);
+    runVoltage(voltage, 3000, 0);
+    IS_TRUE(myData.isLowPower);
+
+    String json = myData.getVoltageStatJson();
+    IS_TRUE(json.startsWith("{\"min\":"));
+    IS_TRUE(json.indexOf("\"max\":") > 0);
+    myData.resetVoltageStat();
+    IS_TRUE(myData.voltageCount == 1);
+    IS_TRUE(myData.voltageMin == myData.voltage);
+    END_IT
+}
+
+int main()
+{
+    SUITE("Voltage");
+    test_rate_and_median();
+    test_hysteresis_and_statistic();
+    FINISH
+}
@@ -36,8 +36,13 @@
 #include "Utils.h"
 #include "StringList.h"
 #include "Gps.h"
+#include "Energy.h"
 #include "Options.h"
+#include "Battery.h"
+#include "Profiler.h"
 #include "Data.h"
+#include "Track.h"
+#include "Scheduler.h"
 #include "Voltage.h"
 #include "DeepSleep.h"
 #include "WebServer.h"
@@ -45,6 +50,7 @@
 #include "GsmGps.h"
 #include "SmsCmd.h"
 #include "Mqtt.h"
+#include "Upload.h"
 #include "BME280.h"
 
 
@@ -53,21 +59,25 @@
 #define     BME_ADDRESS   0x77                                      //!< BME280 port address (Default 0x77, China 0x76)
 #define     PIN_TX        D5                                        //!< Transmit-pin to the sim808 RX
 #define     PIN_RX        D6                                        //!< Receive-pin to the sim808 TX
+#define     PIN_WIFI      D7                                        //!< Button to ground which switches on the WiFi
                                                                  
 MyOptions   myOptions;                                              //!< The global options.
 MyData      myData;                                                 //!< The global collected data.
+MyTrack     myTrack(myOptions, myData);                             //!< Gps track backlog in the SPIFFS.
+MyScheduler myScheduler(myOptions, myData, myTrack);                //!< Adaptive interval of the modem wakes.
 MyVoltage   myVoltage(myOptions, myData);                           //!< Helper class for deep sleeps.
-MyDeepSleep myDeepSleep(myOptions, myData);                         //!< Helper class for deep sleeps.
+MyDeepSleep myDeepSleep(myOptions, myData, myScheduler);            //!< Helper class for deep sleeps.
 MyWebServer myWebServer(myOptions, myData);                         //!< The Webserver
 MyBME280    myBME280(myOptions, myData, PIN_BME_GRND, BME_ADDRESS); //!< Helper class for the BME280 sensor communication.
 
 #ifdef SIM808_CONNECTED
-   MyGsmPower  myGsmPower(myData, PIN_POWER);                       //!< Helper class to switch on/off the sim808 power.
-   MyGsmGps    myGsmGps(myOptions, myData, PIN_RX, PIN_TX);         //!< sim808 gsm/gps communication class.
+   MyGsmPower  myGsmPower(myOptions, myData, PIN_POWER);            //!< Helper class to switch on/off the sim808 power.
+   MyGsmGps    myGsmGps(myOptions, myData, myTrack, PIN_RX, PIN_TX); //!< sim808 gsm/gps communication class.
    MySmsCmd    mySmsCmd(myGsmGps, myOptions, myData);               //!< sms controller class for the sms handling.
-   MyMqtt      myMqtt(myGsmGps.gsmClient, myOptions, myData);       //!< Helper class for the mqtt communication via gsm.
+   MyMqtt      myMqtt(myGsmGps.gsmClient, myOptions, myData, myTrack); //!< Helper class for the mqtt communication via gsm.
+   MyUpload    myUpload(myGsmGps.gsmSim808, myOptions, myData, myTrack); //!< Http upload of the track backlog.
 #else                                                               //!< Helper class for the mqtt communication via wifi.
-   MyMqtt      myMqtt(MyWebServer::server.wifiClient(), myOptions, myData); 
+   MyMqtt      myMqtt(MyWebServer::server.wifiClient(), myOptions, myData, myTrack); 
 #endif                                                          
 
 bool        gsmHasPower = false;                                    //!< Is the DC-DC modul switched on?
@@ -124,6 +134,9 @@ void myDelayLoop()
    myWebServer.handleClient();   
    myWebServer.handleClient();   
    myWebServer.handleClient(); 
+#ifdef SIM808_CONNECTED
+   myGsmGps.gsmSerial.handleLog();
+#endif
    delay(1);
    yield();
 }
@@ -134,27 +147,75 @@ long secondsSincePowerOn()
    return myData.secondsSincePowerOn();
 }
 
+/** Overwritten host name resolution for the mqtt server via gsm or wifi. */
+bool myResolveHost(const String &host, IPAddress &ip)
+{
+#ifdef SIM808_CONNECTED
+   return myGsmGps.getHostIp(host, ip);
+#else
+   return WiFi.hostByName(host.c_str(), ip) == 1;
+#endif
+}
+
+#ifdef SIM808_CONNECTED
+/** Starts the WiFi on a request via sms or the button. After a deep sleep with the radio 
+  * switched off the next deep sleep keeps the radio on. If no deep sleep follows because 
+  * the power is not low the esp8266 is restarted for it.
+  */
+void handleWifiRequest()
+{
+   if (digitalRead(PIN_WIFI) == LOW) {
+      myData.rtcData.isWifiRequested = true;
+   }
+   if (!myData.rtcData.isWifiRequested || myWebServer.isWebServerActive) {
+      return;
+   }
+   if (myDeepSleep.isRfAvailable()) {
+      myWebServer.begin();
+   } else if (!myData.isLowPower && !isStarting && !isStopping) {
+      if (myData.isGsmActive) {
+         myMqtt.stop();
+         myGsmGps.stop();
+      }
+      myGsmPower.off();
+      myData.profiler.save();
+      myDeepSleep.restartWithWifi();
+   }
+}
+#endif
+
 /** Main setup function. This is also called after every deep sleep. 
   * Do the initialization of every sub-component. */
 void setup() 
 {
+   // Back to deep sleep before the initialization if the voltage is still low.
+   myDeepSleep.fastSleep();
+
    Serial.begin(115200); 
    delay(1000);
 
    MyDbg(F("Start SnorkTracker ..."));
 
-#ifdef SIM808_CONNECTED
-   myGsmPower.begin();
-#endif
    SPIFFS.begin();
    myOptions.load();
+   myData.profiler.begin();
    myVoltage.begin();
 
    // Back to deep sleep?
    myDeepSleep.begin();
 
-   // no deep sleep!
-   myWebServer.begin();
+#ifdef SIM808_CONNECTED
+   // After the rtc data is read, to know if the sim808 was kept asleep.
+   myGsmPower.begin();
+#endif
+
+   // no deep sleep! WiFi only after a power on or on request.
+   pinMode(PIN_WIFI, INPUT_PULLUP);
+   if (myDeepSleep.isWifiWake()) {
+      myWebServer.begin();
+   } else {
+      myWebServer.stop();
+   }
    myMqtt.begin();
 #ifdef SIM808_CONNECTED
    mySmsCmd.begin();
@@ -189,13 +250,16 @@ void loop()
 
    if (!myMqtt.waitingForMqtt()) {
       if (myDeepSleep.haveToSleep()) {
-         WiFi.disconnect();
-         WiFi.mode(WIFI_OFF);
+         myData.profiler.save();
+         myWebServer.stop();
          yield();
          myDeepSleep.sleep();
       }
    }
 #else
+   handleWifiRequest();
+   myWebServer.handleIdle();
+
    if (!myData.consoleCmds.isEmpty()) {
       String cmd = myData.consoleCmds.removeHead();
 
@@ -221,8 +285,10 @@ void loop()
    if (!myOptions.powerOn && gsmHasPower) {
       if (!isStarting && !isStopping) {
          isStopping = true;
+         myMqtt.stop();
          myGsmGps.stop();
          myGsmPower.off();
+         myData.profiler.save();
          gsmHasPower = false;
          isStopping  = false;   
       }
@@ -232,12 +298,15 @@ void loop()
    if (gsmHasPower && !isStarting && !isStopping) {
       myGsmGps.handleClient();
 
-      // No sms or mqtt if we are waiting for a gps position.
+      // The gps requests run in the background so the sms are handled in the meantime.
+      if (myOptions.isSmsEnabled) {
+         mySmsCmd.handleClient();
+      }
+      // No mqtt if we are waiting for a gps position.
       // Otherwise we are sending invalid gps values.
       if (!myGsmGps.waitingForGps()) {
-         if (myOptions.isSmsEnabled) {
-            mySmsCmd.handleClient();
-         }
+         // A big track backlog is uploaded via http, mqtt sends the live values.
+         myUpload.handleClient();
          if (myOptions.isMqttEnabled) {
             myMqtt.handleClient();
          }
@@ -248,12 +317,20 @@ void loop()
    // (No deep sleep if we are waiting for a valid gps position).
    if (!myGsmGps.waitingForGps() && !myMqtt.waitingForMqtt()) {
       if (myDeepSleep.haveToSleep()) {
-         if (myData.isGsmActive) {
-            myGsmGps.stop();
+         // The sim808 sleeps until the next modem wake, not only until the next power check.
+         if (myData.isGsmActive && myGsmPower.keepAsleep(myScheduler.getWakeSec())) {
+            myMqtt.stop();
+            myGsmGps.sleep();
+            myGsmPower.sleep();
+         } else {
+            if (myData.isGsmActive) {
+               myMqtt.stop();
+               myGsmGps.stop();
+            }
+            myGsmPower.off();
          }
-         myGsmPower.off();
-         WiFi.disconnect();
-         WiFi.mode(WIFI_OFF);
+         myData.profiler.save();
+         myWebServer.stop();
          yield();
          myDeepSleep.sleep();
       }